@@ -1,14 +1,54 @@
 #include <iostream>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
-#include "util/shader.h"
+#include "util/gl_extensions.h"
+#include "util/gl_state_cache.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "util/stb_image.h"
 #include "util/camera.h"
+#include "util/thread_pool.h"
+#include "util/headless_context.h"
+#include "util/image_writer.h"
+#include "util/bvh.h"
+#include "util/gpu_profiler.h"
+#include "util/cpu_profiler.h"
+#include "util/fixed_step_simulation.h"
+#include "util/baked_texture.h"
+#include "util/mip_generator.h"
+#include "util/mesh_file.h"
+#include "util/mesh_importer.h"
+#include "util/gpu_mesh.h"
+#include "util/world.h"
+#include "util/transform_system.h"
+#include "util/transform_hierarchy.h"
+#include "util/mock_gl.h"
+#include "scene.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>	
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 using namespace std;
 
 // ----------------------------------------------------- Global Variables -----------------------------------------------
@@ -20,16 +60,285 @@ Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 float lastX = (float)(SCREEN_WIDTH / 2);
 float lastY = (float)(SCREEN_HEIGHT / 2);
 
-float deltaTime = 0.0f;
-float lastFrame = 0.0f;
+// ------------------------------------------------ Simulation ------------------------------------------------------
+// Advanced in fixed steps apart from rendering: the animation clock and the camera position.
+// The cubes' transforms are a function of the clock, so interpolating it interpolates them
+struct SimulationState {
+	double time;
+	glm::vec3 cameraPosition;
+};
+
+const double SIMULATION_STEP = 1.0 / 60.0;
+
+// Camera velocity the keyboard asks for, set by the render thread and applied by the simulation steps
+mutex cameraVelocityMutex;
+glm::vec3 cameraVelocity(0.0f);
+
+// Advances the simulation by one step
+void stepSimulation(SimulationState& state, double stepSeconds) {
+	glm::vec3 velocity;
+	{
+		lock_guard<mutex> lock(cameraVelocityMutex);
+		velocity = cameraVelocity;
+	}
+	state.cameraPosition += velocity * (float)stepSeconds;
+	state.time += stepSeconds;
+}
 
 bool firstMouse = true;
 
-glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
+// ------------------------------------------------ Command Line ----------------------------------------------------
+struct Options {
+	// Render offscreen without a window, for machines without a display or GPU
+	bool headless = false;
+	int frames = 300;
+	int width = (int)SCREEN_WIDTH;
+	int height = (int)SCREEN_HEIGHT;
+	// Directory that headless frames are written to as PNG, empty to skip capturing
+	string captureDirectory;
+	int captureEvery = 1;
+	// Randomly placed spinning cubes added to the scene, for stress testing
+	int extraCubes = 0;
+	// Static cubes drawn one by one with a random mix of materials, for benchmarking the render queue
+	int mixedDraws = 0;
+	// Execute draws in submission order instead of sorting them, to compare against
+	bool noSort = false;
+	// Map the streaming ring buffer every frame instead of keeping it persistently mapped
+	bool noPersistentMapping = false;
+	// Boxes in the CPU only culling benchmark, 0 runs the renderer instead
+	int cullBenchmark = 0;
+	// Draws in the submission benchmark, which renders them with a growing number of recording threads
+	int submitBenchmark = 0;
+	// Objects the model matrix benchmark builds matrices for, 0 for none
+	int matrixBenchmark = 0;
+	// Largest number of spinning cubes the instancing benchmark draws, going up from 1k by tens, 0 for none
+	int instanceBenchmark = 0;
+	// Side of the square image the CPU mipmap benchmark filters with every kernel, 0 for none
+	int mipBenchmark = 0;
+	// Directory of images the texture benchmark loads serially and streamed, empty for none
+	string textureBenchmark;
+	// Images to bake into compressed textures instead of running, in a CompressedFormat or -1 to pick by transparency
+	vector<string> bakeFiles;
+	int bakeFormat = -1;
+	// Decode the source images even where baked textures exist, to compare against
+	bool noBakedTextures = false;
+	// OBJ or glTF model placed in the scene, empty for none
+	string meshFile;
+	// Models to convert into mesh files instead of running
+	vector<string> convertMeshFiles;
+	// Model the loading benchmark loads by parsing it and from its converted file, empty for none
+	string meshBenchmark;
+	// Cold and warm starts the startup benchmark times each, 0 for none
+	int startupBenchmark = 0;
+	// Model the import benchmark parses with a growing number of threads, empty for none
+	string importBenchmark;
+	// Model the vertex format benchmark packs in every compact format, empty for none
+	string vertexBenchmark;
+	// Entities the ECS benchmark creates, iterates and churns, 0 for none
+	int ecsBenchmark = 0;
+	// Nodes of the hierarchy benchmark, which changes 1% of them a frame, 0 for none
+	int hierarchyBenchmark = 0;
+	// Draws the uniform benchmark sets a matrix and a color for against a mock GL, 0 for none
+	int uniformBenchmark = 0;
+	// Measure passes with GPU timer queries and print their rolling times on exit
+	bool profile = false;
+	// File the profiled passes are written to as a Chrome trace, implies profile
+	string traceFile;
+	// File the CPU zones of every thread are written to as a Chrome trace, implies profile
+	string cpuTraceFile;
+	// Simulation steps per second in headless mode, the windowed simulation always runs at 60
+	int simulationRate = 60;
+	// Headless frame at which every program is rebuilt from source, -1 for none
+	int reloadAt = -1;
+	// Rebuild and swap the programs within that frame instead of in the background
+	bool blockingReload = false;
+};
+
+void printUsage() {
+	cout << "Usage: engine [options]\n"
+		<< "  --headless           render offscreen without a window and print frame timings\n"
+		<< "  --frames N           number of frames to render in headless mode (default 300)\n"
+		<< "  --size WxH           headless framebuffer size (default 800x600)\n"
+		<< "  --capture DIR        write headless frames to DIR as PNG\n"
+		<< "  --capture-every N    only capture every Nth frame (default 1)\n"
+		<< "  --cubes N            add N randomly placed spinning cubes\n"
+		<< "  --mixed-draws N      add N static cubes drawn separately with mixed materials\n"
+		<< "  --no-sort            draw in submission order instead of sorting by state\n"
+		<< "  --no-persistent      map the per frame stream buffer every frame instead of persistently\n"
+		<< "  --profile            time each pass on the CPU and GPU and every CPU zone, print the results on exit\n"
+		<< "  --trace FILE         profile and write the passes to FILE as Chrome trace JSON\n"
+		<< "  --cpu-trace FILE     profile and write the CPU zones of all threads to FILE as Chrome trace JSON\n"
+		<< "  --sim-rate HZ        headless simulation steps per second, frames interpolate between them (default 60)\n"
+		<< "  --reload-at N        rebuild all shaders at headless frame N and report the hitch\n"
+		<< "  --blocking-reload    rebuild them on the render thread within that frame instead of in the background\n"
+		<< "  --cull-bench N       time BVH frustum culling of N boxes on the CPU, no rendering\n"
+		<< "  --submit-bench N     time submitting N draws offscreen while recording them on 1, 2, 4... threads\n"
+		<< "  --instance-bench N   time frames drawing 1k, 10k... up to N instanced spinning cubes offscreen\n"
+		<< "  --matrix-bench N     time building 10k, 100k... up to N model matrices with glm and each SIMD kernel, no rendering\n"
+		<< "  --mip-bench N        time building mip chains of an NxN image with the scalar and SIMD filters, no rendering\n"
+		<< "  --texture-bench DIR  time loading every image in DIR with a serial stbi_load loop and streamed on 1, 2, 4... threads\n"
+		<< "  --bake FILE          bake an image and its mipmaps into a compressed texture the engine loads instead, repeatable\n"
+		<< "  --bake-format F      bc1, bc3 or bc7 (default bc1 for opaque images, bc3 for ones with alpha)\n"
+		<< "  --no-baked           decode the source images even where baked textures exist\n"
+		<< "  --mesh FILE          place an OBJ, glTF or GLB model in the scene, loaded from its converted file when there is one\n"
+		<< "  --convert-mesh FILE  convert a model into a quantized mesh file the engine maps instead, repeatable\n"
+		<< "  --mesh-bench FILE    time loading a model by parsing it and from its converted file, with peak memory\n"
+		<< "  --startup-bench N    start the scene N times in fresh processes with and without cached programs, print the time to the first frame\n"
+		<< "  --import-bench FILE  time parsing a model on 1, 2, 4... threads and print the MB/s per core\n"
+		<< "  --vertex-bench FILE  pack a model's vertices in each compact format, print the memory, fetch bandwidth and precision\n"
+		<< "  --ecs-bench N        time creating, iterating on 1, 2, 4... threads and churning N entities, no rendering\n"
+		<< "  --hierarchy-bench N  time updating an N node transform hierarchy with 1% of the nodes changing a frame, no rendering\n"
+		<< "  --uniform-bench N    time setting uniforms for N draws by querying locations, by name and by location, against a mock GL" << endl;
+}
+
+// Returns false if the arguments can't be parsed
+bool parseOptions(int argc, char** argv, Options& options) {
+	for (int i = 1; i < argc; i++) {
+		string argument = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (argument == "--headless") {
+			options.headless = true;
+		}
+		else if (argument == "--frames" && hasValue) {
+			options.frames = atoi(argv[++i]);
+		}
+		else if (argument == "--size" && hasValue) {
+			if (sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2) {
+				return false;
+			}
+		}
+		else if (argument == "--capture" && hasValue) {
+			options.captureDirectory = argv[++i];
+		}
+		else if (argument == "--capture-every" && hasValue) {
+			options.captureEvery = atoi(argv[++i]);
+		}
+		else if (argument == "--cubes" && hasValue) {
+			options.extraCubes = atoi(argv[++i]);
+		}
+		else if (argument == "--mixed-draws" && hasValue) {
+			options.mixedDraws = atoi(argv[++i]);
+		}
+		else if (argument == "--no-sort") {
+			options.noSort = true;
+		}
+		else if (argument == "--no-persistent") {
+			options.noPersistentMapping = true;
+		}
+		else if (argument == "--profile") {
+			options.profile = true;
+		}
+		else if (argument == "--trace" && hasValue) {
+			options.traceFile = argv[++i];
+			options.profile = true;
+		}
+		else if (argument == "--cpu-trace" && hasValue) {
+			options.cpuTraceFile = argv[++i];
+			options.profile = true;
+		}
+		else if (argument == "--sim-rate" && hasValue) {
+			options.simulationRate = atoi(argv[++i]);
+		}
+		else if (argument == "--reload-at" && hasValue) {
+			options.reloadAt = atoi(argv[++i]);
+		}
+		else if (argument == "--blocking-reload") {
+			options.blockingReload = true;
+		}
+		else if (argument == "--cull-bench" && hasValue) {
+			options.cullBenchmark = atoi(argv[++i]);
+		}
+		else if (argument == "--submit-bench" && hasValue) {
+			options.submitBenchmark = atoi(argv[++i]);
+		}
+		else if (argument == "--instance-bench" && hasValue) {
+			options.instanceBenchmark = atoi(argv[++i]);
+		}
+		else if (argument == "--matrix-bench" && hasValue) {
+			options.matrixBenchmark = atoi(argv[++i]);
+		}
+		else if (argument == "--mip-bench" && hasValue) {
+			options.mipBenchmark = atoi(argv[++i]);
+		}
+		else if (argument == "--texture-bench" && hasValue) {
+			options.textureBenchmark = argv[++i];
+		}
+		else if (argument == "--bake" && hasValue) {
+			options.bakeFiles.push_back(argv[++i]);
+		}
+		else if (argument == "--bake-format" && hasValue) {
+			CompressedFormat format;
+			if (!parseCompressedFormat(argv[++i], format)) {
+				return false;
+			}
+			options.bakeFormat = format;
+		}
+		else if (argument == "--no-baked") {
+			options.noBakedTextures = true;
+		}
+		else if (argument == "--mesh" && hasValue) {
+			options.meshFile = argv[++i];
+		}
+		else if (argument == "--convert-mesh" && hasValue) {
+			options.convertMeshFiles.push_back(argv[++i]);
+		}
+		else if (argument == "--mesh-bench" && hasValue) {
+			options.meshBenchmark = argv[++i];
+		}
+		else if (argument == "--startup-bench" && hasValue) {
+			options.startupBenchmark = atoi(argv[++i]);
+		}
+		else if (argument == "--import-bench" && hasValue) {
+			options.importBenchmark = argv[++i];
+		}
+		else if (argument == "--vertex-bench" && hasValue) {
+			options.vertexBenchmark = argv[++i];
+		}
+		else if (argument == "--ecs-bench" && hasValue) {
+			options.ecsBenchmark = atoi(argv[++i]);
+		}
+		else if (argument == "--hierarchy-bench" && hasValue) {
+			options.hierarchyBenchmark = atoi(argv[++i]);
+		}
+		else if (argument == "--uniform-bench" && hasValue) {
+			options.uniformBenchmark = atoi(argv[++i]);
+		}
+		else {
+			return false;
+		}
+	}
+	return options.frames > 0 && options.width > 0 && options.height > 0 && options.captureEvery > 0 && options.extraCubes >= 0 && options.mixedDraws >= 0 && options.cullBenchmark >= 0 && options.submitBenchmark >= 0 && options.instanceBenchmark >= 0 && options.matrixBenchmark >= 0 && options.mipBenchmark >= 0 && options.ecsBenchmark >= 0 && options.hierarchyBenchmark >= 0 && options.startupBenchmark >= 0 && options.uniformBenchmark >= 0 && options.simulationRate > 0;
+}
+
+// Prints the average number of state calls per frame that reached the driver and that the state cache dropped
+void printStateCounters(const GLStateCache::Counters& totals, int frames) {
+	static const char* CATEGORY_NAMES[GLStateCache::CATEGORY_COUNT] = { "program", "vao", "buffer", "texture", "raster", "uniform" };
+	if (frames <= 0) {
+		return;
+	}
+	cout << "State calls per frame: " << (double)totals.totalIssued() / frames << " issued, " << (double)totals.totalFiltered() / frames << " filtered (";
+	for (int category = 0; category < GLStateCache::CATEGORY_COUNT; category++) {
+		cout << (category > 0 ? ", " : "") << CATEGORY_NAMES[category] << " " << (double)totals.issued[category] / frames << "/" << (double)totals.filtered[category] / frames;
+	}
+	cout << ")" << endl;
+}
+
+// Prints the render queue's average draws, state switches and CPU time per frame
+void printQueueStats(const RenderQueueStats& totals, int frames) {
+	if (frames <= 0) {
+		return;
+	}
+	cout << "Render queue per frame: " << totals.draws / frames << " draws, " << (double)totals.programChanges / frames << " program / "
+		<< (double)totals.materialChanges / frames << " material / " << (double)totals.geometryChanges / frames << " geometry changes, sort "
+		<< totals.sortMicroseconds / frames << " us, execute " << totals.executeMicroseconds / frames << " us (record "
+		<< totals.recordMicroseconds / frames << " us in " << (double)totals.recordSlices / frames << " slices, replay " << totals.replayMicroseconds / frames
+		<< " us, " << totals.commandBytes / frames / 1024 << " KB of commands)" << endl;
+}
 
 // ------------------------ Function to properly resize the window -------------------------------------
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-	glViewport(0, 0, width, height);
+	GLStateCache::current().viewport(0, 0, width, height);
 }
 
 // ----------------------------- Contains all our code to process user input ---------------------------
@@ -40,23 +349,17 @@ void processInput(GLFWwindow* window) {
 		glfwSetWindowShouldClose(window, true);
 	}
 
-	// W key
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-		camera.ProcessKeyboard(FORWARD, deltaTime);
-	}
-	// A key
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-		camera.ProcessKeyboard(LEFT, deltaTime);
-	}
-	
-	// S key
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-		camera.ProcessKeyboard(BACKWARD, deltaTime);
-	}
-	// D key
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-		camera.ProcessKeyboard(RIGHT, deltaTime);
+	// WASD move the camera, the simulation thread integrates the velocity in fixed steps
+	glm::vec3 velocity(0.0f);
+	const int keys[] = { GLFW_KEY_W, GLFW_KEY_A, GLFW_KEY_S, GLFW_KEY_D };
+	const Camera_Movement directions[] = { FORWARD, LEFT, BACKWARD, RIGHT };
+	for (int i = 0; i < 4; i++) {
+		if (glfwGetKey(window, keys[i]) == GLFW_PRESS) {
+			velocity += camera.GetMovementVelocity(directions[i]);
+		}
 	}
+	lock_guard<mutex> lock(cameraVelocityMutex);
+	cameraVelocity = velocity;
 }
 
 // ------------------------------------------------ Process Mouse Input -------------------------------------------
@@ -82,9 +385,59 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
 	camera.ProcessMouseScroll(yoffset);
 }
-// ------------------------------------------ Main -----------------------------------------------------
-int main() {
+// ----------------------------------------------- Timing Stats ----------------------------------------------------
+// Prints min, median, 99th percentile and mean of a set of timings in milliseconds
+void printTimingStats(const char* label, vector<double> times) {
+	if (times.empty()) {
+		cout << label << ": no samples" << endl;
+		return;
+	}
+	sort(times.begin(), times.end());
+	double total = 0.0;
+	for (double time : times) {
+		total += time;
+	}
+	size_t p99 = (size_t)ceil(times.size() * 0.99) - 1;
+	cout << label << " ms: min " << times.front() << "  median " << times[times.size() / 2] << "  p99 " << times[p99] << "  mean " << total / times.size() << "  (" << times.size() << " frames)" << endl;
+}
 
+// Creates the pass profiler and starts recording CPU zones if profiling was asked for
+unique_ptr<GpuProfiler> startProfile(const Options& options, Scene& scene) {
+	unique_ptr<GpuProfiler> profiler;
+	if (options.profile) {
+		profiler.reset(new GpuProfiler());
+		profiler->captureTrace(!options.traceFile.empty());
+		scene.profiler = profiler.get();
+
+		CpuProfiler::current().captureTrace(!options.cpuTraceFile.empty());
+		CpuProfiler::current().enable(true);
+	}
+	return profiler;
+}
+
+// Prints the profiled passes and zones and writes the traces that were asked for
+void finishProfile(GpuProfiler& profiler, const Options& options) {
+	profiler.collectAll();
+	cout << "Passes (" << profiler.lateFrames() << " frames read before their queries were ready):" << endl;
+	profiler.report(cout);
+
+	CpuProfiler& cpuProfiler = CpuProfiler::current();
+	cpuProfiler.enable(false);
+	cout << "CPU zones (" << cpuProfiler.measureOverhead() << " ns per zone):" << endl;
+	cpuProfiler.report(cout);
+
+	const string* traces[2] = { &options.traceFile, &options.cpuTraceFile };
+	for (int i = 0; i < 2; i++) {
+		if (traces[i]->empty()) {
+			continue;
+		}
+		bool written = i == 0 ? profiler.writeChromeTrace(*traces[i]) : cpuProfiler.writeChromeTrace(*traces[i]);
+		cout << (written ? "Trace written to " : "Failed to write ") << *traces[i] << endl;
+	}
+}
+
+// ------------------------------------------------ Windowed Mode ---------------------------------------------------
+int runWindowed(const Options& options) {
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -104,6 +457,8 @@ int main() {
 		cout << "Failed to initialize GLAD" << endl;
 		return -1;
 	}
+	loadGLExtensions((GLADloadproc)glfwGetProcAddress);
+	GLStateCache::current().invalidate();
 	// ------------------------------------------------ Callbacks -------------------------------------------------------
 	// Adjusts the viewport if the window is resized ensuring that proper coordinate mapping occurs
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
@@ -114,317 +469,1626 @@ int main() {
 	// Scroll wheel for zoom
 	glfwSetScrollCallback(window, scroll_callback);
 
-	// ----------------------------------------- Shader Program -------------------------------------------
-	Shader threeDShaderProgram("shaders/vertex/3dVertexShader.txt", "shaders/fragment/3dFragmentShader.txt");
-	Shader simpleShader("shaders/vertex/simpleVertexShader.txt", "shaders/fragment/simpleFragmentShader.txt");
-	Shader lightingShader("shaders/vertex/simpleVertexShader.txt", "shaders/fragment/lightingFragmentShader.txt");
-
-	// Create VBO, an ID for our buffer, and assigns it to our variable VBO
-	// A buffer object is an object that stores data in memory	
-	unsigned int VBOs[2], VAOs[2];
-	glGenBuffers(2, VBOs);
-	glGenVertexArrays(2, VAOs);
-
-	// ------------------------------------------ tau cube ---------------------------------------------------------------
-	float textured_cube[] = {
-	-0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
-	 0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
-	 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-	 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-	-0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
-	-0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
-
-	-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-	 0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-	 0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-	 0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
-	-0.5f,  0.5f,  0.5f,  0.0f, 1.0f,
-	-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-
-	-0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-	-0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-	-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-	-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-	-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-	-0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-	 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-	 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-	 0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-	 0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-	 0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-	 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-
-	-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-	 0.5f, -0.5f, -0.5f,  1.0f, 1.0f,
-	 0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-	 0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
-	-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
-	-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
-
-	-0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
-	 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
-	 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-	 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
-	-0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
-	-0.5f,  0.5f, -0.5f,  0.0f, 1.0f
-	};
+	GLStateCache::current().setEnabled(GL_DEPTH_TEST, true);
+	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED); // capture mouse input
 
-	glBindVertexArray(VAOs[0]);
-	glBindBuffer(GL_ARRAY_BUFFER, VBOs[0]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(textured_cube), textured_cube, GL_STATIC_DRAW);
-
-	// Pos coords
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	// texture coords
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-
-
-	// ------------------------------------------ Dupe Cubes ------------------------------------------------------------
-	glm::vec3 tau_cubes[] = {
-		// glm::vec3(0.0f,  0.0f,  0.0f),
-		glm::vec3(2.0f,  5.0f, -15.0f),
-		glm::vec3(-1.5f, -2.2f, -2.5f),
-		glm::vec3(-3.8f, -2.0f, -12.3f),
-		glm::vec3(2.4f, -0.4f, -3.5f),
-		glm::vec3(-1.7f,  3.0f, -7.5f),
-		glm::vec3(1.3f, -2.0f, -2.5f),
-		glm::vec3(1.5f,  2.0f, -2.5f),
-		glm::vec3(1.5f,  0.2f, -1.5f),
-		glm::vec3(-1.3f,  1.0f, -1.5f)
-	};
+	// The scene is scoped so its GL objects are freed before the context goes away
+	{
+		// Worker threads shared by texture decoding and transform updates
+		ThreadPool workerPool;
+		Scene scene(workerPool, options.extraCubes, options.mixedDraws, !options.noPersistentMapping, !options.noBakedTextures);
+		scene.sortDraws = !options.noSort;
+		scene.watchShaders();
+		if (!options.meshFile.empty() && !scene.loadModel(options.meshFile)) {
+			cout << "Failed to load " << options.meshFile << endl;
+		}
 
-	// ---------------------------------------- Blank Cube --------------------------------------------
-	float cube[] = {
-	-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-	 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-	 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-	 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-	-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-	-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
-
-	-0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
-	 0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
-	 0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
-	 0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
-	-0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
-	-0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
-
-	-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
-	-0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
-	-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
-	-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
-	-0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
-	-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
-
-	 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-	 0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
-	 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
-	 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
-	 0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-	 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-
-	-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
-	 0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
-	 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
-	 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
-	-0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
-	-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
-
-	-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,
-	 0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,
-	 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
-	 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
-	-0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
-	-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f
-	};
+		unique_ptr<GpuProfiler> profiler = startProfile(options, scene);
+
+		// Simulation runs on its own thread, frames draw the state one step back, interpolated
+		FixedStepSimulation<SimulationState> simulation(SIMULATION_STEP, SimulationState{ 0.0, camera.Position }, stepSimulation);
+		simulation.start();
+
+		// -------------------------------------------- Render Loop ----------------------------------------
+		while (!glfwWindowShouldClose(window)) {
+			GLStateCache::current().beginFrame();
+			if (profiler) {
+				profiler->beginFrame();
+			}
+
+			// Process inputs
+			{
+				PROFILE_ZONE("Input");
+				processInput(window);
+			}
+			scene.update();
+
+			// Rendering stuff
+			{
+				GpuProfileScope clearScope(profiler.get(), "Clear");
+				glClearColor(0.1f, 0.1f, 0.1f, 1.0f); // Set the clear color
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // clear using the color
+			}
+
+			SimulationState previous, current;
+			float blend = simulation.sample(simulation.now() - simulation.stepSeconds(), previous, current);
+			camera.Position = glm::mix(previous.cameraPosition, current.cameraPosition, blend);
+			float currTime = (float)(previous.time + (current.time - previous.time) * blend);
+
+			glm::mat4 view, projection;
+			{
+				PROFILE_ZONE("Camera matrices");
+				view = camera.GetViewMatrix();
+
+				// FOV, aspect ratio, near matrix, far matrix
+				projection = camera.GetProjectionMatrix(16.0f / 10.0f, 0.1f, 100.0f);
+			}
+
+			scene.render(currTime, view, projection);
+			if (profiler) {
+				profiler->endFrame();
+			}
+
+			{
+				PROFILE_ZONE("Swap buffers");
+				glfwSwapBuffers(window);
+				glfwPollEvents();
+			}
+			CpuProfiler::current().endFrame();
+		}
 
-	glBindVertexArray(VAOs[1]);
-	glBindBuffer(GL_ARRAY_BUFFER, VBOs[1]);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cube), cube, GL_STATIC_DRAW);
+		if (profiler) {
+			finishProfile(*profiler, options);
+		}
+	}
 
-	// pos coords
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
+	// Exit and close the window
+	glfwTerminate();
+	return 0;
+}
 
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
+// ------------------------------------------------ Headless Mode ---------------------------------------------------
+// Makes a GL 3.3 context current without showing anything, through EGL where it's available and a hidden window
+// otherwise, which is returned in hiddenWindow. Returns false if neither works
+bool createHeadlessContext(HeadlessContext& headlessContext, GLFWwindow*& hiddenWindow, const Options& options) {
+	// EGL needs no display at all, a hidden window is the fallback where it isn't available
+	hiddenWindow = NULL;
+	GLADloadproc loader = NULL;
+	if (headlessContext.create(3, 3)) {
+		loader = headlessContext.loader();
+	}
+	else {
+		cout << "No headless EGL context, falling back to a hidden window" << endl;
+		glfwInit();
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		hiddenWindow = glfwCreateWindow(options.width, options.height, "OpenGL Graphics Engine", NULL, NULL);
+		if (hiddenWindow == NULL) {
+			cout << "Failed to create GLFW window" << endl;
+			glfwTerminate();
+			return false;
+		}
+		glfwMakeContextCurrent(hiddenWindow);
+		loader = (GLADloadproc)glfwGetProcAddress;
+	}
+
+	if (!gladLoadGLLoader(loader)) {
+		cout << "Failed to initialize GLAD" << endl;
+		return false;
+	}
+	loadGLExtensions(loader);
+	GLStateCache::current().invalidate();
+	cout << "Renderer: " << glGetString(GL_RENDERER) << " (" << glGetString(GL_VERSION) << ")" << endl;
+	return true;
+}
+
+// Framebuffer headless frames are drawn into, since a headless context has no default one
+struct OffscreenTarget {
+	unsigned int framebuffer;
+	unsigned int colorBuffer;
+	unsigned int depthBuffer;
+};
+
+// Creates and binds a color and depth target of the given size
+OffscreenTarget createOffscreenTarget(int width, int height) {
+	OffscreenTarget target;
+	glGenFramebuffers(1, &target.framebuffer);
+	glGenRenderbuffers(1, &target.colorBuffer);
+	glGenRenderbuffers(1, &target.depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, target.colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, target.depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target.depthBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		cout << "Offscreen framebuffer is incomplete" << endl;
+	}
+	GLStateCache::current().viewport(0, 0, width, height);
+	GLStateCache::current().setEnabled(GL_DEPTH_TEST, true);
+	return target;
+}
 
+// Unbinds and deletes an offscreen target
+void destroyOffscreenTarget(const OffscreenTarget& target) {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &target.framebuffer);
+	glDeleteRenderbuffers(1, &target.colorBuffer);
+	glDeleteRenderbuffers(1, &target.depthBuffer);
+}
+
+// Renders a fixed number of frames offscreen along a scripted camera path, optionally saves them as PNG
+// and prints per frame CPU and GPU timings
+int runHeadless(const Options& options) {
+	chrono::steady_clock::time_point launchTime = chrono::steady_clock::now();
+
+	HeadlessContext headlessContext;
+	GLFWwindow* hiddenWindow;
+	if (!createHeadlessContext(headlessContext, hiddenWindow, options)) {
+		return -1;
+	}
 
-	// -------------------------------------------- Textures -------------------------------------------
-	unsigned int tau_texture, container_texture;
-	glGenTextures(1, &tau_texture);
-	glBindTexture(GL_TEXTURE_2D, tau_texture);
+	{
+		OffscreenTarget target = createOffscreenTarget(options.width, options.height);
 
-	int widthContainer, heightContainer, numColorChannelsContainer;
-	// last argument = desired number of channels, leave at 0 to keep original
-	unsigned char* dataTextureContainer = stbi_load("textures/cat.jpg", &widthContainer, &heightContainer, &numColorChannelsContainer, 0);
+		ThreadPool workerPool;
+		Scene scene(workerPool, options.extraCubes, options.mixedDraws, !options.noPersistentMapping, !options.noBakedTextures);
+		scene.sortDraws = !options.noSort;
+		cout << "Spinning cubes: " << scene.cubeCount() << endl;
+		if (!options.meshFile.empty() && !scene.loadModel(options.meshFile)) {
+			cout << "Failed to load " << options.meshFile << endl;
+		}
 
-	// Setting texture wrapping params
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		unique_ptr<GpuProfiler> profiler = startProfile(options, scene);
 
-	// Setting texture filtering params
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		// Let texture streaming finish first so captured frames don't depend on decode timing
+		while (scene.pendingTextures() > 0) {
+			scene.update();
+		}
+		double startupTime = chrono::duration<double, milli>(chrono::steady_clock::now() - launchTime).count();
+
+		// GPU times are read a few frames late so waiting on a query never stalls the pipeline
+		const int QUERY_LATENCY = 4;
+		unsigned int timerQueries[QUERY_LATENCY];
+		glGenQueries(QUERY_LATENCY, timerQueries);
+
+		vector<double> cpuTimes, gpuTimes;
+		vector<unsigned char> pixels;
+		GLStateCache::Counters stateTotals = {};
+		RenderQueueStats queueTotals = {};
+		size_t visibleCubeTotal = 0;
+		double firstFrameTime = 0.0;
+
+		// Frames from starting the shader reload until the new programs were swapped in, and the slowest of them
+		int reloadFrames = 0;
+		double reloadWorstFrame = 0.0;
+
+		const float FRAME_STEP = 1.0f / 60.0f;
+		const glm::vec3 orbitCenter(0.0f, 0.0f, -6.0f);
+
+		// Stepped on this thread rather than its own, so every run simulates and renders exactly the same frames
+		FixedStepSimulation<SimulationState> simulation(1.0 / options.simulationRate, SimulationState{ 0.0, camera.Position }, stepSimulation);
+
+		for (int frame = 0; frame < options.frames; frame++) {
+			chrono::steady_clock::time_point frameStart = chrono::steady_clock::now();
+
+			// Frames advance at a fixed rate too and, like the windowed loop, draw the simulation one step back
+			double frameTime = frame * FRAME_STEP;
+			simulation.advanceTo(frameTime + simulation.stepSeconds());
+			SimulationState previous, current;
+			float blend = simulation.sample(frameTime, previous, current);
+			float time = (float)(previous.time + (current.time - previous.time) * blend);
+
+			// Scripted camera, one orbit around the cube field every ten seconds
+			float orbitAngle = time * glm::radians(36.0f);
+			camera.Position = orbitCenter + glm::vec3(sin(orbitAngle) * 12.0f, 3.0f, cos(orbitAngle) * 12.0f);
+			camera.LookAt(orbitCenter);
+
+			GLStateCache::current().beginFrame();
+			if (profiler) {
+				profiler->beginFrame();
+			}
+			glBeginQuery(GL_TIME_ELAPSED, timerQueries[frame % QUERY_LATENCY]);
+			if (frame == options.reloadAt) {
+				scene.reloadShaders(options.blockingReload);
+			}
+			bool reloading = frame == options.reloadAt || scene.pendingReloads() > 0;
+			scene.update();
+
+			{
+				GpuProfileScope clearScope(profiler.get(), "Clear");
+				glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			}
+
+			glm::mat4 view, projection;
+			{
+				PROFILE_ZONE("Camera matrices");
+				view = camera.GetViewMatrix();
+				projection = camera.GetProjectionMatrix((float)options.width / (float)options.height, 0.1f, 100.0f);
+			}
+			scene.render(time, view, projection);
+			glEndQuery(GL_TIME_ELAPSED);
+			if (profiler) {
+				profiler->endFrame();
+			}
+
+			// The first frame pays for lazy driver work and is reported on its own instead of in the stats
+			if (frame == 0) {
+				glFinish();
+				firstFrameTime = chrono::duration<double, milli>(chrono::steady_clock::now() - launchTime).count();
+			}
+			else {
+				cpuTimes.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - frameStart).count());
+				if (reloading) {
+					reloadFrames++;
+					reloadWorstFrame = max(reloadWorstFrame, cpuTimes.back());
+				}
+
+				const GLStateCache::Counters& counters = GLStateCache::current().frame();
+				for (int category = 0; category < GLStateCache::CATEGORY_COUNT; category++) {
+					stateTotals.issued[category] += counters.issued[category];
+					stateTotals.filtered[category] += counters.filtered[category];
+				}
+
+				visibleCubeTotal += scene.visibleCubeCount();
+
+				const RenderQueueStats& queue = scene.queueStats();
+				queueTotals.draws += queue.draws;
+				queueTotals.programChanges += queue.programChanges;
+				queueTotals.materialChanges += queue.materialChanges;
+				queueTotals.geometryChanges += queue.geometryChanges;
+				queueTotals.sortMicroseconds += queue.sortMicroseconds;
+				queueTotals.executeMicroseconds += queue.executeMicroseconds;
+				queueTotals.recordMicroseconds += queue.recordMicroseconds;
+				queueTotals.replayMicroseconds += queue.replayMicroseconds;
+				queueTotals.recordSlices += queue.recordSlices;
+				queueTotals.commandBytes += queue.commandBytes;
+			}
+
+			if (frame >= QUERY_LATENCY) {
+				GLuint64 elapsed = 0;
+				glGetQueryObjectui64v(timerQueries[(frame - QUERY_LATENCY + 1) % QUERY_LATENCY], GL_QUERY_RESULT, &elapsed);
+				gpuTimes.push_back(elapsed / 1.0e6);
+			}
+
+			if (!options.captureDirectory.empty() && frame % options.captureEvery == 0) {
+				PROFILE_ZONE("Capture");
+				pixels.resize((size_t)options.width * options.height * 4);
+				glPixelStorei(GL_PACK_ALIGNMENT, 1);
+				glReadPixels(0, 0, options.width, options.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+				char fileName[32];
+				snprintf(fileName, sizeof(fileName), "/frame_%05d.png", frame);
+				if (!writePNG(options.captureDirectory + fileName, options.width, options.height, 4, pixels.data(), true)) {
+					cout << "Failed to write " << options.captureDirectory << fileName << endl;
+				}
+			}
+			CpuProfiler::current().endFrame();
+		}
 
+		// Collect the queries of the last few frames
+		for (int frame = max(options.frames - QUERY_LATENCY + 1, 1); frame < options.frames; frame++) {
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(timerQueries[frame % QUERY_LATENCY], GL_QUERY_RESULT, &elapsed);
+			gpuTimes.push_back(elapsed / 1.0e6);
+		}
 
-	if (dataTextureContainer) {
-		// now that texture is bound, we can generate it
-		// first target: texture target
-		// 2nd arg: mipmap level, we leave it at the base val = 0
-		// 3rd arg: what format we want to store the texture, we use RBG
-		// 4 + 5th arg: width + height
-		// 6th: legacy stuff, should always be 0
-		// 7 + 8th: format + datatype of source image, we loaded image as RGB and stores as chars (bytes)
-		// 9th: our actual image data
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, widthContainer, heightContainer, 0, GL_RGB, GL_UNSIGNED_BYTE, dataTextureContainer);
-		// generate all the required mipmaps for the currently bound texture.
-		glGenerateMipmap(GL_TEXTURE_2D);
+		cout << "Startup: " << startupTime << " ms, first frame done after " << firstFrameTime << " ms" << endl;
+		const TextureStreamerStats& textureTotals = scene.textureStats();
+		cout << "Textures: " << textureTotals.loaded << " loaded (" << textureTotals.baked << " baked), decoding took " << textureTotals.decodeMilliseconds
+			<< " ms and mipmaps " << textureTotals.mipMilliseconds << " ms on the workers, uploading " << textureTotals.uploadMilliseconds << " ms on the render thread, " << textureTotals.residentBytes / 1024
+			<< " KB of video memory" << endl;
+		printTimingStats("CPU frame", cpuTimes);
+		printTimingStats("GPU frame", gpuTimes);
+		printStateCounters(stateTotals, (int)cpuTimes.size());
+		printQueueStats(queueTotals, (int)cpuTimes.size());
+		const StreamBufferStats& streamTotals = scene.streamBuffer().total();
+		cout << "Stream buffer: " << streamTotals.bytesUsed / options.frames / 1024 << " KB per frame, " << streamTotals.stalls << " stalls waiting "
+			<< streamTotals.stallMilliseconds << " ms in total, " << streamTotals.overflows << " overflows" << endl;
+		if (!cpuTimes.empty()) {
+			cout << "Visible spinning cubes per frame: " << visibleCubeTotal / cpuTimes.size() << " of " << scene.cubeCount() << endl;
+		}
+		if (reloadFrames > 0) {
+			cout << (options.blockingReload ? "Blocking" : "Background") << " shader reload: swapped in after " << reloadFrames
+				<< " frames, worst of them " << reloadWorstFrame << " ms (driver " << (GLEXT_KHR_parallel_shader_compile ? "compiles" : "can't compile")
+				<< " in the background)" << endl;
+		}
+		if (profiler) {
+			finishProfile(*profiler, options);
+		}
+
+		glDeleteQueries(QUERY_LATENCY, timerQueries);
+		destroyOffscreenTarget(target);
 	}
-	else {
-		cout << "Failed to load texture" << endl;
+
+	if (hiddenWindow) {
+		glfwTerminate();
 	}
-	
+	return 0;
+}
 
-	// Cleanup, free image in memory
-	stbi_image_free(dataTextureContainer);
-
-	glGenTextures(1, &container_texture);
-	glBindTexture(GL_TEXTURE_2D, container_texture);
-	int width, height, numColorChannels;
-	// last argument = desired number of channels, leave at 0 to keep original
-	unsigned char* data = stbi_load("textures/container.jpg", &width, &height, &numColorChannels, 0);
-
-	if (data) {
-		// now that texture is bound, we can generate it
-		// first target: texture target
-		// 2nd arg: mipmap level, we leave it at the base val = 0
-		// 3rd arg: what format we want to store the texture, we use RBG
-		// 4 + 5th arg: width + height
-		// 6th: legacy stuff, should always be 0
-		// 7 + 8th: format + datatype of source image, we loaded image as RGB and stores as chars (bytes)
-		// 9th: our actual image data
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		// generate all the required mipmaps for the currently bound texture.
-		glGenerateMipmap(GL_TEXTURE_2D);
+// ----------------------------------------- Culling Benchmark -----------------------------------------
+// Culls a field of random boxes with the BVH along the headless camera path and compares it to testing every box,
+// no GL involved so it measures the CPU side alone
+int runCullBenchmark(const Options& options) {
+	size_t boxCount = (size_t)options.cullBenchmark;
+	const float FIELD_SIZE = 200.0f;
+
+	// Boxes of 0.5 to 2 units scattered through the field with a fixed seed
+	mt19937 random(1234);
+	uniform_real_distribution<float> spread(-FIELD_SIZE, FIELD_SIZE);
+	uniform_real_distribution<float> halfSize(0.25f, 1.0f);
+	vector<AABB> boxes(boxCount);
+	for (AABB& box : boxes) {
+		glm::vec3 center(spread(random), spread(random), spread(random));
+		glm::vec3 extent(halfSize(random), halfSize(random), halfSize(random));
+		box = AABB{ center - extent, center + extent };
 	}
-	else {
-		cout << "Failed to load texture" << endl;
+
+	BVH bvh;
+	chrono::steady_clock::time_point buildStart = chrono::steady_clock::now();
+	bvh.build(boxes.data(), boxes.size());
+	double buildTime = chrono::duration<double, milli>(chrono::steady_clock::now() - buildStart).count();
+	cout << "Culling " << boxCount << " boxes, BVH built in " << buildTime << " ms (" << bvh.nodeCount() << " nodes)" << endl;
+
+	vector<uint32_t> visible, reference;
+	vector<double> cullTimes, bruteForceTimes, refitTimes;
+	double culledFraction = 0.0;
+	bool matches = true;
+
+	const float FRAME_STEP = 1.0f / 60.0f;
+	for (int frame = 0; frame < options.frames; frame++) {
+		// Every box drifts a little each frame, then the tree is refit around the new bounds
+		float time = frame * FRAME_STEP;
+		glm::vec3 drift(sin(time) * 0.01f, cos(time) * 0.01f, 0.0f);
+		for (AABB& box : boxes) {
+			box.min += drift;
+			box.max += drift;
+		}
+		chrono::steady_clock::time_point refitStart = chrono::steady_clock::now();
+		bvh.refit(boxes.data());
+		refitTimes.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - refitStart).count());
+
+		// Same orbit as the headless renderer, scaled to the field
+		float orbitAngle = time * glm::radians(36.0f);
+		camera.Position = glm::vec3(sin(orbitAngle) * FIELD_SIZE * 0.5f, 10.0f, cos(orbitAngle) * FIELD_SIZE * 0.5f);
+		camera.LookAt(glm::vec3(0.0f));
+		Frustum frustum = camera.GetFrustum((float)options.width / (float)options.height, 0.1f, FIELD_SIZE * 2.0f);
+
+		chrono::steady_clock::time_point cullStart = chrono::steady_clock::now();
+		bvh.cull(frustum, visible);
+		cullTimes.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - cullStart).count());
+
+		chrono::steady_clock::time_point bruteForceStart = chrono::steady_clock::now();
+		reference.clear();
+		for (size_t i = 0; i < boxes.size(); i++) {
+			if (frustum.intersects(boxes[i])) {
+				reference.push_back((uint32_t)i);
+			}
+		}
+		bruteForceTimes.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - bruteForceStart).count());
+
+		culledFraction += 1.0 - (double)visible.size() / boxCount;
+		sort(visible.begin(), visible.end());
+		matches = matches && visible == reference;
 	}
 
-	// -------------------------------------------- Lighting ------------------------------------------
-	//unsigned int lightVBO, lightVAO;
-	unsigned int lightVAO;
-	//glGenBuffers(1, &lightVBO);
-	//glGenBuffers(1, &lightVBO);
-	glGenVertexArrays(1, &lightVAO);
-	glBindVertexArray(lightVAO);
-	//glBindBuffer(GL_ARRAY_BUFFER, lightVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBOs[1]);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(cube), cube, GL_STATIC_DRAW);
+	printTimingStats("BVH cull", cullTimes);
+	printTimingStats("Brute force cull", bruteForceTimes);
+	printTimingStats("BVH refit", refitTimes);
+	cout << "Culled " << culledFraction / options.frames * 100.0 << "% of boxes on average, BVH and brute force results "
+		<< (matches ? "match" : "DIFFER") << endl;
+	return matches ? 0 : -1;
+}
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
+// ---------------------------------------- Submission Benchmark ----------------------------------------
+// Draws a field of separately submitted cubes offscreen, first keying and recording them all on the render thread
+// and then on a growing number of threads, and prints the median CPU time of each part of submitting them
+int runSubmitBenchmark(const Options& options) {
+	HeadlessContext headlessContext;
+	GLFWwindow* hiddenWindow;
+	if (!createHeadlessContext(headlessContext, hiddenWindow, options)) {
+		return -1;
+	}
+
+	{
+		OffscreenTarget target = createOffscreenTarget(options.width, options.height);
+		ThreadPool workerPool;
+		Scene scene(workerPool, 0, options.submitBenchmark, !options.noPersistentMapping, !options.noBakedTextures);
+		scene.sortDraws = !options.noSort;
+		while (scene.pendingTextures() > 0) {
+			scene.update();
+		}
 
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
+		// The same view every frame, looking into the field
+		camera.Position = glm::vec3(0.0f, 0.0f, 3.0f);
+		camera.LookAt(glm::vec3(0.0f, 0.0f, -50.0f));
+		glm::mat4 view = camera.GetViewMatrix();
+		glm::mat4 projection = camera.GetProjectionMatrix((float)options.width / (float)options.height, 0.1f, 100.0f);
 
+		// Powers of two up to the hardware threads, and at least up to 4 so the overhead of oversubscribing shows too
+		unsigned int maxThreads = max(thread::hardware_concurrency(), 4u);
+		vector<unsigned int> threadCounts;
+		for (unsigned int threads = 1; threads < maxThreads; threads *= 2) {
+			threadCounts.push_back(threads);
+		}
+		threadCounts.push_back(maxThreads);
+
+		cout << "Submitting " << options.submitBenchmark << " draws, median of " << options.frames << " frames, "
+			<< thread::hardware_concurrency() << " hardware threads" << endl;
+		double singleThreadRender = 0.0;
+		for (unsigned int threads : threadCounts) {
+			// Recording threads are the calling thread plus threads - 1 workers
+			unique_ptr<ThreadPool> recordPool;
+			if (threads > 1) {
+				recordPool.reset(new ThreadPool(threads - 1));
+			}
+			scene.recordPool = recordPool.get();
+
+			vector<double> renderTimes, recordTimes, replayTimes;
+			RenderQueueStats last = {};
+			for (int frame = 0; frame < options.frames + 1; frame++) {
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				chrono::steady_clock::time_point renderStart = chrono::steady_clock::now();
+				scene.render(0.0f, view, projection);
+				double renderTime = chrono::duration<double, milli>(chrono::steady_clock::now() - renderStart).count();
+
+				// Rasterizing is left out of the times, and the first frame only warms up the command buffers
+				glFinish();
+				if (frame > 0) {
+					last = scene.queueStats();
+					renderTimes.push_back(renderTime);
+					recordTimes.push_back(last.recordMicroseconds / 1000.0);
+					replayTimes.push_back(last.replayMicroseconds / 1000.0);
+				}
+			}
+			scene.recordPool = nullptr;
+
+			sort(renderTimes.begin(), renderTimes.end());
+			sort(recordTimes.begin(), recordTimes.end());
+			sort(replayTimes.begin(), replayTimes.end());
+			double render = renderTimes[renderTimes.size() / 2];
+			if (threads == 1) {
+				singleThreadRender = render;
+			}
+			cout << threads << (threads == 1 ? " thread:  " : " threads: ") << "submit " << render << " ms (" << singleThreadRender / render
+				<< "x), record " << recordTimes[recordTimes.size() / 2] << " ms in " << last.recordSlices << " slices, replay "
+				<< replayTimes[replayTimes.size() / 2] << " ms, " << last.draws << " draws, " << last.commandBytes / 1024 << " KB of commands" << endl;
+		}
 
-	// ------------------------------ Cleanup ---------------------------------------------------------
-	// Cleanup, free image in memory
-	stbi_image_free(data);
+		destroyOffscreenTarget(target);
+	}
 
-	// bind textures
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, tau_texture);
+	if (hiddenWindow) {
+		glfwTerminate();
+	}
+	return 0;
+}
 
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, container_texture);
+// ---------------------------------------- Instancing Benchmark ----------------------------------------
+// Draws 1k, 10k, 100k... up to N spinning cubes offscreen, the same scene --headless --cubes N renders, and prints the
+// median CPU time of a frame and the time until the GPU has finished it
+int runInstanceBenchmark(const Options& options) {
+	HeadlessContext headlessContext;
+	GLFWwindow* hiddenWindow;
+	if (!createHeadlessContext(headlessContext, hiddenWindow, options)) {
+		return -1;
+	}
 
-	glEnable(GL_DEPTH_TEST);
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED); // capture mouse input
+	{
+		OffscreenTarget target = createOffscreenTarget(options.width, options.height);
+		ThreadPool workerPool;
+		const float FRAME_STEP = 1.0f / 60.0f;
 
-	
-	// -------------------------------------------- Render Loop ----------------------------------------
-	while (!glfwWindowShouldClose(window)) {
-		// Process inputs
-		processInput(window);
-
-		// Rendering stuff
-		glClearColor(0.1f, 0.1f, 0.1f, 1.0f); // Set the clear color
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // clear using the color
-		
-		float currTime = glfwGetTime();
-
-		// Calculate frame time
-		float currentFrame = currTime;
-		deltaTime = currentFrame - lastFrame;
-		lastFrame = currentFrame;
-			
-		// Use our shader
-		// Draw blank cube
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-
-		glm::mat4 model = glm::mat4(1.0f);
+		// The view headless runs start from, looking into the cube field
+		const glm::vec3 orbitCenter(0.0f, 0.0f, -6.0f);
+		camera.Position = orbitCenter + glm::vec3(0.0f, 3.0f, 12.0f);
+		camera.LookAt(orbitCenter);
 		glm::mat4 view = camera.GetViewMatrix();
+		glm::mat4 projection = camera.GetProjectionMatrix((float)options.width / (float)options.height, 0.1f, 100.0f);
+
+		cout << "Median of " << options.frames << " frames at " << options.width << "x" << options.height << endl;
+		for (size_t count = 1000; count <= (size_t)options.instanceBenchmark; count *= 10) {
+			Scene scene(workerPool, (int)count, 0, !options.noPersistentMapping, !options.noBakedTextures);
+			while (scene.pendingTextures() > 0) {
+				scene.update();
+			}
+
+			vector<double> cpuTimes, frameTimes;
+			size_t visibleTotal = 0;
+			for (int frame = 0; frame < options.frames + 1; frame++) {
+				chrono::steady_clock::time_point frameStart = chrono::steady_clock::now();
+				GLStateCache::current().beginFrame();
+				scene.update();
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				scene.render(frame * FRAME_STEP, view, projection);
+				double cpuTime = chrono::duration<double, milli>(chrono::steady_clock::now() - frameStart).count();
+				glFinish();
+				double frameTime = chrono::duration<double, milli>(chrono::steady_clock::now() - frameStart).count();
+
+				// The first frame only warms up the buffers
+				if (frame > 0) {
+					cpuTimes.push_back(cpuTime);
+					frameTimes.push_back(frameTime);
+					visibleTotal += scene.visibleCubeCount();
+				}
+			}
+			sort(cpuTimes.begin(), cpuTimes.end());
+			sort(frameTimes.begin(), frameTimes.end());
+			cout << count << " cubes: CPU " << cpuTimes[cpuTimes.size() / 2] << " ms, frame " << frameTimes[frameTimes.size() / 2] << " ms, "
+				<< visibleTotal / options.frames << " visible" << endl;
+		}
 
-		// FOV, aspect ratio, near matrix, far matrix
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), 16.0f / 10.0f, 0.1f, 100.0f);
+		destroyOffscreenTarget(target);
+	}
 
+	if (hiddenWindow) {
+		glfwTerminate();
+	}
+	return 0;
+}
 
-		simpleShader.use();
-		simpleShader.setFloat3f("objectColor", 1.0f, 0.5f, 0.31f);
-		simpleShader.setFloat3f("lightColor", 1.0f, 1.0f, 1.0f);
-		simpleShader.setFloat3fv("lightPos", lightPos);
-		simpleShader.setMatrixTransform4fv("view", view);
-		simpleShader.setMatrixTransform4fv("projection", projection);
-		simpleShader.setMatrixTransform4fv("model", model);
-		glBindVertexArray(VAOs[1]);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+// ----------------------------------------- Matrix Benchmark ------------------------------------------
+// Builds the model matrices of 10k, 100k... up to N spinning objects with glm::translate, rotate and scale and with each
+// kernel, printing millions of matrices a second and the largest difference from glm, then times the fastest kernel
+// over a culled style pointer list on 1, 2, 4... threads. No GL involved
+int runMatrixBenchmark(const Options& options) {
+	const int RUNS = 5;
+	const float TIME = 12.3f;
+	size_t maxCount = (size_t)options.matrixBenchmark;
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> spread(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> speed(0.0f, 10.0f);
+	std::uniform_real_distribution<float> size(0.5f, 2.0f);
+	vector<TransformComponent> transforms(maxCount);
+	for (TransformComponent& transform : transforms) {
+		transform.position = glm::vec3(spread(random), spread(random), spread(random));
+		transform.scale = glm::vec3(size(random), size(random), size(random));
+		glm::vec3 axis(unit(random), unit(random), unit(random));
+		transform.spinAxis = glm::normalize(glm::length(axis) > 0.01f ? axis : glm::vec3(0.0f, 1.0f, 0.0f));
+		transform.spinSpeed = speed(random);
+	}
+	vector<glm::mat4> reference(maxCount), matrices(maxCount);
+
+	// Median time of a few runs of build, in milliseconds
+	auto time = [RUNS](const function<void()>& build) {
+		vector<double> times;
+		for (int run = 0; run < RUNS; run++) {
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			build();
+			times.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+		}
+		sort(times.begin(), times.end());
+		return times[RUNS / 2];
+	};
+	auto largestError = [&reference, &matrices](size_t count) {
+		float error = 0.0f;
+		for (size_t i = 0; i < count; i++) {
+			for (int column = 0; column < 4; column++) {
+				for (int row = 0; row < 4; row++) {
+					error = max(error, fabs(matrices[i][column][row] - reference[i][column][row]));
+				}
+			}
+		}
+		return error;
+	};
 
-		// lighting
-		lightingShader.use();
-		model = glm::mat4(1.0f);
-		model = glm::translate(model, lightPos);
-		model = glm::scale(model, glm::vec3(0.2f));
-		lightingShader.setMatrixTransform4fv("model", model);
-		lightingShader.setMatrixTransform4fv("view", view);
-		lightingShader.setMatrixTransform4fv("projection", projection);
-		glBindVertexArray(lightVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-		
+	cout << "Model matrices, median of " << RUNS << " runs, fastest kernel here " << transformKernelName(bestTransformKernel()) << endl;
+	vector<size_t> counts;
+	for (size_t count = 10000; count < maxCount; count *= 10) {
+		counts.push_back(count);
+	}
+	counts.push_back(maxCount);
+	float worstError = 0.0f;
+	for (size_t count : counts) {
+		double glmMilliseconds = time([&]() {
+			for (size_t i = 0; i < count; i++) {
+				const TransformComponent& transform = transforms[i];
+				glm::mat4 model = glm::translate(glm::mat4(1.0f), transform.position);
+				model = glm::rotate(model, TIME * transform.spinSpeed, transform.spinAxis);
+				reference[i] = glm::scale(model, transform.scale);
+			}
+		});
+		cout << count << " objects: glm " << count / (glmMilliseconds * 1000.0) << " M/s";
+		for (TransformKernel kernel : { TRANSFORM_KERNEL_SCALAR, TRANSFORM_KERNEL_SSE2, TRANSFORM_KERNEL_AVX2 }) {
+			if (!isTransformKernelSupported(kernel)) {
+				continue;
+			}
+			double milliseconds = time([&]() {
+				computeModelMatrices(TIME, transforms.data(), count, matrices.data(), kernel);
+			});
+			float error = largestError(count);
+			worstError = max(worstError, error);
+			cout << ", " << transformKernelName(kernel) << " " << count / (milliseconds * 1000.0) << " M/s (" << glmMilliseconds / milliseconds
+				<< "x, error " << error << ")";
+		}
+		cout << endl;
+	}
 
-		// Cube
-		threeDShaderProgram.use();
-		threeDShaderProgram.setInt("ourTexture", 0);
-		
-		threeDShaderProgram.setMatrixTransform4fv("view", view);
-		threeDShaderProgram.setMatrixTransform4fv("projection", projection);
-		threeDShaderProgram.setFloat3f("objectColor", 1.0f, 1.0f, 1.0f);
-		threeDShaderProgram.setFloat3f("lightColor", 1.0f, 1.0f, 1.0f);
+	// Powers of two up to the hardware threads, and at least up to 4 so the overhead of oversubscribing shows too
+	unsigned int maxThreads = max(thread::hardware_concurrency(), 4u);
+	vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < maxThreads; threads *= 2) {
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(maxThreads);
 
-		glBindVertexArray(VAOs[0]);
-		for (unsigned int i = 0; i < std::size(tau_cubes); i++) {
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, tau_cubes[i]);
-			model = glm::rotate(model, currTime * glm::radians(50.0f) * (i), glm::vec3(0.5f, 1.0f, 0.0f));
-			threeDShaderProgram.setMatrixTransform4fv("model", model);
+	vector<const TransformComponent*> pointers(maxCount);
+	for (size_t i = 0; i < maxCount; i++) {
+		pointers[i] = &transforms[i];
+	}
+	double singleThread = 0.0;
+	for (unsigned int threads : threadCounts) {
+		unique_ptr<ThreadPool> pool;
+		if (threads > 1) {
+			pool.reset(new ThreadPool(threads - 1));
+		}
+		double milliseconds = time([&]() {
+			computeModelMatrices(TIME, pointers.data(), maxCount, matrices.data(), pool.get());
+		});
+		if (threads == 1) {
+			singleThread = milliseconds;
+		}
+		cout << threads << (threads == 1 ? " thread:  " : " threads: ") << milliseconds << " ms, " << maxCount / (milliseconds * 1000.0) << " M/s ("
+			<< singleThread / milliseconds << "x)" << endl;
+	}
+	worstError = max(worstError, largestError(maxCount));
+
+	// Angles reach over a hundred radians, where the kernels' range reduction and std::sin both lose a few ulps
+	bool accurate = worstError < 1e-4f;
+	cout << "Largest difference from glm " << worstError << (accurate ? "" : ", TOO LARGE") << endl;
+	return accurate ? 0 : -1;
+}
 
-			glDrawArrays(GL_TRIANGLES, 0, 36);
+// ----------------------------------------- Mipmap Benchmark ------------------------------------------
+// Builds the mip chain of a random image with every filter, color space and channel count, first with the scalar
+// reference and then with each SIMD kernel the CPU supports, alone and on the worker pool. Prints the source megapixels
+// per second each manages and checks every kernel gives exactly the reference's bytes. No GL involved
+int runMipBenchmark(const Options& options) {
+	const int RUNS = 5;
+	int size = options.mipBenchmark;
+	double megapixels = (double)size * size / 1.0e6;
+
+	// Smooth gradients with noise on top, so neither the flat nor the busy parts of real textures are left out
+	mt19937 random(1234);
+	uniform_int_distribution<int> noise(-24, 24);
+	vector<unsigned char> image((size_t)size * size * 4);
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x++) {
+			unsigned char* pixel = &image[((size_t)y * size + x) * 4];
+			int gradients[4] = { x * 255 / size, y * 255 / size, (x + y) * 127 / size, 255 - x * 64 / size };
+			for (int channel = 0; channel < 4; channel++) {
+				pixel[channel] = (unsigned char)min(max(gradients[channel] + noise(random), 0), 255);
+			}
 		}
+	}
+	vector<unsigned char> rgb((size_t)size * size * 3);
+	for (size_t i = 0; i < (size_t)size * size; i++) {
+		memcpy(&rgb[i * 3], &image[i * 4], 3);
+	}
 
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+	// Median of a few runs of the whole chain
+	ThreadPool workerPool;
+	auto timeChain = [&](const unsigned char* pixels, int channels, const MipOptions& mipOptions, ThreadPool* pool, vector<MipLevel>& levels) {
+		vector<double> times;
+		for (int run = 0; run < RUNS; run++) {
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			generateMipChain(pixels, size, size, channels, mipOptions, levels, pool);
+			times.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+		}
+		sort(times.begin(), times.end());
+		return megapixels / times[times.size() / 2];
+	};
 
+	cout << "Mip chains of a " << size << "x" << size << " image, median of " << RUNS << " runs in source megapixels per second, "
+		<< workerPool.concurrency() << " threads in the pool" << endl;
+	bool matches = true;
+	for (int filter = MIP_FILTER_BOX; filter <= MIP_FILTER_KAISER; filter++) {
+		for (int srgb = 0; srgb < 2; srgb++) {
+			for (int channels = 3; channels <= 4; channels++) {
+				const unsigned char* pixels = channels == 4 ? image.data() : rgb.data();
+				MipOptions mipOptions = { (MipFilter)filter, srgb != 0, MIP_KERNEL_SCALAR };
+				vector<MipLevel> reference, levels;
+				double scalar = timeChain(pixels, channels, mipOptions, nullptr, reference);
+				cout << mipFilterName(mipOptions.filter) << (srgb ? " sRGB " : " linear ") << (channels == 4 ? "RGBA" : "RGB") << ": scalar " << scalar << " MP/s";
+
+				bool same = true;
+				for (int kernel = MIP_KERNEL_SSE2; kernel <= MIP_KERNEL_AVX2; kernel++) {
+					if (!isMipKernelSupported((MipKernel)kernel)) {
+						continue;
+					}
+					mipOptions.kernel = (MipKernel)kernel;
+					double rate = timeChain(pixels, channels, mipOptions, nullptr, levels);
+					for (size_t i = 0; i < levels.size(); i++) {
+						same = same && levels[i].pixels == reference[i].pixels;
+					}
+					cout << ", " << mipKernelName(mipOptions.kernel) << " " << rate << " MP/s (" << rate / scalar << "x)";
+				}
+
+				mipOptions.kernel = bestMipKernel();
+				double threaded = timeChain(pixels, channels, mipOptions, &workerPool, levels);
+				for (size_t i = 0; i < levels.size(); i++) {
+					same = same && levels[i].pixels == reference[i].pixels;
+				}
+				cout << ", " << mipKernelName(mipOptions.kernel) << " threaded " << threaded << " MP/s (" << threaded / scalar << "x), "
+					<< (same ? "match" : "DIFFER") << endl;
+				matches = matches && same;
+			}
+		}
+	}
+	return matches ? 0 : -1;
+}
+
+// --------------------------------------- Texture Loading Benchmark ------------------------------------
+// Loads every image in a directory offscreen, first the way the engine used to, decoding and uploading each with
+// stbi_load and glGenerateMipmap on the render thread before the first frame, then streamed by TextureStreamer with
+// a growing number of decode threads while frames keep going. Prints the time to the first frame and until every
+// texture is resident
+int runTextureBenchmark(const Options& options) {
+	const char* IMAGE_EXTENSIONS[] = { ".jpg", ".jpeg", ".png", ".bmp", ".tga", ".ppm", ".pgm" };
+	vector<string> paths;
+	std::error_code error;
+	for (const filesystem::directory_entry& entry : filesystem::directory_iterator(options.textureBenchmark, error)) {
+		string extension = entry.path().extension().string();
+		transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)tolower(c); });
+		if (entry.is_regular_file() && find(begin(IMAGE_EXTENSIONS), end(IMAGE_EXTENSIONS), extension) != end(IMAGE_EXTENSIONS)) {
+			paths.push_back(entry.path().string());
+		}
+	}
+	if (paths.empty()) {
+		cout << "No images in " << options.textureBenchmark << endl;
+		return -1;
+	}
+	sort(paths.begin(), paths.end());
+
+	// Read everything once so both ways load from the page cache
+	size_t fileBytes = 0;
+	for (const string& path : paths) {
+		fileBytes += (size_t)filesystem::file_size(path, error);
+		ifstream file(path, ios::binary);
+		vector<char> contents((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+	}
 
+	HeadlessContext headlessContext;
+	GLFWwindow* hiddenWindow;
+	if (!createHeadlessContext(headlessContext, hiddenWindow, options)) {
+		return -1;
 	}
 
-	// Exit and close the window
-	glfwTerminate();
+	{
+		cout << paths.size() << " images, " << fileBytes / (1024 * 1024) << " MB, " << thread::hardware_concurrency() << " hardware threads" << endl;
+
+		// Serial loop, nothing can be drawn until it's done
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		vector<unsigned int> serialTextures;
+		for (const string& path : paths) {
+			int width, height, channels;
+			unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &channels, 0);
+			if (!pixels) {
+				cout << "Failed to load texture " << path << endl;
+				continue;
+			}
+			GLenum format = channels == 1 ? GL_RED : channels == 2 ? GL_RG : channels == 3 ? GL_RGB : GL_RGBA;
+			unsigned int texture;
+			glGenTextures(1, &texture);
+			GLStateCache::current().bindTexture(GL_TEXTURE_2D, texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+			glGenerateMipmap(GL_TEXTURE_2D);
+			stbi_image_free(pixels);
+			serialTextures.push_back(texture);
+		}
+		glFinish();
+		double serialMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		cout << "stbi_load loop:         first frame after " << serialMilliseconds << " ms, all loaded after " << serialMilliseconds << " ms" << endl;
+		for (unsigned int texture : serialTextures) {
+			GLStateCache::current().forgetTexture(texture);
+			glDeleteTextures(1, &texture);
+		}
+
+		// Powers of two up to the hardware threads, and at least up to 4 so the overhead of oversubscribing shows too
+		unsigned int maxThreads = max(thread::hardware_concurrency(), 4u);
+		vector<unsigned int> threadCounts;
+		for (unsigned int threads = 1; threads < maxThreads; threads *= 2) {
+			threadCounts.push_back(threads);
+		}
+		threadCounts.push_back(maxThreads);
+
+		for (unsigned int threads : threadCounts) {
+			// The render thread only uploads, every thread of the pool decodes
+			ThreadPool decodePool(threads);
+			TextureStreamer streamer(decodePool);
+			start = chrono::steady_clock::now();
+			vector<int> handles;
+			for (const string& path : paths) {
+				handles.push_back(streamer.request(path));
+			}
+
+			// A frame is one streaming update, finished on the GPU
+			double firstFrame = 0.0, firstResident = 0.0, worstFrame = 0.0;
+			int frames = 0;
+			while (streamer.pendingCount() > 0 || frames == 0) {
+				chrono::steady_clock::time_point frameStart = chrono::steady_clock::now();
+				streamer.update();
+				glFinish();
+				chrono::steady_clock::time_point frameEnd = chrono::steady_clock::now();
+				worstFrame = max(worstFrame, chrono::duration<double, milli>(frameEnd - frameStart).count());
+				double elapsed = chrono::duration<double, milli>(frameEnd - start).count();
+				if (frames++ == 0) {
+					firstFrame = elapsed;
+				}
+				if (firstResident == 0.0 && any_of(handles.begin(), handles.end(), [&streamer](int handle) { return streamer.isResident(handle); })) {
+					firstResident = elapsed;
+				}
+			}
+			double totalMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+			const TextureStreamerStats& stats = streamer.stats();
+			cout << "streamed, " << threads << (threads == 1 ? " thread:  " : " threads: ") << "first frame after " << firstFrame << " ms, all loaded after "
+				<< totalMilliseconds << " ms (" << serialMilliseconds / totalMilliseconds << "x), first texture " << firstResident << " ms, "
+				<< frames << " frames, worst " << worstFrame << " ms, " << stats.loaded << " loaded" << endl;
+		}
+	}
+
+	if (hiddenWindow) {
+		glfwTerminate();
+	}
+	return 0;
+}
+
+// ------------------------------------------ Texture Baking -------------------------------------------
+// Bakes every image given with --bake into the directory the scene looks for baked textures in, no GL involved
+int runBake(const Options& options) {
+	ThreadPool workerPool;
+	int failures = 0;
+	for (const string& source : options.bakeFiles) {
+		string baked = bakedTexturePath(Scene::BAKED_TEXTURE_DIRECTORY, source);
+		BakeStats stats;
+		if (!bakeTexture(source, baked, options.bakeFormat, &workerPool, stats)) {
+			cout << "Failed to bake " << source << endl;
+			failures++;
+			continue;
+		}
+		cout << source << " -> " << baked << ": " << stats.width << "x" << stats.height << " " << compressedFormatName(stats.format) << ", "
+			<< stats.levels << " levels, " << stats.sourceBytes / 1024 << " KB -> " << stats.bakedBytes / 1024 << " KB, decode " << stats.decodeMilliseconds
+			<< " ms, mipmaps " << stats.mipMilliseconds << " ms, compress " << stats.compressMilliseconds << " ms" << endl;
+	}
+	return failures == 0 ? 0 : -1;
+}
+
+// ------------------------------------------ Mesh Conversion ------------------------------------------
+// Converts every model given with --convert-mesh into the directory the scene looks for converted meshes in, no GL involved
+int runConvertMeshes(const Options& options) {
+	ThreadPool workerPool;
+	int failures = 0;
+	for (const string& source : options.convertMeshFiles) {
+		string converted = meshFilePath(Scene::MESH_DIRECTORY, source);
+		MeshFileStats stats;
+		if (!convertMesh(source, converted, &workerPool, stats)) {
+			cout << "Failed to convert " << source << endl;
+			failures++;
+			continue;
+		}
+		cout << source << " -> " << converted << ": " << stats.vertices << " vertices, " << stats.triangles << " triangles, " << stats.sourceBytes / 1024
+			<< " KB -> " << stats.fileBytes / 1024 << " KB (" << stats.floatBytes / 1024 << " KB as floats), parse " << stats.parseMilliseconds
+			<< " ms, optimize " << stats.optimizeMilliseconds << " ms, write " << stats.writeMilliseconds << " ms" << endl;
+	}
+	return failures == 0 ? 0 : -1;
+}
+
+// ---------------------------------------- Mesh Loading Benchmark --------------------------------------
+// Ways the loading benchmark gets a model into video memory
+enum MeshLoadMethod {
+	MESH_LOAD_NONE,
+	MESH_LOAD_PARSE,
+	MESH_LOAD_MAPPED,
+	MESH_LOAD_METHOD_COUNT
+};
+
+// Creates a context and loads the model into a vertex and index buffer with one method, returns the milliseconds from
+// starting to load until the driver has the data, or a negative number if it fails. The context itself isn't timed
+double loadMeshOnce(const Options& options, MeshLoadMethod method) {
+	HeadlessContext headlessContext;
+	GLFWwindow* hiddenWindow;
+	if (!createHeadlessContext(headlessContext, hiddenWindow, options)) {
+		return -1.0;
+	}
+
+	double milliseconds = 0.0;
+	{
+		ThreadPool workerPool;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		unique_ptr<GpuMesh> mesh;
+		if (method == MESH_LOAD_PARSE) {
+			ImportedMesh imported;
+			if (importMesh(options.meshBenchmark, imported, &workerPool)) {
+				mesh.reset(new GpuMesh(imported.layout(), imported.vertices.data(), imported.vertices.size() * sizeof(float), imported.indices.data(), imported.indices.size() * sizeof(uint32_t), GL_UNSIGNED_INT));
+			}
+		}
+		else if (method == MESH_LOAD_MAPPED) {
+			MeshFile file;
+			if (file.open(meshFilePath(Scene::MESH_DIRECTORY, options.meshBenchmark), options.meshBenchmark)) {
+				mesh.reset(new GpuMesh(file.layout(), file.vertexData(), file.vertexBytes(), file.indexData(), file.indexBytes(), file.indexType()));
+			}
+		}
+		glFinish();
+		milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		if (method != MESH_LOAD_NONE && !mesh) {
+			milliseconds = -1.0;
+		}
+	}
+
+	if (hiddenWindow) {
+		glfwTerminate();
+	}
+	return milliseconds;
+}
+
+// Runs work and returns what it returns, -1 if it fails. On Linux it runs in a forked process so peakKilobytes can be the
+// peak resident memory of that work alone, as the kernel reports it for the child. Elsewhere it runs in place and
+// peakKilobytes is 0
+double measureInChild(const function<double()>& work, long& peakKilobytes) {
+	peakKilobytes = 0;
+#ifdef __linux__
+	// The child sends its result back through a pipe
+	int channel[2];
+	if (pipe(channel) != 0) {
+		return -1.0;
+	}
+	cout.flush();
+	pid_t child = fork();
+	if (child == 0) {
+		close(channel[0]);
+		double result = work();
+		ssize_t written = write(channel[1], &result, sizeof(result));
+		_exit(written == sizeof(result) ? 0 : 1);
+	}
+	close(channel[1]);
+	double result = -1.0;
+	if (child < 0 || read(channel[0], &result, sizeof(result)) != sizeof(result)) {
+		result = -1.0;
+	}
+	close(channel[0]);
+	if (child > 0) {
+		int status = 0;
+		struct rusage usage = {};
+		wait4(child, &status, 0, &usage);
+		peakKilobytes = usage.ru_maxrss;
+	}
+	return result;
+#else
+	return work();
+#endif
+}
+
+// Loads a model by parsing its source on the worker pool and from its converted file, converting it first if there's no up to date file.
+// Every load and the conversion run through measureInChild, a load that only creates the context shows how much
+// memory the driver itself takes
+int runMeshBenchmark(const Options& options) {
+	static const char* METHOD_NAMES[MESH_LOAD_METHOD_COUNT] = { "context only", "parse source", "mapped mesh file" };
+	const int RUNS = 3;
+
+	// Only the header is touched here, so the mapping the children inherit adds nothing to their memory
+	MeshFile file;
+	string converted = meshFilePath(Scene::MESH_DIRECTORY, options.meshBenchmark);
+	if (!file.open(converted, options.meshBenchmark)) {
+		long peakKilobytes = 0;
+		double milliseconds = measureInChild([&]() {
+			ThreadPool workerPool;
+			MeshFileStats stats;
+			if (!convertMesh(options.meshBenchmark, converted, &workerPool, stats)) {
+				return -1.0;
+			}
+			return stats.parseMilliseconds + stats.optimizeMilliseconds + stats.writeMilliseconds;
+		}, peakKilobytes);
+		if (milliseconds < 0.0 || !file.open(converted, options.meshBenchmark)) {
+			cout << "Failed to convert " << options.meshBenchmark << endl;
+			return -1;
+		}
+		cout << "Converted in " << milliseconds << " ms";
+		if (peakKilobytes > 0) {
+			cout << ", peak resident " << peakKilobytes / 1024 << " MB";
+		}
+		cout << endl;
+	}
+	cout << options.meshBenchmark << ": " << file.indexCount() / 3 << " triangles, " << file.vertexCount() << " vertices, mesh file "
+		<< file.size() / 1024 << " KB, median of " << RUNS << " loads" << endl;
+
+	bool failed = false;
+	for (int method = 0; method < MESH_LOAD_METHOD_COUNT; method++) {
+		vector<double> times;
+		long peakKilobytes = 0;
+		for (int run = 0; run < RUNS; run++) {
+			long runPeakKilobytes = 0;
+			double milliseconds = measureInChild([&]() { return loadMeshOnce(options, (MeshLoadMethod)method); }, runPeakKilobytes);
+			if (milliseconds < 0.0) {
+				failed = true;
+				break;
+			}
+			times.push_back(milliseconds);
+			peakKilobytes = max(peakKilobytes, runPeakKilobytes);
+		}
+		if (times.empty()) {
+			cout << METHOD_NAMES[method] << ": failed" << endl;
+			continue;
+		}
+
+		sort(times.begin(), times.end());
+		cout << METHOD_NAMES[method] << ": " << times[times.size() / 2] << " ms";
+		if (peakKilobytes > 0) {
+			cout << ", peak resident " << peakKilobytes / 1024 << " MB";
+		}
+		cout << endl;
+	}
+	return failed ? -1 : 0;
+}
+
+// ---------------------------------------- Startup Benchmark ------------------------------------------
+// Creates a context and the scene and draws one frame offscreen, returns the milliseconds from creating the context
+// until that frame has finished, or a negative number if there's no context
+double startupOnce(const Options& options) {
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	HeadlessContext headlessContext;
+	GLFWwindow* hiddenWindow;
+	if (!createHeadlessContext(headlessContext, hiddenWindow, options)) {
+		return -1.0;
+	}
+
+	double milliseconds = 0.0;
+	{
+		OffscreenTarget target = createOffscreenTarget(options.width, options.height);
+		ThreadPool workerPool;
+		Scene scene(workerPool, options.extraCubes, options.mixedDraws, !options.noPersistentMapping, !options.noBakedTextures);
+		while (scene.pendingTextures() > 0) {
+			scene.update();
+		}
+
+		camera.Position = glm::vec3(0.0f, 3.0f, 6.0f);
+		camera.LookAt(glm::vec3(0.0f, 0.0f, -6.0f));
+		scene.update();
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		scene.render(0.0f, camera.GetViewMatrix(), camera.GetProjectionMatrix((float)options.width / (float)options.height, 0.1f, 100.0f));
+		glFinish();
+		milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		destroyOffscreenTarget(target);
+	}
+
+	if (hiddenWindow) {
+		glfwTerminate();
+	}
+	return milliseconds;
+}
+
+// Starts the scene in fresh processes, cold with the program cache emptied first so every shader is compiled and
+// warm with the binaries the cold start stored, and prints the median time to the first frame of each
+int runStartupBenchmark(const Options& options) {
+	const int RUNS = options.startupBenchmark;
+
+	vector<double> coldTimes, warmTimes;
+	for (int run = 0; run < RUNS; run++) {
+		std::error_code error;
+		filesystem::remove_all(Scene::PROGRAM_CACHE_DIRECTORY, error);
+		long peakKilobytes = 0;
+		double cold = measureInChild([&]() { return startupOnce(options); }, peakKilobytes);
+		double warm = measureInChild([&]() { return startupOnce(options); }, peakKilobytes);
+		if (cold < 0.0 || warm < 0.0) {
+			cout << "Failed to start the scene" << endl;
+			return -1;
+		}
+		coldTimes.push_back(cold);
+		warmTimes.push_back(warm);
+	}
+
+	sort(coldTimes.begin(), coldTimes.end());
+	sort(warmTimes.begin(), warmTimes.end());
+	double cold = coldTimes[RUNS / 2];
+	double warm = warmTimes[RUNS / 2];
+	cout << "Startup to first frame, median of " << RUNS << " runs: cold " << cold << " ms, warm " << warm << " ms ("
+		<< cold / warm << "x), program cache in " << Scene::PROGRAM_CACHE_DIRECTORY << endl;
+	return 0;
+}
+
+// ----------------------------------------- Import Benchmark ------------------------------------------
+// Parses a model on one thread and then on a growing number of threads, prints the median time and the throughput in
+// MB/s overall and per thread, and checks every thread count gives exactly the same mesh as one thread. No GL involved
+int runImportBenchmark(const Options& options) {
+	const int RUNS = 3;
+
+	// Powers of two up to the hardware threads, and at least up to 4 so the overhead of oversubscribing shows too
+	unsigned int maxThreads = max(thread::hardware_concurrency(), 4u);
+	vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < maxThreads; threads *= 2) {
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(maxThreads);
+
+	ImportedMesh reference, mesh;
+	bool matches = true;
+	double singleThreadRate = 0.0;
+	for (unsigned int threads : threadCounts) {
+		// One thread runs without a pool, the others are the calling thread plus threads - 1 workers
+		unique_ptr<ThreadPool> pool;
+		if (threads > 1) {
+			pool.reset(new ThreadPool(threads - 1));
+		}
+		ImportedMesh& imported = threads == 1 ? reference : mesh;
+
+		vector<double> times;
+		MeshImportStats stats = {};
+		for (int run = 0; run < RUNS; run++) {
+			if (!importMesh(options.importBenchmark, imported, pool.get(), &stats)) {
+				cout << "Failed to import " << options.importBenchmark << endl;
+				return -1;
+			}
+			times.push_back(stats.milliseconds);
+		}
+		sort(times.begin(), times.end());
+		double milliseconds = times[times.size() / 2];
+		double rate = stats.bytes / 1.0e6 / (milliseconds / 1000.0);
+
+		if (threads == 1) {
+			singleThreadRate = rate;
+			cout << options.importBenchmark << ": " << stats.bytes / (1024 * 1024) << " MB, " << reference.indices.size() / 3 << " triangles, "
+				<< reference.vertexCount() << " vertices, median of " << RUNS << " imports, " << thread::hardware_concurrency() << " hardware threads" << endl;
+		}
+		else {
+			matches = matches && mesh.vertices == reference.vertices && mesh.indices == reference.indices;
+		}
+		// Threads past the hardware's share cores, so they don't count as more
+		unsigned int cores = max(1u, min(stats.threads, thread::hardware_concurrency()));
+		cout << threads << (threads == 1 ? " thread:  " : " threads: ") << milliseconds << " ms, " << rate << " MB/s (" << rate / singleThreadRate
+			<< "x), " << rate / cores << " MB/s per core, " << reference.indices.size() / 3 / (milliseconds * 1000.0) << " M triangles/s" << endl;
+	}
+	cout << "Threaded imports " << (matches ? "match" : "DIFFER") << " the single threaded one" << endl;
+	return matches ? 0 : -1;
+}
+
+// ------------------------------------- Vertex Format Benchmark ---------------------------------------
+// Packs a model's vertices in each compact format and prints the bytes a vertex takes, the vertex memory and the bytes
+// a draw fetches next to the float layout, with the largest error the GPU reads back. No GL involved
+int runVertexBenchmark(const Options& options) {
+	struct NamedFormat {
+		const char* name;
+		VertexFormat format;
+	};
+	static const NamedFormat FORMATS[] = {
+		{ "float", { POSITION_FLOAT, NORMAL_FLOAT, TEXCOORD_FLOAT } },
+		{ "half, snorm8, half", { POSITION_HALF, NORMAL_SNORM8, TEXCOORD_HALF } },
+		{ "half, 2_10_10_10, half", { POSITION_HALF, NORMAL_SNORM10, TEXCOORD_HALF } },
+		{ "unorm16, 2_10_10_10, unorm16", { POSITION_UNORM16, NORMAL_SNORM10, TEXCOORD_UNORM16 } },
+		{ "unorm16, octahedral16, half", { POSITION_UNORM16, NORMAL_OCTAHEDRAL16, TEXCOORD_HALF } },
+		{ "unorm16, octahedral16, unorm16", { POSITION_UNORM16, NORMAL_OCTAHEDRAL16, TEXCOORD_UNORM16 } }
+	};
+
+	ThreadPool workerPool;
+	ImportedMesh imported;
+	if (!importMesh(options.vertexBenchmark, imported, &workerPool)) {
+		cout << "Failed to import " << options.vertexBenchmark << endl;
+		return -1;
+	}
+	vector<VertexSemantic> semantics = imported.semantics();
+	bool hasTexCoords = imported.hasTexCoords;
+	glm::vec3 extent = imported.bounds.max - imported.bounds.min;
+	float size = max(max(extent.x, extent.y), extent.z);
+
+	// Optimized for the post transform cache like a converted file, every cache miss fetches one vertex
+	Mesh mesh(std::move(imported.vertices), std::move(imported.indices), imported.attributeSizes());
+	size_t vertexCount = mesh.stats.vertices;
+	size_t fetches = mesh.stats.optimizedInvocations;
+	cout << options.vertexBenchmark << ": " << vertexCount << " vertices, " << mesh.stats.indices / 3 << " triangles, "
+		<< fetches << " vertices fetched a draw, model size " << size << endl;
+
+	const double MEGABYTE = 1024.0 * 1024.0;
+	for (const NamedFormat& named : FORMATS) {
+		PackedVertices packed;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		packVertices(mesh.vertices.data(), vertexCount, mesh.attributeSizes, semantics, named.format, packed, &workerPool);
+		double packMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		VertexPackingError error = measurePackingError(mesh.vertices.data(), vertexCount, mesh.attributeSizes, semantics, packed);
+
+		size_t stride = packed.layout.stride;
+		cout << named.name << ": " << stride << " bytes a vertex (" << 100.0 * stride / mesh.stats.floatStride << "%), "
+			<< vertexCount * stride / MEGABYTE << " MB of vertices, " << fetches * stride / MEGABYTE << " MB fetched a draw, packed in "
+			<< packMilliseconds << " ms, largest error " << error.position << " position (" << error.position / size << " of the size), "
+			<< error.normalDegrees << " degrees normal";
+		if (hasTexCoords) {
+			cout << ", " << error.texCoord << " texture coordinate";
+			if (named.format.texCoord == TEXCOORD_UNORM16 && packed.layout.attributes[semantics.size() - 1].type == GL_HALF_FLOAT) {
+				cout << " (outside [0, 1], kept as half floats)";
+			}
+		}
+		cout << endl;
+	}
+	return 0;
+}
+
+// ------------------------------------------ ECS Benchmark --------------------------------------------
+// Creates entities spread over the archetypes of the scene, times two systems over their chunks on a growing number of
+// threads, then destroys and recreates random entities and checks the chunks stay packed and stale handles are
+// rejected. No GL involved
+int runEcsBenchmark(const Options& options) {
+	const int RUNS = 5;
+	const int CHURN_ROUNDS = 20;
+	size_t entityCount = (size_t)options.ecsBenchmark;
+
+	// Static draws, lights, spinning cubes drawn instanced, and draws that are culled one by one
+	const ComponentMask drawn = componentBit(COMPONENT_TRANSFORM) | componentBit(COMPONENT_MESH) | componentBit(COMPONENT_MATERIAL);
+	const ComponentMask archetypes[] = {
+		drawn,
+		drawn | componentBit(COMPONENT_LIGHT),
+		componentBit(COMPONENT_TRANSFORM) | componentBit(COMPONENT_BOUNDS),
+		drawn | componentBit(COMPONENT_BOUNDS)
+	};
+	const size_t archetypeCount = sizeof(archetypes) / sizeof(archetypes[0]);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> spread(-50.0f, 50.0f);
+	std::uniform_int_distribution<size_t> pickArchetype(0, archetypeCount - 1);
+	auto createEntity = [&](World& world) {
+		Entity entity = world.create(archetypes[pickArchetype(random)]);
+		TransformComponent* transform = world.get<TransformComponent>(entity);
+		transform->position = glm::vec3(spread(random), spread(random), spread(random));
+		transform->scale = glm::vec3(1.0f);
+		transform->spinAxis = glm::vec3(0.0f, 1.0f, 0.0f);
+		transform->spinSpeed = spread(random) * 0.1f;
+		if (BoundsComponent* bounds = world.get<BoundsComponent>(entity)) {
+			bounds->box = AABB{ transform->position - glm::vec3(0.8660254f), transform->position + glm::vec3(0.8660254f) };
+		}
+		return entity;
+	};
+
+	World world;
+	vector<Entity> entities;
+	entities.reserve(entityCount);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (size_t i = 0; i < entityCount; i++) {
+		entities.push_back(createEntity(world));
+	}
+	double createMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	size_t packedChunks = world.chunkCount();
+	cout << entityCount << " entities in " << world.archetypeCount() << " archetypes, " << packedChunks << " chunks of " << World::CHUNK_BYTES / 1024
+		<< " KB, created in " << createMilliseconds << " ms, " << entityCount / (createMilliseconds / 1000.0) / 1.0e6 << " M entities/s" << endl;
+
+	// Powers of two up to the hardware threads, and at least up to 4 so the overhead of oversubscribing shows too
+	unsigned int maxThreads = max(thread::hardware_concurrency(), 4u);
+	vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < maxThreads; threads *= 2) {
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(maxThreads);
+
+	// Model matrices of everything with a transform, and how many bounds a frustum touches, only reading that column
+	vector<glm::mat4> matrices(world.count(componentBit(COMPONENT_TRANSFORM)));
+	Frustum frustum = Frustum::fromMatrix(glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f));
+	double singleThreadTransforms = 0.0;
+	size_t reference = 0;
+	bool matches = true;
+	for (unsigned int threads : threadCounts) {
+		unique_ptr<ThreadPool> pool;
+		if (threads > 1) {
+			pool.reset(new ThreadPool(threads - 1));
+		}
+
+		vector<double> transformTimes, boundsTimes;
+		size_t inside = 0;
+		for (int run = 0; run < RUNS; run++) {
+			start = chrono::steady_clock::now();
+			world.forEachChunk(componentBit(COMPONENT_TRANSFORM), [&matrices, run](const ChunkView& chunk) {
+				computeModelMatrices((float)run, chunk.get<TransformComponent>(), chunk.count, &matrices[chunk.firstIndex]);
+			}, pool.get());
+			transformTimes.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+
+			std::atomic<size_t> visible(0);
+			start = chrono::steady_clock::now();
+			world.forEachChunk(componentBit(COMPONENT_BOUNDS), [&frustum, &visible](const ChunkView& chunk) {
+				const BoundsComponent* bounds = chunk.get<BoundsComponent>();
+				size_t count = 0;
+				for (size_t i = 0; i < chunk.count; i++) {
+					count += frustum.intersects(bounds[i].box) ? 1 : 0;
+				}
+				visible += count;
+			}, pool.get());
+			boundsTimes.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+			inside = visible;
+		}
+		sort(transformTimes.begin(), transformTimes.end());
+		sort(boundsTimes.begin(), boundsTimes.end());
+		double transformMilliseconds = transformTimes[RUNS / 2];
+		double boundsMilliseconds = boundsTimes[RUNS / 2];
+		if (threads == 1) {
+			singleThreadTransforms = transformMilliseconds;
+			reference = inside;
+		}
+		matches = matches && inside == reference;
+		cout << threads << (threads == 1 ? " thread:  " : " threads: ") << "transforms " << transformMilliseconds << " ms, "
+			<< matrices.size() / (transformMilliseconds * 1000.0) << " M entities/s (" << singleThreadTransforms / transformMilliseconds << "x), bounds "
+			<< boundsMilliseconds << " ms, " << world.count(componentBit(COMPONENT_BOUNDS)) / (boundsMilliseconds * 1000.0) << " M entities/s, "
+			<< inside << " in view" << endl;
+	}
+
+	// Destroys and recreates a tenth of the entities, picked at random, each round
+	vector<Entity> destroyed;
+	size_t churn = max((size_t)1, entityCount / 10);
+	size_t operations = 0;
+	size_t peakChunks = world.chunkCount() + world.freeChunkCount();
+	start = chrono::steady_clock::now();
+	for (int round = 0; round < CHURN_ROUNDS; round++) {
+		for (size_t i = 0; i < churn && !entities.empty(); i++) {
+			size_t pick = std::uniform_int_distribution<size_t>(0, entities.size() - 1)(random);
+			world.destroy(entities[pick]);
+			destroyed.push_back(entities[pick]);
+			entities[pick] = entities.back();
+			entities.pop_back();
+		}
+		for (size_t i = 0; i < churn; i++) {
+			entities.push_back(createEntity(world));
+		}
+		operations += 2 * churn;
+		peakChunks = max(peakChunks, world.chunkCount() + world.freeChunkCount());
+	}
+	double churnMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+	size_t staleAccepted = 0;
+	for (const Entity& entity : destroyed) {
+		staleAccepted += world.isAlive(entity) || world.get<TransformComponent>(entity) != nullptr ? 1 : 0;
+	}
+	size_t liveRejected = 0;
+	for (const Entity& entity : entities) {
+		liveRejected += world.isAlive(entity) ? 0 : 1;
+	}
+	cout << "Churn: " << CHURN_ROUNDS << " rounds destroying and creating " << churn << " entities, " << operations / (churnMilliseconds / 1000.0) / 1.0e6
+		<< " M operations/s, chunks " << packedChunks << " -> " << world.chunkCount() << " in use, " << world.freeChunkCount() << " free, "
+		<< peakChunks << " ever allocated" << endl;
+	cout << "Handles: " << destroyed.size() - staleAccepted << " of " << destroyed.size() << " stale handles rejected, "
+		<< entities.size() - liveRejected << " of " << entities.size() << " live handles valid" << endl;
+	cout << "Threaded iteration " << (matches ? "matches" : "DIFFERS from") << " the single threaded one" << endl;
+	return matches && staleAccepted == 0 && liveRejected == 0 ? 0 : -1;
+}
+
+// --------------------------------------- Hierarchy Benchmark -----------------------------------------
+// Builds a random tree of nodes, then on a growing number of threads times frames where 1% of the nodes get a new local
+// matrix against recomputing every node, and checks the world matrices against a plain parent before child pass.
+// No GL involved
+int runHierarchyBenchmark(const Options& options) {
+	const int FRAMES = 20;
+	size_t nodeCount = (size_t)options.hierarchyBenchmark;
+	size_t changesPerFrame = max((size_t)1, nodeCount / 100);
+
+	// Each node hangs off a random earlier one, so parents always come before their children and the tree is a few
+	// dozen levels deep like a scene of nested groups
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+	auto randomLocal = [&]() {
+		glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::vec3(offset(random), offset(random), offset(random)));
+		return glm::rotate(local, angle(random), glm::vec3(0.0f, 1.0f, 0.0f));
+	};
+	vector<uint32_t> parents(nodeCount);
+	TransformHierarchy hierarchy;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (size_t i = 0; i < nodeCount; i++) {
+		parents[i] = i == 0 ? TransformHierarchy::NO_PARENT : std::uniform_int_distribution<uint32_t>(0, (uint32_t)i - 1)(random);
+		hierarchy.add(parents[i], randomLocal());
+	}
+	hierarchy.update();
+	double buildMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	cout << nodeCount << " nodes, " << hierarchy.depth() << " levels, built, sorted breadth first and updated in " << buildMilliseconds << " ms, "
+		<< changesPerFrame << " nodes changed a frame, median of " << FRAMES << " frames" << endl;
+
+	// Powers of two up to the hardware threads, and at least up to 4 so the overhead of oversubscribing shows too
+	unsigned int maxThreads = max(thread::hardware_concurrency(), 4u);
+	vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < maxThreads; threads *= 2) {
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(maxThreads);
+
+	// The changes are drawn once and replayed for every thread count, so each row updates the same nodes
+	std::uniform_int_distribution<uint32_t> pickNode(0, (uint32_t)nodeCount - 1);
+	vector<uint32_t> changedNodes(FRAMES * changesPerFrame);
+	vector<glm::mat4> changedLocals(FRAMES * changesPerFrame);
+	for (size_t i = 0; i < changedNodes.size(); i++) {
+		changedNodes[i] = pickNode(random);
+		changedLocals[i] = randomLocal();
+	}
+
+	double singleThreadDirty = 0.0;
+	for (unsigned int threads : threadCounts) {
+		unique_ptr<ThreadPool> pool;
+		if (threads > 1) {
+			pool.reset(new ThreadPool(threads - 1));
+		}
+
+		vector<double> dirtyTimes, fullTimes;
+		size_t recomputed = 0;
+		for (int frame = 0; frame < FRAMES; frame++) {
+			for (size_t i = frame * changesPerFrame; i < (frame + 1) * changesPerFrame; i++) {
+				hierarchy.setLocal(changedNodes[i], changedLocals[i]);
+			}
+			start = chrono::steady_clock::now();
+			hierarchy.update(pool.get());
+			dirtyTimes.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+			recomputed += hierarchy.updatedCount();
+
+			hierarchy.invalidate();
+			start = chrono::steady_clock::now();
+			hierarchy.update(pool.get());
+			fullTimes.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+		}
+		sort(dirtyTimes.begin(), dirtyTimes.end());
+		sort(fullTimes.begin(), fullTimes.end());
+		double dirtyMilliseconds = dirtyTimes[FRAMES / 2];
+		double fullMilliseconds = fullTimes[FRAMES / 2];
+		if (threads == 1) {
+			singleThreadDirty = dirtyMilliseconds;
+		}
+		cout << threads << (threads == 1 ? " thread:  " : " threads: ") << "1% changed " << dirtyMilliseconds << " ms (" << singleThreadDirty / dirtyMilliseconds
+			<< "x), " << recomputed / FRAMES << " nodes recomputed a frame, everything " << fullMilliseconds << " ms, "
+			<< nodeCount / (fullMilliseconds * 1000.0) << " M nodes/s, dirty updates " << fullMilliseconds / dirtyMilliseconds << "x faster" << endl;
+	}
+
+	// Changes a last batch, then compares the dirty update with every node recomputed in order of creation
+	for (size_t i = 0; i < changesPerFrame; i++) {
+		hierarchy.setLocal(pickNode(random), randomLocal());
+	}
+	hierarchy.update();
+	vector<glm::mat4> reference(nodeCount);
+	bool matches = true;
+	for (size_t i = 0; i < nodeCount; i++) {
+		reference[i] = parents[i] == TransformHierarchy::NO_PARENT ? hierarchy.local((uint32_t)i) : reference[parents[i]] * hierarchy.local((uint32_t)i);
+		matches = matches && reference[i] == hierarchy.world((uint32_t)i);
+	}
+	cout << "Dirty updates " << (matches ? "match" : "DIFFER from") << " recomputing every node" << endl;
+	return matches ? 0 : -1;
+}
+
+// ---------------------------------------- Uniform Benchmark ------------------------------------------
+// Sets a model matrix and a color per draw, like the render queue does, through glGetUniformLocation on every set as
+// Shader used to, through the name based setters and their hashed table with the name as a std::string and as a
+// literal, and through locations resolved once. Every path ends in the same location setters, so all of them pay for
+// the value shadowing alike and only the lookups differ. GL is replaced by stubs that count the calls, so this times
+// only the engine's side of each set
+int runUniformBenchmark(const Options& options) {
+	const int RUNS = 5;
+	size_t drawCount = (size_t)options.uniformBenchmark;
+
+	// Active uniforms of the lit, textured surface permutation
+	installMockGL({ "model", "objectColor", "ourTexture" });
+	Shader shader("shaders/vertex/surfaceVertexShader.txt", "shaders/fragment/surfaceFragmentShader.txt", { "TEXTURED", "LIT" });
+	shader.use();
+	cout << drawCount << " draws setting a mat4 and a vec3, median of " << RUNS << " runs, mock GL" << endl;
+
+	// The setters as they were, taking the name as a std::string and asking GL for the location every time
+	auto setMatrixByQuery = [&shader](const std::string& name, const glm::mat4& matrix) {
+		shader.setMatrixTransform4fv(glGetUniformLocation(shader.ID, name.c_str()), matrix);
+	};
+	auto setVectorByQuery = [&shader](const std::string& name, const glm::vec3& vector) {
+		shader.setFloat3fv(glGetUniformLocation(shader.ID, name.c_str()), vector);
+	};
+	int modelLocation = shader.getUniformLocation("model");
+	int colorLocation = shader.getUniformLocation("objectColor");
+
+	// Every draw gets new values unless repeat is set, when every draw sets the same ones and the shadow drops them
+	enum SetPath { QUERY, STRING_NAME, NAME, LOCATION };
+	auto timePath = [&](SetPath path, bool repeat) {
+		vector<double> times;
+		for (int run = 0; run < RUNS; run++) {
+			resetMockGLCounts();
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			for (size_t i = 0; i < drawCount; i++) {
+				float value = repeat ? 1.0f : (float)(i + run * drawCount);
+				glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(value, 0.0f, 0.0f));
+				glm::vec3 color(value, 0.5f, 0.25f);
+				if (path == QUERY) {
+					setMatrixByQuery("model", model);
+					setVectorByQuery("objectColor", color);
+				}
+				else if (path == STRING_NAME) {
+					shader.setMatrixTransform4fv(std::string("model"), model);
+					shader.setFloat3fv(std::string("objectColor"), color);
+				}
+				else if (path == NAME) {
+					shader.setMatrixTransform4fv("model", model);
+					shader.setFloat3fv("objectColor", color);
+				}
+				else {
+					shader.setMatrixTransform4fv(modelLocation, model);
+					shader.setFloat3fv(colorLocation, color);
+				}
+			}
+			times.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+		}
+		sort(times.begin(), times.end());
+		return times[RUNS / 2];
+	};
+
+	struct Case {
+		const char* name;
+		SetPath path;
+		bool repeat;
+	};
+	const Case cases[] = {
+		{ "glGetUniformLocation per set ", QUERY, false },
+		{ "std::string name, hash table ", STRING_NAME, false },
+		{ "literal name, hash table     ", NAME, false },
+		{ "location                     ", LOCATION, false },
+		{ "location, repeated values    ", LOCATION, true }
+	};
+	double queryMilliseconds = 0.0;
+	for (const Case& test : cases) {
+		double milliseconds = timePath(test.path, test.repeat);
+		if (test.path == QUERY) {
+			queryMilliseconds = milliseconds;
+		}
+		const MockGLCounts& calls = mockGLCounts();
+		cout << test.name << ": " << milliseconds * 1e6 / drawCount << " ns/draw (" << queryMilliseconds / milliseconds << "x), GL calls a draw: "
+			<< (double)calls.getUniformLocation / drawCount << " glGetUniformLocation, " << (double)calls.uniform / drawCount << " glUniform" << endl;
+	}
 	return 0;
 }
 
+// ------------------------------------------ Main -----------------------------------------------------
+int main(int argc, char** argv) {
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage();
+		return -1;
+	}
+
+	if (options.cullBenchmark > 0) {
+		return runCullBenchmark(options);
+	}
+	if (options.submitBenchmark > 0) {
+		return runSubmitBenchmark(options);
+	}
+	if (options.instanceBenchmark > 0) {
+		return runInstanceBenchmark(options);
+	}
+	if (options.matrixBenchmark > 0) {
+		return runMatrixBenchmark(options);
+	}
+	if (options.mipBenchmark > 0) {
+		return runMipBenchmark(options);
+	}
+	if (!options.textureBenchmark.empty()) {
+		return runTextureBenchmark(options);
+	}
+	if (!options.bakeFiles.empty()) {
+		return runBake(options);
+	}
+	if (!options.convertMeshFiles.empty()) {
+		return runConvertMeshes(options);
+	}
+	if (!options.meshBenchmark.empty()) {
+		return runMeshBenchmark(options);
+	}
+	if (options.startupBenchmark > 0) {
+		return runStartupBenchmark(options);
+	}
+	if (!options.importBenchmark.empty()) {
+		return runImportBenchmark(options);
+	}
+	if (!options.vertexBenchmark.empty()) {
+		return runVertexBenchmark(options);
+	}
+	if (options.ecsBenchmark > 0) {
+		return runEcsBenchmark(options);
+	}
+	if (options.hierarchyBenchmark > 0) {
+		return runHierarchyBenchmark(options);
+	}
+	if (options.uniformBenchmark > 0) {
+		return runUniformBenchmark(options);
+	}
+
+	if (options.headless) {
+		return runHeadless(options);
+	}
+	return runWindowed(options);
+}
\ No newline at end of file
@@ -0,0 +1,555 @@
+#include "scene.h"
+#include "util/cpu_profiler.h"
+#include "util/gl_extensions.h"
+#include "util/mesh_file.h"
+#include "util/mesh_importer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+const char* const Scene::BAKED_TEXTURE_DIRECTORY = "cache/textures";
+const char* const Scene::MESH_DIRECTORY = "cache/meshes";
+const char* const Scene::PROGRAM_CACHE_DIRECTORY = "cache/programs";
+
+// Where a loaded model stands and the size of its longest side
+static const glm::vec3 MODEL_POSITION(-2.5f, 0.0f, 0.0f);
+static const float MODEL_SIZE = 1.5f;
+
+// Components an entity needs to be drawn on its own
+static const ComponentMask DRAWN_COMPONENTS = componentBit(COMPONENT_NODE) | componentBit(COMPONENT_MESH) | componentBit(COMPONENT_MATERIAL);
+
+// Half floats hold the cubes' corners at +-0.5 exactly, so their dequantization stays the identity and the model and
+// instance matrices are used as they are. Axis aligned normals and 0 / 1 texture coordinates are exact as well
+static const VertexFormat CUBE_VERTEX_FORMAT = { POSITION_HALF, NORMAL_OCTAHEDRAL16, TEXCOORD_UNORM16 };
+
+// Prints how much welding, reordering and packing a mesh saved
+static void printMeshStats(const char* name, const MeshStats& stats) {
+	std::cout << name << ": " << stats.soupVertices << " -> " << stats.vertices << " vertices, "
+		<< stats.soupBytes << " -> " << stats.indexedBytes << " bytes, vertex shader invocations "
+		<< stats.soupInvocations << " -> " << stats.weldedInvocations << " welded -> " << stats.optimizedInvocations << " optimized" << std::endl;
+	std::cout << name << " packed: " << stats.floatStride << " -> " << stats.uploadedStride << " bytes a vertex, "
+		<< stats.vertices * stats.floatStride << " -> " << stats.vertices * stats.uploadedStride << " bytes of vertices, "
+		<< stats.optimizedInvocations * stats.floatStride << " -> " << stats.optimizedInvocations * stats.uploadedStride << " bytes fetched a draw, largest error "
+		<< stats.packingError.position << " position, " << stats.packingError.normalDegrees << " degrees normal, " << stats.packingError.texCoord << " texture coordinate" << std::endl;
+}
+
+// Creates an entity drawn on its own, placed by a new node under parent
+static Entity createDrawnEntity(World& world, TransformHierarchy& hierarchy, uint32_t parent, const glm::mat4& local, int geometry, int material, ComponentMask extraComponents = 0) {
+	Entity entity = world.create(DRAWN_COMPONENTS | extraComponents);
+	world.get<NodeComponent>(entity)->node = hierarchy.add(parent, local);
+	world.get<MeshComponent>(entity)->geometry = geometry;
+	world.get<MaterialComponent>(entity)->material = material;
+	return entity;
+}
+
+// Builds the scene
+Scene::Scene(ThreadPool& workerPool, int extraCubes, int mixedDrawCount, bool persistentStreaming, bool bakedTextures) : sortDraws(true), profiler(nullptr), recordPool(&workerPool), workerPool(workerPool), programCache(PROGRAM_CACHE_DIRECTORY), surfaceShaders("shaders/vertex/surfaceVertexShader.txt", "shaders/fragment/surfaceFragmentShader.txt", &programCache), lightShaders("shaders/vertex/surfaceVertexShader.txt", "shaders/fragment/lightingFragmentShader.txt", &programCache), light(NULL_ENTITY), modelEntity(NULL_ENTITY), textureStreamer(workerPool, 4 * 1024 * 1024, bakedTextures ? BAKED_TEXTURE_DIRECTORY : "") {
+	// ----------------------------------------- Shader Program -------------------------------------------
+	// Linked programs are cached on disk so only the first launch pays for compiling them
+	std::chrono::steady_clock::time_point shaderStartTime = std::chrono::steady_clock::now();
+
+	// Only the permutations asked for here are ever compiled
+	threeDShaderProgram = &surfaceShaders.get(SHADER_TEXTURED | SHADER_INSTANCED);
+	simpleShader = &surfaceShaders.get(SHADER_LIT | SHADER_OCTAHEDRAL_NORMALS);
+	lightingShader = &lightShaders.get(0);
+
+	// Every program reads the camera and light from the same uniform buffer
+	for (Shader* shader : { threeDShaderProgram, simpleShader, lightingShader }) {
+		shader->bindUniformBlock(FrameUniformBuffer::BLOCK_NAME, FrameUniformBuffer::BINDING);
+	}
+
+	double shaderTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shaderStartTime).count();
+	std::cout << "Shaders ready in " << shaderTime << " ms (" << surfaceShaders.size() + lightShaders.size() << " permutations, "
+		<< programCache.hits << " cached, " << programCache.misses << " compiled)" << std::endl;
+
+	// ------------------------------------------ tau cube ---------------------------------------------------------------
+	float textured_cube[] = {
+	-0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+	 0.5f, -0.5f, -0.5f,  1.0f, 0.0f,
+	 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+	 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+	-0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
+	-0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
+
+	-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+	 0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+	 0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
+	 0.5f,  0.5f,  0.5f,  1.0f, 1.0f,
+	-0.5f,  0.5f,  0.5f,  0.0f, 1.0f,
+	-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+
+	-0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+	-0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+	-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+	-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+	-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+	-0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+
+	 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+	 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+	 0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+	 0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+	 0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+	 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+
+	-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+	 0.5f, -0.5f, -0.5f,  1.0f, 1.0f,
+	 0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+	 0.5f, -0.5f,  0.5f,  1.0f, 0.0f,
+	-0.5f, -0.5f,  0.5f,  0.0f, 0.0f,
+	-0.5f, -0.5f, -0.5f,  0.0f, 1.0f,
+
+	-0.5f,  0.5f, -0.5f,  0.0f, 1.0f,
+	 0.5f,  0.5f, -0.5f,  1.0f, 1.0f,
+	 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+	 0.5f,  0.5f,  0.5f,  1.0f, 0.0f,
+	-0.5f,  0.5f,  0.5f,  0.0f, 0.0f,
+	-0.5f,  0.5f, -0.5f,  0.0f, 1.0f
+	};
+
+	// Welded into an indexed mesh: pos coords, texture coords
+	texturedCubeMesh.reset(new Mesh(textured_cube, 36, { 3, 2 }));
+	texturedCubeMesh->upload({ VERTEX_POSITION, VERTEX_TEXCOORD }, CUBE_VERTEX_FORMAT);
+	printMeshStats("Textured cube", texturedCubeMesh->stats);
+
+
+	// ------------------------------------------ Dupe Cubes ------------------------------------------------------------
+	std::vector<glm::vec3> tau_cubes = {
+		// glm::vec3(0.0f,  0.0f,  0.0f),
+		glm::vec3(2.0f,  5.0f, -15.0f),
+		glm::vec3(-1.5f, -2.2f, -2.5f),
+		glm::vec3(-3.8f, -2.0f, -12.3f),
+		glm::vec3(2.4f, -0.4f, -3.5f),
+		glm::vec3(-1.7f,  3.0f, -7.5f),
+		glm::vec3(1.3f, -2.0f, -2.5f),
+		glm::vec3(1.5f,  2.0f, -2.5f),
+		glm::vec3(1.5f,  0.2f, -1.5f),
+		glm::vec3(-1.3f,  1.0f, -1.5f)
+	};
+
+	// Stress test cubes, scattered with a fixed seed so every run renders the same scene
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> spread(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> depth(-100.0f, -5.0f);
+	for (int i = 0; i < extraCubes; i++) {
+		float x = spread(random);
+		float y = spread(random);
+		tau_cubes.push_back(glm::vec3(x, y, depth(random)));
+	}
+
+	// Every tau cube is drawn in one instanced call, model matrices are built in parallel straight into the instance buffer.
+	// A unit cube spinning about any axis stays within its bounding sphere, sqrt(3) / 2 from its center
+	const glm::vec3 spinAxis = glm::normalize(glm::vec3(0.5f, 1.0f, 0.0f));
+	const glm::vec3 spinExtent(0.8660254f);
+	std::vector<AABB> tauCubeBoxes(tau_cubes.size());
+	for (unsigned int i = 0; i < tau_cubes.size(); i++) {
+		Entity cube = world.create(componentBit(COMPONENT_TRANSFORM) | componentBit(COMPONENT_BOUNDS));
+		TransformComponent* transform = world.get<TransformComponent>(cube);
+		transform->position = tau_cubes[i];
+		transform->scale = glm::vec3(1.0f);
+		transform->spinAxis = spinAxis;
+		transform->spinSpeed = glm::radians(50.0f) * i;
+		BoundsComponent* bounds = world.get<BoundsComponent>(cube);
+		bounds->box = AABB{ tau_cubes[i] - spinExtent, tau_cubes[i] + spinExtent };
+		tauCubeBoxes[i] = bounds->box;
+		tauCubes.push_back(cube);
+	}
+	tauCubeInstances.reset(new InstancedMesh(*texturedCubeMesh));
+	tauCubeBounds.build(tauCubeBoxes.data(), tauCubeBoxes.size());
+
+	// Each frame needs room for every cube's matrix and the frame uniforms, plus slack for alignment
+	frameStream.reset(new StreamBuffer(tau_cubes.size() * sizeof(glm::mat4) + 64 * 1024, persistentStreaming));
+	frameUniforms.reset(new FrameUniformBuffer(frameStream.get()));
+	std::cout << "Stream buffer: " << StreamBuffer::SEGMENT_COUNT << " x " << frameStream->segmentSize() / 1024 << " KB, "
+		<< (frameStream->isPersistent() ? "persistently mapped" : "mapped per frame") << std::endl;
+
+	// ---------------------------------------- Blank Cube --------------------------------------------
+	float cube[] = {
+	-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
+	 0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
+	 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
+	 0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
+	-0.5f,  0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
+	-0.5f, -0.5f, -0.5f,  0.0f,  0.0f, -1.0f,
+
+	-0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
+	 0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
+	 0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
+	 0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
+	-0.5f,  0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
+	-0.5f, -0.5f,  0.5f,  0.0f,  0.0f, 1.0f,
+
+	-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
+	-0.5f,  0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
+	-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
+	-0.5f, -0.5f, -0.5f, -1.0f,  0.0f,  0.0f,
+	-0.5f, -0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
+	-0.5f,  0.5f,  0.5f, -1.0f,  0.0f,  0.0f,
+
+	 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
+	 0.5f,  0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
+	 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
+	 0.5f, -0.5f, -0.5f,  1.0f,  0.0f,  0.0f,
+	 0.5f, -0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
+	 0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
+
+	-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
+	 0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
+	 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
+	 0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
+	-0.5f, -0.5f,  0.5f,  0.0f, -1.0f,  0.0f,
+	-0.5f, -0.5f, -0.5f,  0.0f, -1.0f,  0.0f,
+
+	-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,
+	 0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f,
+	 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
+	 0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
+	-0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
+	-0.5f,  0.5f, -0.5f,  0.0f,  1.0f,  0.0f
+	};
+
+	// Welded into an indexed mesh: pos coords, normals. The light is drawn with the same mesh
+	cubeMesh.reset(new Mesh(cube, 36, { 3, 3 }));
+	cubeMesh->upload({ VERTEX_POSITION, VERTEX_NORMAL }, CUBE_VERTEX_FORMAT);
+	printMeshStats("Cube", cubeMesh->stats);
+
+
+	// -------------------------------------------- Textures -------------------------------------------
+	// Decoded on the worker pool and uploaded over the first frames, a placeholder is bound until then
+	tauTexture = textureStreamer.request("textures/cat.jpg", GL_REPEAT, GL_LINEAR, GL_LINEAR);
+	containerTexture = textureStreamer.request("textures/container.jpg");
+
+	// ------------------------------------ Uniform Locations -----------------------------------------
+	// Resolved once so the render loop sets uniforms without any name lookups
+	resolveUniforms();
+
+	// ------------------------------------ Render Queue -----------------------------------------
+	// Materials: shader, textures for units 0 and 1, color uniform and color, model uniform
+	simpleMaterial = renderQueue.addMaterial(Material{ simpleShader, { 0, 0 }, simpleObjectColor, glm::vec3(1.0f, 0.5f, 0.31f), simpleModel });
+	lightMaterial = renderQueue.addMaterial(Material{ lightingShader, { 0, 0 }, -1, glm::vec3(1.0f), lightingModel });
+	tauMaterial = renderQueue.addMaterial(Material{ threeDShaderProgram, { 0, 0 }, threeDShaderProgram->getUniformLocation("objectColor"), glm::vec3(1.0f), -1 });
+
+	cubeGeometry = renderQueue.addGeometry(Geometry{ cubeMesh->VAO, cubeMesh->indexType(), cubeMesh->indexCount() });
+	tauGeometry = renderQueue.addGeometry(Geometry{ tauCubeInstances->VAO, tauCubeInstances->indexType, tauCubeInstances->vertexCount });
+	modelGeometry = -1;
+
+	// The blank cube at the origin, and the light drawn as a small cube where it shines from
+	createDrawnEntity(world, hierarchy, TransformHierarchy::NO_PARENT, glm::mat4(1.0f), cubeGeometry, simpleMaterial);
+	glm::mat4 lightModel = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(1.2f, 1.0f, 2.0f)), glm::vec3(0.2f));
+	light = createDrawnEntity(world, hierarchy, TransformHierarchy::NO_PARENT, lightModel, cubeGeometry, lightMaterial, componentBit(COMPONENT_LIGHT));
+	world.get<LightComponent>(light)->color = glm::vec3(1.0f);
+
+	// Mixed draw benchmark: a palette of lit and unlit materials, deliberately submitted in random order
+	std::vector<int> mixedMaterials;
+	for (int i = 0; i < 16; i++) {
+		float hue = i / 16.0f;
+		glm::vec3 color(0.5f + 0.5f * cos(6.2831853f * hue), 0.5f + 0.5f * cos(6.2831853f * (hue - 0.333f)), 0.5f + 0.5f * cos(6.2831853f * (hue - 0.667f)));
+		if (i % 4 == 3) {
+			mixedMaterials.push_back(renderQueue.addMaterial(Material{ lightingShader, { 0, 0 }, -1, color, lightingModel }));
+		}
+		else {
+			mixedMaterials.push_back(renderQueue.addMaterial(Material{ simpleShader, { 0, 0 }, simpleObjectColor, color, simpleModel }));
+		}
+	}
+	// They hang off one group node, moving it would recompute just that subtree
+	uint32_t mixedDrawGroup = hierarchy.add(TransformHierarchy::NO_PARENT, glm::mat4(1.0f));
+	std::mt19937 mixedRandom(4321);
+	std::uniform_int_distribution<int> pickMaterial(0, (int)mixedMaterials.size() - 1);
+	for (int i = 0; i < mixedDrawCount; i++) {
+		glm::vec3 position(spread(mixedRandom), spread(mixedRandom), depth(mixedRandom));
+		glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.5f));
+		createDrawnEntity(world, hierarchy, mixedDrawGroup, model, cubeGeometry, mixedMaterials[pickMaterial(mixedRandom)]);
+	}
+}
+
+// Loads a model from its converted file or its source
+bool Scene::loadModel(const std::string& path) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// The converted file goes to the driver straight from the mapping, its positions still quantized
+	MeshFile file;
+	AABB bounds;
+	glm::mat4 dequantization(1.0f);
+	size_t triangles = 0;
+	const char* source = nullptr;
+	if (file.open(meshFilePath(MESH_DIRECTORY, path), path)) {
+		model.reset(new GpuMesh(file.layout(), file.vertexData(), file.vertexBytes(), file.indexData(), file.indexBytes(), file.indexType()));
+		bounds = file.bounds();
+		dequantization = file.dequantization();
+		triangles = file.indexCount() / 3;
+		source = "converted file";
+	}
+	else {
+		// Packed like a converted file, both are drawn with the same octahedral normal shader
+		ImportedMesh imported;
+		if (!importMesh(path, imported, &workerPool)) {
+			return false;
+		}
+		PackedVertices packed;
+		packVertices(imported.vertices.data(), imported.vertexCount(), imported.attributeSizes(), imported.semantics(), MESH_FILE_VERTEX_FORMAT, packed, &workerPool);
+		model.reset(new GpuMesh(packed.layout, packed.data.data(), packed.data.size(), imported.indices.data(), imported.indices.size() * sizeof(uint32_t), GL_UNSIGNED_INT));
+		bounds = AABB{ packed.boundsMin, packed.boundsMax };
+		dequantization = packed.dequantization;
+		triangles = imported.indices.size() / 3;
+		source = "parsed source";
+	}
+	// A model loaded before hands its handle over, its VAO went with it
+	Geometry geometry = { model->VAO, model->indexType, model->indexCount };
+	if (modelGeometry >= 0) {
+		renderQueue.updateGeometry(modelGeometry, geometry);
+	}
+	else {
+		modelGeometry = renderQueue.addGeometry(geometry);
+		if (modelGeometry < 0) {
+			return false;
+		}
+	}
+
+	// Centered on MODEL_POSITION and scaled so the longest side is MODEL_SIZE
+	glm::vec3 extent = bounds.max - bounds.min;
+	float longest = std::max(std::max(extent.x, extent.y), extent.z);
+	float scale = longest > 0.0f ? MODEL_SIZE / longest : 1.0f;
+	glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), MODEL_POSITION);
+	modelMatrix = glm::scale(modelMatrix, glm::vec3(scale));
+	modelMatrix = glm::translate(modelMatrix, -(bounds.min + bounds.max) * 0.5f);
+	modelMatrix = modelMatrix * dequantization;
+
+	// A model loaded before gives up its place
+	if (world.isAlive(modelEntity)) {
+		hierarchy.setLocal(world.get<NodeComponent>(modelEntity)->node, modelMatrix);
+	}
+	else {
+		modelEntity = createDrawnEntity(world, hierarchy, TransformHierarchy::NO_PARENT, modelMatrix, modelGeometry, simpleMaterial);
+	}
+
+	std::cout << "Model: " << path << ", " << triangles << " triangles from the " << source << ", " << model->bytes / 1024 << " KB of video memory, "
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+	return true;
+}
+
+// Resolves the uniform locations and sets the uniforms that never change
+void Scene::resolveUniforms() {
+	simpleObjectColor = simpleShader->getUniformLocation("objectColor");
+	simpleModel = simpleShader->getUniformLocation("model");
+
+	lightingModel = lightingShader->getUniformLocation("model");
+
+	threeDTexture = threeDShaderProgram->getUniformLocation("ourTexture");
+
+	// The sampler always reads unit 0
+	threeDShaderProgram->use();
+	threeDShaderProgram->setInt(threeDTexture, 0);
+
+	// Materials keep the locations of their shader's color and model uniforms
+	for (int i = 0; i < renderQueue.materialCount(); i++) {
+		Material& material = renderQueue.material(i);
+		material.colorLocation = material.shader->getUniformLocation("objectColor");
+		material.modelLocation = material.shader->getUniformLocation("model");
+	}
+}
+
+// Members, the shader variants included, free their GL objects themselves
+Scene::~Scene() {
+}
+
+// Number of spinning cubes
+size_t Scene::cubeCount() const {
+	return tauCubes.size();
+}
+
+// Number of spinning cubes that survived culling in the last rendered frame
+size_t Scene::visibleCubeCount() const {
+	return visibleTauCubes.size();
+}
+
+// Number of textures still being decoded or uploaded
+int Scene::pendingTextures() const {
+	return textureStreamer.pendingCount();
+}
+
+// Load times and memory of the textures loaded so far
+const TextureStreamerStats& Scene::textureStats() const {
+	return textureStreamer.stats();
+}
+
+// Draw and state switch counts of the last rendered frame
+const RenderQueueStats& Scene::queueStats() const {
+	return renderQueue.stats();
+}
+
+// Ring buffer the per frame uniforms and instance matrices are streamed through
+const StreamBuffer& Scene::streamBuffer() const {
+	return *frameStream;
+}
+
+// Per frame work that isn't drawing
+void Scene::update() {
+	// Upload the next slice of any streamed textures
+	{
+		GpuProfileScope streamingScope(profiler, "Texture streaming");
+		textureStreamer.update();
+	}
+
+	// Rebuild programs whose sources were written, they keep drawing with the old program until the new one links
+	if (shaderWatcher) {
+		PROFILE_ZONE("Watch shaders");
+		shaderWatcher->poll(changedShaderFiles);
+		for (const std::string& path : changedShaderFiles) {
+			std::cout << "Reloading shaders using " << path << std::endl;
+			for (Shader* shader : { threeDShaderProgram, simpleShader, lightingShader }) {
+				if (shader->usesFile(path)) {
+					shader->beginReload();
+				}
+			}
+		}
+	}
+	finishShaderReloads(false);
+
+	// World matrices of the nodes that were moved, and everything below them
+	hierarchy.update(&workerPool);
+}
+
+// Rebuilds a program in the background whenever one of its shader files is written
+void Scene::watchShaders() {
+	shaderWatcher.reset(new FileWatcher());
+
+	// Includes are watched too, editing a shared header rebuilds every program using it
+	std::vector<std::string> watched;
+	for (Shader* shader : { threeDShaderProgram, simpleShader, lightingShader }) {
+		for (const std::string& path : shader->files()) {
+			if (std::find(watched.begin(), watched.end(), path) == watched.end()) {
+				watched.push_back(path);
+				shaderWatcher->watch(path);
+			}
+		}
+	}
+
+	// Let the driver use as many compiler threads as it likes
+	if (GLEXT_KHR_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+	}
+	std::cout << "Watching shaders" << (shaderWatcher->isNative() ? " with inotify" : "") << ", compiling "
+		<< (GLEXT_KHR_parallel_shader_compile ? "in the background" : "on the render thread") << std::endl;
+}
+
+// Rebuilds every program from source
+void Scene::reloadShaders(bool blocking) {
+	for (Shader* shader : { threeDShaderProgram, simpleShader, lightingShader }) {
+		shader->beginReload(false);
+	}
+	if (blocking) {
+		finishShaderReloads(true);
+	}
+}
+
+// Number of programs still being rebuilt
+int Scene::pendingReloads() const {
+	int pending = 0;
+	for (const Shader* shader : { threeDShaderProgram, simpleShader, lightingShader }) {
+		pending += shader->isReloading() ? 1 : 0;
+	}
+	return pending;
+}
+
+// Swaps in the programs whose rebuild has finished
+void Scene::finishShaderReloads(bool wait) {
+	bool swapped = false;
+	for (Shader* shader : { threeDShaderProgram, simpleShader, lightingShader }) {
+		if (!shader->isReloading()) {
+			continue;
+		}
+		// Relinking resets uniform block bindings along with everything else
+		if (shader->pollReload(wait) == Shader::RELOAD_SWAPPED) {
+			shader->bindUniformBlock(FrameUniformBuffer::BLOCK_NAME, FrameUniformBuffer::BINDING);
+			swapped = true;
+		}
+	}
+	if (swapped) {
+		resolveUniforms();
+	}
+}
+
+// Draws the scene at time seconds
+void Scene::render(float time, const glm::mat4& view, const glm::mat4& projection) {
+	GLStateCache& state = GLStateCache::current();
+	GpuProfileScope renderScope(profiler, "Scene render");
+
+	// Waits only if the GPU is still reading the segment from three frames ago
+	{
+		PROFILE_ZONE("Stream buffer wait");
+		frameStream->beginFrame();
+	}
+
+	// Camera and light go out once for all programs
+	FrameUniforms uniforms;
+	uniforms.view = view;
+	uniforms.projection = projection;
+	uniforms.viewProjection = projection * view;
+	uniforms.cameraPos = glm::inverse(view)[3];
+	uniforms.lightPos = hierarchy.world(world.get<NodeComponent>(light)->node)[3];
+	uniforms.lightColor = glm::vec4(world.get<LightComponent>(light)->color, 1.0f);
+	{
+		PROFILE_ZONE("Upload frame uniforms");
+		frameUniforms->update(uniforms);
+	}
+
+	state.polygonMode(GL_FILL);
+
+	// Streamed textures stay on the placeholder until resident, so the tau material picks them up each frame
+	Material& tau = renderQueue.material(tauMaterial);
+	tau.textures[0] = textureStreamer.texture(tauTexture);
+	tau.textures[1] = textureStreamer.texture(containerTexture);
+
+	// The projection's far plane bounds the depth range of the sort keys
+	float farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+	renderQueue.begin(view, farPlane);
+
+	// The blank cube, the light, a loaded model and the mixed draws are keyed in parallel, each chunk of entities filling
+	// its own range of queue slots with the world matrices the hierarchy keeps
+	size_t firstDraw = renderQueue.allocate(world.count(DRAWN_COMPONENTS));
+	world.forEachChunk(DRAWN_COMPONENTS, [this, firstDraw](const ChunkView& chunk) {
+		PROFILE_ZONE("Submit entities");
+		const MeshComponent* meshes = chunk.get<MeshComponent>();
+		const MaterialComponent* materials = chunk.get<MaterialComponent>();
+		const NodeComponent* nodes = chunk.get<NodeComponent>();
+		for (size_t i = 0; i < chunk.count; i++) {
+			renderQueue.submitAt(firstDraw + chunk.firstIndex + i, materials[i].material, meshes[i].geometry, hierarchy.world(nodes[i].node));
+		}
+	}, recordPool);
+
+	// Tau cubes in view, one instanced draw
+	{
+		GpuProfileScope cullScope(profiler, "Cull and stream");
+		tauCubeBounds.cull(Frustum::fromMatrix(uniforms.viewProjection), visibleTauCubes);
+		visibleTauCubeTransforms.resize(visibleTauCubes.size());
+		for (size_t i = 0; i < visibleTauCubes.size(); i++) {
+			visibleTauCubeTransforms[i] = world.get<TransformComponent>(tauCubes[visibleTauCubes[i]]);
+		}
+		StreamAllocation tauCubeModels = frameStream->allocate(visibleTauCubes.size() * sizeof(glm::mat4));
+		if (tauCubeModels.pointer) {
+			computeModelMatrices(time, visibleTauCubeTransforms.data(), visibleTauCubeTransforms.size(), (glm::mat4*)tauCubeModels.pointer, &workerPool);
+			tauCubeInstances->setInstanceSource(frameStream->ID, tauCubeModels.offset, visibleTauCubes.size());
+		}
+		else {
+			tauCubeInstances->setInstanceSource(frameStream->ID, 0, 0);
+		}
+		frameStream->commit();
+	}
+	if (tauCubeInstances->instanceCount > 0) {
+		renderQueue.submit(tauMaterial, tauGeometry, glm::mat4(1.0f), RenderQueue::OPAQUE_PASS, tauCubeInstances->instanceCount);
+	}
+
+	if (sortDraws) {
+		GpuProfileScope sortScope(profiler, "Sort draws");
+		renderQueue.sort();
+	}
+	{
+		GpuProfileScope executeScope(profiler, "Execute draws");
+		renderQueue.execute(recordPool);
+	}
+
+	frameStream->endFrame();
+}
\ No newline at end of file
@@ -0,0 +1,166 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "util/shader.h"
+#include "util/shader_variants.h"
+#include "util/program_cache.h"
+#include "util/mesh.h"
+#include "util/instanced_mesh.h"
+#include "util/thread_pool.h"
+#include "util/transform_system.h"
+#include "util/transform_hierarchy.h"
+#include "util/world.h"
+#include "util/texture_streamer.h"
+#include "util/gl_state_cache.h"
+#include "util/frame_uniforms.h"
+#include "util/render_queue.h"
+#include "util/bvh.h"
+#include "util/stream_buffer.h"
+#include "util/gpu_profiler.h"
+#include "util/file_watcher.h"
+#include "util/gpu_mesh.h"
+
+// The demo scene: a lit blank cube, the light itself, a field of spinning textured cubes and optionally a loaded model.
+// It owns every GL object it creates, so it has to be destroyed while its context is still current.
+class Scene {
+public:
+	// Where textures are looked for in baked form before decoding their source images
+	static const char* const BAKED_TEXTURE_DIRECTORY;
+	// Where models are looked for in converted form before parsing their source files
+	static const char* const MESH_DIRECTORY;
+	// Where linked program binaries are cached between launches
+	static const char* const PROGRAM_CACHE_DIRECTORY;
+
+	// Sort the frame's draws before executing them, off draws in submission order for comparison
+	bool sortDraws;
+	// Passes are measured as scopes of this profiler when set
+	GpuProfiler* profiler;
+	// Threads the mixed draws are submitted and the render queue's commands recorded on, the worker pool
+	// unless changed. Null does both on the render thread
+	ThreadPool* recordPool;
+
+	// Builds the scene, extraCubes scatters that many more spinning cubes around the hand placed ones
+	// and mixedDraws adds that many static cubes drawn one by one with a random mix of materials.
+	// persistentStreaming false maps the per frame stream buffer every frame even when persistent mapping is available,
+	// bakedTextures false decodes the source images even where a baked version exists
+	Scene(ThreadPool& workerPool, int extraCubes = 0, int mixedDraws = 0, bool persistentStreaming = true, bool bakedTextures = true);
+	~Scene();
+
+	Scene(const Scene&) = delete;
+	Scene& operator=(const Scene&) = delete;
+
+	// Loads an OBJ or glTF model and places it beside the blank cube, lit like it, replacing any model loaded before. Uses the
+	// converted file in MESH_DIRECTORY when it's up to date and parses the source on the worker pool otherwise. Returns false if neither loads
+	bool loadModel(const std::string& path);
+
+	// Number of spinning cubes
+	size_t cubeCount() const;
+
+	// Number of spinning cubes that survived culling in the last rendered frame
+	size_t visibleCubeCount() const;
+
+	// Number of textures still being decoded or uploaded
+	int pendingTextures() const;
+
+	// Load times and memory of the textures loaded so far
+	const TextureStreamerStats& textureStats() const;
+
+	// Draw and state switch counts of the last rendered frame
+	const RenderQueueStats& queueStats() const;
+
+	// Ring buffer the per frame uniforms and instance matrices are streamed through
+	const StreamBuffer& streamBuffer() const;
+
+	// Per frame work that isn't drawing, such as streaming textures and swapping in reloaded shaders, call once before render
+	void update();
+
+	// Rebuilds a program in the background whenever one of its shader files is written
+	void watchShaders();
+
+	// Rebuilds every program from source. Non blocking reloads compile in the background while the old programs keep
+	// drawing and are swapped in by a later update, blocking ones compile and swap before returning
+	void reloadShaders(bool blocking);
+
+	// Number of programs still being rebuilt
+	int pendingReloads() const;
+
+	// Draws the scene time seconds into the animation with the given camera matrices
+	void render(float time, const glm::mat4& view, const glm::mat4& projection);
+
+private:
+	ThreadPool& workerPool;
+	ProgramCache programCache;
+
+	// Lit, textured and instanced surfaces are permutations of one shader, the light has its own fragment shader
+	ShaderVariants surfaceShaders;
+	ShaderVariants lightShaders;
+
+	// Permutations in use, owned by the variants above
+	Shader* threeDShaderProgram;
+	Shader* simpleShader;
+	Shader* lightingShader;
+
+	std::unique_ptr<Mesh> texturedCubeMesh;
+	std::unique_ptr<Mesh> cubeMesh;
+
+	// Everything placed in the scene. Entities with a node, mesh and material are drawn one by one, the tau cubes spin
+	// every frame so they have a transform and bounds instead, and are drawn together
+	World world;
+	// Placement of everything that only moves when told to, world matrices are only recomputed below nodes that change
+	TransformHierarchy hierarchy;
+	Entity light;
+	Entity modelEntity;
+
+	// Object i of the BVH is tauCubes[i]
+	std::vector<Entity> tauCubes;
+	std::unique_ptr<InstancedMesh> tauCubeInstances;
+
+	// Tau cubes only spin in place, so their bounds are built once and only the cubes in view get matrices
+	BVH tauCubeBounds;
+	std::vector<uint32_t> visibleTauCubes;
+	std::vector<const TransformComponent*> visibleTauCubeTransforms;
+
+	// Per frame data written by the CPU: frame uniforms and tau cube matrices
+	std::unique_ptr<StreamBuffer> frameStream;
+
+	// Camera and light data shared by all programs, uploaded once per frame
+	std::unique_ptr<FrameUniformBuffer> frameUniforms;
+
+	// Every draw goes through the queue, which orders them to minimise state changes
+	RenderQueue renderQueue;
+	int simpleMaterial, lightMaterial, tauMaterial;
+	int cubeGeometry, tauGeometry;
+	// Queue handle of the loaded model, -1 until the first one is loaded and reused by every model after it
+	int modelGeometry;
+
+	// Model given to loadModel, its entity's node includes the dequantization of its packed positions
+	std::unique_ptr<GpuMesh> model;
+
+	TextureStreamer textureStreamer;
+	int tauTexture;
+	int containerTexture;
+
+	// Uniform locations, resolved once after the shaders are built and again after one is relinked
+	int simpleObjectColor, simpleModel;
+	int lightingModel;
+	int threeDTexture;
+
+	// Shader hot reloading, only set up by watchShaders
+	std::unique_ptr<FileWatcher> shaderWatcher;
+	std::vector<std::string> changedShaderFiles;
+
+	// Resolves the uniform locations above and those held by materials, and sets the uniforms that never change
+	void resolveUniforms();
+
+	// Swaps in the programs whose rebuild has finished, wait blocks until every rebuild has
+	void finishShaderReloads(bool wait);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "baked_texture.h"
+#include "gl_extensions.h"
+#include "mip_generator.h"
+#include "stb_image.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Layout of the start of every baked file, followed by levelCount level entries
+struct BakedTextureHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	// Size and write time of the source image, to notice when it's been changed since baking
+	uint64_t sourceSize;
+	int64_t sourceTime;
+};
+
+// Where one mip level's blocks are in the file
+struct BakedLevelEntry {
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset;
+	uint64_t size;
+};
+
+static const char BAKED_TEXTURE_MAGIC[4] = { 'B', 'T', 'E', 'X' };
+static const uint32_t BAKED_TEXTURE_VERSION = 1;
+static const size_t LEVEL_ALIGNMENT = 16;
+// A 32 level chain would already be 2^31 pixels wide
+static const uint32_t MAX_LEVELS = 32;
+
+// Where the baked version of a source image lives inside a directory
+std::string bakedTexturePath(const std::string& directory, const std::string& sourcePath) {
+	return cacheFilePath(directory, sourcePath, ".btex");
+}
+
+// Decodes, mips and compresses an image into a baked file
+bool bakeTexture(const std::string& sourcePath, const std::string& bakedPath, int format, ThreadPool* pool, BakeStats& stats) {
+	stats = BakeStats();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// Always decoded to RGBA, the block encoders take four channels
+	int width, height, channels;
+	unsigned char* pixels = stbi_load(sourcePath.c_str(), &width, &height, &channels, 4);
+	if (!pixels) {
+		return false;
+	}
+	uint64_t sourceSize = 0;
+	int64_t sourceTime = 0;
+	sourceStamp(sourcePath, sourceSize, sourceTime);
+	std::chrono::steady_clock::time_point decoded = std::chrono::steady_clock::now();
+
+	// Opaque images don't need BC3's alpha block
+	if (format < 0) {
+		bool opaque = true;
+		if (channels == 2 || channels == 4) {
+			for (size_t i = 0; i < (size_t)width * height && opaque; i++) {
+				opaque = pixels[i * 4 + 3] == 255;
+			}
+		}
+		format = opaque ? COMPRESSED_BC1 : COMPRESSED_BC3;
+	}
+	CompressedFormat compressedFormat = (CompressedFormat)format;
+
+	// The whole chain down to 1x1. Baking happens offline, so it can afford the sharper Kaiser filter
+	std::vector<MipLevel> chain(1);
+	chain[0].width = width;
+	chain[0].height = height;
+	chain[0].pixels.assign(pixels, pixels + (size_t)width * height * 4);
+	stbi_image_free(pixels);
+	std::vector<MipLevel> mips;
+	generateMipChain(chain[0].pixels.data(), width, height, 4, defaultMipOptions(MIP_FILTER_KAISER), mips, pool);
+	for (MipLevel& level : mips) {
+		chain.push_back(std::move(level));
+	}
+	std::chrono::steady_clock::time_point mipped = std::chrono::steady_clock::now();
+
+	// Header and level index up front, then every level on a 16 byte boundary
+	BakedTextureHeader header;
+	memcpy(header.magic, BAKED_TEXTURE_MAGIC, sizeof(header.magic));
+	header.version = BAKED_TEXTURE_VERSION;
+	header.format = (uint32_t)compressedFormat;
+	header.width = (uint32_t)width;
+	header.height = (uint32_t)height;
+	header.levelCount = (uint32_t)chain.size();
+	header.sourceSize = sourceSize;
+	header.sourceTime = sourceTime;
+
+	std::vector<BakedLevelEntry> entries(chain.size());
+	size_t offset = sizeof(header) + entries.size() * sizeof(BakedLevelEntry);
+	for (size_t i = 0; i < chain.size(); i++) {
+		offset = (offset + LEVEL_ALIGNMENT - 1) & ~(LEVEL_ALIGNMENT - 1);
+		entries[i] = BakedLevelEntry{ (uint32_t)chain[i].width, (uint32_t)chain[i].height, offset, compressedImageBytes(compressedFormat, chain[i].width, chain[i].height) };
+		offset += entries[i].size;
+	}
+
+	std::vector<unsigned char> file(offset, 0);
+	memcpy(file.data(), &header, sizeof(header));
+	memcpy(file.data() + sizeof(header), entries.data(), entries.size() * sizeof(BakedLevelEntry));
+	for (size_t i = 0; i < chain.size(); i++) {
+		compressImage(compressedFormat, chain[i].pixels.data(), chain[i].width, chain[i].height, file.data() + entries[i].offset, pool);
+	}
+	std::chrono::steady_clock::time_point compressed = std::chrono::steady_clock::now();
+
+	if (!writeFileAtomically(bakedPath, file.data(), file.size())) {
+		std::cout << "WARNING::BAKED_TEXTURE::CANNOT_WRITE " << bakedPath << std::endl;
+		return false;
+	}
+
+	stats.width = width;
+	stats.height = height;
+	stats.levels = (int)chain.size();
+	stats.format = compressedFormat;
+	stats.sourceBytes = (size_t)sourceSize;
+	stats.bakedBytes = file.size();
+	stats.decodeMilliseconds = std::chrono::duration<double, std::milli>(decoded - start).count();
+	stats.mipMilliseconds = std::chrono::duration<double, std::milli>(mipped - decoded).count();
+	stats.compressMilliseconds = std::chrono::duration<double, std::milli>(compressed - mipped).count();
+	return true;
+}
+
+BakedTexture::BakedTexture() : compressedFormat(COMPRESSED_BC1), levels(0) {
+}
+
+// Maps a baked file and checks it against its source
+bool BakedTexture::open(const std::string& path, const std::string& sourcePath) {
+	levels = 0;
+	if (!file.open(path)) {
+		return false;
+	}
+
+	// Anything that doesn't look exactly like what bakeTexture writes is treated as corrupt
+	const BakedTextureHeader* header = (const BakedTextureHeader*)file.data();
+	bool valid = file.size() >= sizeof(BakedTextureHeader)
+		&& memcmp(header->magic, BAKED_TEXTURE_MAGIC, sizeof(header->magic)) == 0
+		&& header->version == BAKED_TEXTURE_VERSION
+		&& header->format <= COMPRESSED_BC7
+		&& header->levelCount > 0 && header->levelCount <= MAX_LEVELS
+		&& file.size() >= sizeof(BakedTextureHeader) + header->levelCount * sizeof(BakedLevelEntry);
+	if (valid) {
+		const BakedLevelEntry* entries = (const BakedLevelEntry*)(file.data() + sizeof(BakedTextureHeader));
+		// Offsets aren't added to sizes, a huge one from a corrupt file would wrap around
+		for (uint32_t i = 0; i < header->levelCount && valid; i++) {
+			valid = entries[i].offset % LEVEL_ALIGNMENT == 0
+				&& entries[i].offset <= file.size() && entries[i].size <= file.size() - entries[i].offset
+				&& entries[i].size == compressedImageBytes((CompressedFormat)header->format, entries[i].width, entries[i].height);
+		}
+	}
+
+	// A source that's missing is fine, the baked file may be all that was shipped
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	if (valid && sourceStamp(sourcePath, sourceSize, sourceTime)) {
+		valid = sourceSize == header->sourceSize && sourceTime == header->sourceTime;
+	}
+
+	if (!valid) {
+		file.close();
+		return false;
+	}
+	compressedFormat = (CompressedFormat)header->format;
+	levels = (int)header->levelCount;
+	return true;
+}
+
+CompressedFormat BakedTexture::format() const {
+	return compressedFormat;
+}
+
+int BakedTexture::levelCount() const {
+	return levels;
+}
+
+// One mip level, pointing into the mapped file
+BakedTexture::Level BakedTexture::level(int index) const {
+	const BakedLevelEntry& entry = ((const BakedLevelEntry*)(file.data() + sizeof(BakedTextureHeader)))[index];
+	return Level{ (int)entry.width, (int)entry.height, file.data() + entry.offset, (size_t)entry.size };
+}
+
+// Bytes of compressed data in every level
+size_t BakedTexture::bytes() const {
+	size_t total = 0;
+	for (int i = 0; i < levels; i++) {
+		total += level(i).size;
+	}
+	return total;
+}
+
+// Internal format to pass to glCompressedTexImage2D
+GLenum BakedTexture::glFormat() const {
+	switch (compressedFormat) {
+	case COMPRESSED_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case COMPRESSED_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	default: return GL_COMPRESSED_RGBA_BPTC_UNORM;
+	}
+}
+
+// True when the current context can sample the format
+bool BakedTexture::isSupported() const {
+	return compressedFormat == COMPRESSED_BC7 ? GLEXT_ARB_texture_compression_bptc : GLEXT_EXT_texture_compression_s3tc;
+}
@@ -0,0 +1,76 @@
+#ifndef BAKED_TEXTURE_H
+#define BAKED_TEXTURE_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "mapped_file.h"
+#include "texture_compression.h"
+#include "thread_pool.h"
+
+// Textures baked ahead of time into a block compressed format with their whole mip chain. The file is laid out
+// like KTX2: a fixed header, an index with the offset and size of every level, then the levels themselves,
+// largest first and 16 byte aligned, ready to hand to glCompressedTexImage2D straight from the mapped file.
+// The header remembers the size and write time of the image it was baked from so stale files are ignored.
+
+// Where the baked version of a source image lives inside a directory, named after the source by cacheFilePath
+std::string bakedTexturePath(const std::string& directory, const std::string& sourcePath);
+
+// What baking one image took and produced
+struct BakeStats {
+	int width;
+	int height;
+	int levels;
+	CompressedFormat format;
+	size_t sourceBytes;
+	size_t bakedBytes;
+	double decodeMilliseconds;
+	double mipMilliseconds;
+	double compressMilliseconds;
+};
+
+// Decodes an image, builds its mip chain on the CPU with sRGB correct Kaiser filtering and writes it compressed to
+// bakedPath. format is a CompressedFormat, or -1 to pick BC1 for opaque images and BC3 for ones with any transparency.
+// With a pool, levels are filtered and blocks compressed in parallel. Returns false if the source can't be decoded
+// or the file can't be written
+bool bakeTexture(const std::string& sourcePath, const std::string& bakedPath, int format, ThreadPool* pool, BakeStats& stats);
+
+// A baked texture mapped into memory
+class BakedTexture {
+public:
+	// One mip level, data points into the mapped file
+	struct Level {
+		int width;
+		int height;
+		const unsigned char* data;
+		size_t size;
+	};
+
+	BakedTexture();
+
+	// Maps a baked file. Returns false if it's missing or malformed, or if sourcePath exists and has changed since baking
+	bool open(const std::string& path, const std::string& sourcePath);
+
+	CompressedFormat format() const;
+	int levelCount() const;
+	Level level(int index) const;
+
+	// Bytes of compressed data in every level
+	size_t bytes() const;
+
+	// Internal format to pass to glCompressedTexImage2D
+	GLenum glFormat() const;
+
+	// True when the current context can sample the format, call after loadGLExtensions
+	bool isSupported() const;
+
+private:
+	MappedFile file;
+	CompressedFormat compressedFormat;
+	int levels;
+};
+
+#endif
@@ -0,0 +1,294 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BVH_SSE
+#include <emmintrin.h>
+#endif
+
+// Half extent given to empty lanes, no plane test can pass it
+static const float EMPTY_EXTENT = -1.0e30f;
+
+// Deepest traversal stack needed, a median split tree over 2^32 objects is 16 levels of four way nodes
+static const int MAX_STACK_DEPTH = 16 * 3 + 1;
+
+// Plane coefficients broadcast for testing four boxes at once
+struct PlaneLanes {
+#ifdef BVH_SSE
+	__m128 x, y, z, w;
+	__m128 absX, absY, absZ;
+#else
+	float x, y, z, w;
+	float absX, absY, absZ;
+#endif
+};
+
+static void broadcastPlanes(const Frustum& frustum, PlaneLanes* lanes) {
+	for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+		const glm::vec4& plane = frustum.planes[p];
+#ifdef BVH_SSE
+		lanes[p].x = _mm_set1_ps(plane.x);
+		lanes[p].y = _mm_set1_ps(plane.y);
+		lanes[p].z = _mm_set1_ps(plane.z);
+		lanes[p].w = _mm_set1_ps(plane.w);
+		lanes[p].absX = _mm_set1_ps(std::fabs(plane.x));
+		lanes[p].absY = _mm_set1_ps(std::fabs(plane.y));
+		lanes[p].absZ = _mm_set1_ps(std::fabs(plane.z));
+#else
+		lanes[p] = PlaneLanes{ plane.x, plane.y, plane.z, plane.w, std::fabs(plane.x), std::fabs(plane.y), std::fabs(plane.z) };
+#endif
+	}
+}
+
+// Tests four boxes given as centers and half extents against every plane. Returns a bit per box that is
+// completely outside a plane, and sets a bit in crossing for each box that straddles at least one plane
+static inline int classifyBoxes(const PlaneLanes* planes, const float* centerX, const float* centerY, const float* centerZ,
+	const float* extentX, const float* extentY, const float* extentZ, int* crossing) {
+#ifdef BVH_SSE
+	__m128 cx = _mm_loadu_ps(centerX);
+	__m128 cy = _mm_loadu_ps(centerY);
+	__m128 cz = _mm_loadu_ps(centerZ);
+	__m128 ex = _mm_loadu_ps(extentX);
+	__m128 ey = _mm_loadu_ps(extentY);
+	__m128 ez = _mm_loadu_ps(extentZ);
+	const __m128 zero = _mm_setzero_ps();
+
+	__m128 outside = zero;
+	__m128 straddling = zero;
+	for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+		const PlaneLanes& plane = planes[p];
+		__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane.x, cx), _mm_mul_ps(plane.y, cy)), _mm_add_ps(_mm_mul_ps(plane.z, cz), plane.w));
+		__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane.absX, ex), _mm_mul_ps(plane.absY, ey)), _mm_mul_ps(plane.absZ, ez));
+		outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+		straddling = _mm_or_ps(straddling, _mm_cmplt_ps(_mm_sub_ps(distance, radius), zero));
+	}
+	*crossing = _mm_movemask_ps(straddling);
+	return _mm_movemask_ps(outside);
+#else
+	int outside = 0;
+	int straddling = 0;
+	for (int lane = 0; lane < 4; lane++) {
+		for (int p = 0; p < Frustum::PLANE_COUNT; p++) {
+			const PlaneLanes& plane = planes[p];
+			float distance = plane.x * centerX[lane] + plane.y * centerY[lane] + plane.z * centerZ[lane] + plane.w;
+			float radius = plane.absX * extentX[lane] + plane.absY * extentY[lane] + plane.absZ * extentZ[lane];
+			if (distance + radius < 0.0f) {
+				outside |= 1 << lane;
+			}
+			if (distance - radius < 0.0f) {
+				straddling |= 1 << lane;
+			}
+		}
+	}
+	*crossing = straddling;
+	return outside;
+#endif
+}
+
+// Builds the tree over count boxes
+void BVH::build(const AABB* boxes, size_t count) {
+	nodes.clear();
+	order.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		order[i] = (uint32_t)i;
+	}
+	if (count > 0) {
+		buildNode(boxes, 0, (uint32_t)count);
+	}
+	refit(boxes);
+}
+
+// Reorders order[first, first + count) around the median along the longest axis
+uint32_t BVH::splitRange(const AABB* boxes, uint32_t first, uint32_t count) {
+	// Bounds of the box centers, min + max is twice the center which sorts the same
+	glm::vec3 low(1.0e30f), high(-1.0e30f);
+	for (uint32_t i = first; i < first + count; i++) {
+		glm::vec3 center = boxes[order[i]].min + boxes[order[i]].max;
+		low = glm::min(low, center);
+		high = glm::max(high, center);
+	}
+	glm::vec3 size = high - low;
+	int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+
+	uint32_t middle = first + count / 2;
+	std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + first + count, [boxes, axis](uint32_t a, uint32_t b) {
+		return boxes[a].min[axis] + boxes[a].max[axis] < boxes[b].min[axis] + boxes[b].max[axis];
+	});
+	return middle;
+}
+
+// Builds the node over order[first, first + count) and returns its index
+int32_t BVH::buildNode(const AABB* boxes, uint32_t first, uint32_t count) {
+	int32_t index = (int32_t)nodes.size();
+	nodes.push_back(Node());
+
+	// Split in two, then split each half again, giving up to four children
+	uint32_t groupFirst[4], groupCount[4];
+	int groups = 0;
+	if (count <= LEAF_SIZE) {
+		groupFirst[0] = first;
+		groupCount[0] = count;
+		groups = 1;
+	}
+	else {
+		uint32_t middle = splitRange(boxes, first, count);
+		uint32_t halfFirst[2] = { first, middle };
+		uint32_t halfCount[2] = { middle - first, first + count - middle };
+		for (int half = 0; half < 2; half++) {
+			if (halfCount[half] <= LEAF_SIZE) {
+				groupFirst[groups] = halfFirst[half];
+				groupCount[groups++] = halfCount[half];
+			}
+			else {
+				uint32_t quarter = splitRange(boxes, halfFirst[half], halfCount[half]);
+				groupFirst[groups] = halfFirst[half];
+				groupCount[groups++] = quarter - halfFirst[half];
+				groupFirst[groups] = quarter;
+				groupCount[groups++] = halfFirst[half] + halfCount[half] - quarter;
+			}
+		}
+	}
+
+	// Children are built before writing to the node, building them can reallocate the node array
+	int32_t children[4] = { -1, -1, -1, -1 };
+	for (int group = 0; group < groups; group++) {
+		if (groupCount[group] > LEAF_SIZE) {
+			children[group] = buildNode(boxes, groupFirst[group], groupCount[group]);
+		}
+	}
+
+	Node& node = nodes[index];
+	for (int lane = 0; lane < 4; lane++) {
+		node.child[lane] = children[lane];
+		node.first[lane] = lane < groups ? groupFirst[lane] : 0;
+		node.count[lane] = lane < groups ? groupCount[lane] : 0;
+	}
+	return index;
+}
+
+// Recomputes every node's bounds from new boxes for the same objects
+void BVH::refit(const AABB* boxes) {
+	size_t count = order.size();
+	size_t padded = count + 3;
+	objectCenterX.resize(padded, 0.0f);
+	objectCenterY.resize(padded, 0.0f);
+	objectCenterZ.resize(padded, 0.0f);
+	objectExtentX.resize(padded, EMPTY_EXTENT);
+	objectExtentY.resize(padded, EMPTY_EXTENT);
+	objectExtentZ.resize(padded, EMPTY_EXTENT);
+	for (size_t i = 0; i < count; i++) {
+		const AABB& box = boxes[order[i]];
+		objectCenterX[i] = (box.min.x + box.max.x) * 0.5f;
+		objectCenterY[i] = (box.min.y + box.max.y) * 0.5f;
+		objectCenterZ[i] = (box.min.z + box.max.z) * 0.5f;
+		objectExtentX[i] = (box.max.x - box.min.x) * 0.5f;
+		objectExtentY[i] = (box.max.y - box.min.y) * 0.5f;
+		objectExtentZ[i] = (box.max.z - box.min.z) * 0.5f;
+	}
+
+	// Children come after their parents, so walking backwards finishes every child before its parent
+	for (size_t n = nodes.size(); n-- > 0;) {
+		Node& node = nodes[n];
+		for (int lane = 0; lane < 4; lane++) {
+			if (node.count[lane] == 0) {
+				node.centerX[lane] = node.centerY[lane] = node.centerZ[lane] = 0.0f;
+				node.extentX[lane] = node.extentY[lane] = node.extentZ[lane] = EMPTY_EXTENT;
+				continue;
+			}
+
+			float lowX = 1.0e30f, lowY = 1.0e30f, lowZ = 1.0e30f;
+			float highX = -1.0e30f, highY = -1.0e30f, highZ = -1.0e30f;
+			if (node.child[lane] < 0) {
+				for (uint32_t i = node.first[lane]; i < node.first[lane] + node.count[lane]; i++) {
+					lowX = std::min(lowX, objectCenterX[i] - objectExtentX[i]);
+					lowY = std::min(lowY, objectCenterY[i] - objectExtentY[i]);
+					lowZ = std::min(lowZ, objectCenterZ[i] - objectExtentZ[i]);
+					highX = std::max(highX, objectCenterX[i] + objectExtentX[i]);
+					highY = std::max(highY, objectCenterY[i] + objectExtentY[i]);
+					highZ = std::max(highZ, objectCenterZ[i] + objectExtentZ[i]);
+				}
+			}
+			else {
+				const Node& child = nodes[node.child[lane]];
+				for (int childLane = 0; childLane < 4; childLane++) {
+					if (child.count[childLane] == 0) {
+						continue;
+					}
+					lowX = std::min(lowX, child.centerX[childLane] - child.extentX[childLane]);
+					lowY = std::min(lowY, child.centerY[childLane] - child.extentY[childLane]);
+					lowZ = std::min(lowZ, child.centerZ[childLane] - child.extentZ[childLane]);
+					highX = std::max(highX, child.centerX[childLane] + child.extentX[childLane]);
+					highY = std::max(highY, child.centerY[childLane] + child.extentY[childLane]);
+					highZ = std::max(highZ, child.centerZ[childLane] + child.extentZ[childLane]);
+				}
+			}
+
+			node.centerX[lane] = (lowX + highX) * 0.5f;
+			node.centerY[lane] = (lowY + highY) * 0.5f;
+			node.centerZ[lane] = (lowZ + highZ) * 0.5f;
+			node.extentX[lane] = (highX - lowX) * 0.5f;
+			node.extentY[lane] = (highY - lowY) * 0.5f;
+			node.extentZ[lane] = (highZ - lowZ) * 0.5f;
+		}
+	}
+}
+
+// Replaces visible with the indices of every object whose box intersects the frustum
+void BVH::cull(const Frustum& frustum, std::vector<uint32_t>& visible) const {
+	visible.clear();
+	if (nodes.empty()) {
+		return;
+	}
+
+	PlaneLanes planes[Frustum::PLANE_COUNT];
+	broadcastPlanes(frustum, planes);
+
+	int32_t stack[MAX_STACK_DEPTH];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0) {
+		const Node& node = nodes[stack[--stackSize]];
+
+		int crossing;
+		int outside = classifyBoxes(planes, node.centerX, node.centerY, node.centerZ, node.extentX, node.extentY, node.extentZ, &crossing);
+
+		for (int lane = 0; lane < 4; lane++) {
+			uint32_t first = node.first[lane];
+			uint32_t count = node.count[lane];
+			if (count == 0 || (outside & (1 << lane))) {
+				continue;
+			}
+
+			// Completely inside, take everything below without looking any further
+			if (!(crossing & (1 << lane))) {
+				visible.insert(visible.end(), order.begin() + first, order.begin() + first + count);
+			}
+			else if (node.child[lane] >= 0) {
+				stack[stackSize++] = node.child[lane];
+			}
+			else {
+				// A leaf fits in one set of lanes, positions past its end belong to other objects and are masked off
+				int objectCrossing;
+				int objectOutside = classifyBoxes(planes, &objectCenterX[first], &objectCenterY[first], &objectCenterZ[first],
+					&objectExtentX[first], &objectExtentY[first], &objectExtentZ[first], &objectCrossing);
+				for (uint32_t i = 0; i < count; i++) {
+					if (!(objectOutside & (1 << i))) {
+						visible.push_back(order[first + i]);
+					}
+				}
+			}
+		}
+	}
+}
+
+// Number of objects
+size_t BVH::size() const {
+	return order.size();
+}
+
+// Number of nodes
+size_t BVH::nodeCount() const {
+	return nodes.size();
+}
@@ -0,0 +1,65 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frustum.h"
+
+// Bounding volume hierarchy over object boxes for frustum culling. Every node holds the boxes of up to four
+// children side by side, so one SSE pass tests all of them against a plane. A child whose box is completely
+// inside the frustum has its whole subtree accepted without testing anything below it.
+//
+// build sorts objects into the tree with median splits, refit updates the boxes of objects that moved
+// without changing the tree, which stays fast as long as objects don't wander far from where they were built.
+class BVH {
+public:
+	// Most objects in a leaf
+	static const uint32_t LEAF_SIZE = 4;
+
+	// Builds the tree over count boxes, object i is reported by cull as i
+	void build(const AABB* boxes, size_t count);
+
+	// Recomputes every node's bounds from new boxes for the same objects
+	void refit(const AABB* boxes);
+
+	// Replaces visible with the indices of every object whose box intersects the frustum, in tree order
+	void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+	// Number of objects
+	size_t size() const;
+
+	// Number of nodes
+	size_t nodeCount() const;
+
+private:
+	// Four children in structure of arrays form, empty lanes have a count of 0 and negative extents so they never pass a test
+	struct Node {
+		float centerX[4], centerY[4], centerZ[4];
+		float extentX[4], extentY[4], extentZ[4];
+		// Index of the child node, or -1 when the child is a leaf
+		int32_t child[4];
+		// Objects under the child, as a range of the tree ordered object arrays
+		uint32_t first[4];
+		uint32_t count[4];
+	};
+
+	// Nodes in build order, children always come after their parent, the root is node 0
+	std::vector<Node> nodes;
+
+	// Object index at each position of the tree order
+	std::vector<uint32_t> order;
+
+	// Object boxes in tree order as centers and half extents, padded by three so a leaf can always be loaded four at a time
+	std::vector<float> objectCenterX, objectCenterY, objectCenterZ;
+	std::vector<float> objectExtentX, objectExtentY, objectExtentZ;
+
+	// Builds the node over order[first, first + count) and returns its index
+	int32_t buildNode(const AABB* boxes, uint32_t first, uint32_t count);
+
+	// Reorders order[first, first + count) around the median along the longest axis and returns the split position
+	uint32_t splitRange(const AABB* boxes, uint32_t first, uint32_t count);
+};
+
+#endif
@@ -23,17 +23,38 @@ glm::mat4 Camera::GetViewMatrix() {
     return glm::lookAt(Position, Position + Front, Up);
 }
 
+// Returns the perspective projection for the current zoom
+glm::mat4 Camera::GetProjectionMatrix(float aspect, float nearPlane, float farPlane) {
+    return glm::perspective(glm::radians(Zoom), aspect, nearPlane, farPlane);
+}
+
+// Returns the planes of everything the camera sees with that projection
+Frustum Camera::GetFrustum(float aspect, float nearPlane, float farPlane) {
+    return Frustum::fromMatrix(GetProjectionMatrix(aspect, nearPlane, farPlane) * GetViewMatrix());
+}
+
+// Turns the camera to face target by deriving yaw and pitch from the direction to it
+void Camera::LookAt(glm::vec3 target) {
+    glm::vec3 direction = glm::normalize(target - Position);
+    Yaw = glm::degrees(atan2(direction.z, direction.x));
+    Pitch = glm::degrees(asin(direction.y));
+    updateCameraVectors();
+}
+
 // Process WASD (or similar) movements
 void Camera::ProcessKeyboard(Camera_Movement direction, float deltaTime) {
-    float velocity = MovementSpeed * deltaTime;
+    Position += GetMovementVelocity(direction) * deltaTime;
+}
+
+// Velocity of moving in a direction
+glm::vec3 Camera::GetMovementVelocity(Camera_Movement direction) const {
     if (direction == FORWARD)
-        Position += Front * velocity;
+        return Front * MovementSpeed;
     if (direction == BACKWARD)
-        Position -= Front * velocity;
+        return -Front * MovementSpeed;
     if (direction == LEFT)
-        Position -= Right * velocity;
-    if (direction == RIGHT)
-        Position += Right * velocity;
+        return -Right * MovementSpeed;
+    return Right * MovementSpeed;
 }
 
 // Processes mouse movements for controlling yaw + patch
@@ -5,6 +5,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "frustum.h"
+
 enum Camera_Movement {
 	FORWARD,
 	BACKWARD,
@@ -46,9 +48,21 @@ public:
     // Returns the view matrix calculated from the LookAt matrix along with our Euler angles.
     glm::mat4 GetViewMatrix();
 
+    // Returns the perspective projection for the current zoom
+    glm::mat4 GetProjectionMatrix(float aspect, float nearPlane = 0.1f, float farPlane = 100.0f);
+
+    // Returns the planes of everything the camera sees with that projection
+    Frustum GetFrustum(float aspect, float nearPlane = 0.1f, float farPlane = 100.0f);
+
+    // Turns the camera to face target, used for scripted camera paths
+    void LookAt(glm::vec3 target);
+
     // Process WASD (or similar) movements
     void ProcessKeyboard(Camera_Movement direction, float deltaTime);
 
+    // Velocity of moving in a direction, for integrating the position elsewhere
+    glm::vec3 GetMovementVelocity(Camera_Movement direction) const;
+
     // Processes mouse movements for controlling yaw + patch
     void ProcessMouseMovement(float xoffset, float yoffset, GLboolean constrainPitch = true);
 
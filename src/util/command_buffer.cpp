@@ -0,0 +1,42 @@
+#include "command_buffer.h"
+
+CommandBuffer::CommandBuffer() : currentBlock(0), commandCount(0), byteCount(0) {
+}
+
+// Drops every command, keeping the memory
+void CommandBuffer::reset() {
+	for (Block& block : blocks) {
+		block.used = 0;
+	}
+	currentBlock = 0;
+	commandCount = 0;
+	byteCount = 0;
+}
+
+// Number of commands recorded since reset
+size_t CommandBuffer::size() const {
+	return commandCount;
+}
+
+// Bytes those commands take up
+size_t CommandBuffer::bytes() const {
+	return byteCount;
+}
+
+// Returns size bytes at the end of the current block
+void* CommandBuffer::allocate(size_t size) {
+	// Blocks are only ever filled in order, so everything before currentBlock is full and everything after it empty
+	while (currentBlock < blocks.size() && blocks[currentBlock].used + size > BLOCK_SIZE) {
+		currentBlock++;
+	}
+	if (currentBlock == blocks.size()) {
+		blocks.push_back(Block{ std::unique_ptr<unsigned char[]>(new unsigned char[BLOCK_SIZE]), 0 });
+	}
+
+	Block& block = blocks[currentBlock];
+	void* memory = block.memory.get() + block.used;
+	block.used += size;
+	commandCount++;
+	byteCount += size;
+	return memory;
+}
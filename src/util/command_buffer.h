@@ -0,0 +1,121 @@
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Kinds of render command, each carries the struct of the same name below
+enum CommandType : uint16_t {
+	COMMAND_PROGRAM,
+	COMMAND_MATERIAL,
+	COMMAND_GEOMETRY,
+	COMMAND_MODEL,
+	COMMAND_DRAW
+};
+
+// Starts every command, size covers the header too so a reader can step over commands it doesn't handle
+struct CommandHeader {
+	uint16_t type;
+	uint16_t size;
+};
+
+// Commands name programs, materials and geometry by the handles they were registered under, never by API objects,
+// so recording them needs no GL context and the thread that owns one resolves the handles when replaying
+
+// Makes a program current
+struct ProgramCommand {
+	CommandHeader header;
+	int32_t program;
+};
+
+// Binds a material's textures and sets its color, its program is already current
+struct MaterialCommand {
+	CommandHeader header;
+	int32_t material;
+};
+
+// Makes a piece of geometry current
+struct GeometryCommand {
+	CommandHeader header;
+	int32_t geometry;
+};
+
+// Sets the current material's model matrix, column major
+struct ModelCommand {
+	CommandHeader header;
+	float model[16];
+};
+
+// Draws the current geometry, instanceCount 0 without instancing
+struct DrawCommand {
+	CommandHeader header;
+	int32_t instanceCount;
+};
+
+// Plain data render commands packed back to back into a linear arena. One thread records a buffer, which can
+// then be read from any thread. Blocks are kept across reset so a frame no bigger than the last allocates nothing
+class CommandBuffer {
+public:
+	static const size_t BLOCK_SIZE = 64 * 1024;
+
+	CommandBuffer();
+
+	CommandBuffer(const CommandBuffer&) = delete;
+	CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+	// Appends a command and returns it for the caller to fill in past the header
+	template <typename T>
+	T* push(CommandType type) {
+		static_assert(std::is_trivially_copyable<T>::value, "Commands must be plain data");
+		size_t size = (sizeof(T) + COMMAND_ALIGNMENT - 1) & ~(COMMAND_ALIGNMENT - 1);
+		T* command = (T*)allocate(size);
+		command->header.type = type;
+		command->header.size = (uint16_t)size;
+		return command;
+	}
+
+	// Drops every command, keeping the memory
+	void reset();
+
+	// Number of commands recorded since reset
+	size_t size() const;
+
+	// Bytes those commands take up
+	size_t bytes() const;
+
+	// Calls visit with the header of every command in recording order
+	template <typename Visitor>
+	void forEach(Visitor visit) const {
+		for (const Block& block : blocks) {
+			const unsigned char* position = block.memory.get();
+			const unsigned char* end = position + block.used;
+			while (position < end) {
+				const CommandHeader* header = (const CommandHeader*)position;
+				visit(*header);
+				position += header->size;
+			}
+		}
+	}
+
+private:
+	// Every command starts on this boundary so its fields can be read in place
+	static const size_t COMMAND_ALIGNMENT = 8;
+
+	struct Block {
+		std::unique_ptr<unsigned char[]> memory;
+		size_t used;
+	};
+
+	std::vector<Block> blocks;
+	size_t currentBlock;
+	size_t commandCount;
+	size_t byteCount;
+
+	// Returns size bytes at the end of the current block, moving on to the next one if it's full
+	void* allocate(size_t size);
+};
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef CONCURRENT_QUEUE_H
+#define CONCURRENT_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded lock free queue that any number of threads can push to and pop from.
+// Every slot carries a sequence number telling producers and consumers whose turn it is,
+// so a push or pop is a single compare and swap on the shared position plus a copy.
+template <typename T>
+class ConcurrentQueue {
+public:
+	// capacity is rounded up to a power of two
+	ConcurrentQueue(size_t capacity) : enqueuePosition(0), dequeuePosition(0) {
+		size_t size = 2;
+		while (size < capacity) {
+			size *= 2;
+		}
+		slots = std::vector<Slot>(size);
+		mask = size - 1;
+		for (size_t i = 0; i < size; i++) {
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	ConcurrentQueue(const ConcurrentQueue&) = delete;
+	ConcurrentQueue& operator=(const ConcurrentQueue&) = delete;
+
+	// Returns false without blocking when the queue is full
+	bool tryPush(const T& value) {
+		size_t position = enqueuePosition.load(std::memory_order_relaxed);
+		while (true) {
+			Slot& slot = slots[position & mask];
+			size_t sequence = slot.sequence.load(std::memory_order_acquire);
+			ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)position;
+			if (difference == 0) {
+				if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					slot.value = value;
+					slot.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference < 0) {
+				return false;
+			}
+			else {
+				position = enqueuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Returns false without blocking when the queue is empty
+	bool tryPop(T& value) {
+		size_t position = dequeuePosition.load(std::memory_order_relaxed);
+		while (true) {
+			Slot& slot = slots[position & mask];
+			size_t sequence = slot.sequence.load(std::memory_order_acquire);
+			ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)(position + 1);
+			if (difference == 0) {
+				if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					value = slot.value;
+					slot.sequence.store(position + mask + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (difference < 0) {
+				return false;
+			}
+			else {
+				position = dequeuePosition.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+private:
+	struct Slot {
+		std::atomic<size_t> sequence;
+		T value;
+
+		Slot() : sequence(0), value() {}
+		Slot(const Slot&) : sequence(0), value() {}
+	};
+
+	std::vector<Slot> slots;
+	size_t mask;
+
+	// Kept on separate cache lines so producers and consumers don't fight over the same line
+	alignas(64) std::atomic<size_t> enqueuePosition;
+	alignas(64) std::atomic<size_t> dequeuePosition;
+};
+
+#endif
\ No newline at end of file
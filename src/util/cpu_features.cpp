@@ -0,0 +1,29 @@
+#include "cpu_features.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+// Asks the CPU once, the answer never changes while running
+bool cpuSupportsAVX2() {
+#if defined(_MSC_VER)
+	static const bool supported = []() {
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7) {
+			return false;
+		}
+		// The OS has to save the upper halves of the registers too
+		__cpuid(info, 1);
+		bool avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+		__cpuidex(info, 7, 0);
+		return avx && (info[1] & (1 << 5)) != 0;
+	}();
+	return supported;
+#elif defined(__GNUC__) || defined(__clang__)
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
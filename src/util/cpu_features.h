@@ -0,0 +1,7 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// Whether the CPU and operating system can run AVX2 code, for picking kernels compiled per function at runtime
+bool cpuSupportsAVX2();
+
+#endif
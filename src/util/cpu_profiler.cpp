@@ -0,0 +1,206 @@
+#include "cpu_profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+std::atomic<bool> CpuProfiler::enabledFlag(false);
+
+// Each thread finds its own buffer without touching shared state
+static thread_local void* threadBuffer = nullptr;
+
+CpuProfiler::CpuProfiler() : frames(0), droppedEvents(0), capturing(false), maxTraceEvents(0), ticksPerNanosecond(0.0), startTicks(0) {
+}
+
+// The profiler shared by all threads
+CpuProfiler& CpuProfiler::current() {
+	static CpuProfiler profiler;
+	return profiler;
+}
+
+// Starts or stops recording
+void CpuProfiler::enable(bool enabled) {
+	// The TSC rate isn't reported anywhere portable, so it's measured against the steady clock once
+	if (enabled && ticksPerNanosecond == 0.0) {
+		std::chrono::steady_clock::time_point clockStart = std::chrono::steady_clock::now();
+		uint64_t tickStart = ticks();
+		std::chrono::steady_clock::time_point clockEnd;
+		do {
+			clockEnd = std::chrono::steady_clock::now();
+		} while (clockEnd - clockStart < std::chrono::milliseconds(10));
+		uint64_t tickEnd = ticks();
+		ticksPerNanosecond = (double)(tickEnd - tickStart) / std::chrono::duration_cast<std::chrono::nanoseconds>(clockEnd - clockStart).count();
+		startTicks = tickStart;
+	}
+	enabledFlag.store(enabled, std::memory_order_relaxed);
+}
+
+// Appends a finished zone to the calling thread's buffer
+void CpuProfiler::record(const char* name, uint64_t begin, uint64_t end) {
+	ThreadBuffer* buffer = (ThreadBuffer*)threadBuffer;
+	if (!buffer) {
+		buffer = current().registerThread();
+		threadBuffer = buffer;
+	}
+
+	// Until the collector has read the oldest events their slots can't be reused, the acquire load orders the
+	// write below after those reads
+	uint32_t head = buffer->head.load(std::memory_order_relaxed);
+	if (head - buffer->tail.load(std::memory_order_acquire) >= THREAD_CAPACITY) {
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	// Only this thread writes head, the release store makes the event visible to the collector
+	buffer->events[head & (THREAD_CAPACITY - 1)] = ZoneEvent{ name, begin, end };
+	buffer->head.store(head + 1, std::memory_order_release);
+}
+
+// Creates the calling thread's buffer
+CpuProfiler::ThreadBuffer* CpuProfiler::registerThread() {
+	ThreadBuffer* buffer = new ThreadBuffer();
+	buffer->head.store(0, std::memory_order_relaxed);
+	buffer->tail.store(0, std::memory_order_relaxed);
+	buffer->dropped.store(0, std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	buffer->index = (int)threads.size();
+	threads.push_back(buffer);
+	return buffer;
+}
+
+int CpuProfiler::zoneIndex(const char* name) {
+	// The same literal is almost always passed, so the pointer comparison usually settles it
+	for (size_t i = 0; i < zones.size(); i++) {
+		if (zones[i].name == name || strcmp(zones[i].name, name) == 0) {
+			return (int)i;
+		}
+	}
+	zones.push_back(ZoneHistory{ name, std::vector<float>(WINDOW, 0.0f), std::vector<uint32_t>(WINDOW, 0) });
+	frameTicks.push_back(0);
+	frameCalls.push_back(0);
+	return (int)zones.size() - 1;
+}
+
+double CpuProfiler::ticksToMilliseconds(uint64_t ticks) const {
+	return ticks / ticksPerNanosecond / 1.0e6;
+}
+
+// Collects the events every thread recorded since the last call as one frame
+void CpuProfiler::endFrame() {
+	if (ticksPerNanosecond == 0.0) {
+		return;
+	}
+	std::fill(frameTicks.begin(), frameTicks.end(), 0);
+	std::fill(frameCalls.begin(), frameCalls.end(), 0);
+
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	for (ThreadBuffer* buffer : threads) {
+		uint32_t head = buffer->head.load(std::memory_order_acquire);
+		uint32_t tail = buffer->tail.load(std::memory_order_relaxed);
+		for (uint32_t i = tail; i != head; i++) {
+			const ZoneEvent& event = buffer->events[i & (THREAD_CAPACITY - 1)];
+			int zone = zoneIndex(event.name);
+			frameTicks[zone] += event.end - event.begin;
+			frameCalls[zone]++;
+			if (capturing && traceEvents.size() < maxTraceEvents) {
+				traceEvents.push_back(TraceEvent{ event.name, buffer->index, event.begin, event.end });
+			}
+		}
+		// Hands the slots back to the thread once they've been read
+		buffer->tail.store(head, std::memory_order_release);
+		droppedEvents += buffer->dropped.exchange(0, std::memory_order_relaxed);
+	}
+
+	int sample = frames % WINDOW;
+	for (size_t zone = 0; zone < zones.size(); zone++) {
+		zones[zone].milliseconds[sample] = (float)ticksToMilliseconds(frameTicks[zone]);
+		zones[zone].calls[sample] = frameCalls[zone];
+	}
+	frames++;
+}
+
+// Keeps collected events for writeChromeTrace
+void CpuProfiler::captureTrace(bool enabled, size_t maxEvents) {
+	capturing = enabled;
+	maxTraceEvents = maxEvents;
+}
+
+// Writes the captured events as Chrome trace event JSON
+bool CpuProfiler::writeChromeTrace(const std::string& path) const {
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"CPU\"}}");
+	for (size_t thread = 0; thread < threads.size(); thread++) {
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"Thread %d\"}}", (int)thread, (int)thread);
+	}
+	for (const TraceEvent& event : traceEvents) {
+		double begin = (double)(int64_t)(event.begin - startTicks) / ticksPerNanosecond / 1000.0;
+		double duration = (double)(event.end - event.begin) / ticksPerNanosecond / 1000.0;
+		fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", event.name, event.thread, begin, duration);
+	}
+	fprintf(file, "\n]}\n");
+	return fclose(file) == 0;
+}
+
+// Prints each zone's calls and time per frame as percentiles over the last WINDOW frames
+void CpuProfiler::report(std::ostream& out) const {
+	int samples = std::min(frames, WINDOW);
+	if (samples == 0) {
+		return;
+	}
+
+	std::vector<float> sorted;
+	for (const ZoneHistory& zone : zones) {
+		sorted.assign(zone.milliseconds.begin(), zone.milliseconds.begin() + samples);
+		std::sort(sorted.begin(), sorted.end());
+		uint64_t calls = 0;
+		for (int i = 0; i < samples; i++) {
+			calls += zone.calls[i];
+		}
+		out << "  " << zone.name << ": " << (double)calls / samples << " calls, ms per frame p50 " << sorted[samples / 2]
+			<< "  p95 " << sorted[(samples * 95 - 1) / 100] << "  p99 " << sorted[(samples * 99 - 1) / 100] << "  max " << sorted.back() << std::endl;
+	}
+	if (droppedEvents > 0) {
+		out << "  " << droppedEvents << " events dropped by threads that filled their buffers between frames" << std::endl;
+	}
+}
+
+// Average cost of opening and closing one zone in nanoseconds
+double CpuProfiler::measureOverhead() {
+	// Half a buffer, so once it's emptied every zone is recorded rather than dropped
+	const int ZONES = THREAD_CAPACITY / 2;
+	bool wasEnabled = isEnabled();
+	enable(true);
+
+	ThreadBuffer* buffer = (ThreadBuffer*)threadBuffer;
+	if (!buffer) {
+		buffer = registerThread();
+		threadBuffer = buffer;
+	}
+	discardEvents(buffer);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < ZONES; i++) {
+		CpuZone zone("Profiler overhead");
+	}
+	double nanoseconds = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+	// The measurement isn't part of any frame
+	discardEvents(buffer);
+
+	enable(wasEnabled);
+	return nanoseconds / ZONES;
+}
+
+// Throws away the events a buffer holds, the lock keeps the collector out meanwhile
+void CpuProfiler::discardEvents(ThreadBuffer* buffer) {
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	buffer->tail.store(buffer->head.load(std::memory_order_relaxed), std::memory_order_release);
+	buffer->dropped.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,167 @@
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CPU_PROFILER_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CPU_PROFILER_TSC
+#else
+#include <chrono>
+#endif
+
+// Records named CPU zones on any thread with as little overhead as possible: a zone reads the time stamp
+// counter when it opens and closes and appends one event to a buffer owned by its thread, no locks, no
+// allocation. Once per frame the render thread collects every thread's events into per zone statistics
+// (percentiles of the time each zone took per frame) and, when capturing, into a Chrome trace.
+//
+// Zones are placed with PROFILE_ZONE("name"), which compiles to nothing when ENGINE_DISABLE_PROFILING is
+// defined. Names must be string literals, only the pointer is stored.
+class CpuProfiler {
+public:
+	// Events each thread can hold between two collections, a thread that records more drops the newest
+	static const uint32_t THREAD_CAPACITY = 1 << 16;
+
+	// Frames the percentiles are computed over
+	static const int WINDOW = 1024;
+
+	// The profiler shared by all threads
+	static CpuProfiler& current();
+
+	// Starts or stops recording, zones opened while disabled cost a single load and record nothing
+	void enable(bool enabled);
+	static bool isEnabled() {
+		return enabledFlag.load(std::memory_order_relaxed);
+	}
+
+	// Counter value, in TSC ticks where the CPU has one, nanoseconds otherwise
+	static uint64_t ticks() {
+#ifdef CPU_PROFILER_TSC
+		return __rdtsc();
+#else
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	// Appends a finished zone to the calling thread's buffer
+	static void record(const char* name, uint64_t begin, uint64_t end);
+
+	// Collects the events every thread recorded since the last call as one frame, call on one thread only
+	void endFrame();
+
+	// Keeps collected events for writeChromeTrace, up to maxEvents of them
+	void captureTrace(bool enabled, size_t maxEvents = 1 << 21);
+
+	// Writes the captured events as Chrome trace event JSON, one track per thread
+	bool writeChromeTrace(const std::string& path) const;
+
+	// Prints each zone's calls and time per frame as percentiles over the last WINDOW frames
+	void report(std::ostream& out) const;
+
+	// Average cost of opening and closing one zone in nanoseconds, measured on the calling thread
+	double measureOverhead();
+
+private:
+	struct ZoneEvent {
+		const char* name;
+		uint64_t begin;
+		uint64_t end;
+	};
+
+	// Single producer ring: the owning thread writes events and publishes them by advancing head,
+	// the collecting thread reads up to head and then frees the slots by advancing tail. A full ring
+	// drops new events, so a slot is never written while it's being read
+	struct ThreadBuffer {
+		ZoneEvent events[THREAD_CAPACITY];
+		std::atomic<uint32_t> head;
+		std::atomic<uint32_t> tail;
+		// Events dropped since the last collection
+		std::atomic<uint32_t> dropped;
+		int index;
+	};
+
+	// Per frame totals of one zone over the last WINDOW frames
+	struct ZoneHistory {
+		const char* name;
+		std::vector<float> milliseconds;
+		std::vector<uint32_t> calls;
+	};
+
+	struct TraceEvent {
+		const char* name;
+		int thread;
+		uint64_t begin;
+		uint64_t end;
+	};
+
+	static std::atomic<bool> enabledFlag;
+
+	CpuProfiler();
+	CpuProfiler(const CpuProfiler&) = delete;
+	CpuProfiler& operator=(const CpuProfiler&) = delete;
+
+	// Creates the calling thread's buffer, buffers are never freed so a thread can exit at any time
+	ThreadBuffer* registerThread();
+
+	// Throws away the events a buffer holds, on its own thread
+	void discardEvents(ThreadBuffer* buffer);
+
+	int zoneIndex(const char* name);
+	double ticksToMilliseconds(uint64_t ticks) const;
+
+	std::mutex threadsMutex;
+	std::vector<ThreadBuffer*> threads;
+
+	std::vector<ZoneHistory> zones;
+	std::vector<uint64_t> frameTicks;
+	std::vector<uint32_t> frameCalls;
+	int frames;
+	uint64_t droppedEvents;
+
+	bool capturing;
+	size_t maxTraceEvents;
+	std::vector<TraceEvent> traceEvents;
+
+	// Counter ticks per nanosecond and the counter value recording started at
+	double ticksPerNanosecond;
+	uint64_t startTicks;
+};
+
+// Records the enclosing block as a zone
+class CpuZone {
+public:
+	explicit CpuZone(const char* name) : name(name), begin(CpuProfiler::isEnabled() ? CpuProfiler::ticks() : 0) {
+	}
+	~CpuZone() {
+		if (begin != 0) {
+			CpuProfiler::record(name, begin, CpuProfiler::ticks());
+		}
+	}
+
+	CpuZone(const CpuZone&) = delete;
+	CpuZone& operator=(const CpuZone&) = delete;
+
+private:
+	const char* name;
+	uint64_t begin;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifndef ENGINE_DISABLE_PROFILING
+#define PROFILE_ZONE(name) CpuZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#endif
+
+#endif
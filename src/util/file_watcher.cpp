@@ -0,0 +1,93 @@
+#include "file_watcher.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// How often modification times are compared where there's no inotify
+static const int POLL_INTERVAL_MILLISECONDS = 250;
+
+FileWatcher::FileWatcher() : inotifyDescriptor(-1), lastPoll(std::chrono::steady_clock::now()) {
+#ifdef __linux__
+	inotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+	if (inotifyDescriptor >= 0) {
+		close(inotifyDescriptor);
+	}
+#endif
+}
+
+std::filesystem::file_time_type FileWatcher::modificationTime(const std::string& path) {
+	std::error_code error;
+	std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+	return error ? std::filesystem::file_time_type::min() : time;
+}
+
+// Starts watching a file
+void FileWatcher::watch(const std::string& path) {
+	std::filesystem::path filePath(path);
+	WatchedFile file = { path, filePath.filename().string(), -1, modificationTime(path) };
+
+#ifdef __linux__
+	if (inotifyDescriptor >= 0) {
+		// Watching the directory rather than the file survives the file being replaced.
+		// Adding a directory that's already watched returns the same descriptor
+		std::string directory = filePath.has_parent_path() ? filePath.parent_path().string() : std::string(".");
+		file.watchDescriptor = inotify_add_watch(inotifyDescriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	}
+#endif
+	files.push_back(file);
+}
+
+// Fills changed with the watched files written since the last call
+void FileWatcher::poll(std::vector<std::string>& changed) {
+	changed.clear();
+
+#ifdef __linux__
+	if (inotifyDescriptor >= 0) {
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length;
+		while ((length = read(inotifyDescriptor, buffer, sizeof(buffer))) > 0) {
+			for (char* position = buffer; position < buffer + length;) {
+				const inotify_event* event = (const inotify_event*)position;
+				position += sizeof(inotify_event) + event->len;
+				if (event->len == 0) {
+					continue;
+				}
+				for (const WatchedFile& file : files) {
+					if (file.watchDescriptor == event->wd && file.name == event->name
+						&& std::find(changed.begin(), changed.end(), file.path) == changed.end()) {
+						changed.push_back(file.path);
+					}
+				}
+			}
+		}
+		return;
+	}
+#endif
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - lastPoll < std::chrono::milliseconds(POLL_INTERVAL_MILLISECONDS)) {
+		return;
+	}
+	lastPoll = now;
+	for (WatchedFile& file : files) {
+		std::filesystem::file_time_type modified = modificationTime(file.path);
+		if (modified != file.modified) {
+			file.modified = modified;
+			changed.push_back(file.path);
+		}
+	}
+}
+
+// True when changes are delivered by the OS
+bool FileWatcher::isNative() const {
+	return inotifyDescriptor >= 0;
+}
@@ -0,0 +1,45 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Reports files that were written since the last poll. On Linux the containing directories are watched
+// with inotify, which also catches editors that save by writing a new file and renaming it over the old one.
+// Elsewhere the modification times are compared, at most every 250 ms so polling every frame stays cheap.
+class FileWatcher {
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	// Starts watching a file, it's reported back with the path exactly as given here
+	void watch(const std::string& path);
+
+	// Fills changed with the watched files written since the last call, each at most once, never blocks
+	void poll(std::vector<std::string>& changed);
+
+	// True when changes are delivered by the OS rather than found by comparing modification times
+	bool isNative() const;
+
+private:
+	struct WatchedFile {
+		std::string path;
+		// File name within its directory, as inotify reports it
+		std::string name;
+		int watchDescriptor;
+		std::filesystem::file_time_type modified;
+	};
+
+	std::vector<WatchedFile> files;
+	int inotifyDescriptor;
+	std::chrono::steady_clock::time_point lastPoll;
+
+	static std::filesystem::file_time_type modificationTime(const std::string& path);
+};
+
+#endif
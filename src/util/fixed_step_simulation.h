@@ -0,0 +1,158 @@
+#ifndef FIXED_STEP_SIMULATION_H
+#define FIXED_STEP_SIMULATION_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Advances a State in fixed steps, independent of how fast frames are rendered. Either runs on its own
+// thread (start), which accumulates elapsed wall time and runs one step per STEP of it, or is advanced
+// explicitly from the caller's thread (advanceTo) when runs have to be reproducible.
+//
+// After every step the state is published as a snapshot. The two newest snapshots are kept, so the render
+// thread can always interpolate between them without waiting for a step in progress: it draws the moment
+// one step in the past, which is bracketed by those two. A step that runs long delays new snapshots but
+// not frames, which keep interpolating and then holding the newest state.
+//
+// State is copied on every step and every sample, keep it small. The step function runs on the
+// simulation thread and may use other threads (a ThreadPool) for the work of a step.
+template <typename State>
+class FixedStepSimulation {
+public:
+	typedef std::function<void(State& state, double stepSeconds)> StepFunction;
+
+	// The thread runs at most this many steps to catch up after a stall, the rest of the backlog is dropped
+	static const int MAX_CATCH_UP_STEPS = 8;
+
+	FixedStepSimulation(double stepSeconds, const State& initial, StepFunction step) : step(step), stepLength(stepSeconds), state(initial), timeline(0.0), newest(0), stepCount(0), droppedCount(0), running(false), startTime(std::chrono::steady_clock::now()) {
+		snapshots[0] = Snapshot{ initial, 0.0 };
+		snapshots[1] = Snapshot{ initial, 0.0 };
+	}
+
+	~FixedStepSimulation() {
+		stop();
+	}
+
+	FixedStepSimulation(const FixedStepSimulation&) = delete;
+	FixedStepSimulation& operator=(const FixedStepSimulation&) = delete;
+
+	// Starts stepping on a thread of its own in real time, from now
+	void start() {
+		if (running.exchange(true)) {
+			return;
+		}
+		startTime = std::chrono::steady_clock::now();
+		thread = std::thread([this]() { run(); });
+	}
+
+	// Stops the thread, the last published snapshots stay readable
+	void stop() {
+		if (running.exchange(false)) {
+			thread.join();
+		}
+	}
+
+	// Runs steps on the calling thread until the simulation reaches seconds, must not be mixed with start
+	void advanceTo(double seconds) {
+		while (timeline + stepLength <= seconds + stepLength * 1e-6) {
+			runStep();
+		}
+	}
+
+	// Seconds since start, the clock the threaded simulation runs on
+	double now() const {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	// The state at renderSeconds interpolated between the two newest snapshots: previous + (current - previous) * the
+	// returned factor, 0 to 1. Sample one step in the past (now() - stepSeconds()) so the moment is between them
+	float sample(double renderSeconds, State& previous, State& current) const {
+		std::lock_guard<std::mutex> lock(snapshotMutex);
+		const Snapshot& older = snapshots[newest ^ 1];
+		const Snapshot& newer = snapshots[newest];
+		previous = older.state;
+		current = newer.state;
+		if (newer.time <= older.time) {
+			return 1.0f;
+		}
+		double factor = (renderSeconds - older.time) / (newer.time - older.time);
+		return (float)std::min(std::max(factor, 0.0), 1.0);
+	}
+
+	double stepSeconds() const {
+		return stepLength;
+	}
+
+	// Steps run so far, and steps skipped because the thread fell too far behind
+	uint64_t steps() const {
+		return stepCount.load(std::memory_order_relaxed);
+	}
+	uint64_t droppedSteps() const {
+		return droppedCount.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Snapshot {
+		State state;
+		// Point on the simulation's timeline the state belongs to
+		double time;
+	};
+
+	StepFunction step;
+	double stepLength;
+
+	// Only touched by whichever thread steps the simulation
+	State state;
+	double timeline;
+
+	// Two newest snapshots, newest indexes the latest one
+	mutable std::mutex snapshotMutex;
+	Snapshot snapshots[2];
+	int newest;
+
+	std::atomic<uint64_t> stepCount;
+	std::atomic<uint64_t> droppedCount;
+
+	std::atomic<bool> running;
+	std::thread thread;
+	std::chrono::steady_clock::time_point startTime;
+
+	// Runs one step and publishes its result
+	void runStep() {
+		step(state, stepLength);
+		timeline += stepLength;
+		stepCount.fetch_add(1, std::memory_order_relaxed);
+
+		// The older snapshot is overwritten, readers only hold the lock while copying both out
+		std::lock_guard<std::mutex> lock(snapshotMutex);
+		snapshots[newest ^ 1] = Snapshot{ state, timeline };
+		newest ^= 1;
+	}
+
+	// Accumulates wall time and spends it in fixed steps
+	void run() {
+		while (running.load()) {
+			double elapsed = now();
+			int caughtUp = 0;
+			while (timeline + stepLength <= elapsed && caughtUp < MAX_CATCH_UP_STEPS) {
+				runStep();
+				caughtUp++;
+			}
+
+			// Too far behind to ever catch up, skip ahead rather than stepping ever longer
+			if (timeline + stepLength <= elapsed) {
+				uint64_t skipped = (uint64_t)((elapsed - timeline) / stepLength);
+				timeline += skipped * stepLength;
+				droppedCount.fetch_add(skipped, std::memory_order_relaxed);
+			}
+
+			std::this_thread::sleep_until(startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeline + stepLength)));
+		}
+	}
+};
+
+#endif
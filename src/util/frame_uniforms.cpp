@@ -0,0 +1,47 @@
+#include "frame_uniforms.h"
+#include "gl_state_cache.h"
+
+#include <cstring>
+
+const char* const FrameUniformBuffer::BLOCK_NAME = "FrameData";
+
+FrameUniformBuffer::FrameUniformBuffer(StreamBuffer* stream) : ID(0), stream(stream) {
+	int alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	rangeAlignment = (size_t)alignment;
+
+	if (stream == nullptr) {
+		glGenBuffers(1, &ID);
+		GLStateCache::current().bindBuffer(GL_UNIFORM_BUFFER, ID);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_STREAM_DRAW);
+	}
+}
+
+FrameUniformBuffer::~FrameUniformBuffer() {
+	if (ID != 0) {
+		GLStateCache::current().forgetBuffer(ID);
+		glDeleteBuffers(1, &ID);
+	}
+}
+
+// Uploads this frame's values and binds them to BINDING
+void FrameUniformBuffer::update(const FrameUniforms& uniforms) {
+	GLStateCache& state = GLStateCache::current();
+
+	if (stream) {
+		StreamAllocation allocation = stream->allocate(sizeof(FrameUniforms), rangeAlignment);
+		if (allocation.pointer) {
+			memcpy(allocation.pointer, &uniforms, sizeof(FrameUniforms));
+			state.bindBufferRange(GL_UNIFORM_BUFFER, BINDING, stream->ID, allocation.offset, sizeof(FrameUniforms));
+		}
+		return;
+	}
+
+	state.bindBuffer(GL_UNIFORM_BUFFER, ID);
+
+	// Orphan the old storage so draws of the previous frame still reading it don't stall the upload
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &uniforms);
+
+	state.bindBufferBase(GL_UNIFORM_BUFFER, BINDING, ID);
+}
\ No newline at end of file
@@ -0,0 +1,58 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "stream_buffer.h"
+
+// Per frame data shared by every program, mirrors this std140 block declared in the shaders:
+//
+//	layout (std140) uniform FrameData {
+//		mat4 view;
+//		mat4 projection;
+//		mat4 viewProjection;
+//		vec4 cameraPos;
+//		vec4 lightPos;
+//		vec4 lightColor;
+//	};
+//
+// vec3 values are padded to vec4 so the C++ layout matches std140 without any packing rules.
+struct FrameUniforms {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::vec4 cameraPos;
+	glm::vec4 lightPos;
+	glm::vec4 lightColor;
+};
+
+static_assert(sizeof(FrameUniforms) == 240, "FrameUniforms must match the std140 FrameData block");
+
+// Uniform buffer holding FrameUniforms, written once per frame and bound at a fixed binding point
+// that every program's FrameData block is pointed at with Shader::bindUniformBlock. When given a stream
+// buffer each frame's copy is written into it and that range is bound, otherwise it orphans its own buffer.
+class FrameUniformBuffer {
+public:
+	static const unsigned int BINDING = 0;
+	static const char* const BLOCK_NAME;
+
+	// The buffer bound at BINDING, 0 when writing into a stream buffer
+	unsigned int ID;
+
+	FrameUniformBuffer(StreamBuffer* stream = nullptr);
+	~FrameUniformBuffer();
+
+	FrameUniformBuffer(const FrameUniformBuffer&) = delete;
+	FrameUniformBuffer& operator=(const FrameUniformBuffer&) = delete;
+
+	// Uploads this frame's values and binds them to BINDING, with a stream buffer this must come between its beginFrame and commit
+	void update(const FrameUniforms& uniforms);
+
+private:
+	StreamBuffer* stream;
+	// Offset alignment GL requires for uniform buffer ranges
+	size_t rangeAlignment;
+};
+
+#endif
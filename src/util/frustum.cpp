@@ -0,0 +1,42 @@
+#include "frustum.h"
+
+#include <cmath>
+
+// Extracts the planes from a projection * view matrix (Gribb & Hartmann), a point is inside when
+// -w <= x, y, z <= w in clip space, each comparison gives one plane as a sum of matrix rows
+Frustum Frustum::fromMatrix(const glm::mat4& m) {
+	// glm is column major, row i is m[0][i], m[1][i], m[2][i], m[3][i]
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	Frustum frustum;
+	frustum.planes[LEFT_PLANE] = row3 + row0;
+	frustum.planes[RIGHT_PLANE] = row3 - row0;
+	frustum.planes[BOTTOM_PLANE] = row3 + row1;
+	frustum.planes[TOP_PLANE] = row3 - row1;
+	frustum.planes[NEAR_PLANE] = row3 + row2;
+	frustum.planes[FAR_PLANE] = row3 - row2;
+
+	for (glm::vec4& plane : frustum.planes) {
+		float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		plane /= length;
+	}
+	return frustum;
+}
+
+// True unless the box is completely outside one of the planes
+bool Frustum::intersects(const AABB& box) const {
+	glm::vec3 center = (box.min + box.max) * 0.5f;
+	glm::vec3 extent = (box.max - box.min) * 0.5f;
+	for (const glm::vec4& plane : planes) {
+		// Distance of the center and how far the box reaches towards the plane's normal
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float radius = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y + std::fabs(plane.z) * extent.z;
+		if (distance + radius < 0.0f) {
+			return false;
+		}
+	}
+	return true;
+}
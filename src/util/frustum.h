@@ -0,0 +1,34 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// Axis aligned bounding box
+struct AABB {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+// The six planes bounding what a camera sees, normals point inwards and are normalized,
+// so dot(xyz, point) + w is the signed distance of a point from a plane
+struct Frustum {
+	enum Plane {
+		LEFT_PLANE,
+		RIGHT_PLANE,
+		BOTTOM_PLANE,
+		TOP_PLANE,
+		NEAR_PLANE,
+		FAR_PLANE,
+		PLANE_COUNT
+	};
+
+	glm::vec4 planes[PLANE_COUNT];
+
+	// Extracts the planes from a projection * view matrix with OpenGL's -1 to 1 clip depth
+	static Frustum fromMatrix(const glm::mat4& viewProjection);
+
+	// True unless the box is completely outside one of the planes, boxes near the corners can pass without being visible
+	bool intersects(const AABB& box) const;
+};
+
+#endif
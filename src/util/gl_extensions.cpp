@@ -0,0 +1,69 @@
+#include "gl_extensions.h"
+
+#include <cstring>
+
+bool GLEXT_ARB_get_program_binary = false;
+PFNGLGETPROGRAMBINARYPROC glext_glGetProgramBinary = NULL;
+PFNGLPROGRAMBINARYPROC glext_glProgramBinary = NULL;
+PFNGLPROGRAMPARAMETERIPROC glext_glProgramParameteri = NULL;
+
+bool GLEXT_ARB_buffer_storage = false;
+PFNGLBUFFERSTORAGEPROC glext_glBufferStorage = NULL;
+
+bool GLEXT_KHR_parallel_shader_compile = false;
+PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glext_glMaxShaderCompilerThreadsKHR = NULL;
+
+bool GLEXT_EXT_texture_compression_s3tc = false;
+bool GLEXT_ARB_texture_compression_bptc = false;
+
+// Returns true if the current context advertises the named extension
+bool hasGLExtension(const char* name) {
+	int extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (int i = 0; i < extensionCount; i++) {
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension && strcmp(extension, name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// True when the context version is at least major.minor
+static bool hasGLVersion(int major, int minor) {
+	return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+// Resolves the optional entry points through the same loader handed to glad
+void loadGLExtensions(GLADloadproc load) {
+	// Program binaries
+	if (hasGLVersion(4, 1) || hasGLExtension("GL_ARB_get_program_binary")) {
+		glext_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+		glext_glProgramBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+		glext_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+
+		// Drivers are allowed to support the entry points with zero binary formats, which makes caching pointless
+		int formatCount = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		GLEXT_ARB_get_program_binary = glext_glGetProgramBinary && glext_glProgramBinary && glext_glProgramParameteri && formatCount > 0;
+	}
+
+	// Immutable buffer storage, needed for persistent mapping
+	if (hasGLVersion(4, 4) || hasGLExtension("GL_ARB_buffer_storage")) {
+		glext_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+		GLEXT_ARB_buffer_storage = glext_glBufferStorage != NULL;
+	}
+
+	// Background shader compilation, the ARB version only differs in the entry point's suffix
+	if (hasGLExtension("GL_KHR_parallel_shader_compile")) {
+		glext_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+	}
+	else if (hasGLExtension("GL_ARB_parallel_shader_compile")) {
+		glext_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsARB");
+	}
+	GLEXT_KHR_parallel_shader_compile = glext_glMaxShaderCompilerThreadsKHR != NULL;
+
+	// Block compressed texture formats
+	GLEXT_EXT_texture_compression_s3tc = hasGLExtension("GL_EXT_texture_compression_s3tc");
+	GLEXT_ARB_texture_compression_bptc = hasGLVersion(4, 2) || hasGLExtension("GL_ARB_texture_compression_bptc");
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+// Optional entry points from versions newer than the 3.3 core profile glad was generated for.
+// Call loadGLExtensions after gladLoadGLLoader, then check the GLEXT_* flag before using a group.
+
+// ---------------------------------------- ARB_get_program_binary (core in 4.1) ----------------------------------------
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+extern bool GLEXT_ARB_get_program_binary;
+extern PFNGLGETPROGRAMBINARYPROC glext_glGetProgramBinary;
+extern PFNGLPROGRAMBINARYPROC glext_glProgramBinary;
+extern PFNGLPROGRAMPARAMETERIPROC glext_glProgramParameteri;
+#define glGetProgramBinary glext_glGetProgramBinary
+#define glProgramBinary glext_glProgramBinary
+#define glProgramParameteri glext_glProgramParameteri
+
+// ------------------------------------------ ARB_buffer_storage (core in 4.4) ------------------------------------------
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+extern bool GLEXT_ARB_buffer_storage;
+extern PFNGLBUFFERSTORAGEPROC glext_glBufferStorage;
+#define glBufferStorage glext_glBufferStorage
+
+// --------------------------------- KHR_parallel_shader_compile / ARB_parallel_shader_compile ---------------------------------
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+extern bool GLEXT_KHR_parallel_shader_compile;
+extern PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glext_glMaxShaderCompilerThreadsKHR;
+#define glMaxShaderCompilerThreadsKHR glext_glMaxShaderCompilerThreadsKHR
+
+// ------------------------------ EXT_texture_compression_s3tc / ARB_texture_compression_bptc ------------------------------
+// Formats only, neither adds entry points. BPTC is core in 4.2
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+extern bool GLEXT_EXT_texture_compression_s3tc;
+extern bool GLEXT_ARB_texture_compression_bptc;
+
+// Returns true if the current context advertises the named extension
+bool hasGLExtension(const char *name);
+
+// Resolves the entry points above through the same loader handed to glad
+void loadGLExtensions(GLADloadproc load);
+
+#endif
\ No newline at end of file
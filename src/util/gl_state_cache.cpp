@@ -0,0 +1,272 @@
+#include "gl_state_cache.h"
+
+#include <cstring>
+
+// Shadow value meaning "not known", forces the next call through
+static const unsigned int UNKNOWN = 0xFFFFFFFFu;
+
+// Buffer binding points that aren't part of VAO state, in shadow slot order
+static const GLenum BUFFER_TARGETS[] = {
+	GL_ARRAY_BUFFER,
+	GL_PIXEL_PACK_BUFFER,
+	GL_PIXEL_UNPACK_BUFFER,
+	GL_UNIFORM_BUFFER,
+	GL_COPY_READ_BUFFER,
+	GL_COPY_WRITE_BUFFER,
+	GL_TEXTURE_BUFFER
+};
+
+// Capabilities whose enabled state is shadowed, in shadow slot order
+static const GLenum CAPABILITIES[] = {
+	GL_DEPTH_TEST,
+	GL_CULL_FACE,
+	GL_BLEND,
+	GL_SCISSOR_TEST,
+	GL_STENCIL_TEST,
+	GL_MULTISAMPLE
+};
+
+// Shadow slot of a binding point, or -1 when it isn't shadowed
+static int bufferSlot(GLenum target) {
+	for (int i = 0; i < (int)(sizeof(BUFFER_TARGETS) / sizeof(BUFFER_TARGETS[0])); i++) {
+		if (BUFFER_TARGETS[i] == target) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Shadow slot of a capability, or -1 when it isn't shadowed
+static int capabilitySlot(GLenum capability) {
+	for (int i = 0; i < (int)(sizeof(CAPABILITIES) / sizeof(CAPABILITIES[0])); i++) {
+		if (CAPABILITIES[i] == capability) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+unsigned int GLStateCache::Counters::totalIssued() const {
+	unsigned int total = 0;
+	for (int i = 0; i < CATEGORY_COUNT; i++) {
+		total += issued[i];
+	}
+	return total;
+}
+
+unsigned int GLStateCache::Counters::totalFiltered() const {
+	unsigned int total = 0;
+	for (int i = 0; i < CATEGORY_COUNT; i++) {
+		total += filtered[i];
+	}
+	return total;
+}
+
+// The cache for the context current on the render thread
+GLStateCache& GLStateCache::current() {
+	static GLStateCache cache;
+	return cache;
+}
+
+GLStateCache::GLStateCache() {
+	invalidate();
+	memset(&frameCounters, 0, sizeof(frameCounters));
+	memset(&lastFrameCounters, 0, sizeof(lastFrameCounters));
+}
+
+// Forgets all shadowed state
+void GLStateCache::invalidate() {
+	program = UNKNOWN;
+	vertexArray = UNKNOWN;
+	for (unsigned int& buffer : buffers) {
+		buffer = UNKNOWN;
+	}
+	for (int i = 0; i < UNIFORM_BINDING_COUNT; i++) {
+		uniformBindings[i] = UNKNOWN;
+		uniformBindingOffsets[i] = 0;
+		uniformBindingSizes[i] = 0;
+	}
+	activeUnit = UNKNOWN;
+	for (unsigned int& texture : textures2D) {
+		texture = UNKNOWN;
+	}
+	polygonModeValue = GL_NONE;
+	for (int& capability : capabilities) {
+		capability = -1;
+	}
+	viewportValue[0] = viewportValue[1] = viewportValue[2] = viewportValue[3] = -1;
+}
+
+// Starts counting a new frame
+void GLStateCache::beginFrame() {
+	lastFrameCounters = frameCounters;
+	memset(&frameCounters, 0, sizeof(frameCounters));
+}
+
+const GLStateCache::Counters& GLStateCache::frame() const {
+	return frameCounters;
+}
+
+const GLStateCache::Counters& GLStateCache::lastFrame() const {
+	return lastFrameCounters;
+}
+
+// Counts a call and returns true if it has to reach the driver
+bool GLStateCache::record(Category category, bool changed) {
+	if (changed) {
+		frameCounters.issued[category]++;
+	}
+	else {
+		frameCounters.filtered[category]++;
+	}
+	return changed;
+}
+
+void GLStateCache::useProgram(unsigned int newProgram) {
+	if (record(PROGRAM, program != newProgram)) {
+		glUseProgram(newProgram);
+		program = newProgram;
+	}
+}
+
+void GLStateCache::bindVertexArray(unsigned int newVertexArray) {
+	if (record(VERTEX_ARRAY, vertexArray != newVertexArray)) {
+		glBindVertexArray(newVertexArray);
+		vertexArray = newVertexArray;
+	}
+}
+
+void GLStateCache::bindBuffer(GLenum target, unsigned int buffer) {
+	int slot = bufferSlot(target);
+	if (record(BUFFER, slot < 0 || buffers[slot] != buffer)) {
+		glBindBuffer(target, buffer);
+		if (slot >= 0) {
+			buffers[slot] = buffer;
+		}
+	}
+}
+
+// Binds a whole buffer to an indexed binding point
+void GLStateCache::bindBufferBase(GLenum target, unsigned int index, unsigned int buffer) {
+	bindBufferRange(target, index, buffer, 0, 0);
+}
+
+// Binds part of a buffer to an indexed binding point
+void GLStateCache::bindBufferRange(GLenum target, unsigned int index, unsigned int buffer, size_t offset, size_t size) {
+	bool shadowed = target == GL_UNIFORM_BUFFER && index < UNIFORM_BINDING_COUNT;
+	bool changed = !shadowed || uniformBindings[index] != buffer || uniformBindingOffsets[index] != offset || uniformBindingSizes[index] != size;
+	if (record(BUFFER, changed)) {
+		if (size == 0) {
+			glBindBufferBase(target, index, buffer);
+		}
+		else {
+			glBindBufferRange(target, index, buffer, (GLintptr)offset, (GLsizeiptr)size);
+		}
+		if (shadowed) {
+			uniformBindings[index] = buffer;
+			uniformBindingOffsets[index] = offset;
+			uniformBindingSizes[index] = size;
+		}
+		int slot = bufferSlot(target);
+		if (slot >= 0) {
+			buffers[slot] = buffer;
+		}
+	}
+}
+
+// Binds a texture to a given unit, switching the active unit only if needed
+void GLStateCache::bindTexture(unsigned int unit, GLenum target, unsigned int texture) {
+	if (target == GL_TEXTURE_2D && unit < TEXTURE_UNIT_COUNT && textures2D[unit] == texture) {
+		record(TEXTURE, false);
+		return;
+	}
+	if (activeUnit != unit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+	}
+	bindTexture(target, texture);
+}
+
+// Binds a texture to the active unit
+void GLStateCache::bindTexture(GLenum target, unsigned int texture) {
+	bool shadowed = target == GL_TEXTURE_2D && activeUnit < TEXTURE_UNIT_COUNT;
+	if (record(TEXTURE, !shadowed || textures2D[activeUnit] != texture)) {
+		glBindTexture(target, texture);
+		if (shadowed) {
+			textures2D[activeUnit] = texture;
+		}
+	}
+}
+
+void GLStateCache::polygonMode(GLenum mode) {
+	if (record(RASTER, polygonModeValue != mode)) {
+		glPolygonMode(GL_FRONT_AND_BACK, mode);
+		polygonModeValue = mode;
+	}
+}
+
+void GLStateCache::setEnabled(GLenum capability, bool enabled) {
+	int slot = capabilitySlot(capability);
+	if (record(RASTER, slot < 0 || capabilities[slot] != (int)enabled)) {
+		if (enabled) {
+			glEnable(capability);
+		}
+		else {
+			glDisable(capability);
+		}
+		if (slot >= 0) {
+			capabilities[slot] = (int)enabled;
+		}
+	}
+}
+
+void GLStateCache::viewport(int x, int y, int width, int height) {
+	bool changed = viewportValue[0] != x || viewportValue[1] != y || viewportValue[2] != width || viewportValue[3] != height;
+	if (record(RASTER, changed)) {
+		glViewport(x, y, width, height);
+		viewportValue[0] = x;
+		viewportValue[1] = y;
+		viewportValue[2] = width;
+		viewportValue[3] = height;
+	}
+}
+
+// Deleting a bound object resets its binding to 0
+void GLStateCache::forgetProgram(unsigned int deletedProgram) {
+	// A deleted program stays in use until another one is bound, so the binding is just unknown now
+	if (program == deletedProgram) {
+		program = UNKNOWN;
+	}
+}
+
+void GLStateCache::forgetVertexArray(unsigned int deletedVertexArray) {
+	if (vertexArray == deletedVertexArray) {
+		vertexArray = 0;
+	}
+}
+
+void GLStateCache::forgetBuffer(unsigned int deletedBuffer) {
+	for (unsigned int& buffer : buffers) {
+		if (buffer == deletedBuffer) {
+			buffer = 0;
+		}
+	}
+	for (unsigned int& buffer : uniformBindings) {
+		if (buffer == deletedBuffer) {
+			buffer = 0;
+		}
+	}
+}
+
+void GLStateCache::forgetTexture(unsigned int deletedTexture) {
+	for (unsigned int& texture : textures2D) {
+		if (texture == deletedTexture) {
+			texture = 0;
+		}
+	}
+}
+
+// Records whether a uniform upload was sent or dropped
+void GLStateCache::countUniform(bool filtered) {
+	record(UNIFORM, !filtered);
+}
\ No newline at end of file
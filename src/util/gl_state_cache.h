@@ -0,0 +1,107 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// Shadows the GL state the engine changes most often (bound program, VAO, buffers, textures per unit and a
+// few raster settings) and drops calls that would set what's already set. Everything that binds state on
+// the render thread goes through the single instance returned by current(), so the shadow stays accurate.
+// Code that changes state behind its back must call invalidate afterwards.
+class GLStateCache {
+public:
+	// Kinds of state calls that are counted separately
+	enum Category {
+		PROGRAM,
+		VERTEX_ARRAY,
+		BUFFER,
+		TEXTURE,
+		RASTER,
+		UNIFORM,
+		CATEGORY_COUNT
+	};
+
+	// Calls passed on to the driver and calls dropped because nothing would have changed
+	struct Counters {
+		unsigned int issued[CATEGORY_COUNT];
+		unsigned int filtered[CATEGORY_COUNT];
+
+		unsigned int totalIssued() const;
+		unsigned int totalFiltered() const;
+	};
+
+	// The cache for the context current on the render thread
+	static GLStateCache& current();
+
+	// Forgets all shadowed state, call after creating a context or after foreign code touched GL state
+	void invalidate();
+
+	// Starts counting a new frame, the counters of the frame that just ended move to lastFrame
+	void beginFrame();
+	const Counters& frame() const;
+	const Counters& lastFrame() const;
+
+	void useProgram(unsigned int program);
+	void bindVertexArray(unsigned int vertexArray);
+
+	// Only binding points outside VAO state are shadowed, GL_ELEMENT_ARRAY_BUFFER is always passed on
+	void bindBuffer(GLenum target, unsigned int buffer);
+
+	// Binds a whole buffer to an indexed binding point, which also changes the target's generic binding.
+	// Indexed GL_UNIFORM_BUFFER bindings are shadowed, other targets are passed on
+	void bindBufferBase(GLenum target, unsigned int index, unsigned int buffer);
+
+	// Binds part of a buffer to an indexed binding point, shadowed the same way as bindBufferBase
+	void bindBufferRange(GLenum target, unsigned int index, unsigned int buffer, size_t offset, size_t size);
+
+	// Binds a texture to a given unit, switching the active unit only if needed
+	void bindTexture(unsigned int unit, GLenum target, unsigned int texture);
+
+	// Binds a texture to the active unit
+	void bindTexture(GLenum target, unsigned int texture);
+
+	void polygonMode(GLenum mode);
+	void setEnabled(GLenum capability, bool enabled);
+	void viewport(int x, int y, int width, int height);
+
+	// Deleting a bound object resets its binding to 0, call these when deleting objects
+	void forgetProgram(unsigned int program);
+	void forgetVertexArray(unsigned int vertexArray);
+	void forgetBuffer(unsigned int buffer);
+	void forgetTexture(unsigned int texture);
+
+	// Records whether a uniform upload was sent or dropped, the values themselves are shadowed per program in Shader
+	void countUniform(bool filtered);
+
+private:
+	static const int BUFFER_TARGET_COUNT = 7;
+	static const int UNIFORM_BINDING_COUNT = 16;
+	static const int TEXTURE_UNIT_COUNT = 32;
+	static const int CAPABILITY_COUNT = 6;
+
+	unsigned int program;
+	unsigned int vertexArray;
+	unsigned int buffers[BUFFER_TARGET_COUNT];
+	unsigned int uniformBindings[UNIFORM_BINDING_COUNT];
+	// Range bound to each uniform binding point, a size of 0 means the whole buffer
+	size_t uniformBindingOffsets[UNIFORM_BINDING_COUNT];
+	size_t uniformBindingSizes[UNIFORM_BINDING_COUNT];
+	unsigned int activeUnit;
+	// Only GL_TEXTURE_2D bindings are shadowed, other targets are passed on
+	unsigned int textures2D[TEXTURE_UNIT_COUNT];
+	GLenum polygonModeValue;
+	// 0 = disabled, 1 = enabled, anything else = unknown
+	int capabilities[CAPABILITY_COUNT];
+	int viewportValue[4];
+
+	Counters frameCounters;
+	Counters lastFrameCounters;
+
+	GLStateCache();
+
+	// Counts a call and returns true if it has to reach the driver
+	bool record(Category category, bool changed);
+};
+
+#endif
\ No newline at end of file
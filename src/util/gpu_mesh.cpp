@@ -0,0 +1,34 @@
+#include "gpu_mesh.h"
+#include "gl_state_cache.h"
+
+// Creates the buffers and VAO and uploads the data in place
+GpuMesh::GpuMesh(const VertexLayout& layout, const void* vertices, size_t vertexBytes, const void* indices, size_t indexBytes, GLenum indexType) : VAO(0), VBO(0), EBO(0), indexType(indexType), indexCount((int)(indexBytes / vertexComponentBytes(indexType))), bytes(vertexBytes + indexBytes) {
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
+
+	GLStateCache::current().bindVertexArray(VAO);
+	GLStateCache::current().bindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertices, GL_STATIC_DRAW);
+	applyVertexLayout(layout);
+
+	// The element buffer binding is part of the VAO state
+	GLStateCache::current().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indices, GL_STATIC_DRAW);
+
+	GLStateCache::current().bindVertexArray(0);
+}
+
+GpuMesh::~GpuMesh() {
+	GLStateCache::current().forgetVertexArray(VAO);
+	GLStateCache::current().forgetBuffer(VBO);
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+}
+
+// Draws the mesh
+void GpuMesh::draw() const {
+	GLStateCache::current().bindVertexArray(VAO);
+	glDrawElements(GL_TRIANGLES, indexCount, indexType, (void*)0);
+}
@@ -0,0 +1,32 @@
+#ifndef GPU_MESH_H
+#define GPU_MESH_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+#include "vertex_layout.h"
+
+// Vertex and index buffers with a VAO set up from a layout. The data goes to the driver straight from wherever the
+// caller has it, such as a mapped file, so nothing is copied on the CPU side on the way
+class GpuMesh {
+public:
+	unsigned int VAO;
+	unsigned int VBO;
+	unsigned int EBO;
+	GLenum indexType;
+	int indexCount;
+	// Size of both buffers together
+	size_t bytes;
+
+	GpuMesh(const VertexLayout& layout, const void* vertices, size_t vertexBytes, const void* indices, size_t indexBytes, GLenum indexType);
+	~GpuMesh();
+
+	GpuMesh(const GpuMesh&) = delete;
+	GpuMesh& operator=(const GpuMesh&) = delete;
+
+	// Draws the mesh
+	void draw() const;
+};
+
+#endif
@@ -0,0 +1,181 @@
+#include "gpu_profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+GpuProfiler::GpuProfiler() : currentFrame(0), depth(0), late(0), capturing(false), maxTraceEvents(0), gpuClockOffset(0) {
+	epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	for (FrameSlot& frame : frames) {
+		frame.pending = false;
+		frame.lastQuery = -1;
+	}
+
+	// The GPU clock has its own origin, reading it synchronously once tells how to map it onto ours
+	GLint64 gpuTime = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+	gpuClockOffset = (int64_t)gpuTime - cpuNow();
+}
+
+GpuProfiler::~GpuProfiler() {
+	for (FrameSlot& frame : frames) {
+		if (!frame.queries.empty()) {
+			glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+		}
+	}
+}
+
+// Nanoseconds since the profiler was created
+int64_t GpuProfiler::cpuNow() const {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() - epoch;
+}
+
+// Starts a frame, collecting the results of the frame issued FRAME_LATENCY frames ago
+void GpuProfiler::beginFrame() {
+	currentFrame = (currentFrame + 1) % FRAME_LATENCY;
+	FrameSlot& frame = frames[currentFrame];
+	if (frame.pending) {
+		collect(frame);
+	}
+	frame.scopes.clear();
+	frame.lastQuery = -1;
+	depth = 0;
+}
+
+// Ends the frame started by beginFrame
+void GpuProfiler::endFrame() {
+	frames[currentFrame].pending = true;
+}
+
+// Opens a scope and returns its handle for endScope
+int GpuProfiler::beginScope(const char* name) {
+	FrameSlot& frame = frames[currentFrame];
+	int scope = (int)frame.scopes.size();
+
+	// Query objects are kept from frame to frame, only a frame with more scopes than ever before creates any
+	if (frame.queries.size() < (size_t)(scope + 1) * 2) {
+		size_t first = frame.queries.size();
+		frame.queries.resize((scope + 1) * 2);
+		glGenQueries((GLsizei)(frame.queries.size() - first), &frame.queries[first]);
+	}
+
+	glQueryCounter(frame.queries[scope * 2], GL_TIMESTAMP);
+	frame.lastQuery = scope * 2;
+	frame.scopes.push_back(PendingScope{ name, depth++, cpuNow(), 0 });
+	return scope;
+}
+
+void GpuProfiler::endScope(int scope) {
+	FrameSlot& frame = frames[currentFrame];
+	glQueryCounter(frame.queries[scope * 2 + 1], GL_TIMESTAMP);
+	frame.lastQuery = scope * 2 + 1;
+	frame.scopes[scope].cpuEnd = cpuNow();
+	depth--;
+}
+
+// Reads every frame still in flight, oldest first
+void GpuProfiler::collectAll() {
+	for (int i = 1; i <= FRAME_LATENCY; i++) {
+		FrameSlot& frame = frames[(currentFrame + i) % FRAME_LATENCY];
+		if (frame.pending) {
+			collect(frame);
+		}
+	}
+}
+
+// Reads a frame's queries into the statistics and the trace
+void GpuProfiler::collect(FrameSlot& frame) {
+	frame.pending = false;
+	if (frame.scopes.empty()) {
+		return;
+	}
+
+	// The query issued last finishes last, if it's ready all of them are. That's not the last scope's end when scopes
+	// nest: an outer scope opened first closes after every scope inside it
+	GLint available = 0;
+	glGetQueryObjectiv(frame.queries[frame.lastQuery], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) {
+		late++;
+	}
+
+	for (size_t i = 0; i < frame.scopes.size(); i++) {
+		const PendingScope& scope = frame.scopes[i];
+		GLuint64 gpuBegin = 0, gpuEnd = 0;
+		glGetQueryObjectui64v(frame.queries[i * 2], GL_QUERY_RESULT, &gpuBegin);
+		glGetQueryObjectui64v(frame.queries[i * 2 + 1], GL_QUERY_RESULT, &gpuEnd);
+
+		ScopeHistory& scopeHistory = history(scope.name);
+		int sample = scopeHistory.count % WINDOW;
+		scopeHistory.gpu[sample] = (float)((double)(gpuEnd - gpuBegin) / 1.0e6);
+		scopeHistory.cpu[sample] = (float)((double)(scope.cpuEnd - scope.cpuBegin) / 1.0e6);
+		scopeHistory.count++;
+
+		if (capturing && traceEvents.size() + 2 <= maxTraceEvents) {
+			traceEvents.push_back(TraceEvent{ scope.name, false, scope.cpuBegin, scope.cpuEnd - scope.cpuBegin });
+			traceEvents.push_back(TraceEvent{ scope.name, true, (int64_t)gpuBegin - gpuClockOffset, (int64_t)(gpuEnd - gpuBegin) });
+		}
+	}
+}
+
+GpuProfiler::ScopeHistory& GpuProfiler::history(const char* name) {
+	// Few scopes exist, and the same literal is almost always passed, so a linear search is plenty
+	for (ScopeHistory& scopeHistory : histories) {
+		if (scopeHistory.name == name || strcmp(scopeHistory.name, name) == 0) {
+			return scopeHistory;
+		}
+	}
+	histories.push_back(ScopeHistory());
+	histories.back().name = name;
+	histories.back().count = 0;
+	return histories.back();
+}
+
+// Records every collected scope for writeChromeTrace
+void GpuProfiler::captureTrace(bool enabled, size_t maxEvents) {
+	capturing = enabled;
+	maxTraceEvents = maxEvents;
+}
+
+// Writes the recorded scopes as Chrome trace event JSON
+bool GpuProfiler::writeChromeTrace(const std::string& path) const {
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+
+	// Complete ("X") events in microseconds, CPU scopes on one track and GPU scopes on another
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"GPU\"}}");
+	for (const TraceEvent& event : traceEvents) {
+		fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+			event.name, event.gpu ? "gpu" : "cpu", event.gpu ? 2 : 1, event.begin / 1000.0, event.duration / 1000.0);
+	}
+	fprintf(file, "\n]}\n");
+	return fclose(file) == 0;
+}
+
+// Prints the rolling CPU and GPU statistics of every scope
+void GpuProfiler::report(std::ostream& out) const {
+	for (const ScopeHistory& scopeHistory : histories) {
+		int samples = std::min(scopeHistory.count, WINDOW);
+		if (samples == 0) {
+			continue;
+		}
+		float gpuTotal = 0.0f, gpuMax = 0.0f, cpuTotal = 0.0f, cpuMax = 0.0f;
+		for (int i = 0; i < samples; i++) {
+			gpuTotal += scopeHistory.gpu[i];
+			gpuMax = std::max(gpuMax, scopeHistory.gpu[i]);
+			cpuTotal += scopeHistory.cpu[i];
+			cpuMax = std::max(cpuMax, scopeHistory.cpu[i]);
+		}
+		out << "  " << scopeHistory.name << ": GPU mean " << gpuTotal / samples << " ms max " << gpuMax
+			<< "  CPU mean " << cpuTotal / samples << " ms max " << cpuMax << "  (last " << samples << " frames)" << std::endl;
+	}
+}
+
+// Frames whose queries weren't ready yet when they were read
+int GpuProfiler::lateFrames() const {
+	return late;
+}
@@ -0,0 +1,133 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Measures named scopes on the GPU with timestamp queries and on the CPU with a steady clock.
+// Queries are read FRAME_LATENCY frames after they were issued, by then the GPU is almost always done
+// with them so reading never stalls the pipeline. Times are kept as rolling statistics per scope name
+// and can be recorded as a Chrome trace (chrome://tracing, ui.perfetto.dev) with CPU and GPU tracks.
+//
+// Scopes may nest. Timestamps are used rather than GL_TIME_ELAPSED, whose queries can't be nested.
+class GpuProfiler {
+public:
+	// Frames between issuing a frame's queries and reading them
+	static const int FRAME_LATENCY = 4;
+
+	// Frames the rolling statistics are computed over
+	static const int WINDOW = 120;
+
+	GpuProfiler();
+	~GpuProfiler();
+
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	// Starts a frame, collecting the results of the frame issued FRAME_LATENCY frames ago
+	void beginFrame();
+
+	// Ends the frame started by beginFrame
+	void endFrame();
+
+	// Opens a scope and returns its handle for endScope, name must outlive the profiler (a string literal)
+	int beginScope(const char* name);
+	void endScope(int scope);
+
+	// Reads every frame still in flight, blocking until the GPU is done with them
+	void collectAll();
+
+	// Records every collected scope for writeChromeTrace, up to maxEvents of them
+	void captureTrace(bool enabled, size_t maxEvents = 1 << 20);
+
+	// Writes the recorded scopes as Chrome trace event JSON, returns false if the file can't be written
+	bool writeChromeTrace(const std::string& path) const;
+
+	// Prints the rolling CPU and GPU statistics of every scope
+	void report(std::ostream& out) const;
+
+	// Frames whose queries weren't ready yet when they were read, each one stalled the CPU
+	int lateFrames() const;
+
+private:
+	// A scope of a frame in flight, times are nanoseconds since the profiler was created
+	struct PendingScope {
+		const char* name;
+		int depth;
+		int64_t cpuBegin;
+		int64_t cpuEnd;
+	};
+
+	// Queries and scopes of one frame in flight, two queries per scope
+	struct FrameSlot {
+		std::vector<unsigned int> queries;
+		std::vector<PendingScope> scopes;
+		// Index of the query issued last, with nested scopes that's the end of whichever scope closed last
+		int lastQuery;
+		bool pending;
+	};
+
+	// Last WINDOW samples of a scope, in milliseconds
+	struct ScopeHistory {
+		const char* name;
+		float gpu[WINDOW];
+		float cpu[WINDOW];
+		int count;
+	};
+
+	// A finished scope, as it goes into the trace
+	struct TraceEvent {
+		const char* name;
+		bool gpu;
+		int64_t begin;
+		int64_t duration;
+	};
+
+	FrameSlot frames[FRAME_LATENCY];
+	int currentFrame;
+	int depth;
+	int late;
+
+	std::vector<ScopeHistory> histories;
+
+	bool capturing;
+	size_t maxTraceEvents;
+	std::vector<TraceEvent> traceEvents;
+
+	// GPU timestamp minus CPU time, both in nanoseconds, sampled once so GPU scopes line up with CPU ones in the trace
+	int64_t gpuClockOffset;
+
+	// Nanoseconds since the profiler was created
+	int64_t cpuNow() const;
+	int64_t epoch;
+
+	// Reads a frame's queries into the statistics and the trace
+	void collect(FrameSlot& frame);
+
+	ScopeHistory& history(const char* name);
+};
+
+// Measures the enclosing block as a scope of profiler, does nothing when profiler is null
+class GpuProfileScope {
+public:
+	GpuProfileScope(GpuProfiler* profiler, const char* name) : profiler(profiler), scope(profiler ? profiler->beginScope(name) : -1) {
+	}
+	~GpuProfileScope() {
+		if (profiler) {
+			profiler->endScope(scope);
+		}
+	}
+
+	GpuProfileScope(const GpuProfileScope&) = delete;
+	GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+	GpuProfiler* profiler;
+	int scope;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "headless_context.h"
+
+#include <iostream>
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+HeadlessContext::HeadlessContext() : display(nullptr), surface(nullptr), context(nullptr) {
+}
+
+HeadlessContext::~HeadlessContext() {
+	destroy();
+}
+
+#ifdef __linux__
+
+// Creates a context of at least the given version and makes it current
+bool HeadlessContext::create(int majorVersion, int minorVersion) {
+	// Prefer the surfaceless platform, which needs neither a display server nor a GPU device
+	EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay) {
+		eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	}
+	bool surfaceless = eglDisplay != EGL_NO_DISPLAY && eglInitialize(eglDisplay, NULL, NULL);
+	if (!surfaceless) {
+		eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, NULL, NULL)) {
+			std::cout << "ERROR::HEADLESS::NO_EGL_DISPLAY" << std::endl;
+			return false;
+		}
+	}
+	display = eglDisplay;
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		std::cout << "ERROR::HEADLESS::NO_DESKTOP_GL" << std::endl;
+		destroy();
+		return false;
+	}
+
+	const EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+		EGL_NONE
+	};
+	EGLConfig config = NULL;
+	EGLint configCount = 0;
+	eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configCount);
+
+	// Surfaceless displays may expose no configs at all, a context without one is fine there
+	if (configCount == 0 && !surfaceless) {
+		std::cout << "ERROR::HEADLESS::NO_EGL_CONFIG" << std::endl;
+		destroy();
+		return false;
+	}
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, majorVersion,
+		EGL_CONTEXT_MINOR_VERSION, minorVersion,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext eglContext = eglCreateContext(eglDisplay, configCount ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+	if (eglContext == EGL_NO_CONTEXT) {
+		std::cout << "ERROR::HEADLESS::CONTEXT_CREATION_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+		destroy();
+		return false;
+	}
+	context = eglContext;
+
+	// Without surfaceless support the context still needs some surface to be made current with
+	EGLSurface eglSurface = EGL_NO_SURFACE;
+	if (!surfaceless) {
+		const EGLint surfaceAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		eglSurface = eglCreatePbufferSurface(eglDisplay, config, surfaceAttributes);
+		surface = eglSurface;
+	}
+
+	if (!eglMakeCurrent(eglDisplay, eglSurface, eglSurface, eglContext)) {
+		std::cout << "ERROR::HEADLESS::MAKE_CURRENT_FAILED" << std::endl;
+		destroy();
+		return false;
+	}
+	return true;
+}
+
+// Destroys the context
+void HeadlessContext::destroy() {
+	if (display == nullptr) {
+		return;
+	}
+	eglMakeCurrent((EGLDisplay)display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (surface) {
+		eglDestroySurface((EGLDisplay)display, (EGLSurface)surface);
+	}
+	if (context) {
+		eglDestroyContext((EGLDisplay)display, (EGLContext)context);
+	}
+	eglTerminate((EGLDisplay)display);
+	display = surface = context = nullptr;
+}
+
+// Function loader for gladLoadGLLoader and loadGLExtensions
+GLADloadproc HeadlessContext::loader() const {
+	return (GLADloadproc)eglGetProcAddress;
+}
+
+#else
+
+// EGL isn't generally available off Linux, callers fall back to a hidden window
+bool HeadlessContext::create(int majorVersion, int minorVersion) {
+	return false;
+}
+
+void HeadlessContext::destroy() {
+}
+
+GLADloadproc HeadlessContext::loader() const {
+	return nullptr;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <glad/glad.h>
+
+// OpenGL core profile context without a window or display server, used to run the engine on
+// machines without a GPU or X session (Mesa's llvmpipe through EGL). Rendering has to go
+// into a framebuffer object since there is no default framebuffer to draw to.
+// Only implemented on Linux, create returns false elsewhere.
+class HeadlessContext {
+public:
+	HeadlessContext();
+	~HeadlessContext();
+
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+	// Creates a context of at least the given version and makes it current
+	bool create(int majorVersion, int minorVersion);
+
+	// Destroys the context, also done by the destructor
+	void destroy();
+
+	// Function loader for gladLoadGLLoader and loadGLExtensions
+	GLADloadproc loader() const;
+
+private:
+	// EGLDisplay, EGLSurface and EGLContext, kept opaque so EGL headers stay out of this header
+	void* display;
+	void* surface;
+	void* context;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "image_writer.h"
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// CRC-32 as used by PNG chunks
+static uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+	static uint32_t table[256];
+	static bool tableReady = false;
+	if (!tableReady) {
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++) {
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			table[n] = c;
+		}
+		tableReady = true;
+	}
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++) {
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+// Appends a 32 bit big endian value
+static void putBigEndian32(std::vector<unsigned char>& out, uint32_t value) {
+	out.push_back((unsigned char)(value >> 24));
+	out.push_back((unsigned char)(value >> 16));
+	out.push_back((unsigned char)(value >> 8));
+	out.push_back((unsigned char)value);
+}
+
+// Writes one length + type + data + CRC chunk
+static void writeChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data) {
+	std::vector<unsigned char> chunk;
+	putBigEndian32(chunk, (uint32_t)data.size());
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	putBigEndian32(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+	file.write((const char*)chunk.data(), chunk.size());
+}
+
+// Writes 8 bit RGB or RGBA pixels to an uncompressed PNG file
+bool writePNG(const std::string& path, int width, int height, int channels, const unsigned char* pixels, bool flipVertically) {
+	if (width <= 0 || height <= 0 || (channels != 3 && channels != 4)) {
+		return false;
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		return false;
+	}
+
+	const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	file.write((const char*)signature, sizeof(signature));
+
+	// Header: size, 8 bits per channel, truecolor with or without alpha, default compression, filter and interlace
+	std::vector<unsigned char> header;
+	putBigEndian32(header, (uint32_t)width);
+	putBigEndian32(header, (uint32_t)height);
+	header.push_back(8);
+	header.push_back(channels == 4 ? 6 : 2);
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	writeChunk(file, "IHDR", header);
+
+	// Every scanline starts with its filter type, 0 meaning the bytes are stored as is
+	size_t rowBytes = (size_t)width * channels;
+	std::vector<unsigned char> scanlines;
+	scanlines.reserve((rowBytes + 1) * height);
+	for (int y = 0; y < height; y++) {
+		const unsigned char* row = pixels + (size_t)(flipVertically ? height - 1 - y : y) * rowBytes;
+		scanlines.push_back(0);
+		scanlines.insert(scanlines.end(), row, row + rowBytes);
+	}
+
+	// zlib stream made of stored deflate blocks, each holding at most 65535 bytes
+	std::vector<unsigned char> compressed;
+	compressed.push_back(0x78);
+	compressed.push_back(0x01);
+	size_t offset = 0;
+	do {
+		size_t blockSize = scanlines.size() - offset < 65535 ? scanlines.size() - offset : 65535;
+		bool lastBlock = offset + blockSize == scanlines.size();
+		compressed.push_back(lastBlock ? 1 : 0);
+		compressed.push_back((unsigned char)(blockSize & 0xFF));
+		compressed.push_back((unsigned char)(blockSize >> 8));
+		compressed.push_back((unsigned char)(~blockSize & 0xFF));
+		compressed.push_back((unsigned char)((~blockSize >> 8) & 0xFF));
+		compressed.insert(compressed.end(), scanlines.begin() + offset, scanlines.begin() + offset + blockSize);
+		offset += blockSize;
+	} while (offset < scanlines.size());
+
+	// Adler-32 of the uncompressed data closes the zlib stream
+	uint32_t a = 1, b = 0;
+	for (unsigned char byte : scanlines) {
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	putBigEndian32(compressed, (b << 16) | a);
+	writeChunk(file, "IDAT", compressed);
+
+	writeChunk(file, "IEND", std::vector<unsigned char>());
+	return (bool)file;
+}
\ No newline at end of file
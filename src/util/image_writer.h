@@ -0,0 +1,11 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <string>
+
+// Writes 8 bit RGB (3 channels) or RGBA (4 channels) pixels to a PNG file. The image data is
+// stored without compression, which keeps the writer tiny at the cost of larger files.
+// flipVertically is for pixels read back with glReadPixels, whose first row is the bottom one.
+bool writePNG(const std::string& path, int width, int height, int channels, const unsigned char* pixels, bool flipVertically = false);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "instanced_mesh.h"
+#include "gl_state_cache.h"
+
+// Attaches an instance buffer to an existing non indexed VAO
+InstancedMesh::InstancedMesh(unsigned int VAO, int vertexCount, unsigned int modelLocation) : VAO(VAO), vertexCount(vertexCount), indexType(GL_NONE), instanceCount(0), modelLocation(modelLocation), externalSource(false), capacity(0) {
+	attachInstanceBuffer();
+}
+
+// Attaches an instance buffer to an uploaded indexed mesh
+InstancedMesh::InstancedMesh(const Mesh& mesh, unsigned int modelLocation) : VAO(mesh.VAO), vertexCount(mesh.indexCount()), indexType(mesh.indexType()), instanceCount(0), modelLocation(modelLocation), externalSource(false), capacity(0) {
+	attachInstanceBuffer();
+}
+
+// Sets up the per instance model matrix attributes on the VAO
+void InstancedMesh::attachInstanceBuffer() {
+	glGenBuffers(1, &instanceVBO);
+
+	pointModelAttributes(instanceVBO, 0);
+	GLStateCache::current().bindVertexArray(VAO);
+	for (unsigned int column = 0; column < 4; column++) {
+		glEnableVertexAttribArray(modelLocation + column);
+		glVertexAttribDivisor(modelLocation + column, 1);
+	}
+	GLStateCache::current().bindVertexArray(0);
+}
+
+// Points the model matrix attributes at offset of buffer
+void InstancedMesh::pointModelAttributes(unsigned int buffer, size_t offset) {
+	GLStateCache::current().bindVertexArray(VAO);
+	GLStateCache::current().bindBuffer(GL_ARRAY_BUFFER, buffer);
+
+	// A mat4 attribute is fed as four vec4 columns, each advancing once per instance
+	for (unsigned int column = 0; column < 4; column++) {
+		glVertexAttribPointer(modelLocation + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + column * sizeof(glm::vec4)));
+	}
+}
+
+// Reads count model matrices starting at offset of another buffer
+void InstancedMesh::setInstanceSource(unsigned int buffer, size_t offset, size_t count) {
+	pointModelAttributes(buffer, offset);
+	externalSource = true;
+	instanceCount = (int)count;
+}
+
+InstancedMesh::~InstancedMesh() {
+	GLStateCache::current().forgetBuffer(instanceVBO);
+	glDeleteBuffers(1, &instanceVBO);
+}
+
+// Uploads this frame's model matrices
+void InstancedMesh::update(const glm::mat4* models, size_t count) {
+	if (externalSource) {
+		pointModelAttributes(instanceVBO, 0);
+		externalSource = false;
+	}
+	GLStateCache::current().bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+
+	// Grow geometrically so a slowly rising instance count doesn't reallocate every frame
+	if (count > capacity) {
+		capacity = capacity * 2 > count ? capacity * 2 : count;
+	}
+
+	// Orphan the old storage so the driver doesn't wait on draws still reading last frame's matrices
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), models);
+
+	instanceCount = (int)count;
+}
+
+// Maps room for count model matrices in the instance buffer
+glm::mat4* InstancedMesh::map(size_t count) {
+	if (externalSource) {
+		pointModelAttributes(instanceVBO, 0);
+		externalSource = false;
+	}
+	GLStateCache::current().bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+
+	if (count > capacity) {
+		capacity = capacity * 2 > count ? capacity * 2 : count;
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+	}
+
+	instanceCount = (int)count;
+	if (count == 0) {
+		return nullptr;
+	}
+
+	// Invalidating the whole buffer lets the driver hand back fresh memory instead of syncing with the GPU
+	return (glm::mat4*)glMapBufferRange(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+}
+
+// Finishes writing the matrices returned by map
+void InstancedMesh::unmap() {
+	if (instanceCount == 0) {
+		return;
+	}
+	GLStateCache::current().bindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+
+	// The driver can lose mapped memory in rare cases, the contents are then undefined so skip the draw
+	if (glUnmapBuffer(GL_ARRAY_BUFFER) == GL_FALSE) {
+		instanceCount = 0;
+	}
+}
+
+// Draws all instances uploaded by the last update
+void InstancedMesh::draw() {
+	if (instanceCount == 0) {
+		return;
+	}
+	GLStateCache::current().bindVertexArray(VAO);
+	if (indexType != GL_NONE) {
+		glDrawElementsInstanced(GL_TRIANGLES, vertexCount, indexType, (void*)0, instanceCount);
+	}
+	else {
+		glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, instanceCount);
+	}
+}
\ No newline at end of file
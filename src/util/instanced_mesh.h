@@ -0,0 +1,67 @@
+#ifndef INSTANCED_MESH_H
+#define INSTANCED_MESH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+#include "mesh.h"
+
+// Draws every instance of a mesh with a single draw call, per instance model matrices
+// are streamed into an instance buffer and read as vertex attributes with a divisor of 1
+class InstancedMesh {
+public:
+	unsigned int VAO;
+	unsigned int instanceVBO;
+	// Vertices per instance, or indices per instance when indexType is set
+	int vertexCount;
+	GLenum indexType;
+	int instanceCount;
+
+	// Attaches an instance buffer to an existing non indexed VAO, the model matrix takes up
+	// the four attribute locations starting at modelLocation
+	InstancedMesh(unsigned int VAO, int vertexCount, unsigned int modelLocation = 2);
+
+	// Attaches an instance buffer to an uploaded indexed mesh
+	InstancedMesh(const Mesh& mesh, unsigned int modelLocation = 2);
+	~InstancedMesh();
+
+	InstancedMesh(const InstancedMesh&) = delete;
+	InstancedMesh& operator=(const InstancedMesh&) = delete;
+
+	// Uploads this frame's model matrices, growing the instance buffer when needed
+	void update(const glm::mat4* models, size_t count);
+
+	// Maps room for count model matrices so they can be written straight into the instance buffer,
+	// the previous contents are discarded. Must be followed by unmap before drawing
+	glm::mat4* map(size_t count);
+
+	// Finishes writing the matrices returned by map
+	void unmap();
+
+	// Reads count model matrices starting at offset of another buffer instead of the instance buffer,
+	// such as a StreamBuffer allocation. Lasts until the next update or map
+	void setInstanceSource(unsigned int buffer, size_t offset, size_t count);
+
+	// Draws all instances uploaded by the last update
+	void draw();
+
+private:
+	// Sets up the per instance model matrix attributes on the VAO
+	void attachInstanceBuffer();
+
+	// Points the model matrix attributes at offset of buffer
+	void pointModelAttributes(unsigned int buffer, size_t offset);
+
+	// First of the four attribute locations the model matrix takes up
+	unsigned int modelLocation;
+
+	// True while the attributes read from somewhere other than instanceVBO
+	bool externalSource;
+
+	// Number of matrices the instance buffer can currently hold
+	size_t capacity;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,313 @@
+#include "json.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+// Deepest nesting parsed, keeps a malformed document from overflowing the stack
+static const int MAX_DEPTH = 256;
+
+// What lookups that find nothing return
+static const JsonValue NULL_VALUE;
+static const std::string EMPTY_STRING;
+
+JsonValue::JsonValue() : type(JSON_NULL), boolean(false), number(0.0) {
+}
+
+// Member of an object by name
+const JsonValue& JsonValue::operator[](const char* name) const {
+	if (type == JSON_OBJECT) {
+		for (const std::pair<std::string, JsonValue>& member : members) {
+			if (member.first == name) {
+				return member.second;
+			}
+		}
+	}
+	return NULL_VALUE;
+}
+
+// Element of an array by index
+const JsonValue& JsonValue::operator[](size_t index) const {
+	if (type == JSON_ARRAY && index < elements.size()) {
+		return elements[index];
+	}
+	return NULL_VALUE;
+}
+
+size_t JsonValue::size() const {
+	return type == JSON_ARRAY ? elements.size() : (type == JSON_OBJECT ? members.size() : 0);
+}
+
+bool JsonValue::isNull() const {
+	return type == JSON_NULL;
+}
+
+double JsonValue::asNumber(double fallback) const {
+	return type == JSON_NUMBER ? number : fallback;
+}
+
+// Whole numbers only, anything with a fraction gets the fallback
+long long JsonValue::asInteger(long long fallback) const {
+	if (type != JSON_NUMBER || number != floor(number) || fabs(number) > 9.0e15) {
+		return fallback;
+	}
+	return (long long)number;
+}
+
+bool JsonValue::asBool(bool fallback) const {
+	return type == JSON_BOOL ? boolean : fallback;
+}
+
+const std::string& JsonValue::asString() const {
+	return type == JSON_STRING ? string : EMPTY_STRING;
+}
+
+// Recursive descent over the text, cursor moves past whatever was parsed
+struct JsonParser {
+	const char* cursor;
+	const char* end;
+
+	void skipWhitespace() {
+		while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r')) {
+			cursor++;
+		}
+	}
+
+	// True and moves past the literal if the text continues with it
+	bool match(const char* literal) {
+		size_t length = strlen(literal);
+		if ((size_t)(end - cursor) < length || memcmp(cursor, literal, length) != 0) {
+			return false;
+		}
+		cursor += length;
+		return true;
+	}
+
+	// Four hex digits of a \u escape
+	bool parseHex(unsigned int& codePoint) {
+		if (end - cursor < 4) {
+			return false;
+		}
+		codePoint = 0;
+		for (int i = 0; i < 4; i++) {
+			char digit = *cursor++;
+			codePoint <<= 4;
+			if (digit >= '0' && digit <= '9') {
+				codePoint |= digit - '0';
+			}
+			else if (digit >= 'a' && digit <= 'f') {
+				codePoint |= digit - 'a' + 10;
+			}
+			else if (digit >= 'A' && digit <= 'F') {
+				codePoint |= digit - 'A' + 10;
+			}
+			else {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Appends a code point as UTF-8
+	static void appendUtf8(std::string& out, unsigned int codePoint) {
+		if (codePoint < 0x80) {
+			out += (char)codePoint;
+		}
+		else if (codePoint < 0x800) {
+			out += (char)(0xC0 | (codePoint >> 6));
+			out += (char)(0x80 | (codePoint & 0x3F));
+		}
+		else if (codePoint < 0x10000) {
+			out += (char)(0xE0 | (codePoint >> 12));
+			out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+			out += (char)(0x80 | (codePoint & 0x3F));
+		}
+		else {
+			out += (char)(0xF0 | (codePoint >> 18));
+			out += (char)(0x80 | ((codePoint >> 12) & 0x3F));
+			out += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+			out += (char)(0x80 | (codePoint & 0x3F));
+		}
+	}
+
+	// A quoted string, the cursor is on the opening quote
+	bool parseString(std::string& out) {
+		cursor++;
+		// Runs without escapes are copied in one go, which matters for embedded base64 buffers
+		const char* run = cursor;
+		while (true) {
+			while (cursor < end && *cursor != '"' && *cursor != '\\') {
+				cursor++;
+			}
+			if (cursor == end) {
+				return false;
+			}
+			out.append(run, cursor);
+			if (*cursor == '"') {
+				cursor++;
+				return true;
+			}
+
+			cursor++;
+			if (cursor == end) {
+				return false;
+			}
+			char escaped = *cursor++;
+			switch (escaped) {
+			case '"': out += '"'; break;
+			case '\\': out += '\\'; break;
+			case '/': out += '/'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u': {
+				unsigned int codePoint;
+				if (!parseHex(codePoint)) {
+					return false;
+				}
+				// A surrogate pair makes one code point past the basic plane
+				if (codePoint >= 0xD800 && codePoint < 0xDC00 && match("\\u")) {
+					unsigned int low;
+					if (!parseHex(low) || low < 0xDC00 || low >= 0xE000) {
+						return false;
+					}
+					codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+				}
+				appendUtf8(out, codePoint);
+				break;
+			}
+			default:
+				return false;
+			}
+			run = cursor;
+		}
+	}
+
+	// A number, strtod does the conversion once the extent is known so it's exact
+	bool parseNumber(double& out) {
+		const char* start = cursor;
+		if (cursor < end && *cursor == '-') {
+			cursor++;
+		}
+		while (cursor < end && ((*cursor >= '0' && *cursor <= '9') || *cursor == '.' || *cursor == 'e' || *cursor == 'E' || *cursor == '+' || *cursor == '-')) {
+			cursor++;
+		}
+		if (cursor == start || cursor - start > 64) {
+			return false;
+		}
+		char buffer[65];
+		memcpy(buffer, start, cursor - start);
+		buffer[cursor - start] = '\0';
+		char* parsedEnd;
+		out = strtod(buffer, &parsedEnd);
+		return parsedEnd == buffer + (cursor - start);
+	}
+
+	bool parseValue(JsonValue& value, int depth) {
+		if (depth > MAX_DEPTH) {
+			return false;
+		}
+		skipWhitespace();
+		if (cursor == end) {
+			return false;
+		}
+
+		switch (*cursor) {
+		case '{': {
+			value.type = JsonValue::JSON_OBJECT;
+			cursor++;
+			skipWhitespace();
+			if (cursor < end && *cursor == '}') {
+				cursor++;
+				return true;
+			}
+			while (true) {
+				skipWhitespace();
+				if (cursor == end || *cursor != '"') {
+					return false;
+				}
+				value.members.emplace_back();
+				if (!parseString(value.members.back().first)) {
+					return false;
+				}
+				skipWhitespace();
+				if (cursor == end || *cursor != ':') {
+					return false;
+				}
+				cursor++;
+				if (!parseValue(value.members.back().second, depth + 1)) {
+					return false;
+				}
+				skipWhitespace();
+				if (cursor < end && *cursor == ',') {
+					cursor++;
+				}
+				else if (cursor < end && *cursor == '}') {
+					cursor++;
+					return true;
+				}
+				else {
+					return false;
+				}
+			}
+		}
+		case '[': {
+			value.type = JsonValue::JSON_ARRAY;
+			cursor++;
+			skipWhitespace();
+			if (cursor < end && *cursor == ']') {
+				cursor++;
+				return true;
+			}
+			while (true) {
+				value.elements.emplace_back();
+				if (!parseValue(value.elements.back(), depth + 1)) {
+					return false;
+				}
+				skipWhitespace();
+				if (cursor < end && *cursor == ',') {
+					cursor++;
+				}
+				else if (cursor < end && *cursor == ']') {
+					cursor++;
+					return true;
+				}
+				else {
+					return false;
+				}
+			}
+		}
+		case '"':
+			value.type = JsonValue::JSON_STRING;
+			return parseString(value.string);
+		case 't':
+			value.type = JsonValue::JSON_BOOL;
+			value.boolean = true;
+			return match("true");
+		case 'f':
+			value.type = JsonValue::JSON_BOOL;
+			value.boolean = false;
+			return match("false");
+		case 'n':
+			value.type = JsonValue::JSON_NULL;
+			return match("null");
+		default:
+			value.type = JsonValue::JSON_NUMBER;
+			return parseNumber(value.number);
+		}
+	}
+};
+
+// Parses a whole document, nothing but whitespace may follow the value
+bool parseJson(const char* text, size_t length, JsonValue& value) {
+	value = JsonValue();
+	JsonParser parser = { text, text + length };
+	if (!parser.parseValue(value, 0)) {
+		value = JsonValue();
+		return false;
+	}
+	parser.skipWhitespace();
+	return parser.cursor == parser.end;
+}
@@ -0,0 +1,54 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A value of a parsed JSON document. Small and read only, made for asset headers such as glTF's rather than for
+// large or untrusted documents
+class JsonValue {
+public:
+	enum Type {
+		JSON_NULL,
+		JSON_BOOL,
+		JSON_NUMBER,
+		JSON_STRING,
+		JSON_ARRAY,
+		JSON_OBJECT
+	};
+
+	Type type;
+	bool boolean;
+	double number;
+	// Unescaped contents of a string
+	std::string string;
+	std::vector<JsonValue> elements;
+	// Members of an object in the order they were written
+	std::vector<std::pair<std::string, JsonValue>> members;
+
+	JsonValue();
+
+	// Member of an object with the given name, a null value if there's none or this isn't an object
+	const JsonValue& operator[](const char* name) const;
+
+	// Element of an array, a null value if it's out of range or this isn't an array
+	const JsonValue& operator[](size_t index) const;
+
+	// Number of elements of an array or members of an object
+	size_t size() const;
+
+	bool isNull() const;
+
+	// The value if it has the type asked for, fallback otherwise
+	double asNumber(double fallback = 0.0) const;
+	long long asInteger(long long fallback = 0) const;
+	bool asBool(bool fallback = false) const;
+	const std::string& asString() const;
+};
+
+// Parses a whole document, returns false if it isn't valid JSON or nests deeper than a few hundred levels
+bool parseJson(const char* text, size_t length, JsonValue& value);
+
+#endif
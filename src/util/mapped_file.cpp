@@ -0,0 +1,156 @@
+#include "mapped_file.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : bytes(nullptr), length(0), mapped(false) {
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+// Opens a file, closing the one opened before
+bool MappedFile::open(const std::string& path) {
+	close();
+
+#ifdef __linux__
+	int descriptor = ::open(path.c_str(), O_RDONLY);
+	if (descriptor < 0) {
+		return false;
+	}
+	struct stat status;
+	if (fstat(descriptor, &status) != 0) {
+		::close(descriptor);
+		return false;
+	}
+
+	// An empty file can't be mapped, it's simply open with no data
+	length = (size_t)status.st_size;
+	if (length > 0) {
+		void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		if (view == MAP_FAILED) {
+			::close(descriptor);
+			length = 0;
+			return false;
+		}
+		bytes = (const unsigned char*)view;
+		mapped = true;
+	}
+
+	// The mapping keeps the file alive on its own
+	::close(descriptor);
+	return true;
+#else
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) {
+		return false;
+	}
+	buffer.resize((size_t)file.tellg());
+	file.seekg(0);
+	if (!file.read((char*)buffer.data(), buffer.size())) {
+		buffer.clear();
+		return false;
+	}
+	bytes = buffer.data();
+	length = buffer.size();
+	return true;
+#endif
+}
+
+// Releases the view
+void MappedFile::close() {
+#ifdef __linux__
+	if (mapped) {
+		munmap((void*)bytes, length);
+	}
+#endif
+	buffer.clear();
+	bytes = nullptr;
+	length = 0;
+	mapped = false;
+}
+
+const unsigned char* MappedFile::data() const {
+	return bytes;
+}
+
+size_t MappedFile::size() const {
+	return length;
+}
+
+// True when data points straight into the page cache rather than a copy
+bool MappedFile::isMapped() const {
+	return mapped;
+}
+
+// Size and last write time of a file, false if it doesn't exist
+bool sourceStamp(const std::string& path, uint64_t& size, int64_t& time) {
+	std::error_code error;
+	size = (uint64_t)std::filesystem::file_size(path, error);
+	if (error) {
+		return false;
+	}
+	std::filesystem::file_time_type written = std::filesystem::last_write_time(path, error);
+	if (error) {
+		return false;
+	}
+	time = (int64_t)written.time_since_epoch().count();
+	return true;
+}
+
+// Flattened source path, a hash of the original path and the extension
+std::string cacheFilePath(const std::string& directory, const std::string& sourcePath, const std::string& extension) {
+	// FNV-1a over the path as given
+	uint32_t hash = 2166136261u;
+	for (char character : sourcePath) {
+		hash ^= (unsigned char)character;
+		hash *= 16777619u;
+	}
+	char hashText[16];
+	snprintf(hashText, sizeof(hashText), ".%08x", hash);
+
+	std::string name = sourcePath;
+	for (char& character : name) {
+		if (character == '/' || character == '\\' || character == ':') {
+			character = '_';
+		}
+	}
+	return directory + "/" + name + hashText + extension;
+}
+
+// Writes to path.tmp and renames it over path
+bool writeFileAtomically(const std::string& path, const void* data, size_t size) {
+	std::error_code error;
+	std::filesystem::path parent = std::filesystem::path(path).parent_path();
+	if (!parent.empty()) {
+		std::filesystem::create_directories(parent, error);
+	}
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+		if (!output) {
+			return false;
+		}
+		output.write((const char*)data, size);
+		if (!output) {
+			output.close();
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+	}
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,53 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Read only view of a whole file. On Linux the file is memory mapped, so nothing is copied and pages are only
+// read from disk once they're touched. Elsewhere it's read into memory up front.
+class MappedFile {
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Opens a file, closing the one opened before. Returns false if it can't be read
+	bool open(const std::string& path);
+
+	// Releases the view, also done by the destructor
+	void close();
+
+	const unsigned char* data() const;
+	size_t size() const;
+
+	// True when data points straight into the page cache rather than a copy
+	bool isMapped() const;
+
+private:
+	const unsigned char* bytes;
+	size_t length;
+	bool mapped;
+	// Holds the contents where the file can't be mapped
+	std::vector<unsigned char> buffer;
+};
+
+// Helpers for files the engine builds from a source and maps on later launches, such as baked textures, converted
+// meshes and cached programs
+
+// Size and last write time of a file, false if it doesn't exist. Built files store the source's to notice it changing
+bool sourceStamp(const std::string& path, uint64_t& size, int64_t& time);
+
+// Where the file built from a source lives inside a directory: the source's path flattened into one file name, plus a
+// hash of the whole path since flattening alone gives a/b_c and a_b/c the same name
+std::string cacheFilePath(const std::string& directory, const std::string& sourcePath, const std::string& extension);
+
+// Writes a whole file to a temporary one and renames it over path, so a running engine never maps a half written file.
+// Creates the parent directories first. Returns false if anything fails, leaving no temporary file behind
+bool writeFileAtomically(const std::string& path, const void* data, size_t size);
+
+#endif
@@ -0,0 +1,342 @@
+#include "mesh.h"
+#include "gl_state_cache.h"
+
+#include <cmath>
+#include <cstring>
+
+// Marks an unused slot / a vertex or triangle that hasn't been assigned yet
+static const unsigned int INVALID_INDEX = 0xFFFFFFFFu;
+
+// Hashes a vertex's floats, treating -0 and 0 as the same value so they weld together
+static unsigned int hashVertex(const float* vertex, int floatCount) {
+	unsigned int hash = 2166136261u;
+	for (int i = 0; i < floatCount; i++) {
+		unsigned int bits = 0;
+		if (vertex[i] != 0.0f) {
+			memcpy(&bits, &vertex[i], sizeof(bits));
+		}
+		for (int byte = 0; byte < 4; byte++) {
+			hash ^= (bits >> (byte * 8)) & 0xFF;
+			hash *= 16777619u;
+		}
+	}
+	return hash;
+}
+
+// True if every float of two vertices compares equal
+static bool sameVertex(const float* a, const float* b, int floatCount) {
+	for (int i = 0; i < floatCount; i++) {
+		if (a[i] != b[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Welds a triangle soup into an indexed mesh
+Mesh::Mesh(const float* soup, size_t vertexCount, const std::vector<int>& attributeSizes, bool optimize) : VAO(0), VBO(0), EBO(0), attributeSizes(attributeSizes), floatsPerVertex(0), layout(), dequantization(1.0f) {
+	for (int size : attributeSizes) {
+		floatsPerVertex += size;
+	}
+
+	// Open addressed table of vertex indices keyed by the hash of the vertex data
+	size_t tableSize = 16;
+	while (tableSize < vertexCount * 2) {
+		tableSize *= 2;
+	}
+	std::vector<unsigned int> table(tableSize, INVALID_INDEX);
+	size_t mask = tableSize - 1;
+
+	indices.reserve(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++) {
+		const float* vertex = soup + i * floatsPerVertex;
+		size_t slot = hashVertex(vertex, floatsPerVertex) & mask;
+		while (table[slot] != INVALID_INDEX && !sameVertex(&vertices[(size_t)table[slot] * floatsPerVertex], vertex, floatsPerVertex)) {
+			slot = (slot + 1) & mask;
+		}
+		if (table[slot] == INVALID_INDEX) {
+			table[slot] = (unsigned int)(vertices.size() / floatsPerVertex);
+			vertices.insert(vertices.end(), vertex, vertex + floatsPerVertex);
+		}
+		indices.push_back(table[slot]);
+	}
+
+	stats.soupVertices = vertexCount;
+	stats.soupBytes = vertexCount * floatsPerVertex * sizeof(float);
+	stats.soupInvocations = vertexCount;
+	finishIndexing(optimize);
+}
+
+// Takes a mesh that's already indexed, it counts as the soup its indices would expand to
+Mesh::Mesh(std::vector<float> vertices, std::vector<unsigned int> indices, const std::vector<int>& attributeSizes, bool optimize) : VAO(0), VBO(0), EBO(0), vertices(std::move(vertices)), indices(std::move(indices)), attributeSizes(attributeSizes), floatsPerVertex(0), layout(), dequantization(1.0f) {
+	for (int size : attributeSizes) {
+		floatsPerVertex += size;
+	}
+	stats.soupVertices = this->indices.size();
+	stats.soupBytes = this->indices.size() * floatsPerVertex * sizeof(float);
+	stats.soupInvocations = this->indices.size();
+	finishIndexing(optimize);
+}
+
+// Optimizes the indexed mesh if asked and fills in the rest of stats
+void Mesh::finishIndexing(bool optimize) {
+	stats.weldedInvocations = simulateVertexShaderInvocations();
+
+	if (optimize) {
+		optimizeVertexCache();
+		optimizeVertexFetch();
+	}
+
+	stats.vertices = vertices.size() / floatsPerVertex;
+	stats.indices = indices.size();
+	stats.indexedBytes = vertices.size() * sizeof(float) + indices.size() * (indexType() == GL_UNSIGNED_SHORT ? 2 : 4);
+	stats.optimizedInvocations = simulateVertexShaderInvocations();
+	stats.floatStride = floatsPerVertex * sizeof(float);
+	stats.uploadedStride = stats.floatStride;
+	stats.packingError = VertexPackingError();
+}
+
+Mesh::~Mesh() {
+	if (VAO != 0) {
+		GLStateCache::current().forgetVertexArray(VAO);
+		GLStateCache::current().forgetBuffer(VBO);
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+	}
+}
+
+// Forsyth's vertex score: recently used vertices score high so triangles sharing them are emitted next,
+// and vertices with few triangles left get a boost so they're finished off instead of lingering
+static float forsythVertexScore(int cachePosition, unsigned int remainingTriangles, int cacheSize) {
+	if (remainingTriangles == 0) {
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		if (cachePosition < 3) {
+			// Used by the triangle just emitted, a fixed score keeps the order from favouring long thin strips
+			score = 0.75f;
+		}
+		else {
+			float scale = 1.0f / (cacheSize - 3);
+			score = powf(1.0f - (cachePosition - 3) * scale, 1.5f);
+		}
+	}
+	return score + 2.0f * powf((float)remainingTriangles, -0.5f);
+}
+
+// Reorders triangles to maximize post transform cache hits
+void Mesh::optimizeVertexCache(int cacheSize) {
+	size_t triangleCount = indices.size() / 3;
+	size_t vertexCount = vertices.size() / floatsPerVertex;
+	if (triangleCount == 0 || cacheSize <= 3) {
+		return;
+	}
+
+	// Triangles using each vertex, stored as one flat list with an offset per vertex.
+	// The first remainingTriangles[v] entries of a vertex's range are the ones not emitted yet
+	std::vector<unsigned int> remainingTriangles(vertexCount, 0);
+	for (unsigned int index : indices) {
+		remainingTriangles[index]++;
+	}
+	std::vector<size_t> triangleOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) {
+		triangleOffsets[v + 1] = triangleOffsets[v] + remainingTriangles[v];
+	}
+	std::vector<unsigned int> vertexTriangles(indices.size());
+	std::vector<size_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (int k = 0; k < 3; k++) {
+			unsigned int v = indices[t * 3 + k];
+			vertexTriangles[fill[v]++] = (unsigned int)t;
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) {
+		vertexScore[v] = forsythVertexScore(-1, remainingTriangles[v], cacheSize);
+	}
+
+	std::vector<bool> emitted(triangleCount, false);
+	unsigned int bestTriangle = 0;
+	float bestScore = -1.0f;
+	for (size_t t = 0; t < triangleCount; t++) {
+		float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+		if (score > bestScore) {
+			bestScore = score;
+			bestTriangle = (unsigned int)t;
+		}
+	}
+
+	std::vector<unsigned int> optimized;
+	optimized.reserve(indices.size());
+	std::vector<unsigned int> cache, nextCache;
+	cache.reserve(cacheSize + 3);
+	nextCache.reserve(cacheSize + 3);
+	size_t scanPosition = 0;
+
+	for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+		// Nothing in the cache has triangles left, take the next one in the original order
+		if (bestTriangle == INVALID_INDEX) {
+			while (emitted[scanPosition]) {
+				scanPosition++;
+			}
+			bestTriangle = (unsigned int)scanPosition;
+		}
+
+		const unsigned int* triangle = &indices[(size_t)bestTriangle * 3];
+		emitted[bestTriangle] = true;
+		for (int k = 0; k < 3; k++) {
+			unsigned int v = triangle[k];
+			optimized.push_back(v);
+
+			// Swap the triangle out of the vertex's remaining range
+			size_t begin = triangleOffsets[v];
+			size_t last = begin + remainingTriangles[v] - 1;
+			for (size_t i = begin; i <= last; i++) {
+				if (vertexTriangles[i] == bestTriangle) {
+					vertexTriangles[i] = vertexTriangles[last];
+					vertexTriangles[last] = bestTriangle;
+					break;
+				}
+			}
+			remainingTriangles[v]--;
+		}
+
+		// Simulated LRU cache, the emitted triangle's vertices move to the front
+		nextCache.assign(triangle, triangle + 3);
+		for (unsigned int v : cache) {
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+				nextCache.push_back(v);
+			}
+		}
+		for (size_t i = 0; i < nextCache.size(); i++) {
+			unsigned int v = nextCache[i];
+			cachePosition[v] = i < (size_t)cacheSize ? (int)i : -1;
+			vertexScore[v] = forsythVertexScore(cachePosition[v], remainingTriangles[v], cacheSize);
+		}
+
+		// Only triangles touching vertices whose score changed need rescoring, the best of them goes next
+		bestTriangle = INVALID_INDEX;
+		bestScore = -1.0f;
+		for (unsigned int v : nextCache) {
+			for (size_t i = triangleOffsets[v]; i < triangleOffsets[v] + remainingTriangles[v]; i++) {
+				unsigned int t = vertexTriangles[i];
+				float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+				if (score > bestScore) {
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+
+		if (nextCache.size() > (size_t)cacheSize) {
+			nextCache.resize(cacheSize);
+		}
+		cache.swap(nextCache);
+	}
+
+	indices.swap(optimized);
+}
+
+// Renumbers vertices in the order they're first referenced
+void Mesh::optimizeVertexFetch() {
+	size_t vertexCount = vertices.size() / floatsPerVertex;
+	std::vector<unsigned int> remap(vertexCount, INVALID_INDEX);
+	std::vector<float> reordered;
+	reordered.reserve(vertices.size());
+
+	unsigned int nextVertex = 0;
+	for (unsigned int& index : indices) {
+		if (remap[index] == INVALID_INDEX) {
+			remap[index] = nextVertex++;
+			const float* vertex = &vertices[(size_t)index * floatsPerVertex];
+			reordered.insert(reordered.end(), vertex, vertex + floatsPerVertex);
+		}
+		index = remap[index];
+	}
+
+	// Vertices no triangle uses are dropped along the way
+	vertices.swap(reordered);
+}
+
+// Counts vertex shader invocations with a FIFO post transform cache
+size_t Mesh::simulateVertexShaderInvocations(int cacheSize) const {
+	// A vertex is still cached if fewer than cacheSize other vertices were transformed since it was
+	std::vector<size_t> transformedAt(vertices.size() / floatsPerVertex, (size_t)-1);
+	size_t invocations = 0;
+	for (unsigned int index : indices) {
+		if (transformedAt[index] == (size_t)-1 || invocations - transformedAt[index] >= (size_t)cacheSize) {
+			transformedAt[index] = invocations;
+			invocations++;
+		}
+	}
+	return invocations;
+}
+
+// Index type to pass to glDrawElements
+GLenum Mesh::indexType() const {
+	return vertices.size() / floatsPerVertex <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+// Index count to pass to glDrawElements
+int Mesh::indexCount() const {
+	return (int)indices.size();
+}
+
+// Creates the VAO, vertex and index buffers
+void Mesh::upload() {
+	layout = VertexLayout();
+	for (size_t i = 0; i < attributeSizes.size(); i++) {
+		addVertexAttribute(layout, (uint32_t)i, (uint32_t)attributeSizes[i], GL_FLOAT, false);
+	}
+	dequantization = glm::mat4(1.0f);
+	uploadBuffers(vertices.data(), vertices.size() * sizeof(float));
+}
+
+// Packs the vertices and uploads them, recording the space saved and the precision lost
+void Mesh::upload(const std::vector<VertexSemantic>& semantics, const VertexFormat& format) {
+	size_t vertexCount = vertices.size() / floatsPerVertex;
+	PackedVertices packed;
+	packVertices(vertices.data(), vertexCount, attributeSizes, semantics, format, packed);
+	layout = packed.layout;
+	dequantization = packed.dequantization;
+	stats.uploadedStride = layout.stride;
+	stats.packingError = measurePackingError(vertices.data(), vertexCount, attributeSizes, semantics, packed);
+	uploadBuffers(packed.data.data(), packed.data.size());
+}
+
+// Uploads vertex data in layout and the indices
+void Mesh::uploadBuffers(const void* vertexData, size_t vertexBytes) {
+	if (VAO == 0) {
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+		glGenBuffers(1, &EBO);
+	}
+
+	GLStateCache::current().bindVertexArray(VAO);
+	GLStateCache::current().bindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertexData, GL_STATIC_DRAW);
+	applyVertexLayout(layout);
+
+	// The element buffer binding is part of the VAO state
+	GLStateCache::current().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	if (indexType() == GL_UNSIGNED_SHORT) {
+		std::vector<unsigned short> shortIndices(indices.begin(), indices.end());
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short), shortIndices.data(), GL_STATIC_DRAW);
+	}
+	else {
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+	}
+
+	GLStateCache::current().bindVertexArray(0);
+}
+
+// Draws the mesh
+void Mesh::draw() const {
+	GLStateCache::current().bindVertexArray(VAO);
+	glDrawElements(GL_TRIANGLES, indexCount(), indexType(), (void*)0);
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "vertex_layout.h"
+
+// Size and transform cost of a mesh before and after it was welded and optimized
+struct MeshStats {
+	size_t soupVertices;
+	size_t vertices;
+	size_t indices;
+
+	// Bytes of vertex data as a triangle soup, and of vertex plus index data once indexed
+	size_t soupBytes;
+	size_t indexedBytes;
+
+	// Vertex shader invocations with a simulated post transform cache, a soup runs the shader for every
+	// vertex it has, an indexed mesh only on cache misses
+	size_t soupInvocations;
+	size_t weldedInvocations;
+	size_t optimizedInvocations;
+
+	// Bytes of one vertex as floats and as uploaded, the same unless the mesh was packed. Every vertex shader
+	// invocation fetches a vertex, so the vertex bandwidth of a draw scales with the stride
+	size_t floatStride;
+	size_t uploadedStride;
+	// How far the uploaded vertices are from the float ones, zero unless packed
+	VertexPackingError packingError;
+};
+
+// Indexed triangle mesh with interleaved float vertices. Built from a triangle soup by welding identical
+// vertices together, then reordered so the GPU's post transform cache and vertex fetch are used well.
+class Mesh {
+public:
+	unsigned int VAO;
+	unsigned int VBO;
+	unsigned int EBO;
+
+	// Interleaved vertex data and triangle list
+	std::vector<float> vertices;
+	std::vector<unsigned int> indices;
+
+	// Number of floats in each attribute, attribute i is bound to location i
+	std::vector<int> attributeSizes;
+	int floatsPerVertex;
+
+	// Layout of the vertex buffer once uploaded, and the transform undoing its position quantization
+	VertexLayout layout;
+	glm::mat4 dequantization;
+
+	MeshStats stats;
+
+	// Welds a triangle soup of vertexCount vertices into an indexed mesh, optimizing it unless told not to
+	Mesh(const float* soup, size_t vertexCount, const std::vector<int>& attributeSizes, bool optimize = true);
+
+	// Takes a mesh that's already indexed, such as an imported one, optimizing it unless told not to
+	Mesh(std::vector<float> vertices, std::vector<unsigned int> indices, const std::vector<int>& attributeSizes, bool optimize = true);
+	~Mesh();
+
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
+
+	// Reorders triangles to maximize post transform cache hits (Tom Forsyth's linear speed algorithm)
+	void optimizeVertexCache(int cacheSize = 32);
+
+	// Renumbers vertices in the order they're first referenced so fetching them walks memory linearly
+	void optimizeVertexFetch();
+
+	// Counts vertex shader invocations for the current index order with a FIFO cache of cacheSize entries
+	size_t simulateVertexShaderInvocations(int cacheSize = 16) const;
+
+	// Creates the VAO, vertex and index buffers. Indices are stored as 16 bit when the vertex count allows it
+	void upload();
+
+	// Uploads the vertices packed into a compact format, semantics saying what each attribute holds. The model matrix
+	// has to be multiplied by dequantization when positions are quantized
+	void upload(const std::vector<VertexSemantic>& semantics, const VertexFormat& format);
+
+	// Index type and count to pass to glDrawElements once uploaded
+	GLenum indexType() const;
+	int indexCount() const;
+
+	// Draws the mesh
+	void draw() const;
+
+private:
+	// Optimizes the indexed mesh if asked and fills in the rest of stats
+	void finishIndexing(bool optimize);
+
+	// Uploads vertex data in layout and the indices
+	void uploadBuffers(const void* vertexData, size_t vertexBytes);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,248 @@
+#include "mesh_file.h"
+#include "mesh.h"
+#include "mesh_importer.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Layout of the start of every converted file
+struct MeshFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexType;
+	uint32_t reserved;
+	VertexLayout layout;
+	float boundsMin[3];
+	float boundsMax[3];
+	// Where the streams are in the file
+	uint64_t vertexOffset;
+	uint64_t vertexBytes;
+	uint64_t indexOffset;
+	uint64_t indexBytes;
+	// Size and write time of the source model, to notice when it's been changed since converting
+	uint64_t sourceSize;
+	int64_t sourceTime;
+};
+
+static const char MESH_FILE_MAGIC[4] = { 'B', 'M', 'S', 'H' };
+// Version 2 stores normals octahedral instead of as three bytes
+static const uint32_t MESH_FILE_VERSION = 2;
+static const size_t STREAM_ALIGNMENT = 16;
+
+// Texture coordinates of models often repeat outside [0, 1], so they're kept as half floats
+const VertexFormat MESH_FILE_VERTEX_FORMAT = { POSITION_UNORM16, NORMAL_OCTAHEDRAL16, TEXCOORD_HALF };
+
+// Largest of count indices of the given type
+template <typename Index>
+static uint32_t largestIndex(const Index* indices, size_t count) {
+	Index largest = 0;
+	for (size_t i = 0; i < count; i++) {
+		largest = std::max(largest, indices[i]);
+	}
+	return largest;
+}
+
+static uint32_t largestIndex(const unsigned char* indices, size_t count, uint32_t indexType) {
+	if (indexType == GL_UNSIGNED_SHORT) {
+		return largestIndex((const uint16_t*)indices, count);
+	}
+	return largestIndex((const uint32_t*)indices, count);
+}
+
+// Where the converted version of a model lives inside a directory
+std::string meshFilePath(const std::string& directory, const std::string& sourcePath) {
+	return cacheFilePath(directory, sourcePath, ".bmesh");
+}
+
+// Imports, optimizes, quantizes and writes a model
+bool convertMesh(const std::string& sourcePath, const std::string& path, ThreadPool* pool, MeshFileStats& stats) {
+	stats = MeshFileStats();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	ImportedMesh imported;
+	MeshImportStats importStats;
+	if (!importMesh(sourcePath, imported, pool, &importStats)) {
+		return false;
+	}
+	uint64_t sourceSize = 0;
+	int64_t sourceTime = 0;
+	sourceStamp(sourcePath, sourceSize, sourceTime);
+	std::chrono::steady_clock::time_point parsed = std::chrono::steady_clock::now();
+
+	// Already welded by the importer, Mesh only reorders it for the post transform cache and vertex fetch
+	Mesh mesh(std::move(imported.vertices), std::move(imported.indices), imported.attributeSizes());
+	std::chrono::steady_clock::time_point optimized = std::chrono::steady_clock::now();
+
+	// Positions are stored across the bounds of the vertices the mesh ended up with
+	PackedVertices packed;
+	size_t vertexCount = mesh.vertices.size() / mesh.floatsPerVertex;
+	packVertices(mesh.vertices.data(), vertexCount, mesh.attributeSizes, imported.semantics(), MESH_FILE_VERTEX_FORMAT, packed, pool);
+	const VertexLayout& layout = packed.layout;
+
+	size_t indexCount = mesh.indices.size();
+	GLenum indexType = mesh.indexType();
+	size_t indexSize = vertexComponentBytes(indexType);
+
+	MeshFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MESH_FILE_MAGIC, sizeof(header.magic));
+	header.version = MESH_FILE_VERSION;
+	header.vertexCount = (uint32_t)vertexCount;
+	header.indexCount = (uint32_t)indexCount;
+	header.indexType = indexType;
+	header.layout = layout;
+	for (int axis = 0; axis < 3; axis++) {
+		header.boundsMin[axis] = packed.boundsMin[axis];
+		header.boundsMax[axis] = packed.boundsMax[axis];
+	}
+	header.vertexOffset = (sizeof(header) + STREAM_ALIGNMENT - 1) & ~(STREAM_ALIGNMENT - 1);
+	header.vertexBytes = vertexCount * layout.stride;
+	header.indexOffset = (header.vertexOffset + header.vertexBytes + STREAM_ALIGNMENT - 1) & ~(STREAM_ALIGNMENT - 1);
+	header.indexBytes = indexCount * indexSize;
+	header.sourceSize = sourceSize;
+	header.sourceTime = sourceTime;
+
+	std::vector<unsigned char> file(header.indexOffset + header.indexBytes, 0);
+	memcpy(file.data(), &header, sizeof(header));
+
+	memcpy(file.data() + header.vertexOffset, packed.data.data(), packed.data.size());
+
+	unsigned char* indexStream = file.data() + header.indexOffset;
+	if (indexType == GL_UNSIGNED_SHORT) {
+		uint16_t* shortIndices = (uint16_t*)indexStream;
+		for (size_t i = 0; i < indexCount; i++) {
+			shortIndices[i] = (uint16_t)mesh.indices[i];
+		}
+	}
+	else {
+		memcpy(indexStream, mesh.indices.data(), header.indexBytes);
+	}
+
+	if (!writeFileAtomically(path, file.data(), file.size())) {
+		std::cout << "WARNING::MESH_FILE::CANNOT_WRITE " << path << std::endl;
+		return false;
+	}
+	std::chrono::steady_clock::time_point written = std::chrono::steady_clock::now();
+
+	stats.vertices = vertexCount;
+	stats.triangles = indexCount / 3;
+	// Counts a glTF's external buffers too, not just the file the stamp is taken from
+	stats.sourceBytes = importStats.bytes;
+	stats.fileBytes = file.size();
+	stats.floatBytes = mesh.vertices.size() * sizeof(float) + indexCount * sizeof(uint32_t);
+	stats.parseMilliseconds = std::chrono::duration<double, std::milli>(parsed - start).count();
+	stats.optimizeMilliseconds = std::chrono::duration<double, std::milli>(optimized - parsed).count();
+	stats.writeMilliseconds = std::chrono::duration<double, std::milli>(written - optimized).count();
+	return true;
+}
+
+MeshFile::MeshFile() : header(nullptr) {
+}
+
+// Maps a converted file and checks it against its source
+bool MeshFile::open(const std::string& path, const std::string& sourcePath) {
+	header = nullptr;
+	if (!file.open(path)) {
+		return false;
+	}
+
+	// Anything that doesn't look exactly like what convertMesh writes is treated as corrupt
+	const MeshFileHeader* candidate = (const MeshFileHeader*)file.data();
+	bool valid = file.size() >= sizeof(MeshFileHeader)
+		&& memcmp(candidate->magic, MESH_FILE_MAGIC, sizeof(candidate->magic)) == 0
+		&& candidate->version == MESH_FILE_VERSION
+		&& (candidate->indexType == GL_UNSIGNED_SHORT || candidate->indexType == GL_UNSIGNED_INT)
+		&& candidate->layout.attributeCount > 0 && candidate->layout.attributeCount <= (uint32_t)MAX_VERTEX_ATTRIBUTES
+		&& candidate->vertexOffset % STREAM_ALIGNMENT == 0 && candidate->indexOffset % STREAM_ALIGNMENT == 0
+		&& candidate->vertexBytes == (uint64_t)candidate->vertexCount * candidate->layout.stride
+		&& candidate->indexBytes == (uint64_t)candidate->indexCount * vertexComponentBytes(candidate->indexType)
+		// Written without adding the offsets, a huge one from a corrupt header would wrap around
+		&& candidate->vertexOffset <= file.size() && candidate->vertexBytes <= file.size() - candidate->vertexOffset
+		&& candidate->indexOffset <= file.size() && candidate->indexBytes <= file.size() - candidate->indexOffset;
+	for (uint32_t i = 0; valid && i < candidate->layout.attributeCount; i++) {
+		const VertexAttribute& attribute = candidate->layout.attributes[i];
+		valid = attribute.components >= 1 && attribute.components <= 4
+			&& attribute.offset + vertexAttributeBytes(attribute.components, attribute.type) <= candidate->layout.stride;
+	}
+
+	// One pass over the indices, the upload reads them all anyway. An index past the vertices would have the GPU fetch
+	// outside the vertex buffer
+	if (valid && candidate->indexCount > 0) {
+		valid = largestIndex(file.data() + candidate->indexOffset, candidate->indexCount, candidate->indexType) < candidate->vertexCount;
+	}
+
+	// A source that's missing is fine, the converted file may be all that was shipped
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	if (valid && sourceStamp(sourcePath, sourceSize, sourceTime)) {
+		valid = sourceSize == candidate->sourceSize && sourceTime == candidate->sourceTime;
+	}
+
+	if (!valid) {
+		file.close();
+		return false;
+	}
+	header = candidate;
+	return true;
+}
+
+const VertexLayout& MeshFile::layout() const {
+	return header->layout;
+}
+
+size_t MeshFile::vertexCount() const {
+	return header->vertexCount;
+}
+
+size_t MeshFile::indexCount() const {
+	return header->indexCount;
+}
+
+GLenum MeshFile::indexType() const {
+	return header->indexType;
+}
+
+const void* MeshFile::vertexData() const {
+	return file.data() + header->vertexOffset;
+}
+
+size_t MeshFile::vertexBytes() const {
+	return (size_t)header->vertexBytes;
+}
+
+const void* MeshFile::indexData() const {
+	return file.data() + header->indexOffset;
+}
+
+size_t MeshFile::indexBytes() const {
+	return (size_t)header->indexBytes;
+}
+
+// Bounds of the model as it was before quantization
+AABB MeshFile::bounds() const {
+	return AABB{ glm::vec3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]), glm::vec3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]) };
+}
+
+// Scales [0, 1] back up to the extent of the bounds and moves it to their corner, the same flat axis rule as convertMesh
+glm::mat4 MeshFile::dequantization() const {
+	AABB box = bounds();
+	glm::vec3 extent = box.max - box.min;
+	for (int axis = 0; axis < 3; axis++) {
+		if (extent[axis] <= 0.0f) {
+			extent[axis] = 1.0f;
+		}
+	}
+	return glm::scale(glm::translate(glm::mat4(1.0f), box.min), extent);
+}
+
+size_t MeshFile::size() const {
+	return file.size();
+}
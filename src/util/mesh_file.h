@@ -0,0 +1,83 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "frustum.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "vertex_layout.h"
+
+// Meshes converted ahead of time into a compact binary file: a fixed header holding the vertex layout and bounds,
+// then the vertex stream and the index stream, each 16 byte aligned and ready to hand to glBufferData straight from
+// the mapped file. Vertices are packed in MESH_FILE_VERTEX_FORMAT: positions quantized to 16 bits across the bounds,
+// normals octahedral in two 16 bit components and texture coordinates as half floats, so a vertex takes 16 bytes
+// instead of 32. Like baked textures, the header remembers the size and
+// write time of the model it came from so stale files are ignored.
+
+// How converted files pack vertices, normals need the OCTAHEDRAL_NORMALS shader permutation
+extern const VertexFormat MESH_FILE_VERTEX_FORMAT;
+
+// Where the converted version of a model lives inside a directory, named after the source by cacheFilePath
+std::string meshFilePath(const std::string& directory, const std::string& sourcePath);
+
+// What converting one model took and produced
+struct MeshFileStats {
+	size_t vertices;
+	size_t triangles;
+	size_t sourceBytes;
+	size_t fileBytes;
+	// Vertex and index bytes the same mesh takes with float attributes and 32 bit indices
+	size_t floatBytes;
+	double parseMilliseconds;
+	double optimizeMilliseconds;
+	double writeMilliseconds;
+};
+
+// Imports an OBJ or glTF model, in parallel with a pool, optimizes its vertex and index order, quantizes the vertices
+// and writes the result to path. Returns false if the model can't be read or the file can't be written
+bool convertMesh(const std::string& sourcePath, const std::string& path, ThreadPool* pool, MeshFileStats& stats);
+
+struct MeshFileHeader;
+
+// A converted mesh mapped into memory
+class MeshFile {
+public:
+	MeshFile();
+
+	// Maps a converted file. Returns false if it's missing or malformed, or if sourcePath exists and has changed since
+	// the conversion
+	bool open(const std::string& path, const std::string& sourcePath);
+
+	const VertexLayout& layout() const;
+	size_t vertexCount() const;
+	size_t indexCount() const;
+	GLenum indexType() const;
+
+	// The streams, pointing into the mapped file
+	const void* vertexData() const;
+	size_t vertexBytes() const;
+	const void* indexData() const;
+	size_t indexBytes() const;
+
+	// Bounds of the model as it was before quantization
+	AABB bounds() const;
+
+	// Takes quantized positions, which the GPU reads as [0, 1], back into the bounds. Goes in front of the model matrix
+	glm::mat4 dequantization() const;
+
+	// Size of the whole file
+	size_t size() const;
+
+private:
+	MappedFile file;
+	const MeshFileHeader* header;
+};
+
+#endif
@@ -0,0 +1,1305 @@
+#include "mesh_importer.h"
+#include "mapped_file.h"
+#include "cpu_profiler.h"
+#include "json.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+// Marks an empty slot of the vertex table
+static const uint32_t EMPTY_SLOT = 0xFFFFFFFFu;
+// Bytes of OBJ text each parsing task takes, cut at the next line start
+static const size_t OBJ_CHUNK_BYTES = 4 * 1024 * 1024;
+// OBJ vertices are welded in this many independent partitions, picked by the top bits of their hash
+static const int WELD_PARTITION_BITS = 6;
+static const size_t WELD_PARTITIONS = (size_t)1 << WELD_PARTITION_BITS;
+// Set on a corner's vertex index while welding when that corner is the first to use the vertex
+static const uint32_t FIRST_USE_BIT = 0x80000000u;
+// Corners or vertices per parallelFor range
+static const size_t ELEMENT_GRAIN_SIZE = 64 * 1024;
+// Indices per glTF decoding task, whole triangles so a mirrored node's winding can be flipped within one
+static const size_t GLTF_INDEX_GRAIN_SIZE = 3 * 32 * 1024;
+// Powers of ten for the float parser, exponents past these are rare enough to take pow
+static const double POWERS_OF_TEN[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+// Number of floats in each attribute
+std::vector<int> ImportedMesh::attributeSizes() const {
+	if (hasTexCoords) {
+		return { 3, 3, 2 };
+	}
+	return { 3, 3 };
+}
+
+std::vector<VertexSemantic> ImportedMesh::semantics() const {
+	if (hasTexCoords) {
+		return { VERTEX_POSITION, VERTEX_NORMAL, VERTEX_TEXCOORD };
+	}
+	return { VERTEX_POSITION, VERTEX_NORMAL };
+}
+
+int ImportedMesh::floatsPerVertex() const {
+	return hasTexCoords ? 8 : 6;
+}
+
+size_t ImportedMesh::vertexCount() const {
+	return vertices.size() / floatsPerVertex();
+}
+
+// Float attributes at locations 0, 1 and 2
+VertexLayout ImportedMesh::layout() const {
+	VertexLayout floatLayout = VertexLayout();
+	addVertexAttribute(floatLayout, 0, 3, GL_FLOAT, false);
+	addVertexAttribute(floatLayout, 1, 3, GL_FLOAT, false);
+	if (hasTexCoords) {
+		addVertexAttribute(floatLayout, 2, 2, GL_FLOAT, false);
+	}
+	return floatLayout;
+}
+
+// Skips spaces and tabs, not line ends
+static inline const char* skipBlanks(const char* cursor, const char* end) {
+	while (cursor < end && (*cursor == ' ' || *cursor == '\t')) {
+		cursor++;
+	}
+	return cursor;
+}
+
+// Moves past the end of the current line
+static inline const char* nextLine(const char* cursor, const char* end) {
+	const char* newline = (const char*)memchr(cursor, '\n', end - cursor);
+	return newline ? newline + 1 : end;
+}
+
+// Reads a decimal float with optional sign, fraction and exponent. strtof is several times slower and depends on the locale
+static const char* parseFloat(const char* cursor, const char* end, float& value) {
+	cursor = skipBlanks(cursor, end);
+	bool negative = false;
+	if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+		negative = *cursor == '-';
+		cursor++;
+	}
+
+	// Up to 19 significant digits fit in the mantissa, any more only shift the exponent
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+	while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*cursor - '0');
+			digits += mantissa > 0 ? 1 : 0;
+		}
+		else {
+			exponent++;
+		}
+		cursor++;
+	}
+	if (cursor < end && *cursor == '.') {
+		cursor++;
+		while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*cursor - '0');
+				digits += mantissa > 0 ? 1 : 0;
+				exponent--;
+			}
+			cursor++;
+		}
+	}
+	if (cursor < end && (*cursor == 'e' || *cursor == 'E')) {
+		cursor++;
+		bool negativeExponent = false;
+		if (cursor < end && (*cursor == '-' || *cursor == '+')) {
+			negativeExponent = *cursor == '-';
+			cursor++;
+		}
+		int written = 0;
+		while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+			written = written < 10000 ? written * 10 + (*cursor - '0') : written;
+			cursor++;
+		}
+		exponent += negativeExponent ? -written : written;
+	}
+
+	double result = (double)mantissa;
+	if (exponent < 0) {
+		result = -exponent <= 22 ? result / POWERS_OF_TEN[-exponent] : result * pow(10.0, exponent);
+	}
+	else if (exponent > 0) {
+		result = exponent <= 22 ? result * POWERS_OF_TEN[exponent] : result * pow(10.0, exponent);
+	}
+	value = (float)(negative ? -result : result);
+	return cursor;
+}
+
+// Reads a signed integer, returns null if there are no digits
+static const char* parseIndex(const char* cursor, const char* end, long long& value) {
+	bool negative = false;
+	if (cursor < end && *cursor == '-') {
+		negative = true;
+		cursor++;
+	}
+	if (cursor == end || *cursor < '0' || *cursor > '9') {
+		return nullptr;
+	}
+	value = 0;
+	while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+		value = value * 10 + (*cursor - '0');
+		cursor++;
+	}
+	value = negative ? -value : value;
+	return cursor;
+}
+
+// Turns an OBJ index, 1 based or negative counting back from the last element so far, into a 0 based one.
+// Returns false when it points outside the elements read so far
+static bool resolveIndex(long long index, size_t count, uint32_t& resolved) {
+	long long zeroBased = index > 0 ? index - 1 : (long long)count + index;
+	if (index == 0 || zeroBased < 0 || zeroBased >= (long long)count) {
+		return false;
+	}
+	resolved = (uint32_t)zeroBased;
+	return true;
+}
+
+
+// Runs body over [0, count) in ranges on the pool, or all at once on this thread without one
+static void forRanges(ThreadPool* pool, size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)>& body) {
+	if (pool) {
+		pool->parallelFor(count, grainSize, body);
+	}
+	else if (count > 0) {
+		body(0, count);
+	}
+}
+
+// Hash of a position / texture coordinate / normal triple
+static inline uint64_t hashTriple(const uint32_t* key) {
+	uint64_t mixed = ((uint64_t)key[0] * 0x9E3779B97F4A7C15ull) ^ ((uint64_t)key[1] * 0xC2B2AE3D27D4EB4Full) ^ ((uint64_t)key[2] * 0x165667B19E3779F9ull);
+	return mixed ^ (mixed >> 29);
+}
+
+// Weld partition a triple belongs to, the table inside a partition uses the low bits of the same hash
+static inline size_t weldPartition(const uint32_t* key) {
+	return (size_t)(hashTriple(key) >> (64 - WELD_PARTITION_BITS));
+}
+
+// Maps position / texture coordinate / normal triples to vertex indices, open addressed and grown at half load
+struct VertexTable {
+	std::vector<uint32_t> slots;
+	// The triple of every vertex, three entries each
+	std::vector<uint32_t> keys;
+
+	VertexTable() : slots(1024, EMPTY_SLOT) {
+	}
+
+	// Index of the vertex for a triple, isNew tells whether it was just added
+	uint32_t find(const uint32_t* key, bool& isNew) {
+		size_t mask = slots.size() - 1;
+		size_t slot = (size_t)hashTriple(key) & mask;
+		while (slots[slot] != EMPTY_SLOT) {
+			const uint32_t* existing = &keys[(size_t)slots[slot] * 3];
+			if (existing[0] == key[0] && existing[1] == key[1] && existing[2] == key[2]) {
+				isNew = false;
+				return slots[slot];
+			}
+			slot = (slot + 1) & mask;
+		}
+
+		uint32_t vertex = (uint32_t)(keys.size() / 3);
+		keys.insert(keys.end(), key, key + 3);
+		slots[slot] = vertex;
+		isNew = true;
+		if (keys.size() / 3 * 2 > slots.size()) {
+			grow();
+		}
+		return vertex;
+	}
+
+	void grow() {
+		std::vector<uint32_t> larger(slots.size() * 2, EMPTY_SLOT);
+		size_t mask = larger.size() - 1;
+		for (uint32_t vertex = 0; vertex < keys.size() / 3; vertex++) {
+			size_t slot = (size_t)hashTriple(&keys[(size_t)vertex * 3]) & mask;
+			while (larger[slot] != EMPTY_SLOT) {
+				slot = (slot + 1) & mask;
+			}
+			larger[slot] = vertex;
+		}
+		slots.swap(larger);
+	}
+};
+
+// Kinds of OBJ line the importer reads, everything else is skipped
+enum ObjLine {
+	OBJ_OTHER,
+	OBJ_POSITION,
+	OBJ_TEXCOORD,
+	OBJ_NORMAL,
+	OBJ_FACE
+};
+
+// What the line at cursor declares, cursor is past any leading blanks
+static inline ObjLine classifyLine(const char* cursor, const char* end) {
+	if (end - cursor > 2 && cursor[0] == 'v' && (cursor[1] == ' ' || cursor[1] == '\t')) {
+		return OBJ_POSITION;
+	}
+	if (end - cursor > 3 && cursor[0] == 'v' && (cursor[2] == ' ' || cursor[2] == '\t')) {
+		return cursor[1] == 't' ? OBJ_TEXCOORD : (cursor[1] == 'n' ? OBJ_NORMAL : OBJ_OTHER);
+	}
+	if (end - cursor > 2 && cursor[0] == 'f' && (cursor[1] == ' ' || cursor[1] == '\t')) {
+		return OBJ_FACE;
+	}
+	return OBJ_OTHER;
+}
+
+// A run of whole lines of an OBJ file parsed by one task
+struct ObjChunk {
+	const char* begin;
+	const char* end;
+
+	// Elements and lines in the chunk, counted before parsing
+	size_t positions;
+	size_t texCoords;
+	size_t normals;
+	size_t lines;
+
+	// Elements and lines of all chunks before this one, where this chunk's go in the whole file
+	size_t firstPosition;
+	size_t firstTexCoord;
+	size_t firstNormal;
+	size_t firstLine;
+
+	// Triples of every corner of every triangle, a missing texture coordinate or normal is EMPTY_SLOT
+	std::vector<uint32_t> corners;
+	size_t firstCorner;
+	bool anyTexCoords;
+	// Line of the first face referring to a missing element, 0 if there's none
+	size_t badLine;
+	// Corners falling into each weld partition
+	size_t partitionCorners[WELD_PARTITIONS];
+};
+
+// Counts the elements and lines of a chunk so every chunk knows where its elements go before any is parsed
+static void countObjChunk(ObjChunk& chunk) {
+	chunk.positions = chunk.texCoords = chunk.normals = chunk.lines = 0;
+	const char* cursor = chunk.begin;
+	while (cursor < chunk.end) {
+		chunk.lines++;
+		cursor = skipBlanks(cursor, chunk.end);
+		switch (classifyLine(cursor, chunk.end)) {
+		case OBJ_POSITION: chunk.positions++; break;
+		case OBJ_TEXCOORD: chunk.texCoords++; break;
+		case OBJ_NORMAL: chunk.normals++; break;
+		default: break;
+		}
+		cursor = nextLine(cursor, chunk.end);
+	}
+}
+
+// Parses a chunk's elements into their place in the whole file's arrays and its faces into the chunk's corners.
+// Stops at the first bad face
+static void parseObjChunk(ObjChunk& chunk, std::vector<glm::vec3>& positions, std::vector<glm::vec2>& texCoords, std::vector<glm::vec3>& normals) {
+	PROFILE_ZONE("Parse OBJ chunk");
+	size_t positionCount = chunk.firstPosition;
+	size_t texCoordCount = chunk.firstTexCoord;
+	size_t normalCount = chunk.firstNormal;
+	size_t line = chunk.firstLine;
+	std::vector<uint32_t> polygon;
+	const char* cursor = chunk.begin;
+	const char* end = chunk.end;
+
+	while (cursor < end) {
+		line++;
+		cursor = skipBlanks(cursor, end);
+		switch (classifyLine(cursor, end)) {
+		case OBJ_POSITION: {
+			glm::vec3& position = positions[positionCount++];
+			cursor = parseFloat(cursor + 2, end, position.x);
+			cursor = parseFloat(cursor, end, position.y);
+			cursor = parseFloat(cursor, end, position.z);
+			break;
+		}
+		case OBJ_TEXCOORD: {
+			glm::vec2& texCoord = texCoords[texCoordCount++];
+			cursor = parseFloat(cursor + 3, end, texCoord.x);
+			cursor = parseFloat(cursor, end, texCoord.y);
+			break;
+		}
+		case OBJ_NORMAL: {
+			glm::vec3& normal = normals[normalCount++];
+			cursor = parseFloat(cursor + 3, end, normal.x);
+			cursor = parseFloat(cursor, end, normal.y);
+			cursor = parseFloat(cursor, end, normal.z);
+			break;
+		}
+		case OBJ_FACE: {
+			// Every v, v/vt, v//vn or v/vt/vn on the line
+			polygon.clear();
+			cursor += 2;
+			while (true) {
+				cursor = skipBlanks(cursor, end);
+				if (cursor == end || *cursor == '\n' || *cursor == '\r' || *cursor == '#') {
+					break;
+				}
+				uint32_t corner[3] = { EMPTY_SLOT, EMPTY_SLOT, EMPTY_SLOT };
+				long long index;
+				cursor = parseIndex(cursor, end, index);
+				bool valid = cursor && resolveIndex(index, positionCount, corner[0]);
+				if (valid && cursor < end && *cursor == '/') {
+					cursor++;
+					if (cursor < end && *cursor != '/') {
+						cursor = parseIndex(cursor, end, index);
+						valid = cursor && resolveIndex(index, texCoordCount, corner[1]);
+						chunk.anyTexCoords = true;
+					}
+					if (valid && cursor < end && *cursor == '/') {
+						cursor = parseIndex(cursor + 1, end, index);
+						valid = cursor && resolveIndex(index, normalCount, corner[2]);
+					}
+				}
+				if (!valid) {
+					chunk.badLine = line;
+					return;
+				}
+				polygon.insert(polygon.end(), corner, corner + 3);
+			}
+
+			// Fan around the first corner
+			for (size_t i = 2; i < polygon.size() / 3; i++) {
+				chunk.corners.insert(chunk.corners.end(), &polygon[0], &polygon[3]);
+				chunk.corners.insert(chunk.corners.end(), &polygon[(i - 1) * 3], &polygon[i * 3]);
+				chunk.corners.insert(chunk.corners.end(), &polygon[i * 3], &polygon[(i + 1) * 3]);
+			}
+			break;
+		}
+		default:
+			break;
+		}
+		cursor = nextLine(cursor, end);
+	}
+}
+
+// A corner waiting to be welded: its triple and where it is in the index buffer
+struct WeldCorner {
+	uint32_t key[3];
+	uint32_t corner;
+};
+
+// Reads a Wavefront OBJ file into an indexed mesh
+bool importOBJ(const std::string& path, ImportedMesh& mesh, ThreadPool* pool, MeshImportStats* stats) {
+	PROFILE_ZONE("Import OBJ");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	mesh = ImportedMesh();
+	MappedFile file;
+	if (!file.open(path)) {
+		return false;
+	}
+	const char* text = (const char*)file.data();
+	const char* textEnd = text + file.size();
+
+	// Chunks start at the first line start at or after every multiple of OBJ_CHUNK_BYTES
+	size_t chunkCount = (file.size() + OBJ_CHUNK_BYTES - 1) / OBJ_CHUNK_BYTES;
+	std::vector<ObjChunk> chunks(chunkCount);
+	for (size_t i = 0; i < chunkCount; i++) {
+		const char* begin = text + i * OBJ_CHUNK_BYTES;
+		chunks[i].begin = i == 0 ? text : nextLine(begin - 1, textEnd);
+		chunks[i].anyTexCoords = false;
+		chunks[i].badLine = 0;
+		if (i > 0) {
+			chunks[i - 1].end = chunks[i].begin;
+		}
+	}
+	if (chunkCount > 0) {
+		chunks.back().end = textEnd;
+	}
+
+	// Counting first means every chunk can parse straight into the shared arrays and resolve negative indices on its own
+	forRanges(pool, chunkCount, 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			countObjChunk(chunks[i]);
+		}
+	});
+	size_t positionCount = 0, texCoordCount = 0, normalCount = 0, lineCount = 0;
+	for (ObjChunk& chunk : chunks) {
+		chunk.firstPosition = positionCount;
+		chunk.firstTexCoord = texCoordCount;
+		chunk.firstNormal = normalCount;
+		chunk.firstLine = lineCount;
+		positionCount += chunk.positions;
+		texCoordCount += chunk.texCoords;
+		normalCount += chunk.normals;
+		lineCount += chunk.lines;
+	}
+
+	std::vector<glm::vec3> positions(positionCount), normals(normalCount);
+	std::vector<glm::vec2> texCoords(texCoordCount);
+	forRanges(pool, chunkCount, 1, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			parseObjChunk(chunks[i], positions, texCoords, normals);
+		}
+	});
+
+	size_t cornerCount = 0;
+	for (ObjChunk& chunk : chunks) {
+		if (chunk.badLine != 0) {
+			std::cout << "WARNING::MESH_IMPORTER::BAD_FACE " << path << " line " << chunk.badLine << std::endl;
+			return false;
+		}
+		chunk.firstCorner = cornerCount;
+		cornerCount += chunk.corners.size() / 3;
+		mesh.hasTexCoords = mesh.hasTexCoords || chunk.anyTexCoords;
+	}
+	if (cornerCount == 0) {
+		return false;
+	}
+	mesh.generatedNormals = normals.empty();
+
+	// Welding: corners are bucketed by the top bits of their hash, so each partition can weld its own with no locking,
+	// keeping the order the corners come in
+	std::vector<WeldCorner> weldCorners(cornerCount);
+	std::vector<unsigned char> cornerPartitions(cornerCount);
+	size_t partitionStarts[WELD_PARTITIONS + 1];
+	{
+		PROFILE_ZONE("Bucket corners");
+		forRanges(pool, chunkCount, 1, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				ObjChunk& chunk = chunks[i];
+				memset(chunk.partitionCorners, 0, sizeof(chunk.partitionCorners));
+				for (size_t corner = 0; corner < chunk.corners.size(); corner += 3) {
+					size_t partition = weldPartition(&chunk.corners[corner]);
+					cornerPartitions[chunk.firstCorner + corner / 3] = (unsigned char)partition;
+					chunk.partitionCorners[partition]++;
+				}
+			}
+		});
+
+		// Each partition's corners in chunk order, each chunk's share of a partition at its own offset
+		size_t offset = 0;
+		for (size_t partition = 0; partition < WELD_PARTITIONS; partition++) {
+			partitionStarts[partition] = offset;
+			for (ObjChunk& chunk : chunks) {
+				size_t count = chunk.partitionCorners[partition];
+				chunk.partitionCorners[partition] = offset;
+				offset += count;
+			}
+		}
+		partitionStarts[WELD_PARTITIONS] = offset;
+
+		forRanges(pool, chunkCount, 1, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				ObjChunk& chunk = chunks[i];
+				for (size_t corner = 0; corner < chunk.corners.size(); corner += 3) {
+					size_t globalCorner = chunk.firstCorner + corner / 3;
+					WeldCorner& weldCorner = weldCorners[chunk.partitionCorners[cornerPartitions[globalCorner]]++];
+					memcpy(weldCorner.key, &chunk.corners[corner], sizeof(weldCorner.key));
+					weldCorner.corner = (uint32_t)globalCorner;
+				}
+				std::vector<uint32_t>().swap(chunk.corners);
+			}
+		});
+	}
+
+	// Indices are partition local until every partition knows its size, the first corner to use a vertex is flagged
+	std::vector<VertexTable> tables(WELD_PARTITIONS);
+	mesh.indices.resize(cornerCount);
+	{
+		PROFILE_ZONE("Weld vertices");
+		forRanges(pool, WELD_PARTITIONS, 1, [&](size_t begin, size_t end) {
+			for (size_t partition = begin; partition < end; partition++) {
+				for (size_t i = partitionStarts[partition]; i < partitionStarts[partition + 1]; i++) {
+					bool isNew;
+					uint32_t vertex = tables[partition].find(weldCorners[i].key, isNew);
+					mesh.indices[weldCorners[i].corner] = vertex | (isNew ? FIRST_USE_BIT : 0);
+				}
+			}
+		});
+	}
+	std::vector<WeldCorner>().swap(weldCorners);
+
+	size_t partitionVertexStarts[WELD_PARTITIONS + 1];
+	size_t vertexCount = 0;
+	for (size_t partition = 0; partition < WELD_PARTITIONS; partition++) {
+		partitionVertexStarts[partition] = vertexCount;
+		vertexCount += tables[partition].keys.size() / 3;
+	}
+	partitionVertexStarts[WELD_PARTITIONS] = vertexCount;
+
+	// Vertices are numbered in the order corners first use them, the same order welding them one by one gives:
+	// a vertex's number is how many first uses come before its own
+	std::vector<uint32_t> vertexNumbers(vertexCount);
+	{
+		PROFILE_ZONE("Number vertices");
+		size_t blockCount = (cornerCount + ELEMENT_GRAIN_SIZE - 1) / ELEMENT_GRAIN_SIZE;
+		std::vector<size_t> blockFirstUses(blockCount + 1, 0);
+		forRanges(pool, blockCount, 1, [&](size_t begin, size_t end) {
+			for (size_t block = begin; block < end; block++) {
+				size_t last = std::min((block + 1) * ELEMENT_GRAIN_SIZE, cornerCount);
+				size_t firstUses = 0;
+				for (size_t corner = block * ELEMENT_GRAIN_SIZE; corner < last; corner++) {
+					firstUses += mesh.indices[corner] >> 31;
+				}
+				blockFirstUses[block + 1] = firstUses;
+			}
+		});
+		for (size_t block = 0; block < blockCount; block++) {
+			blockFirstUses[block + 1] += blockFirstUses[block];
+		}
+
+		forRanges(pool, blockCount, 1, [&](size_t begin, size_t end) {
+			for (size_t block = begin; block < end; block++) {
+				size_t last = std::min((block + 1) * ELEMENT_GRAIN_SIZE, cornerCount);
+				uint32_t number = (uint32_t)blockFirstUses[block];
+				for (size_t corner = block * ELEMENT_GRAIN_SIZE; corner < last; corner++) {
+					if (mesh.indices[corner] & FIRST_USE_BIT) {
+						vertexNumbers[partitionVertexStarts[cornerPartitions[corner]] + (mesh.indices[corner] & ~FIRST_USE_BIT)] = number++;
+					}
+				}
+			}
+		});
+
+		forRanges(pool, cornerCount, ELEMENT_GRAIN_SIZE, [&](size_t begin, size_t end) {
+			for (size_t corner = begin; corner < end; corner++) {
+				mesh.indices[corner] = vertexNumbers[partitionVertexStarts[cornerPartitions[corner]] + (mesh.indices[corner] & ~FIRST_USE_BIT)];
+			}
+		});
+	}
+	std::vector<unsigned char>().swap(cornerPartitions);
+
+	// Without normals in the file, each position gets the area weighted average of the faces around it.
+	// Triangles sharing a position would race on it, so this part stays on one thread
+	std::vector<glm::vec3> positionNormals;
+	if (mesh.generatedNormals) {
+		PROFILE_ZONE("Generate normals");
+		std::vector<uint32_t> vertexPositions(vertexCount);
+		forRanges(pool, WELD_PARTITIONS, 1, [&](size_t begin, size_t end) {
+			for (size_t partition = begin; partition < end; partition++) {
+				const std::vector<uint32_t>& keys = tables[partition].keys;
+				for (size_t local = 0; local < keys.size() / 3; local++) {
+					vertexPositions[vertexNumbers[partitionVertexStarts[partition] + local]] = keys[local * 3];
+				}
+			}
+		});
+		positionNormals.assign(positions.size(), glm::vec3(0.0f));
+		for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+			uint32_t a = vertexPositions[mesh.indices[i]];
+			uint32_t b = vertexPositions[mesh.indices[i + 1]];
+			uint32_t c = vertexPositions[mesh.indices[i + 2]];
+			glm::vec3 faceNormal = glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+			positionNormals[a] += faceNormal;
+			positionNormals[b] += faceNormal;
+			positionNormals[c] += faceNormal;
+		}
+	}
+
+	// Each partition writes its vertices to their final numbers and bounds them
+	int stride = mesh.floatsPerVertex();
+	mesh.vertices.resize(vertexCount * stride);
+	std::vector<AABB> partitionBounds(WELD_PARTITIONS, AABB{ glm::vec3(INFINITY), glm::vec3(-INFINITY) });
+	{
+		PROFILE_ZONE("Build vertices");
+		forRanges(pool, WELD_PARTITIONS, 1, [&](size_t begin, size_t end) {
+			for (size_t partition = begin; partition < end; partition++) {
+				const std::vector<uint32_t>& keys = tables[partition].keys;
+				AABB& bounds = partitionBounds[partition];
+				for (size_t local = 0; local < keys.size() / 3; local++) {
+					const uint32_t* key = &keys[local * 3];
+					float* vertex = &mesh.vertices[(size_t)vertexNumbers[partitionVertexStarts[partition] + local] * stride];
+					glm::vec3 position = positions[key[0]];
+					glm::vec3 normal = mesh.generatedNormals ? positionNormals[key[0]] : (key[2] != EMPTY_SLOT ? normals[key[2]] : glm::vec3(0.0f));
+					float length = glm::length(normal);
+					normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+
+					vertex[0] = position.x;
+					vertex[1] = position.y;
+					vertex[2] = position.z;
+					vertex[3] = normal.x;
+					vertex[4] = normal.y;
+					vertex[5] = normal.z;
+					if (mesh.hasTexCoords) {
+						glm::vec2 texCoord = key[1] != EMPTY_SLOT ? texCoords[key[1]] : glm::vec2(0.0f);
+						vertex[6] = texCoord.x;
+						vertex[7] = texCoord.y;
+					}
+					bounds.min = glm::min(bounds.min, position);
+					bounds.max = glm::max(bounds.max, position);
+				}
+			}
+		});
+	}
+	mesh.bounds = partitionBounds[0];
+	for (const AABB& bounds : partitionBounds) {
+		mesh.bounds.min = glm::min(mesh.bounds.min, bounds.min);
+		mesh.bounds.max = glm::max(mesh.bounds.max, bounds.max);
+	}
+
+	if (stats) {
+		stats->bytes = file.size();
+		stats->milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stats->threads = pool ? pool->concurrency() : 1;
+	}
+	return true;
+}
+
+// glTF component types
+static const long long GLTF_BYTE = 5120;
+static const long long GLTF_UNSIGNED_BYTE = 5121;
+static const long long GLTF_SHORT = 5122;
+static const long long GLTF_UNSIGNED_SHORT = 5123;
+static const long long GLTF_UNSIGNED_INT = 5125;
+static const long long GLTF_FLOAT = 5126;
+static const long long GLTF_TRIANGLES = 4;
+
+// Binary glTF container: header, then a JSON chunk and optionally a binary one
+static const uint32_t GLB_MAGIC = 0x46546C67;
+static const uint32_t GLB_JSON_CHUNK = 0x4E4F534A;
+static const uint32_t GLB_BIN_CHUNK = 0x004E4942;
+
+// Bytes of one glTF buffer, wherever they're kept
+struct GltfBuffer {
+	const unsigned char* data;
+	size_t size;
+};
+
+// Where an accessor's elements are and how to read them
+struct GltfAccessor {
+	// First element, null when the accessor has no buffer view and reads as zeros
+	const unsigned char* data;
+	size_t count;
+	size_t stride;
+	long long componentType;
+	int components;
+	bool normalized;
+};
+
+// One triangle primitive of one node, and where its vertices and indices go in the flattened mesh
+struct GltfPrimitive {
+	GltfAccessor positions;
+	GltfAccessor normals;
+	GltfAccessor texCoords;
+	GltfAccessor indices;
+	bool hasNormals;
+	bool hasTexCoords;
+	bool indexed;
+	glm::mat4 transform;
+	// Transforms normals, the inverse transpose of the transform scaled by its determinant's sign
+	glm::mat3 normalTransform;
+	// The transform mirrors, so triangles are flipped to keep them front facing
+	bool mirrored;
+	size_t firstVertex;
+	size_t firstIndex;
+	size_t indexCount;
+};
+
+// Part of a primitive decoded by one task
+struct GltfTask {
+	size_t primitive;
+	bool indices;
+	size_t begin;
+	size_t end;
+	AABB bounds;
+};
+
+// Bytes one component takes
+static size_t gltfComponentBytes(long long componentType) {
+	switch (componentType) {
+	case GLTF_BYTE:
+	case GLTF_UNSIGNED_BYTE:
+		return 1;
+	case GLTF_SHORT:
+	case GLTF_UNSIGNED_SHORT:
+		return 2;
+	case GLTF_UNSIGNED_INT:
+	case GLTF_FLOAT:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+// Components of an accessor type, 0 for the matrix types nothing here reads
+static int gltfComponentCount(const std::string& type) {
+	if (type == "SCALAR") {
+		return 1;
+	}
+	if (type == "VEC2") {
+		return 2;
+	}
+	if (type == "VEC3") {
+		return 3;
+	}
+	if (type == "VEC4") {
+		return 4;
+	}
+	return 0;
+}
+
+// Decodes standard base64, stopping at padding. Returns false on any other character
+static bool decodeBase64(const char* text, size_t length, std::vector<unsigned char>& out) {
+	static signed char values[256];
+	static bool initialized = false;
+	if (!initialized) {
+		memset(values, -1, sizeof(values));
+		const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		for (int i = 0; i < 64; i++) {
+			values[(unsigned char)alphabet[i]] = (signed char)i;
+		}
+		initialized = true;
+	}
+
+	out.clear();
+	out.reserve(length / 4 * 3);
+	uint32_t bits = 0;
+	int bitCount = 0;
+	for (size_t i = 0; i < length && text[i] != '='; i++) {
+		int value = values[(unsigned char)text[i]];
+		if (value < 0) {
+			return false;
+		}
+		bits = (bits << 6) | (uint32_t)value;
+		bitCount += 6;
+		if (bitCount >= 8) {
+			bitCount -= 8;
+			out.push_back((unsigned char)(bits >> bitCount));
+		}
+	}
+	return true;
+}
+
+// Turns %XX escapes of a relative URI back into characters
+static std::string decodeUri(const std::string& uri) {
+	std::string decoded;
+	for (size_t i = 0; i < uri.size(); i++) {
+		if (uri[i] == '%' && i + 2 < uri.size() && isxdigit((unsigned char)uri[i + 1]) && isxdigit((unsigned char)uri[i + 2])) {
+			decoded += (char)strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16);
+			i += 2;
+		}
+		else {
+			decoded += uri[i];
+		}
+	}
+	return decoded;
+}
+
+// Looks up an accessor and checks every element it reads lies inside its buffer view and buffer
+static bool resolveAccessor(const JsonValue& document, const std::vector<GltfBuffer>& buffers, long long index, GltfAccessor& accessor) {
+	const JsonValue& json = document["accessors"][(size_t)index];
+	if (index < 0 || json.isNull() || !json["sparse"].isNull()) {
+		return false;
+	}
+	accessor.componentType = json["componentType"].asInteger();
+	accessor.components = gltfComponentCount(json["type"].asString());
+	accessor.normalized = json["normalized"].asBool();
+	long long count = json["count"].asInteger(-1);
+	size_t componentBytes = gltfComponentBytes(accessor.componentType);
+	if (count < 0 || componentBytes == 0 || accessor.components == 0) {
+		return false;
+	}
+	accessor.count = (size_t)count;
+	size_t elementBytes = componentBytes * accessor.components;
+
+	// Without a buffer view every element is zero
+	if (json["bufferView"].isNull()) {
+		accessor.data = nullptr;
+		accessor.stride = 0;
+		return true;
+	}
+	const JsonValue& view = document["bufferViews"][(size_t)json["bufferView"].asInteger(-1)];
+	long long buffer = view["buffer"].asInteger(-1);
+	long long viewOffset = view["byteOffset"].asInteger(0);
+	long long viewLength = view["byteLength"].asInteger(-1);
+	long long stride = view["byteStride"].asInteger(0);
+	long long offset = json["byteOffset"].asInteger(0);
+	if (view.isNull() || buffer < 0 || (size_t)buffer >= buffers.size() || viewOffset < 0 || viewLength < 0 || stride < 0 || offset < 0
+		|| (uint64_t)viewOffset + (uint64_t)viewLength > buffers[buffer].size) {
+		return false;
+	}
+	accessor.stride = stride > 0 ? (size_t)stride : elementBytes;
+	uint64_t needed = accessor.count == 0 ? 0 : (uint64_t)offset + (uint64_t)(accessor.count - 1) * accessor.stride + elementBytes;
+	if (needed > (uint64_t)viewLength) {
+		return false;
+	}
+	accessor.data = buffers[buffer].data + viewOffset + offset;
+	return true;
+}
+
+// Reads up to four components of an element as floats, normalized integers scaled as glTF specifies
+static inline void readElement(const GltfAccessor& accessor, size_t index, float* out) {
+	if (!accessor.data) {
+		for (int i = 0; i < accessor.components; i++) {
+			out[i] = 0.0f;
+		}
+		return;
+	}
+	const unsigned char* element = accessor.data + index * accessor.stride;
+	for (int i = 0; i < accessor.components; i++) {
+		switch (accessor.componentType) {
+		case GLTF_FLOAT: {
+			float value;
+			memcpy(&value, element + i * 4, 4);
+			out[i] = value;
+			break;
+		}
+		case GLTF_BYTE: {
+			int8_t value = (int8_t)element[i];
+			out[i] = accessor.normalized ? std::max(value / 127.0f, -1.0f) : (float)value;
+			break;
+		}
+		case GLTF_UNSIGNED_BYTE:
+			out[i] = accessor.normalized ? element[i] / 255.0f : (float)element[i];
+			break;
+		case GLTF_SHORT: {
+			int16_t value;
+			memcpy(&value, element + i * 2, 2);
+			out[i] = accessor.normalized ? std::max(value / 32767.0f, -1.0f) : (float)value;
+			break;
+		}
+		case GLTF_UNSIGNED_SHORT: {
+			uint16_t value;
+			memcpy(&value, element + i * 2, 2);
+			out[i] = accessor.normalized ? value / 65535.0f : (float)value;
+			break;
+		}
+		default: {
+			uint32_t value;
+			memcpy(&value, element + i * 4, 4);
+			out[i] = (float)value;
+			break;
+		}
+		}
+	}
+}
+
+// Reads an element of an index accessor
+static inline uint32_t readIndex(const GltfAccessor& accessor, size_t index) {
+	if (!accessor.data) {
+		return 0;
+	}
+	const unsigned char* element = accessor.data + index * accessor.stride;
+	if (accessor.componentType == GLTF_UNSIGNED_BYTE) {
+		return element[0];
+	}
+	if (accessor.componentType == GLTF_UNSIGNED_SHORT) {
+		uint16_t value;
+		memcpy(&value, element, 2);
+		return value;
+	}
+	uint32_t value;
+	memcpy(&value, element, 4);
+	return value;
+}
+
+// A node's local transform, from its matrix or its translation, rotation and scale
+static glm::mat4 gltfNodeTransform(const JsonValue& node) {
+	glm::mat4 transform(1.0f);
+	const JsonValue& matrix = node["matrix"];
+	if (matrix.size() == 16) {
+		for (int column = 0; column < 4; column++) {
+			for (int row = 0; row < 4; row++) {
+				transform[column][row] = (float)matrix[(size_t)(column * 4 + row)].asNumber();
+			}
+		}
+		return transform;
+	}
+
+	const JsonValue& rotation = node["rotation"];
+	if (rotation.size() == 4) {
+		float quaternion[4];
+		for (size_t i = 0; i < 4; i++) {
+			quaternion[i] = (float)rotation[i].asNumber();
+		}
+		float x = quaternion[0], y = quaternion[1], z = quaternion[2], w = quaternion[3];
+		transform[0] = glm::vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w), 0.0f);
+		transform[1] = glm::vec4(2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w), 0.0f);
+		transform[2] = glm::vec4(2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y), 0.0f);
+	}
+	const JsonValue& scale = node["scale"];
+	if (scale.size() == 3) {
+		for (int axis = 0; axis < 3; axis++) {
+			transform[axis] = transform[axis] * (float)scale[(size_t)axis].asNumber(1.0);
+		}
+	}
+	const JsonValue& translation = node["translation"];
+	if (translation.size() == 3) {
+		for (size_t axis = 0; axis < 3; axis++) {
+			transform[3][(int)axis] = (float)translation[axis].asNumber();
+		}
+	}
+	return transform;
+}
+
+// Adds the triangle primitives of a mesh drawn with a transform. Returns false if one refers to a missing or malformed accessor.
+// Skipped primitives are only reported the first time a mesh is drawn, warned tracks which ones were
+static bool addGltfMesh(const JsonValue& document, const std::vector<GltfBuffer>& buffers, const std::string& path, long long meshIndex, const glm::mat4& transform, std::vector<GltfPrimitive>& primitives, std::vector<bool>& warned) {
+	const JsonValue& json = document["meshes"][(size_t)meshIndex];
+	if (meshIndex < 0 || json.isNull()) {
+		return false;
+	}
+	bool warn = !warned[(size_t)meshIndex];
+	warned[(size_t)meshIndex] = true;
+
+	// Cofactors of the upper 3x3, the inverse transpose up to the determinant's scale
+	glm::vec3 x(transform[0]), y(transform[1]), z(transform[2]);
+	float determinant = glm::dot(x, glm::cross(y, z));
+	float sign = determinant < 0.0f ? -1.0f : 1.0f;
+	glm::mat3 normalTransform;
+	normalTransform[0] = glm::cross(y, z) * sign;
+	normalTransform[1] = glm::cross(z, x) * sign;
+	normalTransform[2] = glm::cross(x, y) * sign;
+
+	const JsonValue& jsonPrimitives = json["primitives"];
+	for (size_t i = 0; i < jsonPrimitives.size(); i++) {
+		const JsonValue& jsonPrimitive = jsonPrimitives[i];
+		const JsonValue& attributes = jsonPrimitive["attributes"];
+		if (jsonPrimitive["mode"].asInteger(GLTF_TRIANGLES) != GLTF_TRIANGLES || attributes["POSITION"].isNull()) {
+			if (warn) {
+				std::cout << "WARNING::MESH_IMPORTER::SKIPPED_PRIMITIVE " << path << " mesh " << meshIndex << " primitive " << i << std::endl;
+			}
+			continue;
+		}
+
+		GltfPrimitive primitive = GltfPrimitive();
+		primitive.transform = transform;
+		primitive.normalTransform = normalTransform;
+		primitive.mirrored = determinant < 0.0f;
+		primitive.hasNormals = !attributes["NORMAL"].isNull();
+		primitive.hasTexCoords = !attributes["TEXCOORD_0"].isNull();
+		primitive.indexed = !jsonPrimitive["indices"].isNull();
+		bool valid = resolveAccessor(document, buffers, attributes["POSITION"].asInteger(-1), primitive.positions) && primitive.positions.components == 3;
+		if (valid && primitive.hasNormals) {
+			valid = resolveAccessor(document, buffers, attributes["NORMAL"].asInteger(-1), primitive.normals) && primitive.normals.components == 3
+				&& primitive.normals.count == primitive.positions.count;
+		}
+		if (valid && primitive.hasTexCoords) {
+			valid = resolveAccessor(document, buffers, attributes["TEXCOORD_0"].asInteger(-1), primitive.texCoords) && primitive.texCoords.components == 2
+				&& primitive.texCoords.count == primitive.positions.count;
+		}
+		if (valid && primitive.indexed) {
+			valid = resolveAccessor(document, buffers, jsonPrimitive["indices"].asInteger(-1), primitive.indices) && primitive.indices.components == 1
+				&& (primitive.indices.componentType == GLTF_UNSIGNED_BYTE || primitive.indices.componentType == GLTF_UNSIGNED_SHORT || primitive.indices.componentType == GLTF_UNSIGNED_INT);
+		}
+		if (!valid) {
+			std::cout << "WARNING::MESH_IMPORTER::BAD_ACCESSOR " << path << " mesh " << meshIndex << " primitive " << i << std::endl;
+			return false;
+		}
+
+		// Trailing indices that don't make a whole triangle are dropped
+		primitive.indexCount = (primitive.indexed ? primitive.indices.count : primitive.positions.count) / 3 * 3;
+		if (primitive.indexCount > 0) {
+			primitives.push_back(primitive);
+		}
+	}
+	return true;
+}
+
+// Decodes one task's range of a primitive's vertices or indices into the mesh
+static bool decodeGltfTask(GltfTask& task, const GltfPrimitive& primitive, ImportedMesh& mesh) {
+	int stride = mesh.floatsPerVertex();
+	if (task.indices) {
+		// A mirrored primitive swaps the last two corners of every triangle
+		static const size_t SAME_ORDER[3] = { 0, 1, 2 };
+		static const size_t FLIPPED_ORDER[3] = { 0, 2, 1 };
+		const size_t* order = primitive.mirrored ? FLIPPED_ORDER : SAME_ORDER;
+		uint32_t* indices = &mesh.indices[primitive.firstIndex];
+		for (size_t i = task.begin; i < task.end; i++) {
+			size_t source = i - i % 3 + order[i % 3];
+			uint32_t index = primitive.indexed ? readIndex(primitive.indices, source) : (uint32_t)source;
+			if (index >= primitive.positions.count) {
+				return false;
+			}
+			indices[i] = (uint32_t)primitive.firstVertex + index;
+		}
+		return true;
+	}
+
+	task.bounds = AABB{ glm::vec3(INFINITY), glm::vec3(-INFINITY) };
+	for (size_t i = task.begin; i < task.end; i++) {
+		float* vertex = &mesh.vertices[(primitive.firstVertex + i) * stride];
+		float values[3];
+		readElement(primitive.positions, i, values);
+		glm::vec3 position = glm::vec3(primitive.transform * glm::vec4(values[0], values[1], values[2], 1.0f));
+		vertex[0] = position.x;
+		vertex[1] = position.y;
+		vertex[2] = position.z;
+		task.bounds.min = glm::min(task.bounds.min, position);
+		task.bounds.max = glm::max(task.bounds.max, position);
+
+		// Missing normals stay zero for generateGltfNormals to fill in
+		if (primitive.hasNormals) {
+			readElement(primitive.normals, i, values);
+			glm::vec3 normal = primitive.normalTransform * glm::vec3(values[0], values[1], values[2]);
+			float length = glm::length(normal);
+			normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+			vertex[3] = normal.x;
+			vertex[4] = normal.y;
+			vertex[5] = normal.z;
+		}
+		if (mesh.hasTexCoords) {
+			if (primitive.hasTexCoords) {
+				readElement(primitive.texCoords, i, values);
+			}
+			else {
+				values[0] = values[1] = 0.0f;
+			}
+			vertex[6] = values[0];
+			vertex[7] = values[1];
+		}
+	}
+	return true;
+}
+
+// Area weighted normals for a primitive that came without any. glTF asks for flat normals, but smooth ones match
+// what the OBJ importer does and keep the vertices shared
+static void generateGltfNormals(const GltfPrimitive& primitive, ImportedMesh& mesh) {
+	int stride = mesh.floatsPerVertex();
+	const uint32_t* indices = &mesh.indices[primitive.firstIndex];
+	for (size_t i = 0; i < primitive.indexCount; i += 3) {
+		float* a = &mesh.vertices[(size_t)indices[i] * stride];
+		float* b = &mesh.vertices[(size_t)indices[i + 1] * stride];
+		float* c = &mesh.vertices[(size_t)indices[i + 2] * stride];
+		glm::vec3 pa(a[0], a[1], a[2]), pb(b[0], b[1], b[2]), pc(c[0], c[1], c[2]);
+		glm::vec3 faceNormal = glm::cross(pb - pa, pc - pa);
+		for (float* vertex : { a, b, c }) {
+			vertex[3] += faceNormal.x;
+			vertex[4] += faceNormal.y;
+			vertex[5] += faceNormal.z;
+		}
+	}
+	for (size_t v = 0; v < primitive.positions.count; v++) {
+		float* vertex = &mesh.vertices[(primitive.firstVertex + v) * stride];
+		glm::vec3 normal(vertex[3], vertex[4], vertex[5]);
+		float length = glm::length(normal);
+		normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+		vertex[3] = normal.x;
+		vertex[4] = normal.y;
+		vertex[5] = normal.z;
+	}
+}
+
+// Reads a glTF 2.0 or GLB model into one indexed mesh
+bool importGLTF(const std::string& path, ImportedMesh& mesh, ThreadPool* pool, MeshImportStats* stats) {
+	PROFILE_ZONE("Import glTF");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	mesh = ImportedMesh();
+	MappedFile file;
+	if (!file.open(path)) {
+		return false;
+	}
+	size_t totalBytes = file.size();
+
+	// A GLB holds the JSON and the first buffer as chunks, a .gltf is the JSON itself
+	const char* json = (const char*)file.data();
+	size_t jsonLength = file.size();
+	GltfBuffer binaryChunk = { nullptr, 0 };
+	uint32_t magic = 0;
+	if (file.size() >= 4) {
+		memcpy(&magic, file.data(), 4);
+	}
+	if (magic == GLB_MAGIC) {
+		uint32_t header[5];
+		if (file.size() < sizeof(header)) {
+			return false;
+		}
+		memcpy(header, file.data(), sizeof(header));
+		if (header[1] != 2 || header[4] != GLB_JSON_CHUNK || 20 + (uint64_t)header[3] > file.size()) {
+			std::cout << "WARNING::MESH_IMPORTER::BAD_GLB " << path << std::endl;
+			return false;
+		}
+		json = (const char*)file.data() + 20;
+		jsonLength = header[3];
+		size_t next = 20 + (((size_t)header[3] + 3) & ~(size_t)3);
+		uint32_t chunk[2];
+		if (next + 8 <= file.size()) {
+			memcpy(chunk, file.data() + next, sizeof(chunk));
+			if (chunk[1] == GLB_BIN_CHUNK && next + 8 + (uint64_t)chunk[0] <= file.size()) {
+				binaryChunk = GltfBuffer{ file.data() + next + 8, chunk[0] };
+			}
+		}
+	}
+
+	JsonValue document;
+	if (!parseJson(json, jsonLength, document) || document["asset"]["version"].asString().compare(0, 1, "2") != 0) {
+		std::cout << "WARNING::MESH_IMPORTER::BAD_GLTF " << path << std::endl;
+		return false;
+	}
+
+	// Buffers come from the GLB's binary chunk, base64 data URIs or files next to the model
+	std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+	const JsonValue& jsonBuffers = document["buffers"];
+	std::vector<GltfBuffer> buffers(jsonBuffers.size());
+	std::vector<std::unique_ptr<MappedFile>> bufferFiles;
+	std::vector<std::vector<unsigned char>> decodedBuffers;
+	for (size_t i = 0; i < jsonBuffers.size(); i++) {
+		const std::string& uri = jsonBuffers[i]["uri"].asString();
+		long long byteLength = jsonBuffers[i]["byteLength"].asInteger(-1);
+		bool loaded = false;
+		if (uri.empty()) {
+			buffers[i] = binaryChunk;
+			loaded = i == 0 && binaryChunk.data != nullptr;
+		}
+		else if (uri.compare(0, 5, "data:") == 0) {
+			size_t comma = uri.find(',');
+			decodedBuffers.emplace_back();
+			loaded = comma != std::string::npos && uri.rfind(";base64", comma) != std::string::npos
+				&& decodeBase64(uri.data() + comma + 1, uri.size() - comma - 1, decodedBuffers.back());
+			buffers[i] = GltfBuffer{ decodedBuffers.back().data(), decodedBuffers.back().size() };
+		}
+		else {
+			bufferFiles.emplace_back(new MappedFile());
+			loaded = bufferFiles.back()->open(directory + decodeUri(uri));
+			buffers[i] = GltfBuffer{ bufferFiles.back()->data(), bufferFiles.back()->size() };
+			totalBytes += buffers[i].size;
+		}
+		if (!loaded || byteLength < 0 || (uint64_t)byteLength > buffers[i].size) {
+			std::cout << "WARNING::MESH_IMPORTER::MISSING_BUFFER " << path << " buffer " << i << std::endl;
+			return false;
+		}
+		buffers[i].size = (size_t)byteLength;
+	}
+
+	// Every mesh instance of the scene's node trees, without a scene every node nothing has as a child is a root,
+	// and a file with meshes but no nodes draws each mesh once untransformed
+	std::vector<GltfPrimitive> primitives;
+	const JsonValue& nodes = document["nodes"];
+	std::vector<long long> roots;
+	std::vector<bool> warned(document["meshes"].size(), false);
+	const JsonValue& scene = document["scenes"][(size_t)document["scene"].asInteger(0)];
+	if (!scene.isNull()) {
+		for (size_t i = 0; i < scene["nodes"].size(); i++) {
+			roots.push_back(scene["nodes"][i].asInteger(-1));
+		}
+	}
+	else if (nodes.size() > 0) {
+		std::vector<bool> isChild(nodes.size(), false);
+		for (size_t i = 0; i < nodes.size(); i++) {
+			for (size_t child = 0; child < nodes[i]["children"].size(); child++) {
+				long long index = nodes[i]["children"][child].asInteger(-1);
+				if (index >= 0 && (size_t)index < nodes.size()) {
+					isChild[index] = true;
+				}
+			}
+		}
+		for (size_t i = 0; i < nodes.size(); i++) {
+			if (!isChild[i]) {
+				roots.push_back((long long)i);
+			}
+		}
+	}
+	else {
+		for (size_t i = 0; i < document["meshes"].size(); i++) {
+			if (!addGltfMesh(document, buffers, path, (long long)i, glm::mat4(1.0f), primitives, warned)) {
+				return false;
+			}
+		}
+	}
+
+	// Nodes form trees, one reached twice means a malformed file and is only taken once
+	std::vector<bool> visited(nodes.size(), false);
+	std::vector<std::pair<long long, glm::mat4>> pending;
+	for (size_t i = roots.size(); i-- > 0;) {
+		pending.push_back(std::make_pair(roots[i], glm::mat4(1.0f)));
+	}
+	while (!pending.empty()) {
+		long long index = pending.back().first;
+		glm::mat4 parent = pending.back().second;
+		pending.pop_back();
+		if (index < 0 || (size_t)index >= nodes.size() || visited[index]) {
+			continue;
+		}
+		visited[index] = true;
+
+		const JsonValue& node = nodes[(size_t)index];
+		glm::mat4 transform = parent * gltfNodeTransform(node);
+		if (!node["mesh"].isNull() && !addGltfMesh(document, buffers, path, node["mesh"].asInteger(-1), transform, primitives, warned)) {
+			return false;
+		}
+		const JsonValue& children = node["children"];
+		for (size_t child = children.size(); child-- > 0;) {
+			pending.push_back(std::make_pair(children[child].asInteger(-1), transform));
+		}
+	}
+
+	// Primitives are laid out one after another
+	size_t vertexCount = 0, indexCount = 0;
+	for (GltfPrimitive& primitive : primitives) {
+		primitive.firstVertex = vertexCount;
+		primitive.firstIndex = indexCount;
+		vertexCount += primitive.positions.count;
+		indexCount += primitive.indexCount;
+		mesh.hasTexCoords = mesh.hasTexCoords || primitive.hasTexCoords;
+		mesh.generatedNormals = mesh.generatedNormals || !primitive.hasNormals;
+	}
+	if (indexCount == 0 || vertexCount > EMPTY_SLOT) {
+		return false;
+	}
+	mesh.vertices.assign(vertexCount * mesh.floatsPerVertex(), 0.0f);
+	mesh.indices.resize(indexCount);
+
+	// Each primitive's vertices and indices are cut into tasks, so one huge accessor is spread out as well as many small ones
+	std::vector<GltfTask> tasks;
+	for (size_t i = 0; i < primitives.size(); i++) {
+		for (size_t begin = 0; begin < primitives[i].positions.count; begin += ELEMENT_GRAIN_SIZE) {
+			tasks.push_back(GltfTask{ i, false, begin, std::min(begin + ELEMENT_GRAIN_SIZE, primitives[i].positions.count), AABB() });
+		}
+		for (size_t begin = 0; begin < primitives[i].indexCount; begin += GLTF_INDEX_GRAIN_SIZE) {
+			tasks.push_back(GltfTask{ i, true, begin, std::min(begin + GLTF_INDEX_GRAIN_SIZE, primitives[i].indexCount), AABB() });
+		}
+	}
+	std::atomic<bool> badIndex(false);
+	{
+		PROFILE_ZONE("Decode accessors");
+		forRanges(pool, tasks.size(), 1, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				if (!decodeGltfTask(tasks[i], primitives[tasks[i].primitive], mesh)) {
+					badIndex = true;
+				}
+			}
+		});
+	}
+	if (badIndex) {
+		std::cout << "WARNING::MESH_IMPORTER::BAD_INDEX " << path << std::endl;
+		return false;
+	}
+
+	// Primitives share no vertices, so each can have its normals generated separately
+	if (mesh.generatedNormals) {
+		PROFILE_ZONE("Generate normals");
+		forRanges(pool, primitives.size(), 1, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				if (!primitives[i].hasNormals) {
+					generateGltfNormals(primitives[i], mesh);
+				}
+			}
+		});
+	}
+
+	mesh.bounds = AABB{ glm::vec3(INFINITY), glm::vec3(-INFINITY) };
+	for (const GltfTask& task : tasks) {
+		if (!task.indices) {
+			mesh.bounds.min = glm::min(mesh.bounds.min, task.bounds.min);
+			mesh.bounds.max = glm::max(mesh.bounds.max, task.bounds.max);
+		}
+	}
+
+	if (stats) {
+		stats->bytes = totalBytes;
+		stats->milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stats->threads = pool ? pool->concurrency() : 1;
+	}
+	return true;
+}
+
+// Picks the importer by extension, case insensitively
+bool importMesh(const std::string& path, ImportedMesh& mesh, ThreadPool* pool, MeshImportStats* stats) {
+	std::string extension = path.substr(path.find_last_of('.') == std::string::npos ? path.size() : path.find_last_of('.'));
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char character) { return (char)tolower(character); });
+	if (extension == ".gltf" || extension == ".glb") {
+		return importGLTF(path, mesh, pool, stats);
+	}
+	return importOBJ(path, mesh, pool, stats);
+}
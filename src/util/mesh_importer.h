@@ -0,0 +1,59 @@
+#ifndef MESH_IMPORTER_H
+#define MESH_IMPORTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "frustum.h"
+#include "thread_pool.h"
+#include "vertex_layout.h"
+
+// A mesh read from a model file as an indexed triangle list
+struct ImportedMesh {
+	// Interleaved position and normal, then texture coordinates when the file has them
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+	bool hasTexCoords;
+	// Some or all normals were averaged from the faces around each vertex because the file had none
+	bool generatedNormals;
+	AABB bounds;
+
+	// Number of floats in each attribute and in a whole vertex, in the order Mesh takes them
+	std::vector<int> attributeSizes() const;
+	// What each attribute holds, for packing the vertices
+	std::vector<VertexSemantic> semantics() const;
+	int floatsPerVertex() const;
+	size_t vertexCount() const;
+
+	// The vertices as they are, float attributes at locations 0, 1 and 2
+	VertexLayout layout() const;
+};
+
+// How long an import took over how much data
+struct MeshImportStats {
+	// The model file and any buffer files it refers to
+	size_t bytes;
+	double milliseconds;
+	// Threads that took part, the calling thread included
+	unsigned int threads;
+};
+
+// Reads a Wavefront OBJ file. Polygons are triangulated as fans and only geometry is kept, materials, groups and
+// smoothing are ignored. A vertex is made for every distinct position / texture coordinate / normal triple the faces use,
+// numbered in the order the faces first use them. With a pool the file is parsed in chunks of whole lines and the
+// vertices welded in parallel, giving exactly the same mesh as without.
+// Returns false if the file can't be read, has a face referring to a missing element or has no faces at all
+bool importOBJ(const std::string& path, ImportedMesh& mesh, ThreadPool* pool = nullptr, MeshImportStats* stats = nullptr);
+
+// Reads a glTF 2.0 model, either a .gltf with its buffers embedded as data URIs or in .bin files beside it, or a binary
+// .glb. Every triangle primitive of the default scene is flattened into one mesh with its node's transform applied,
+// other primitive modes are skipped. With a pool the accessors are decoded in parallel ranges.
+// Returns false if the file can't be read, isn't valid glTF 2.0 or has no triangles
+bool importGLTF(const std::string& path, ImportedMesh& mesh, ThreadPool* pool = nullptr, MeshImportStats* stats = nullptr);
+
+// Picks the importer by the file's extension: .obj, .gltf or .glb
+bool importMesh(const std::string& path, ImportedMesh& mesh, ThreadPool* pool = nullptr, MeshImportStats* stats = nullptr);
+
+#endif
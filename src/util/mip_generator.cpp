@@ -0,0 +1,615 @@
+#include "mip_generator.h"
+#include "cpu_profiler.h"
+#include "cpu_features.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_GENERATOR_SSE
+#include <emmintrin.h>
+// AVX2 code is compiled per function below, so it's available without building the whole engine for AVX2
+#if defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER)
+#define MIP_GENERATOR_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(MIP_GENERATOR_AVX2) && (defined(__GNUC__) || defined(__clang__))
+#define MIP_AVX2_FUNCTION __attribute__((target("avx2")))
+#else
+#define MIP_AVX2_FUNCTION
+#endif
+
+// Output rows per parallelFor range. Each range decodes a few source rows the previous one already did, so it stays well above the tap count
+static const size_t MIP_GRAIN_SIZE = 32;
+// Entries in the linear to sRGB table. Fine enough that the steepest part of the curve, near black, is still within 0.6 of a step
+static const int SRGB_ENCODE_SIZE = 16384;
+// Most taps either filter has
+static const int MAX_TAPS = 8;
+// Pixels repeated past both ends of a row after the column pass, so the row pass never has to clamp
+static const int ROW_PADDING = 4;
+// Kaiser window shape, NVTT's default. Higher is smoother with less ringing, lower is sharper
+static const double KAISER_ALPHA = 4.0;
+
+static const char* KERNEL_NAMES[] = { "scalar", "sse2", "avx2" };
+static const char* FILTER_NAMES[] = { "box", "kaiser" };
+
+// Weights of a filter, applied to the source texels first + 0 ... first + count - 1 around twice the destination coordinate
+struct FilterTaps {
+	int count;
+	int first;
+	float weights[MAX_TAPS];
+};
+
+// Conversions between 8 bit sRGB and linear light. fromLinear has three spare entries since AVX2 gathers it four bytes at a time
+struct SrgbTables {
+	float toLinear[256];
+	unsigned char fromLinear[SRGB_ENCODE_SIZE + 3];
+
+	SrgbTables() {
+		for (int i = 0; i < 256; i++) {
+			double value = i / 255.0;
+			toLinear[i] = (float)(value <= 0.04045 ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4));
+		}
+		for (int i = 0; i < SRGB_ENCODE_SIZE; i++) {
+			double value = (double)i / (SRGB_ENCODE_SIZE - 1);
+			double encoded = value <= 0.0031308 ? value * 12.92 : 1.055 * pow(value, 1.0 / 2.4) - 0.055;
+			fromLinear[i] = (unsigned char)(encoded * 255.0 + 0.5);
+		}
+		std::fill(fromLinear + SRGB_ENCODE_SIZE, fromLinear + SRGB_ENCODE_SIZE + 3, (unsigned char)255);
+	}
+};
+
+// Built on first use, shared by every thread
+static const SrgbTables& srgbTables() {
+	static const SrgbTables tables;
+	return tables;
+}
+
+// Zeroth order modified Bessel function of the first kind, by its power series
+static double besselI0(double x) {
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 32; k++) {
+		double factor = x / (2.0 * k);
+		term *= factor * factor;
+		sum += term;
+	}
+	return sum;
+}
+
+// Two taps of a half, the texel pair each destination texel covers
+static FilterTaps boxTaps() {
+	return FilterTaps{ 2, 0, { 0.5f, 0.5f } };
+}
+
+// Sinc with a cutoff at the destination's Nyquist frequency under a Kaiser window two destination texels wide
+// either side, so 8 source texels centered between the pair each destination texel covers
+static FilterTaps makeKaiserTaps() {
+	const double RADIUS = 2.0;
+	const double PI = 3.14159265358979323846;
+	FilterTaps taps = { MAX_TAPS, -3, {} };
+	double weights[MAX_TAPS];
+	double total = 0.0;
+	for (int k = 0; k < taps.count; k++) {
+		// Distance from the destination texel's center, in destination texels
+		double t = (taps.first + k - 0.5) / 2.0;
+		double sinc = sin(PI * t) / (PI * t);
+		double ratio = t / RADIUS;
+		double window = besselI0(KAISER_ALPHA * sqrt(1.0 - ratio * ratio)) / besselI0(KAISER_ALPHA);
+		weights[k] = sinc * window;
+		total += weights[k];
+	}
+	for (int k = 0; k < taps.count; k++) {
+		taps.weights[k] = (float)(weights[k] / total);
+	}
+	return taps;
+}
+
+static const FilterTaps& kaiserTaps() {
+	static const FilterTaps taps = makeKaiserTaps();
+	return taps;
+}
+
+// Channels that hold color, the last one of two or four is alpha
+static int colorChannelCount(int channels) {
+	return channels == 2 || channels == 4 ? channels - 1 : channels;
+}
+
+// 8 bit value of a filtered channel. The clamp catches the Kaiser filter's overshoot around sharp edges
+static inline unsigned char encodeLinear(float value) {
+	value = std::min(std::max(value, 0.0f), 1.0f);
+	return (unsigned char)(int)(value * 255.0f + 0.5f);
+}
+
+static inline unsigned char encodeSrgb(float value, const SrgbTables& tables) {
+	value = std::min(std::max(value, 0.0f), 1.0f);
+	return tables.fromLinear[(int)(value * (float)(SRGB_ENCODE_SIZE - 1) + 0.5f)];
+}
+
+// ------------------------------------------------ Scalar ----------------------------------------------------
+// The reference every other kernel has to match
+
+// Widens a row of 8 bit pixels to four floats each, in linear light when srgb is set. Unused lanes are zero
+static void decodeRowScalar(const unsigned char* source, int width, int channels, bool srgb, float* destination) {
+	const SrgbTables& tables = srgbTables();
+	int colorChannels = srgb ? colorChannelCount(channels) : 0;
+	for (int x = 0; x < width; x++) {
+		const unsigned char* pixel = source + (size_t)x * channels;
+		float* decoded = destination + (size_t)x * 4;
+		for (int channel = 0; channel < 4; channel++) {
+			if (channel >= channels) {
+				decoded[channel] = 0.0f;
+			}
+			else if (channel < colorChannels) {
+				decoded[channel] = tables.toLinear[pixel[channel]];
+			}
+			else {
+				decoded[channel] = pixel[channel] * (1.0f / 255.0f);
+			}
+		}
+	}
+}
+
+// Weighted sum of taps rows, count floats long
+static void filterColumnsScalar(const float* const* rows, const float* weights, int taps, size_t count, float* destination) {
+	for (size_t i = 0; i < count; i++) {
+		float sum = rows[0][i] * weights[0];
+		for (int k = 1; k < taps; k++) {
+			sum = sum + rows[k][i] * weights[k];
+		}
+		destination[i] = sum;
+	}
+}
+
+// Destination pixel x is the weighted sum of the taps pixels from source pixel 2x on
+static void filterRowScalar(const float* source, const float* weights, int taps, int width, float* destination) {
+	for (int x = 0; x < width; x++) {
+		const float* first = source + (size_t)x * 8;
+		for (int channel = 0; channel < 4; channel++) {
+			float sum = first[channel] * weights[0];
+			for (int k = 1; k < taps; k++) {
+				sum = sum + first[k * 4 + channel] * weights[k];
+			}
+			destination[(size_t)x * 4 + channel] = sum;
+		}
+	}
+}
+
+// Narrows filtered pixels back to 8 bits and the image's channel count
+static void encodeRowScalar(const float* source, int width, int channels, bool srgb, unsigned char* destination) {
+	const SrgbTables& tables = srgbTables();
+	int colorChannels = srgb ? colorChannelCount(channels) : 0;
+	for (int x = 0; x < width; x++) {
+		const float* pixel = source + (size_t)x * 4;
+		unsigned char* encoded = destination + (size_t)x * channels;
+		for (int channel = 0; channel < channels; channel++) {
+			encoded[channel] = channel < colorChannels ? encodeSrgb(pixel[channel], tables) : encodeLinear(pixel[channel]);
+		}
+	}
+}
+
+#ifdef MIP_GENERATOR_SSE
+// ------------------------------------------------ SSE2 ------------------------------------------------------
+// Four lanes hold one pixel, so the row pass needs no shuffles at all. RGB and RGBA get their own decode and
+// encode, one and two channel images are rare enough to stay scalar
+
+// Table lookups don't vectorize without a gather, but with the channel count fixed the loop has no branches
+static void decodeSrgbRow(const unsigned char* source, int width, int channels, float* destination) {
+	const SrgbTables& tables = srgbTables();
+	for (int x = 0; x < width; x++) {
+		const unsigned char* pixel = source + (size_t)x * channels;
+		float* decoded = destination + (size_t)x * 4;
+		decoded[0] = tables.toLinear[pixel[0]];
+		decoded[1] = tables.toLinear[pixel[1]];
+		decoded[2] = tables.toLinear[pixel[2]];
+		decoded[3] = channels == 4 ? pixel[3] * (1.0f / 255.0f) : 0.0f;
+	}
+}
+
+// Widens four packed 8 bit channels to floats between 0 and 1
+static inline __m128 widenPixel(__m128i bytes) {
+	const __m128i zero = _mm_setzero_si128();
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero)), _mm_set1_ps(1.0f / 255.0f));
+}
+
+// RGBA is widened four pixels from one load, RGB a pixel at a time from its three bytes
+static void decodeRowSSE2(const unsigned char* source, int width, int channels, bool srgb, float* destination) {
+	if (channels < 3) {
+		decodeRowScalar(source, width, channels, srgb, destination);
+		return;
+	}
+	if (srgb) {
+		decodeSrgbRow(source, width, channels, destination);
+		return;
+	}
+	int x = 0;
+	if (channels == 4) {
+		for (; x + 4 <= width; x += 4) {
+			__m128i bytes = _mm_loadu_si128((const __m128i*)(source + (size_t)x * 4));
+			float* decoded = destination + (size_t)x * 4;
+			_mm_storeu_ps(decoded, widenPixel(bytes));
+			_mm_storeu_ps(decoded + 4, widenPixel(_mm_srli_si128(bytes, 4)));
+			_mm_storeu_ps(decoded + 8, widenPixel(_mm_srli_si128(bytes, 8)));
+			_mm_storeu_ps(decoded + 12, widenPixel(_mm_srli_si128(bytes, 12)));
+		}
+	}
+	else {
+		for (; x < width; x++) {
+			const unsigned char* pixel = source + (size_t)x * 3;
+			_mm_storeu_ps(destination + (size_t)x * 4, widenPixel(_mm_cvtsi32_si128(pixel[0] | pixel[1] << 8 | pixel[2] << 16)));
+		}
+	}
+	decodeRowScalar(source + (size_t)x * channels, width - x, channels, srgb, destination + (size_t)x * 4);
+}
+
+static void filterColumnsSSE2(const float* const* rows, const float* weights, int taps, size_t count, float* destination) {
+	// Rows are whole pixels, so count is always a multiple of four
+	for (size_t i = 0; i < count; i += 4) {
+		__m128 sum = _mm_mul_ps(_mm_loadu_ps(rows[0] + i), _mm_set1_ps(weights[0]));
+		for (int k = 1; k < taps; k++) {
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[k] + i), _mm_set1_ps(weights[k])));
+		}
+		_mm_storeu_ps(destination + i, sum);
+	}
+}
+
+static void filterRowSSE2(const float* source, const float* weights, int taps, int width, float* destination) {
+	__m128 tapWeights[MAX_TAPS];
+	for (int k = 0; k < taps; k++) {
+		tapWeights[k] = _mm_set1_ps(weights[k]);
+	}
+	for (int x = 0; x < width; x++) {
+		const float* first = source + (size_t)x * 8;
+		__m128 sum = _mm_mul_ps(_mm_loadu_ps(first), tapWeights[0]);
+		for (int k = 1; k < taps; k++) {
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(first + k * 4), tapWeights[k]));
+		}
+		_mm_storeu_ps(destination + (size_t)x * 4, sum);
+	}
+}
+
+// Clamps one pixel and scales it to the 8 bit range or the sRGB table, truncating like the scalar casts
+static inline __m128i encodeIndices(__m128 pixel, __m128 scale) {
+	pixel = _mm_min_ps(_mm_max_ps(pixel, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(pixel, scale), _mm_set1_ps(0.5f)));
+}
+
+// Stores four pixels packed as RGBA bytes with the image's channel count
+static inline void storePixels(__m128i packed, int channels, unsigned char* destination) {
+	if (channels == 4) {
+		_mm_storeu_si128((__m128i*)destination, packed);
+		return;
+	}
+	alignas(16) unsigned char bytes[16];
+	_mm_store_si128((__m128i*)bytes, packed);
+	for (int i = 0; i < 4; i++) {
+		memcpy(destination + i * 3, bytes + i * 4, 3);
+	}
+}
+
+// Four pixels at a time, in sRGB the color lanes go through the table one by one
+static void encodeRowSSE2(const float* source, int width, int channels, bool srgb, unsigned char* destination) {
+	if (channels < 3) {
+		encodeRowScalar(source, width, channels, srgb, destination);
+		return;
+	}
+	const __m128 byteScale = _mm_set1_ps(255.0f);
+	int x = 0;
+	if (srgb) {
+		const SrgbTables& tables = srgbTables();
+		const __m128 tableScale = _mm_set1_ps((float)(SRGB_ENCODE_SIZE - 1));
+		alignas(16) int indices[4];
+		for (; x < width; x++) {
+			_mm_store_si128((__m128i*)indices, encodeIndices(_mm_loadu_ps(source + (size_t)x * 4), tableScale));
+			unsigned char* encoded = destination + (size_t)x * channels;
+			encoded[0] = tables.fromLinear[indices[0]];
+			encoded[1] = tables.fromLinear[indices[1]];
+			encoded[2] = tables.fromLinear[indices[2]];
+			if (channels == 4) {
+				encoded[3] = encodeLinear(source[(size_t)x * 4 + 3]);
+			}
+		}
+		return;
+	}
+	for (; x + 4 <= width; x += 4) {
+		const float* pixels = source + (size_t)x * 4;
+		__m128i first = _mm_packs_epi32(encodeIndices(_mm_loadu_ps(pixels), byteScale), encodeIndices(_mm_loadu_ps(pixels + 4), byteScale));
+		__m128i second = _mm_packs_epi32(encodeIndices(_mm_loadu_ps(pixels + 8), byteScale), encodeIndices(_mm_loadu_ps(pixels + 12), byteScale));
+		storePixels(_mm_packus_epi16(first, second), channels, destination + (size_t)x * channels);
+	}
+	encodeRowScalar(source + (size_t)x * 4, width - x, channels, srgb, destination + (size_t)x * channels);
+}
+#endif
+
+#ifdef MIP_GENERATOR_AVX2
+// ------------------------------------------------ AVX2 ------------------------------------------------------
+// Eight lanes hold two pixels. RGB is spread to RGBA with a byte shuffle and the sRGB tables are read with gathers,
+// so every channel count from three up stays in vector registers
+
+// Moves four RGB pixels into the low three bytes of each 32 bit lane, zeroing the fourth
+MIP_AVX2_FUNCTION static inline __m128i expandRGB(__m128i bytes) {
+	return _mm_shuffle_epi8(bytes, _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1));
+}
+
+// Two pixels of 32 bit channels to floats, color lanes through the sRGB table when asked
+MIP_AVX2_FUNCTION static inline __m256 widenPixels(__m256i channels, bool srgb, const float* toLinear) {
+	__m256 linear = _mm256_mul_ps(_mm256_cvtepi32_ps(channels), _mm256_set1_ps(1.0f / 255.0f));
+	if (!srgb) {
+		return linear;
+	}
+	return _mm256_blend_ps(_mm256_i32gather_ps(toLinear, channels, 4), linear, 0x88);
+}
+
+MIP_AVX2_FUNCTION static void decodeRowAVX2(const unsigned char* source, int width, int channels, bool srgb, float* destination) {
+	if (channels < 3) {
+		decodeRowScalar(source, width, channels, srgb, destination);
+		return;
+	}
+	const float* toLinear = srgbTables().toLinear;
+	int x = 0;
+	// Four pixels per 16 byte load, RGB stops early enough that the load never reads past the row
+	for (; (size_t)(x + 4) * channels + (channels == 3 ? 4 : 0) <= (size_t)width * channels; x += 4) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(source + (size_t)x * channels));
+		if (channels == 3) {
+			bytes = expandRGB(bytes);
+		}
+		float* decoded = destination + (size_t)x * 4;
+		_mm256_storeu_ps(decoded, widenPixels(_mm256_cvtepu8_epi32(bytes), srgb, toLinear));
+		_mm256_storeu_ps(decoded + 8, widenPixels(_mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)), srgb, toLinear));
+	}
+	decodeRowScalar(source + (size_t)x * channels, width - x, channels, srgb, destination + (size_t)x * 4);
+}
+
+// Two pixels to 32 bit channels, color lanes looked up in the sRGB table when asked. The table is gathered
+// as 32 bit words at byte offsets, so only the low byte of each is the entry
+MIP_AVX2_FUNCTION static inline __m256i narrowPixels(__m256 pixels, bool srgb, const unsigned char* fromLinear) {
+	pixels = _mm256_min_ps(_mm256_max_ps(pixels, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+	__m256i linear = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(pixels, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+	if (!srgb) {
+		return linear;
+	}
+	__m256i indices = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(pixels, _mm256_set1_ps((float)(SRGB_ENCODE_SIZE - 1))), _mm256_set1_ps(0.5f)));
+	__m256i encoded = _mm256_and_si256(_mm256_i32gather_epi32((const int*)fromLinear, indices, 1), _mm256_set1_epi32(0xFF));
+	return _mm256_blend_epi32(encoded, linear, 0x88);
+}
+
+MIP_AVX2_FUNCTION static void encodeRowAVX2(const float* source, int width, int channels, bool srgb, unsigned char* destination) {
+	if (channels < 3) {
+		encodeRowScalar(source, width, channels, srgb, destination);
+		return;
+	}
+	const unsigned char* fromLinear = srgbTables().fromLinear;
+	int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		const float* pixels = source + (size_t)x * 4;
+		__m256i first = narrowPixels(_mm256_loadu_ps(pixels), srgb, fromLinear);
+		__m256i second = narrowPixels(_mm256_loadu_ps(pixels + 8), srgb, fromLinear);
+		// Packing works within 128 bit halves, so split each pair of pixels to keep them in order
+		__m128i firstWords = _mm_packs_epi32(_mm256_castsi256_si128(first), _mm256_extracti128_si256(first, 1));
+		__m128i secondWords = _mm_packs_epi32(_mm256_castsi256_si128(second), _mm256_extracti128_si256(second, 1));
+		__m128i packed = _mm_packus_epi16(firstWords, secondWords);
+
+		unsigned char* encoded = destination + (size_t)x * channels;
+		if (channels == 4) {
+			_mm_storeu_si128((__m128i*)encoded, packed);
+		}
+		else {
+			// Drop every fourth byte and store the twelve left without touching the next pixel
+			packed = _mm_shuffle_epi8(packed, _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+			_mm_storel_epi64((__m128i*)encoded, packed);
+			int last = _mm_cvtsi128_si32(_mm_srli_si128(packed, 8));
+			memcpy(encoded + 8, &last, 4);
+		}
+	}
+	encodeRowScalar(source + (size_t)x * 4, width - x, channels, srgb, destination + (size_t)x * channels);
+}
+
+MIP_AVX2_FUNCTION static void filterColumnsAVX2(const float* const* rows, const float* weights, int taps, size_t count, float* destination) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 sum = _mm256_mul_ps(_mm256_loadu_ps(rows[0] + i), _mm256_set1_ps(weights[0]));
+		for (int k = 1; k < taps; k++) {
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(rows[k] + i), _mm256_set1_ps(weights[k])));
+		}
+		_mm256_storeu_ps(destination + i, sum);
+	}
+	// An odd number of pixels leaves one
+	if (i < count) {
+		__m128 sum = _mm_mul_ps(_mm_loadu_ps(rows[0] + i), _mm_set1_ps(weights[0]));
+		for (int k = 1; k < taps; k++) {
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[k] + i), _mm_set1_ps(weights[k])));
+		}
+		_mm_storeu_ps(destination + i, sum);
+	}
+}
+
+// Two destination pixels per iteration, their source pixels are two apart so each tap is two 128 bit loads
+MIP_AVX2_FUNCTION static void filterRowAVX2(const float* source, const float* weights, int taps, int width, float* destination) {
+	__m256 tapWeights[MAX_TAPS];
+	for (int k = 0; k < taps; k++) {
+		tapWeights[k] = _mm256_set1_ps(weights[k]);
+	}
+	int x = 0;
+	for (; x + 2 <= width; x += 2) {
+		const float* first = source + (size_t)x * 8;
+		__m256 sum = _mm256_mul_ps(_mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(first)), _mm_loadu_ps(first + 8), 1), tapWeights[0]);
+		for (int k = 1; k < taps; k++) {
+			__m256 pixels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(first + k * 4)), _mm_loadu_ps(first + k * 4 + 8), 1);
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(pixels, tapWeights[k]));
+		}
+		_mm256_storeu_ps(destination + (size_t)x * 4, sum);
+	}
+	if (x < width) {
+		filterRowSSE2(source + (size_t)x * 8, weights, taps, width - x, destination + (size_t)x * 4);
+	}
+}
+#endif
+
+// --------------------------------------------- Dispatch -----------------------------------------------------
+
+// The four steps of filtering a row, one set per kernel
+struct MipKernelFunctions {
+	void (*decodeRow)(const unsigned char* source, int width, int channels, bool srgb, float* destination);
+	void (*filterColumns)(const float* const* rows, const float* weights, int taps, size_t count, float* destination);
+	void (*filterRow)(const float* source, const float* weights, int taps, int width, float* destination);
+	void (*encodeRow)(const float* source, int width, int channels, bool srgb, unsigned char* destination);
+};
+
+// True when the kernel was compiled in and the CPU can run it
+bool isMipKernelSupported(MipKernel kernel) {
+	switch (kernel) {
+	case MIP_KERNEL_SCALAR:
+		return true;
+	case MIP_KERNEL_SSE2:
+#ifdef MIP_GENERATOR_SSE
+		return true;
+#else
+		return false;
+#endif
+	case MIP_KERNEL_AVX2: {
+#ifdef MIP_GENERATOR_AVX2
+		static const bool supported = cpuSupportsAVX2();
+		return supported;
+#else
+		return false;
+#endif
+	}
+	}
+	return false;
+}
+
+// Fastest kernel both this build and the CPU support
+MipKernel bestMipKernel() {
+	if (isMipKernelSupported(MIP_KERNEL_AVX2)) {
+		return MIP_KERNEL_AVX2;
+	}
+	return isMipKernelSupported(MIP_KERNEL_SSE2) ? MIP_KERNEL_SSE2 : MIP_KERNEL_SCALAR;
+}
+
+// Functions for a kernel, the scalar ones when it can't run here
+static MipKernelFunctions kernelFunctions(MipKernel kernel) {
+	if (!isMipKernelSupported(kernel)) {
+		kernel = MIP_KERNEL_SCALAR;
+	}
+	switch (kernel) {
+#ifdef MIP_GENERATOR_AVX2
+	case MIP_KERNEL_AVX2:
+		return MipKernelFunctions{ decodeRowAVX2, filterColumnsAVX2, filterRowAVX2, encodeRowAVX2 };
+#endif
+#ifdef MIP_GENERATOR_SSE
+	case MIP_KERNEL_SSE2:
+		return MipKernelFunctions{ decodeRowSSE2, filterColumnsSSE2, filterRowSSE2, encodeRowSSE2 };
+#endif
+	default:
+		return MipKernelFunctions{ decodeRowScalar, filterColumnsScalar, filterRowScalar, encodeRowScalar };
+	}
+}
+
+const char* mipKernelName(MipKernel kernel) {
+	return KERNEL_NAMES[kernel];
+}
+
+const char* mipFilterName(MipFilter filter) {
+	return FILTER_NAMES[filter];
+}
+
+// Options for color textures
+MipOptions defaultMipOptions(MipFilter filter) {
+	return MipOptions{ filter, true, bestMipKernel() };
+}
+
+// Size of the level below
+int mipLevelSize(int size) {
+	return size > 1 ? size / 2 : 1;
+}
+
+// --------------------------------------------- Filtering ----------------------------------------------------
+
+// Filters destination rows [beginRow, endRow). Source rows are decoded once into a ring with a slot per tap,
+// since the rows one destination row needs are consecutive they never compete for a slot
+static void downsampleRows(const unsigned char* source, int width, int height, int channels, unsigned char* destination, const FilterTaps& taps,
+	bool srgb, const MipKernelFunctions& kernels, int beginRow, int endRow) {
+	int halfWidth = mipLevelSize(width);
+	size_t rowFloats = (size_t)width * 4;
+
+	std::vector<float> decoded(rowFloats * taps.count);
+	int slotRows[MAX_TAPS];
+	std::fill(slotRows, slotRows + MAX_TAPS, -1);
+	std::vector<float> columns(rowFloats + ROW_PADDING * 2 * 4);
+	std::vector<float> filtered((size_t)halfWidth * 4);
+	const float* rows[MAX_TAPS];
+
+	for (int y = beginRow; y < endRow; y++) {
+		// A dimension of 1 isn't halved, its only texel is the center
+		int center = height > 1 ? y * 2 : 0;
+		for (int k = 0; k < taps.count; k++) {
+			int row = std::min(std::max(center + taps.first + k, 0), height - 1);
+			int slot = row % taps.count;
+			if (slotRows[slot] != row) {
+				kernels.decodeRow(source + (size_t)row * width * channels, width, channels, srgb, decoded.data() + slot * rowFloats);
+				slotRows[slot] = row;
+			}
+			rows[k] = decoded.data() + slot * rowFloats;
+		}
+		float* padded = columns.data() + ROW_PADDING * 4;
+		kernels.filterColumns(rows, taps.weights, taps.count, rowFloats, padded);
+
+		// Edge pixels repeat, which is what clamping the taps would do
+		for (int p = 1; p <= ROW_PADDING; p++) {
+			std::copy(padded, padded + 4, padded - p * 4);
+			std::copy(padded + rowFloats - 4, padded + rowFloats, padded + rowFloats + (p - 1) * 4);
+		}
+
+		kernels.filterRow(padded + taps.first * 4, taps.weights, taps.count, halfWidth, filtered.data());
+		kernels.encodeRow(filtered.data(), halfWidth, channels, srgb, destination + (size_t)y * halfWidth * channels);
+	}
+}
+
+// Halves an image into destination
+void downsampleImage(const unsigned char* source, int width, int height, int channels, unsigned char* destination, const MipOptions& options, ThreadPool* pool) {
+	const FilterTaps& taps = options.filter == MIP_FILTER_KAISER ? kaiserTaps() : boxTaps();
+	MipKernelFunctions kernels = kernelFunctions(options.kernel);
+	int halfHeight = mipLevelSize(height);
+
+	auto filterRows = [&](size_t beginRow, size_t endRow) {
+		PROFILE_ZONE("Filter mip rows");
+		downsampleRows(source, width, height, channels, destination, taps, options.srgb, kernels, (int)beginRow, (int)endRow);
+	};
+
+	if (pool && (size_t)halfHeight > MIP_GRAIN_SIZE) {
+		pool->parallelFor(halfHeight, MIP_GRAIN_SIZE, filterRows);
+	}
+	else {
+		filterRows(0, halfHeight);
+	}
+}
+
+// Every level below the given image down to 1x1
+void generateMipChain(const unsigned char* pixels, int width, int height, int channels, const MipOptions& options, std::vector<MipLevel>& levels, ThreadPool* pool) {
+	PROFILE_ZONE("Generate mips");
+	int levelCount = 0;
+	for (int w = width, h = height; w > 1 || h > 1; w = mipLevelSize(w), h = mipLevelSize(h)) {
+		levelCount++;
+	}
+	levels.clear();
+	levels.reserve(levelCount);
+
+	const unsigned char* source = pixels;
+	int sourceWidth = width;
+	int sourceHeight = height;
+	for (int i = 0; i < levelCount; i++) {
+		MipLevel level;
+		level.width = mipLevelSize(sourceWidth);
+		level.height = mipLevelSize(sourceHeight);
+		level.pixels.resize((size_t)level.width * level.height * channels);
+		downsampleImage(source, sourceWidth, sourceHeight, channels, level.pixels.data(), options, pool);
+		levels.push_back(std::move(level));
+
+		source = levels.back().pixels.data();
+		sourceWidth = levels.back().width;
+		sourceHeight = levels.back().height;
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include <cstddef>
+#include <vector>
+
+#include "thread_pool.h"
+
+// Builds mip chains of 8 bit images on the CPU. Every level is made from the one above it by a separable filter
+// run in 32 bit floats, a pass down the columns and then one along the rows, with the pixels widened to four
+// lanes so the same kernels serve one to four channels. With sRGB on, color channels are converted to linear light
+// before filtering and back after, so dark and bright texels average the way they look rather than darkening.
+// Alpha is always filtered as stored.
+
+// How a level is reduced from the one above
+enum MipFilter {
+	// Average of the 2x2 block under each texel, cheap enough to run while streaming
+	MIP_FILTER_BOX = 0,
+	// 8 tap Kaiser windowed sinc, sharper with less aliasing but four times the work, for offline baking
+	MIP_FILTER_KAISER = 1
+};
+
+// Instruction sets the filters are written for. All give bit identical results, only the speed differs
+enum MipKernel {
+	MIP_KERNEL_SCALAR = 0,
+	MIP_KERNEL_SSE2 = 1,
+	MIP_KERNEL_AVX2 = 2
+};
+
+struct MipOptions {
+	MipFilter filter;
+	bool srgb;
+	MipKernel kernel;
+};
+
+// One level below the top of a chain, tightly packed rows
+struct MipLevel {
+	int width;
+	int height;
+	std::vector<unsigned char> pixels;
+};
+
+// Fastest kernel both this build and the CPU running it support
+MipKernel bestMipKernel();
+
+// True when the kernel was compiled in and the CPU can run it
+bool isMipKernelSupported(MipKernel kernel);
+
+// Short names such as "sse2" and "kaiser"
+const char* mipKernelName(MipKernel kernel);
+const char* mipFilterName(MipFilter filter);
+
+// Options for color textures: sRGB with the fastest kernel
+MipOptions defaultMipOptions(MipFilter filter);
+
+// Size of the level below, a dimension that's already 1 stays 1
+int mipLevelSize(int size);
+
+// Halves an image with 1 to 4 channels into destination, which holds mipLevelSize(width) x mipLevelSize(height)
+// pixels. With a pool, bands of rows are filtered in parallel
+void downsampleImage(const unsigned char* source, int width, int height, int channels, unsigned char* destination, const MipOptions& options, ThreadPool* pool = nullptr);
+
+// Replaces levels with every level below the given image down to 1x1
+void generateMipChain(const unsigned char* pixels, int width, int height, int channels, const MipOptions& options, std::vector<MipLevel>& levels, ThreadPool* pool = nullptr);
+
+#endif
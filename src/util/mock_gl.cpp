@@ -0,0 +1,163 @@
+#include "mock_gl.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstring>
+
+// Active uniforms every mock program reports, indexed by location
+static std::vector<std::string> mockUniforms;
+static MockGLCounts counts = { 0, 0, 0, 0 };
+// Names handed out by glCreateShader and glCreateProgram
+static GLuint nextObject = 1;
+
+static GLuint APIENTRY mockCreateShader(GLenum) {
+	counts.other++;
+	return nextObject++;
+}
+
+static GLuint APIENTRY mockCreateProgram() {
+	counts.other++;
+	return nextObject++;
+}
+
+static void APIENTRY mockShaderSource(GLuint, GLsizei, const GLchar* const*, const GLint*) {
+	counts.other++;
+}
+
+// Compiling, attaching, linking and deleting all take a single object
+static void APIENTRY mockObjectCall(GLuint) {
+	counts.other++;
+}
+
+static void APIENTRY mockAttachShader(GLuint, GLuint) {
+	counts.other++;
+}
+
+// Every shader compiles
+static void APIENTRY mockGetShaderiv(GLuint, GLenum, GLint* params) {
+	counts.other++;
+	*params = GL_TRUE;
+}
+
+static void APIENTRY mockGetInfoLog(GLuint, GLsizei bufSize, GLsizei* length, GLchar* infoLog) {
+	counts.other++;
+	if (bufSize > 0) {
+		infoLog[0] = '\0';
+	}
+	if (length) {
+		*length = 0;
+	}
+}
+
+// Every program links and has the mock uniforms active
+static void APIENTRY mockGetProgramiv(GLuint, GLenum pname, GLint* params) {
+	counts.other++;
+	switch (pname) {
+	case GL_ACTIVE_UNIFORMS:
+		*params = (GLint)mockUniforms.size();
+		break;
+	case GL_ACTIVE_UNIFORM_MAX_LENGTH: {
+		size_t longest = 0;
+		for (const std::string& name : mockUniforms) {
+			longest = std::max(longest, name.size());
+		}
+		*params = (GLint)longest + 1;
+		break;
+	}
+	case GL_LINK_STATUS:
+		*params = GL_TRUE;
+		break;
+	default:
+		*params = 0;
+		break;
+	}
+}
+
+static void APIENTRY mockGetActiveUniform(GLuint, GLuint index, GLsizei bufSize, GLsizei* length, GLint* size, GLenum* type, GLchar* name) {
+	counts.other++;
+	const std::string& uniform = mockUniforms[index];
+	GLsizei written = std::min((GLsizei)uniform.size(), bufSize - 1);
+	memcpy(name, uniform.c_str(), written);
+	name[written] = '\0';
+	*length = written;
+	*size = 1;
+	*type = GL_FLOAT;
+}
+
+// Walks the names like a driver without a name table would
+static GLint APIENTRY mockGetUniformLocation(GLuint, const GLchar* name) {
+	counts.getUniformLocation++;
+	for (size_t i = 0; i < mockUniforms.size(); i++) {
+		if (strcmp(mockUniforms[i].c_str(), name) == 0) {
+			return (GLint)i;
+		}
+	}
+	return -1;
+}
+
+static void APIENTRY mockUniform1i(GLint, GLint) {
+	counts.uniform++;
+}
+
+static void APIENTRY mockUniform1f(GLint, GLfloat) {
+	counts.uniform++;
+}
+
+static void APIENTRY mockUniform3f(GLint, GLfloat, GLfloat, GLfloat) {
+	counts.uniform++;
+}
+
+static void APIENTRY mockUniform4f(GLint, GLfloat, GLfloat, GLfloat, GLfloat) {
+	counts.uniform++;
+}
+
+static void APIENTRY mockUniform3fv(GLint, GLsizei, const GLfloat*) {
+	counts.uniform++;
+}
+
+static void APIENTRY mockUniformMatrix4fv(GLint, GLsizei, GLboolean, const GLfloat*) {
+	counts.uniform++;
+}
+
+static void APIENTRY mockUseProgram(GLuint) {
+	counts.useProgram++;
+}
+
+// Swaps the stubs into glad's pointers
+void installMockGL(const std::vector<std::string>& uniforms) {
+	mockUniforms = uniforms;
+	resetMockGLCounts();
+
+	glad_glCreateShader = mockCreateShader;
+	glad_glShaderSource = mockShaderSource;
+	glad_glCompileShader = mockObjectCall;
+	glad_glGetShaderiv = mockGetShaderiv;
+	glad_glGetShaderInfoLog = mockGetInfoLog;
+	glad_glDeleteShader = mockObjectCall;
+	glad_glCreateProgram = mockCreateProgram;
+	glad_glAttachShader = mockAttachShader;
+	glad_glLinkProgram = mockObjectCall;
+	glad_glGetProgramiv = mockGetProgramiv;
+	glad_glGetProgramInfoLog = mockGetInfoLog;
+	glad_glDeleteProgram = mockObjectCall;
+	glad_glGetActiveUniform = mockGetActiveUniform;
+	glad_glGetUniformLocation = mockGetUniformLocation;
+	glad_glUniform1i = mockUniform1i;
+	glad_glUniform1f = mockUniform1f;
+	glad_glUniform3f = mockUniform3f;
+	glad_glUniform4f = mockUniform4f;
+	glad_glUniform3fv = mockUniform3fv;
+	glad_glUniformMatrix4fv = mockUniformMatrix4fv;
+	glad_glUseProgram = mockUseProgram;
+}
+
+// Counts of the calls the stubs have seen
+MockGLCounts& mockGLCounts() {
+	return counts;
+}
+
+// Sets every count back to zero
+void resetMockGLCounts() {
+	counts = MockGLCounts{ 0, 0, 0, 0 };
+}
@@ -0,0 +1,29 @@
+#ifndef MOCK_GL_H
+#define MOCK_GL_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// GL calls made since the mock was installed or the counts were last reset
+struct MockGLCounts {
+	size_t getUniformLocation;
+	size_t uniform;
+	size_t useProgram;
+	// Everything else: compiling, linking and reflection
+	size_t other;
+};
+
+// Points glad's function pointers for shaders, programs and uniforms at stubs that only count the calls, so code
+// built on Shader can be timed without a context. Every program links successfully and reports uniforms as its
+// active uniforms, uniforms[i] at location i; glGetUniformLocation looks names up by comparing strings like a driver
+// without a name table would. Calls outside that set still go to whatever glad loaded, nothing when there's no context
+void installMockGL(const std::vector<std::string>& uniforms);
+
+// Counts of the calls the stubs have seen
+MockGLCounts& mockGLCounts();
+
+// Sets every count back to zero
+void resetMockGLCounts();
+
+#endif
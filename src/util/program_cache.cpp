@@ -0,0 +1,167 @@
+#include "program_cache.h"
+#include "gl_extensions.h"
+#include "mapped_file.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// Layout of the start of every cache file, followed by binaryLength bytes of program binary
+struct ProgramCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t binaryFormat;
+	uint32_t binaryLength;
+	uint64_t checksum;
+};
+
+static const char PROGRAM_CACHE_MAGIC[4] = { 'P', 'B', 'I', 'N' };
+static const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+// 64 bit FNV-1a, chained through the hash argument so several strings can be combined
+static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// Reads a GL string, which may be null on broken contexts
+static std::string getGLString(GLenum name) {
+	const char* value = (const char*)glGetString(name);
+	return value ? value : "";
+}
+
+// Remembers which driver the cache is used with
+ProgramCache::ProgramCache(const std::string& directory) : hits(0), misses(0), directory(directory) {
+	driverID = getGLString(GL_VENDOR) + '\n' + getGLString(GL_RENDERER) + '\n' + getGLString(GL_VERSION);
+}
+
+// True when the driver can hand out program binaries
+bool ProgramCache::isSupported() const {
+	return GLEXT_ARB_get_program_binary;
+}
+
+// Hash identifying a program built from these sources on this driver
+uint64_t ProgramCache::makeKey(const std::string& vertexSource, const std::string& fragmentSource) const {
+	// The separators keep "ab" + "c" from colliding with "a" + "bc"
+	const char separator = '\0';
+	uint64_t key = hashBytes(vertexSource.data(), vertexSource.size());
+	key = hashBytes(&separator, 1, key);
+	key = hashBytes(fragmentSource.data(), fragmentSource.size(), key);
+	key = hashBytes(&separator, 1, key);
+	key = hashBytes(driverID.data(), driverID.size(), key);
+	return key;
+}
+
+// File that holds the entry for a key
+std::string ProgramCache::entryPath(uint64_t key) const {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	return directory + "/" + name;
+}
+
+// Returns a linked program built from the cached binary, or 0 on a miss
+unsigned int ProgramCache::load(const std::string& vertexSource, const std::string& fragmentSource) {
+	if (!isSupported()) {
+		misses++;
+		return 0;
+	}
+
+	uint64_t key = makeKey(vertexSource, fragmentSource);
+	std::string path = entryPath(key);
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		misses++;
+		return 0;
+	}
+
+	// Anything that doesn't look exactly like what we wrote is treated as corrupt
+	ProgramCacheHeader header;
+	std::vector<char> binary;
+	bool valid = (bool)file.read((char*)&header, sizeof(header))
+		&& memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic)) == 0
+		&& header.version == PROGRAM_CACHE_VERSION
+		&& header.key == key
+		&& header.binaryLength > 0;
+	if (valid) {
+		binary.resize(header.binaryLength);
+		valid = (bool)file.read(binary.data(), binary.size()) && hashBytes(binary.data(), binary.size()) == header.checksum;
+	}
+	file.close();
+
+	unsigned int program = 0;
+	if (valid) {
+		program = glCreateProgram();
+		glProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+
+		// The driver reports a failed link when it no longer accepts the binary's format
+		int linked = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if (!linked) {
+			glDeleteProgram(program);
+			program = 0;
+		}
+	}
+
+	if (program == 0) {
+		// Drop the stale entry, a fresh one gets stored once the program is compiled from source
+		std::error_code error;
+		std::filesystem::remove(path, error);
+		misses++;
+		return 0;
+	}
+
+	hits++;
+	return program;
+}
+
+// Marks a program as retrievable, must be called before glLinkProgram
+void ProgramCache::prepare(unsigned int program) const {
+	if (isSupported()) {
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+}
+
+// Saves the binary of a successfully linked program
+void ProgramCache::store(const std::string& vertexSource, const std::string& fragmentSource, unsigned int program) {
+	if (!isSupported()) {
+		return;
+	}
+
+	int binaryLength = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+	if (binaryLength <= 0) {
+		return;
+	}
+
+	ProgramCacheHeader header;
+	std::vector<char> binary(binaryLength);
+	GLsizei writtenLength = 0;
+	glGetProgramBinary(program, binaryLength, &writtenLength, &header.binaryFormat, binary.data());
+	if (writtenLength <= 0) {
+		return;
+	}
+	binary.resize(writtenLength);
+
+	memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+	header.version = PROGRAM_CACHE_VERSION;
+	header.key = makeKey(vertexSource, fragmentSource);
+	header.binaryLength = (uint32_t)binary.size();
+	header.checksum = hashBytes(binary.data(), binary.size());
+
+	// One buffer so the entry goes through a single temporary file and rename
+	std::vector<char> file(sizeof(header) + binary.size());
+	memcpy(file.data(), &header, sizeof(header));
+	memcpy(file.data() + sizeof(header), binary.data(), binary.size());
+	std::string path = entryPath(header.key);
+	if (!writeFileAtomically(path, file.data(), file.size())) {
+		std::cout << "WARNING::PROGRAM_CACHE::CANNOT_WRITE " << path << std::endl;
+	}
+}
\ No newline at end of file
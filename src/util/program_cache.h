@@ -0,0 +1,46 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+
+// On disk cache of linked program binaries, so shaders only get compiled on the first launch
+// or after the sources or driver change. Entries are keyed by a hash of both sources and the
+// GL vendor, renderer and version strings.
+class ProgramCache {
+public:
+	// Number of programs created from the cache and compiled from source since startup
+	int hits;
+	int misses;
+
+	// Binaries are stored in directory, which is created on the first store
+	ProgramCache(const std::string& directory);
+
+	// True when the driver can hand out program binaries
+	bool isSupported() const;
+
+	// Returns a linked program built from the cached binary for these sources, or 0 when there is
+	// no entry or the driver rejects it (format mismatch after an update, corrupted file)
+	unsigned int load(const std::string& vertexSource, const std::string& fragmentSource);
+
+	// Marks a program as retrievable, must be called before glLinkProgram
+	void prepare(unsigned int program) const;
+
+	// Saves the binary of a successfully linked program
+	void store(const std::string& vertexSource, const std::string& fragmentSource, unsigned int program);
+
+private:
+	std::string directory;
+	// Vendor, renderer and version strings of the context the cache was opened with
+	std::string driverID;
+
+	// Hash identifying a program built from these sources on this driver
+	uint64_t makeKey(const std::string& vertexSource, const std::string& fragmentSource) const;
+
+	// File that holds the entry for a key
+	std::string entryPath(uint64_t key) const;
+};
+
+#endif
\ No newline at end of file
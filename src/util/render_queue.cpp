@@ -0,0 +1,340 @@
+#include "render_queue.h"
+#include "gl_state_cache.h"
+#include "cpu_profiler.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+// Bit positions of the key fields for opaque and overlay draws
+static const int PASS_SHIFT = 62;
+static const int PROGRAM_SHIFT = 54;
+static const int MATERIAL_SHIFT = 42;
+static const int GEOMETRY_SHIFT = 30;
+static const int DEPTH_SHIFT = 6;
+
+// Bit positions for transparent draws, where depth moves up to right below the pass
+static const int BLENDED_DEPTH_SHIFT = 38;
+static const int BLENDED_PROGRAM_SHIFT = 30;
+static const int BLENDED_MATERIAL_SHIFT = 18;
+static const int BLENDED_GEOMETRY_SHIFT = 6;
+
+static const uint32_t DEPTH_MAX = (1u << 24) - 1;
+
+// Fewest draws worth handing to a thread of their own when recording commands
+static const size_t MIN_RECORD_SLICE = 2048;
+
+RenderQueue::RenderQueue() : view(1.0f), depthScale(0.0f), frameStats() {
+}
+
+// Registers a material and returns its handle
+int RenderQueue::addMaterial(const Material& material) {
+	int program = -1;
+	for (size_t i = 0; i < programs.size(); i++) {
+		if (programs[i] == material.shader) {
+			program = (int)i;
+		}
+	}
+	// Handles past the limits wouldn't fit their fields of the sort key
+	if (materials.size() >= (size_t)MAX_MATERIALS || (program < 0 && programs.size() >= (size_t)MAX_PROGRAMS)) {
+		std::cout << "WARNING::RENDER_QUEUE::TOO_MANY_" << (program < 0 && programs.size() >= (size_t)MAX_PROGRAMS ? "PROGRAMS" : "MATERIALS") << std::endl;
+		return -1;
+	}
+	if (program < 0) {
+		program = (int)programs.size();
+		programs.push_back(material.shader);
+	}
+
+	materials.push_back(material);
+	materialPrograms.push_back(program);
+	return (int)materials.size() - 1;
+}
+
+// Registers a piece of geometry and returns its handle
+int RenderQueue::addGeometry(const Geometry& newGeometry) {
+	if (geometry.size() >= (size_t)MAX_GEOMETRY) {
+		std::cout << "WARNING::RENDER_QUEUE::TOO_MANY_GEOMETRY" << std::endl;
+		return -1;
+	}
+	geometry.push_back(newGeometry);
+	return (int)geometry.size() - 1;
+}
+
+// Points a registered handle at different geometry
+void RenderQueue::updateGeometry(int handle, const Geometry& newGeometry) {
+	geometry[handle] = newGeometry;
+}
+
+// A registered material, for changing its textures or color between frames
+Material& RenderQueue::material(int handle) {
+	return materials[handle];
+}
+
+int RenderQueue::materialCount() const {
+	return (int)materials.size();
+}
+
+// Starts a new frame
+void RenderQueue::begin(const glm::mat4& newView, float farPlane) {
+	view = newView;
+	depthScale = farPlane > 0.0f ? DEPTH_MAX / farPlane : 0.0f;
+	draws.clear();
+	items.clear();
+	frameStats.sortMicroseconds = 0.0;
+}
+
+// Sort key of a draw
+uint64_t RenderQueue::makeKey(int material, int geometryHandle, const glm::mat4& model, Pass pass) const {
+	// Distance of the draw's origin along the view direction, clamped into the 24 bit depth field
+	float viewDepth = -(view[0][2] * model[3][0] + view[1][2] * model[3][1] + view[2][2] * model[3][2] + view[3][2]);
+	float scaled = viewDepth * depthScale;
+	uint32_t depth = scaled <= 0.0f ? 0 : scaled >= (float)DEPTH_MAX ? DEPTH_MAX : (uint32_t)scaled;
+	if (pass == TRANSPARENT_PASS) {
+		depth = DEPTH_MAX - depth;
+	}
+
+	uint64_t key = (uint64_t)pass << PASS_SHIFT;
+	if (pass == TRANSPARENT_PASS) {
+		// Blended draws must stay in depth order, so for them depth outranks everything but the pass
+		key |= ((uint64_t)depth << BLENDED_DEPTH_SHIFT)
+			| ((uint64_t)materialPrograms[material] << BLENDED_PROGRAM_SHIFT)
+			| ((uint64_t)material << BLENDED_MATERIAL_SHIFT)
+			| ((uint64_t)geometryHandle << BLENDED_GEOMETRY_SHIFT);
+	}
+	else {
+		key |= ((uint64_t)materialPrograms[material] << PROGRAM_SHIFT)
+			| ((uint64_t)material << MATERIAL_SHIFT)
+			| ((uint64_t)geometryHandle << GEOMETRY_SHIFT)
+			| ((uint64_t)depth << DEPTH_SHIFT);
+	}
+	return key;
+}
+
+// Records a draw
+void RenderQueue::submit(int material, int geometryHandle, const glm::mat4& model, Pass pass, int instanceCount) {
+	items.push_back(SortItem{ makeKey(material, geometryHandle, model, pass), (uint32_t)draws.size() });
+	draws.push_back(Draw{ model, material, geometryHandle, instanceCount });
+}
+
+// Makes room for count draws and returns the slot of the first one
+size_t RenderQueue::allocate(size_t count) {
+	size_t first = draws.size();
+	items.resize(first + count);
+	draws.resize(first + count);
+	return first;
+}
+
+// Records a draw into a slot returned by allocate
+void RenderQueue::submitAt(size_t slot, int material, int geometryHandle, const glm::mat4& model, Pass pass, int instanceCount) {
+	items[slot] = SortItem{ makeKey(material, geometryHandle, model, pass), (uint32_t)slot };
+	draws[slot] = Draw{ model, material, geometryHandle, instanceCount };
+}
+
+// Radix sorts the recorded draws by key
+void RenderQueue::sort() {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	size_t count = items.size();
+	if (count < 2) {
+		return;
+	}
+	sortBuffer.resize(count);
+
+	// One histogram per key byte, all built in a single pass over the keys
+	uint32_t histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (size_t i = 0; i < count; i++) {
+		uint64_t key = items[i].key;
+		for (int byte = 0; byte < 8; byte++) {
+			histograms[byte][(key >> (byte * 8)) & 0xFF]++;
+		}
+	}
+
+	// Least significant byte first, each pass is stable so earlier passes break ties of later ones
+	SortItem* source = items.data();
+	SortItem* destination = sortBuffer.data();
+	for (int byte = 0; byte < 8; byte++) {
+		uint32_t* histogram = histograms[byte];
+
+		// A byte every key shares doesn't change the order, which skips the unused and usually the pass bits
+		if (histogram[(source[0].key >> (byte * 8)) & 0xFF] == count) {
+			continue;
+		}
+
+		uint32_t offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++) {
+			uint32_t bucketCount = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketCount;
+		}
+		for (size_t i = 0; i < count; i++) {
+			destination[histogram[(source[i].key >> (byte * 8)) & 0xFF]++] = source[i];
+		}
+		SortItem* swap = source;
+		source = destination;
+		destination = swap;
+	}
+	if (source != items.data()) {
+		items.swap(sortBuffer);
+	}
+
+	frameStats.sortMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Issues the recorded draws in their current order
+void RenderQueue::execute(ThreadPool* pool) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// One slice per thread, unless that would leave the threads too little to do
+	size_t sliceCount = 1;
+	if (pool) {
+		size_t threadCount = pool->concurrency();
+		sliceCount = (items.size() + MIN_RECORD_SLICE - 1) / MIN_RECORD_SLICE;
+		sliceCount = sliceCount > threadCount ? threadCount : sliceCount < 1 ? 1 : sliceCount;
+	}
+	while (commandBuffers.size() < sliceCount) {
+		commandBuffers.emplace_back(new CommandBuffer());
+	}
+
+	size_t sliceSize = (items.size() + sliceCount - 1) / sliceCount;
+	auto recordSlices = [this, sliceSize](size_t firstSlice, size_t lastSlice) {
+		for (size_t slice = firstSlice; slice < lastSlice; slice++) {
+			size_t begin = slice * sliceSize < items.size() ? slice * sliceSize : items.size();
+			size_t end = begin + sliceSize < items.size() ? begin + sliceSize : items.size();
+			record(begin, end, *commandBuffers[slice]);
+		}
+	};
+	if (sliceCount > 1) {
+		pool->parallelFor(sliceCount, 1, recordSlices);
+	}
+	else {
+		recordSlices(0, 1);
+	}
+	std::chrono::steady_clock::time_point recorded = std::chrono::steady_clock::now();
+
+	frameStats.draws = (int)items.size();
+	frameStats.programChanges = 0;
+	frameStats.materialChanges = 0;
+	frameStats.geometryChanges = 0;
+	frameStats.recordSlices = (int)sliceCount;
+	frameStats.commandBytes = 0;
+
+	// Slices are contiguous runs of the sorted draws, so replaying them in order issues the draws in sorted order
+	for (size_t slice = 0; slice < sliceCount; slice++) {
+		replay(*commandBuffers[slice]);
+		frameStats.commandBytes += commandBuffers[slice]->bytes();
+	}
+
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+	frameStats.recordMicroseconds = std::chrono::duration<double, std::micro>(recorded - start).count();
+	frameStats.replayMicroseconds = std::chrono::duration<double, std::micro>(end - recorded).count();
+	frameStats.executeMicroseconds = std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+// Records the draws of items [begin, end) as commands
+void RenderQueue::record(size_t begin, size_t end, CommandBuffer& commands) const {
+	PROFILE_ZONE("Record commands");
+	commands.reset();
+
+	// Each slice starts from unknown state, so its first draw sets everything it needs
+	int currentProgram = -1;
+	int currentMaterial = -1;
+	int currentGeometry = -1;
+	for (size_t i = begin; i < end; i++) {
+		const Draw& draw = draws[items[i].payload];
+
+		if (draw.material != currentMaterial) {
+			int program = materialPrograms[draw.material];
+			if (program != currentProgram) {
+				commands.push<ProgramCommand>(COMMAND_PROGRAM)->program = program;
+				currentProgram = program;
+			}
+			commands.push<MaterialCommand>(COMMAND_MATERIAL)->material = draw.material;
+			currentMaterial = draw.material;
+		}
+
+		if (draw.geometry != currentGeometry) {
+			commands.push<GeometryCommand>(COMMAND_GEOMETRY)->geometry = draw.geometry;
+			currentGeometry = draw.geometry;
+		}
+
+		if (materials[draw.material].modelLocation >= 0) {
+			memcpy(commands.push<ModelCommand>(COMMAND_MODEL)->model, &draw.model[0][0], sizeof(float) * 16);
+		}
+
+		commands.push<DrawCommand>(COMMAND_DRAW)->instanceCount = draw.instanceCount;
+	}
+}
+
+// Makes the GL calls for a recorded buffer
+void RenderQueue::replay(const CommandBuffer& commands) {
+	GLStateCache& state = GLStateCache::current();
+	const Material* material = nullptr;
+	const Geometry* drawGeometry = nullptr;
+
+	commands.forEach([&](const CommandHeader& header) {
+		switch (header.type) {
+		case COMMAND_PROGRAM:
+			programs[((const ProgramCommand&)header).program]->use();
+			frameStats.programChanges++;
+			break;
+
+		case COMMAND_MATERIAL:
+			material = &materials[((const MaterialCommand&)header).material];
+			for (unsigned int unit = 0; unit < 2; unit++) {
+				if (material->textures[unit] != 0) {
+					state.bindTexture(unit, GL_TEXTURE_2D, material->textures[unit]);
+				}
+			}
+			if (material->colorLocation >= 0) {
+				material->shader->setFloat3fv(material->colorLocation, material->color);
+			}
+			frameStats.materialChanges++;
+			break;
+
+		case COMMAND_GEOMETRY:
+			drawGeometry = &geometry[((const GeometryCommand&)header).geometry];
+			state.bindVertexArray(drawGeometry->VAO);
+			frameStats.geometryChanges++;
+			break;
+
+		case COMMAND_MODEL: {
+			// Through the shader, which drops uploads of a matrix it already holds
+			glm::mat4 model;
+			memcpy(&model[0][0], ((const ModelCommand&)header).model, sizeof(float) * 16);
+			material->shader->setMatrixTransform4fv(material->modelLocation, model);
+			break;
+		}
+
+		case COMMAND_DRAW: {
+			int instanceCount = ((const DrawCommand&)header).instanceCount;
+			if (drawGeometry->indexType != GL_NONE) {
+				if (instanceCount > 0) {
+					glDrawElementsInstanced(GL_TRIANGLES, drawGeometry->count, drawGeometry->indexType, (void*)0, instanceCount);
+				}
+				else {
+					glDrawElements(GL_TRIANGLES, drawGeometry->count, drawGeometry->indexType, (void*)0);
+				}
+			}
+			else {
+				if (instanceCount > 0) {
+					glDrawArraysInstanced(GL_TRIANGLES, 0, drawGeometry->count, instanceCount);
+				}
+				else {
+					glDrawArrays(GL_TRIANGLES, 0, drawGeometry->count);
+				}
+			}
+			break;
+		}
+		}
+	});
+}
+
+// Number of draws recorded since begin
+size_t RenderQueue::size() const {
+	return items.size();
+}
+
+const RenderQueueStats& RenderQueue::stats() const {
+	return frameStats;
+}
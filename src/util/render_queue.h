@@ -0,0 +1,158 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "shader.h"
+#include "command_buffer.h"
+#include "thread_pool.h"
+
+// How a draw is shaded: the program, the textures bound to units 0 and 1 and the uniforms the queue sets per draw
+struct Material {
+	Shader* shader;
+	// Bound to texture units 0 and 1, 0 leaves the unit alone
+	unsigned int textures[2];
+	// Per material color, skipped when the location is -1
+	int colorLocation;
+	glm::vec3 color;
+	// Per draw model matrix, skipped when the location is -1
+	int modelLocation;
+};
+
+// What a draw renders: a VAO and how many indices (or vertices when indexType is GL_NONE) to draw from it
+struct Geometry {
+	unsigned int VAO;
+	GLenum indexType;
+	int count;
+};
+
+// Draws submitted, state switches made while executing them and where the CPU time went, for the last frame
+struct RenderQueueStats {
+	int draws;
+	int programChanges;
+	int materialChanges;
+	int geometryChanges;
+	double sortMicroseconds;
+	// Recording the sorted draws as commands plus replaying them, the two parts below
+	double executeMicroseconds;
+	double recordMicroseconds;
+	double replayMicroseconds;
+	// Command buffers recorded in parallel and the bytes of commands in all of them
+	int recordSlices;
+	size_t commandBytes;
+};
+
+// Collects a frame's draws as 64 bit sort keys and executes them in key order, so draws sharing a program,
+// material and VAO end up next to each other and the state between them is only set once.
+//
+// Key layout, most significant first:
+//	opaque and overlay:	pass (2 bits) | program (8) | material (12) | geometry (12) | depth (24) | unused (6)
+//	transparent:		pass (2 bits) | inverted depth (24) | program (8) | material (12) | geometry (12) | unused (6)
+//
+// Opaque draws sort front to back within a material so early depth testing rejects more fragments,
+// transparent ones back to front across all materials so they blend correctly. Materials and geometry are registered up front
+// so the key holds small dense indices instead of GL names.
+//
+// Executing turns the sorted draws into plain data commands, split into contiguous slices that worker threads record
+// into command buffers of their own, and then replays the buffers in order on the thread that owns the GL context.
+class RenderQueue {
+public:
+	enum Pass {
+		OPAQUE_PASS = 0,
+		TRANSPARENT_PASS = 1,
+		OVERLAY_PASS = 2
+	};
+
+	static const int MAX_PROGRAMS = 1 << 8;
+	static const int MAX_MATERIALS = 1 << 12;
+	static const int MAX_GEOMETRY = 1 << 12;
+
+	RenderQueue();
+
+	// Registers a material and returns its handle, materials sharing a shader share a program index.
+	// Returns -1 once MAX_MATERIALS materials or MAX_PROGRAMS shaders are registered
+	int addMaterial(const Material& material);
+
+	// Registers a piece of geometry and returns its handle, -1 once MAX_GEOMETRY pieces are registered
+	int addGeometry(const Geometry& geometry);
+
+	// Points a registered handle at different geometry, for replacing a mesh without using up another handle
+	void updateGeometry(int handle, const Geometry& geometry);
+
+	// A registered material, for changing its textures or color between frames. The shader can't change
+	Material& material(int handle);
+	int materialCount() const;
+
+	// Starts a new frame, depths are measured along the view direction and quantized over [0, farPlane]
+	void begin(const glm::mat4& view, float farPlane);
+
+	// Records a draw, instanceCount 0 draws without instancing
+	void submit(int material, int geometry, const glm::mat4& model, Pass pass = OPAQUE_PASS, int instanceCount = 0);
+
+	// Makes room for count draws and returns the slot of the first one. Threads can then fill distinct slots
+	// with submitAt at the same time, the draws keep slot order as if they had been submitted one by one
+	size_t allocate(size_t count);
+	void submitAt(size_t slot, int material, int geometry, const glm::mat4& model, Pass pass = OPAQUE_PASS, int instanceCount = 0);
+
+	// Radix sorts the recorded draws by key, without it execute draws in submission order
+	void sort();
+
+	// Issues the recorded draws in their current order. With a pool the commands are recorded on its threads,
+	// the GL calls are always made on the calling thread
+	void execute(ThreadPool* pool = nullptr);
+
+	// Number of draws recorded since begin
+	size_t size() const;
+
+	const RenderQueueStats& stats() const;
+
+private:
+	// What the queue sorts: the key and the index of the draw it belongs to
+	struct SortItem {
+		uint64_t key;
+		uint32_t payload;
+	};
+
+	// Everything needed to issue a draw once its turn comes
+	struct Draw {
+		glm::mat4 model;
+		int material;
+		int geometry;
+		int instanceCount;
+	};
+
+	std::vector<Material> materials;
+	std::vector<int> materialPrograms;
+	std::vector<Shader*> programs;
+	std::vector<Geometry> geometry;
+
+	std::vector<Draw> draws;
+	std::vector<SortItem> items;
+	// Scratch space the radix sort ping pongs with
+	std::vector<SortItem> sortBuffer;
+
+	// One per slice of the last execute, reused every frame
+	std::vector<std::unique_ptr<CommandBuffer>> commandBuffers;
+
+	glm::mat4 view;
+	float depthScale;
+
+	RenderQueueStats frameStats;
+
+	// Sort key of a draw
+	uint64_t makeKey(int material, int geometry, const glm::mat4& model, Pass pass) const;
+
+	// Records the draws of items [begin, end) as commands, setting all state the first of them needs
+	void record(size_t begin, size_t end, CommandBuffer& commands) const;
+
+	// Makes the GL calls for a recorded buffer
+	void replay(const CommandBuffer& commands);
+};
+
+#endif
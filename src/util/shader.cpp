@@ -1,47 +1,99 @@
 #include "shader.h"
+#include "gl_extensions.h"
+#include "shader_preprocessor.h"
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
+#include <algorithm>
+#include <cstring>
+
+// FNV-1a hash used to index the uniform table
+static unsigned int hashUniformName(const char* name) {
+	unsigned int hash = 2166136261u;
+	while (*name) {
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, ProgramCache* cache) : Shader(vertexPath, fragmentPath, std::vector<std::string>(), cache) {
+}
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines, ProgramCache* cache) : vertexPath(vertexPath), fragmentPath(fragmentPath), defines(defines), cache(cache), reload{ 0, 0, 0, std::string(), std::string() } {
 
 	std::string vertexSourceCode;
 	std::string fragmentSourceCode;
-	std::ifstream vertexShaderFile;
-	std::ifstream fragmentShaderFile;
+	readSources(vertexSourceCode, fragmentSourceCode);
 
-	// Ensure ifstream objects can throw exceptions
-	vertexShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	fragmentShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+	// Reuse the binary linked on an earlier launch when there is one, otherwise build from source
+	ID = 0;
+	if (cache) {
+		ID = cache->load(vertexSourceCode, fragmentSourceCode);
+	}
+	if (ID == 0) {
+		compileProgram(vertexSourceCode, fragmentSourceCode, cache);
+	}
 
-	try {
-		// Open files
-		vertexShaderFile.open(vertexPath);
-		fragmentShaderFile.open(fragmentPath);
+	// Cache uniform locations so setting them never has to ask the driver
+	reflectUniforms();
+}
 
-		std::stringstream vertexShaderStream;
-		std::stringstream fragmentShaderStream;
+// Reads and preprocesses both source files
+bool Shader::readSources(std::string& vertexSourceCode, std::string& fragmentSourceCode) {
+	std::vector<std::string> fragmentFiles;
+	bool read = preprocessShaderSource(vertexPath, defines, vertexSourceCode, sourceFiles);
+	read = preprocessShaderSource(fragmentPath, defines, fragmentSourceCode, fragmentFiles) && read;
 
-		// Read file's buffer content into streams
-		vertexShaderStream << vertexShaderFile.rdbuf();
-		fragmentShaderStream << fragmentShaderFile.rdbuf();
+	// Both stages usually include the same headers
+	for (const std::string& file : fragmentFiles) {
+		if (std::find(sourceFiles.begin(), sourceFiles.end(), file) == sourceFiles.end()) {
+			sourceFiles.push_back(file);
+		}
+	}
+	return read;
+}
 
-		// Close file handlers
-		vertexShaderFile.close();
-		fragmentShaderFile.close();
+// Compiles and links the program from source, storing the result in the cache if one is given
+void Shader::compileProgram(const std::string& vertexSourceCode, const std::string& fragmentSourceCode, ProgramCache* cache) {
+	PendingProgram pending = startProgram(vertexSourceCode, fragmentSourceCode, cache);
+	finishProgram(pending, cache);
+	ID = pending.program;
+}
 
-		// Convert streams into code
-		vertexSourceCode = vertexShaderStream.str();
-		fragmentSourceCode = fragmentShaderStream.str();
-	}
-	catch (std::ifstream::failure e) {
-		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
-	}
+// Issues the compile and link without asking for their results
+Shader::PendingProgram Shader::startProgram(const std::string& vertexSourceCode, const std::string& fragmentSourceCode, ProgramCache* cache) const {
+	PendingProgram pending = { 0, 0, 0, vertexSourceCode, fragmentSourceCode };
 
 	// Convert the source code into char arrays
-	const char* vertexCode = vertexSourceCode.c_str();
-	const char* fragmentCode = fragmentSourceCode.c_str();
+	const char* vertexCode = pending.vertexSourceCode.c_str();
+	const char* fragmentCode = pending.fragmentSourceCode.c_str();
+
+	// Compile vertex shader
+	pending.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(pending.vertexShader, 1, &vertexCode, NULL);
+	glCompileShader(pending.vertexShader);
 
-	// Compile shaders and check for errors
-	unsigned int vertexShader;
-	unsigned int fragmentShader;
+	// Compile fragment shader
+	pending.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(pending.fragmentShader, 1, &fragmentCode, NULL);
+	glCompileShader(pending.fragmentShader);
+
+	// Create shader program, linking right away lets the driver finish both compiles and the link in one go
+	pending.program = glCreateProgram();
+	glAttachShader(pending.program, pending.vertexShader);
+	glAttachShader(pending.program, pending.fragmentShader);
+	if (cache) {
+		cache->prepare(pending.program);
+	}
+	glLinkProgram(pending.program);
+	return pending;
+}
+
+// Checks and logs the compile and link results
+bool Shader::finishProgram(PendingProgram& pending, ProgramCache* cache) const {
+	// Loaded from the cache, already linked
+	if (pending.vertexShader == 0) {
+		return true;
+	}
 
 	int vertexSuccess;
 	char vertexInfoLog[512];
@@ -49,75 +101,315 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) {
 	int fragmentSuccess;
 	char fragmentInfoLog[512];
 
-	// Compile vertex shader
-	vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &vertexCode, NULL);
-	glCompileShader(vertexShader);
 	// Check for vertex shader compilation errors
-	glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &vertexSuccess);
-
+	glGetShaderiv(pending.vertexShader, GL_COMPILE_STATUS, &vertexSuccess);
 	if (!vertexSuccess) {
-		glGetShaderInfoLog(vertexShader, 512, NULL, vertexInfoLog);
+		glGetShaderInfoLog(pending.vertexShader, 512, NULL, vertexInfoLog);
 		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << vertexInfoLog << std::endl;
 	}
 
-
-	// Compile fragment shader
-	fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &fragmentCode, NULL);
-	glCompileShader(fragmentShader);
 	// Check for fragment shader compilation errors
-	glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &fragmentSuccess);
+	glGetShaderiv(pending.fragmentShader, GL_COMPILE_STATUS, &fragmentSuccess);
 	if (!fragmentSuccess) {
-		glGetShaderInfoLog(fragmentShader, 512, NULL, fragmentInfoLog);
+		glGetShaderInfoLog(pending.fragmentShader, 512, NULL, fragmentInfoLog);
 		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << fragmentInfoLog << std::endl;
 	}
 
 	int shaderSuccess;
 	char shaderInfoLog[512];
-	// Create shader program
-	ID = glCreateProgram();
-	glAttachShader(ID, vertexShader);
-	glAttachShader(ID, fragmentShader);
-	glLinkProgram(ID);
 
 	// Check for shader program errors
-	glGetProgramiv(ID, GL_LINK_STATUS, &shaderSuccess);
+	glGetProgramiv(pending.program, GL_LINK_STATUS, &shaderSuccess);
 	if (!shaderSuccess) {
-		glGetProgramInfoLog(ID, 512, NULL, shaderInfoLog);
+		glGetProgramInfoLog(pending.program, 512, NULL, shaderInfoLog);
 		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << shaderInfoLog << std::endl;
-	};
+	}
+	else if (cache) {
+		cache->store(pending.vertexSourceCode, pending.fragmentSourceCode, pending.program);
+	}
 
 
 	// Cleanup
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	glDeleteShader(pending.vertexShader);
+	glDeleteShader(pending.fragmentShader);
+	pending.vertexShader = 0;
+	pending.fragmentShader = 0;
+	return shaderSuccess != 0;
+}
+
+// Starts rebuilding the program from the source files again
+void Shader::beginReload(bool useCache) {
+	// A reload still in flight is superseded, its sources are already out of date
+	if (reload.program != 0) {
+		if (reload.vertexShader != 0) {
+			glDeleteShader(reload.vertexShader);
+			glDeleteShader(reload.fragmentShader);
+		}
+		glDeleteProgram(reload.program);
+		reload.program = 0;
+	}
+
+	std::string vertexSourceCode;
+	std::string fragmentSourceCode;
+	if (!readSources(vertexSourceCode, fragmentSourceCode)) {
+		return;
+	}
+
+	// Reverting an edit finds the earlier binary in the cache
+	unsigned int cached = useCache && cache ? cache->load(vertexSourceCode, fragmentSourceCode) : 0;
+	if (cached != 0) {
+		reload = PendingProgram{ cached, 0, 0, vertexSourceCode, fragmentSourceCode };
+		return;
+	}
+	reload = startProgram(vertexSourceCode, fragmentSourceCode, cache);
+}
+
+// Checks on the rebuild started by beginReload
+Shader::ReloadStatus Shader::pollReload(bool wait) {
+	if (reload.program == 0) {
+		return RELOAD_IDLE;
+	}
+
+	// Any other query on the program would wait for the compile and link to finish
+	if (!wait && reload.vertexShader != 0 && GLEXT_KHR_parallel_shader_compile) {
+		int complete = 0;
+		glGetProgramiv(reload.program, GL_COMPLETION_STATUS_KHR, &complete);
+		if (!complete) {
+			return RELOAD_PENDING;
+		}
+	}
+
+	bool linked = finishProgram(reload, cache);
+	unsigned int program = reload.program;
+	reload.program = 0;
+	if (!linked) {
+		glDeleteProgram(program);
+		return RELOAD_FAILED;
+	}
+
+	// Swapped between frames on the render thread, so no draw ever sees a half built program
+	GLStateCache::current().forgetProgram(ID);
+	glDeleteProgram(ID);
+	ID = program;
+	reflectUniforms();
+	return RELOAD_SWAPPED;
+}
+
+// True between beginReload and the poll that finishes it
+bool Shader::isReloading() const {
+	return reload.program != 0;
+}
+
+// True if the program is built from the file at path
+bool Shader::usesFile(const std::string& path) const {
+	return std::find(sourceFiles.begin(), sourceFiles.end(), path) != sourceFiles.end();
+}
+
+// Every file the program was built from
+const std::vector<std::string>& Shader::files() const {
+	return sourceFiles;
+}
+
+// Queries all active uniforms of the linked program and fills the uniform table
+void Shader::reflectUniforms() {
+	int uniformCount = 0;
+	int maxNameLength = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	// Keep the table at most half full so probe sequences stay short, arrays may add a second entry
+	size_t tableSize = 8;
+	while (tableSize < (size_t)uniformCount * 4) {
+		tableSize *= 2;
+	}
+	uniformTable.assign(tableSize, UniformSlot{ 0, -1, std::string() });
+
+	std::vector<char> nameBuffer(maxNameLength > 0 ? maxNameLength : 1);
+	int maxLocation = -1;
+	for (int i = 0; i < uniformCount; i++) {
+		int size;
+		GLenum type;
+		GLsizei length;
+		glGetActiveUniform(ID, i, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+
+		std::string name(nameBuffer.data(), length);
+		int location = glGetUniformLocation(ID, name.c_str());
+
+		// Members of uniform blocks have no location
+		if (location < 0) {
+			continue;
+		}
+		insertUniform(name, location);
+		if (location > maxLocation) {
+			maxLocation = location;
+		}
+
+		// Arrays are reported as "name[0]", also allow looking them up by their plain name
+		size_t bracket = name.find('[');
+		if (bracket != std::string::npos) {
+			insertUniform(name.substr(0, bracket), location);
+		}
+	}
+
+	// Nothing has been sent to the freshly linked program yet
+	uniformValues.assign((size_t)(maxLocation + 1) * UNIFORM_SHADOW_FLOATS, 0.0f);
+	uniformValueSet.assign((size_t)(maxLocation + 1), 0);
+}
+
+// Inserts a single uniform name into the uniform table
+void Shader::insertUniform(const std::string& name, int location) {
+	unsigned int hash = hashUniformName(name.c_str());
+	size_t mask = uniformTable.size() - 1;
+	size_t slot = hash & mask;
+	while (uniformTable[slot].location >= 0) {
+		if (uniformTable[slot].hash == hash && uniformTable[slot].name == name) {
+			return;
+		}
+		slot = (slot + 1) & mask;
+	}
+	uniformTable[slot] = UniformSlot{ hash, location, name };
+}
+
+// Returns the location of an active uniform from the uniform table, or -1 if it is not active
+int Shader::getUniformLocation(const std::string& name) const {
+	return getUniformLocation(name.c_str());
+}
+
+// Same lookup straight from the characters, comparing against the stored name allocates nothing
+int Shader::getUniformLocation(const char* name) const {
+	if (uniformTable.empty()) {
+		return -1;
+	}
+	unsigned int hash = hashUniformName(name);
+	size_t mask = uniformTable.size() - 1;
+	size_t slot = hash & mask;
+	while (uniformTable[slot].location >= 0) {
+		if (uniformTable[slot].hash == hash && uniformTable[slot].name == name) {
+			return uniformTable[slot].location;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return -1;
+}
+
+// Points the named uniform block at a uniform buffer binding point
+bool Shader::bindUniformBlock(const std::string& name, unsigned int binding) {
+	unsigned int blockIndex = glGetUniformBlockIndex(ID, name.c_str());
+	if (blockIndex == GL_INVALID_INDEX) {
+		return false;
+	}
+	glUniformBlockBinding(ID, blockIndex, binding);
+	return true;
+}
+
+// Compares a value with the one last sent to the location and remembers it
+bool Shader::uniformChanged(int location, const void* value, size_t size) const {
+	// Inactive uniforms are ignored by GL anyway
+	if (location < 0) {
+		GLStateCache::current().countUniform(true);
+		return false;
+	}
+	// Locations the reflection didn't see (array elements past the first) aren't shadowed
+	if ((size_t)location >= uniformValueSet.size()) {
+		GLStateCache::current().countUniform(false);
+		return true;
+	}
+
+	float* shadow = &uniformValues[(size_t)location * UNIFORM_SHADOW_FLOATS];
+	if (uniformValueSet[location] && memcmp(shadow, value, size) == 0) {
+		GLStateCache::current().countUniform(true);
+		return false;
+	}
+	memcpy(shadow, value, size);
+	uniformValueSet[location] = 1;
+	GLStateCache::current().countUniform(false);
+	return true;
 }
 
 // Activate the shader
 void Shader::use() {
-	glUseProgram(ID);
+	GLStateCache::current().useProgram(ID);
 }
 
 // Used to query a uniform location and set it's value
 void Shader::setBool(const std::string& name, bool value) const {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	setBool(getUniformLocation(name), value);
 }
 void Shader::setInt(const std::string& name, int value) const {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	setInt(getUniformLocation(name), value);
 }
 void Shader::setFloat(const std::string& name, float value) const {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	setFloat(getUniformLocation(name), value);
 }
 void Shader::setFloat3f(const std::string& name, float value1, float value2, float value3) const {
-	glUniform3f(glGetUniformLocation(ID, name.c_str()), value1, value2, value3);
+	setFloat3f(getUniformLocation(name), value1, value2, value3);
 }
-void Shader::setFloat3fv(const std::string& name, glm::vec3& vector) const {
-	glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &vector[0]);
+void Shader::setFloat3fv(const std::string& name, const glm::vec3& vector) const {
+	setFloat3fv(getUniformLocation(name), vector);
 }
 void Shader::setFloat4f(const std::string& name, float value1, float value2, float value3, float value4) const {
-	glUniform4f(glGetUniformLocation(ID, name.c_str()), value1, value2, value3, value4);
+	setFloat4f(getUniformLocation(name), value1, value2, value3, value4);
 }
 void Shader::setMatrixTransform4fv(const std::string& name, glm::mat4 matrix) const {
-	glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(matrix));
+	setMatrixTransform4fv(getUniformLocation(name), matrix);
+}
+
+// Used to set a uniform's value by a name given as a literal
+void Shader::setBool(const char* name, bool value) const {
+	setBool(getUniformLocation(name), value);
+}
+void Shader::setInt(const char* name, int value) const {
+	setInt(getUniformLocation(name), value);
+}
+void Shader::setFloat(const char* name, float value) const {
+	setFloat(getUniformLocation(name), value);
+}
+void Shader::setFloat3f(const char* name, float value1, float value2, float value3) const {
+	setFloat3f(getUniformLocation(name), value1, value2, value3);
+}
+void Shader::setFloat3fv(const char* name, const glm::vec3& vector) const {
+	setFloat3fv(getUniformLocation(name), vector);
+}
+void Shader::setFloat4f(const char* name, float value1, float value2, float value3, float value4) const {
+	setFloat4f(getUniformLocation(name), value1, value2, value3, value4);
+}
+void Shader::setMatrixTransform4fv(const char* name, const glm::mat4& matrix) const {
+	setMatrixTransform4fv(getUniformLocation(name), matrix);
+}
+
+// Used to set a uniform's value through a location returned by getUniformLocation
+void Shader::setBool(int location, bool value) const {
+	setInt(location, (int)value);
+}
+void Shader::setInt(int location, int value) const {
+	if (uniformChanged(location, &value, sizeof(value))) {
+		glUniform1i(location, value);
+	}
+}
+void Shader::setFloat(int location, float value) const {
+	if (uniformChanged(location, &value, sizeof(value))) {
+		glUniform1f(location, value);
+	}
+}
+void Shader::setFloat3f(int location, float value1, float value2, float value3) const {
+	float values[3] = { value1, value2, value3 };
+	if (uniformChanged(location, values, sizeof(values))) {
+		glUniform3f(location, value1, value2, value3);
+	}
+}
+void Shader::setFloat3fv(int location, const glm::vec3& vector) const {
+	if (uniformChanged(location, &vector[0], sizeof(float) * 3)) {
+		glUniform3fv(location, 1, &vector[0]);
+	}
+}
+void Shader::setFloat4f(int location, float value1, float value2, float value3, float value4) const {
+	float values[4] = { value1, value2, value3, value4 };
+	if (uniformChanged(location, values, sizeof(values))) {
+		glUniform4f(location, value1, value2, value3, value4);
+	}
+}
+void Shader::setMatrixTransform4fv(int location, const glm::mat4& matrix) const {
+	if (uniformChanged(location, glm::value_ptr(matrix), sizeof(float) * 16)) {
+		glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
+	}
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <glad/glad.h>
 
 #include <string>
+#include <vector>
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -11,25 +12,148 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "program_cache.h"
+#include "gl_state_cache.h"
+
 
 class Shader {
 public:
 	unsigned int ID;
 
-	// Constructor that reads in file paths for vertex and fragment shader's source codes
-	Shader(const char *vertexPath, const char *fragmentPath);
+	// State of a reload started by beginReload, as returned by pollReload
+	enum ReloadStatus {
+		RELOAD_IDLE,
+		RELOAD_PENDING,
+		RELOAD_FAILED,
+		RELOAD_SWAPPED
+	};
+
+	// Constructor that reads in file paths for vertex and fragment shader's source codes,
+	// when a cache is given the linked program is loaded from / saved to it
+	Shader(const char *vertexPath, const char *fragmentPath, ProgramCache *cache = nullptr);
 
-	// Activate the shader
+	// Same, building the permutation where each of defines is #defined in both stages.
+	// Sources go through preprocessShaderSource, so they may #include other files
+	Shader(const char *vertexPath, const char *fragmentPath, const std::vector<std::string>& defines, ProgramCache *cache = nullptr);
+
+	// Activate the shader, skipped when it is already in use
 	void use();
 
+	// Starts rebuilding the program from the source files again, the current program stays in use meanwhile.
+	// useCache false always compiles, even when the cache holds a binary for the sources
+	void beginReload(bool useCache = true);
+
+	// Checks on the rebuild started by beginReload. With parallel shader compilation this never waits on the
+	// driver, without it (or when wait is true) it blocks until the program has linked. On a successful link
+	// ID is switched to the new program and the old one is deleted; uniform locations, uniform values and
+	// uniform block bindings all start over, so the caller has to resolve and set them again.
+	// A failed compile or link is logged and the current program is kept
+	ReloadStatus pollReload(bool wait = false);
+
+	// True between beginReload and the poll that finishes it
+	bool isReloading() const;
+
+	// True if the program is built from the file at path, includes count
+	bool usesFile(const std::string& path) const;
+
+	// Every file the program was built from, includes and all
+	const std::vector<std::string>& files() const;
+
+	// Returns the location of an active uniform from the table built after linking, or -1 if it is not active.
+	// Resolve locations once up front and pass them to the set* overloads below to skip the lookup per draw.
+	int getUniformLocation(const std::string &name) const;
+	int getUniformLocation(const char* name) const;
+
+	// Points the named uniform block at a uniform buffer binding point, returns false if the program has no such block.
+	// Linking resets block bindings, so this has to be called again whenever the program is relinked.
+	bool bindUniformBlock(const std::string& name, unsigned int binding);
+
 	// Used to query a uniform location and set it's value
 	void setBool(const std::string &name, bool value) const;
 	void setInt(const std::string &name, int value) const;
 	void setFloat(const std::string& name, float value) const;
 	void setFloat3f(const std::string& name, float value1, float value2, float value3) const;
-	void setFloat3fv(const std::string& name, glm::vec3& vector) const;
+	void setFloat3fv(const std::string& name, const glm::vec3& vector) const;
 	void setFloat4f(const std::string& name, float value1, float value2, float value3, float value4) const;
 	void setMatrixTransform4fv(const std::string& name, glm::mat4 matrix) const;
 
+	// Same for names given as literals, which are hashed in place instead of being copied into a std::string first
+	void setBool(const char* name, bool value) const;
+	void setInt(const char* name, int value) const;
+	void setFloat(const char* name, float value) const;
+	void setFloat3f(const char* name, float value1, float value2, float value3) const;
+	void setFloat3fv(const char* name, const glm::vec3& vector) const;
+	void setFloat4f(const char* name, float value1, float value2, float value3, float value4) const;
+	void setMatrixTransform4fv(const char* name, const glm::mat4& matrix) const;
+
+	// Used to set a uniform's value through a location returned by getUniformLocation.
+	// The last value sent to each location is remembered and unchanged values aren't sent again,
+	// so like glUniform* these must only be called while the shader is in use.
+	void setBool(int location, bool value) const;
+	void setInt(int location, int value) const;
+	void setFloat(int location, float value) const;
+	void setFloat3f(int location, float value1, float value2, float value3) const;
+	void setFloat3fv(int location, const glm::vec3& vector) const;
+	void setFloat4f(int location, float value1, float value2, float value3, float value4) const;
+	void setMatrixTransform4fv(int location, const glm::mat4& matrix) const;
+
+private:
+	std::string vertexPath;
+	std::string fragmentPath;
+	std::vector<std::string> defines;
+	ProgramCache* cache;
+
+	// Files read by the last readSources
+	std::vector<std::string> sourceFiles;
+
+	// A program whose compile and link were started but not checked yet. A program loaded from the
+	// cache has no shader objects and is already linked
+	struct PendingProgram {
+		unsigned int program;
+		unsigned int vertexShader;
+		unsigned int fragmentShader;
+		std::string vertexSourceCode;
+		std::string fragmentSourceCode;
+	};
+	PendingProgram reload;
+
+	// Reads and preprocesses both source files, returns false if either can't be read
+	bool readSources(std::string& vertexSourceCode, std::string& fragmentSourceCode);
+
+	// Compiles and links the program from source, storing the result in the cache if one is given
+	void compileProgram(const std::string& vertexSourceCode, const std::string& fragmentSourceCode, ProgramCache* cache);
+
+	// Issues the compile and link without asking for their results, so a driver compiling in the background isn't waited on
+	PendingProgram startProgram(const std::string& vertexSourceCode, const std::string& fragmentSourceCode, ProgramCache* cache) const;
+
+	// Checks and logs the compile and link results, stores a successfully linked program in the cache and
+	// deletes the shader objects. Blocks until the driver is done with the program
+	bool finishProgram(PendingProgram& pending, ProgramCache* cache) const;
+
+	// One slot of the open addressed uniform table, empty slots have a location of -1
+	struct UniformSlot {
+		unsigned int hash;
+		int location;
+		std::string name;
+	};
+
+	// Flat hash table of every active uniform, sized to a power of two
+	std::vector<UniformSlot> uniformTable;
+
+	// Queries all active uniforms of the linked program and fills the uniform table
+	void reflectUniforms();
+
+	// Inserts a single uniform name into the uniform table
+	void insertUniform(const std::string& name, int location);
+
+	// Largest value a shadowed uniform can hold, a mat4
+	static const int UNIFORM_SHADOW_FLOATS = 16;
+
+	// Last value sent to each uniform location, UNIFORM_SHADOW_FLOATS per location
+	mutable std::vector<float> uniformValues;
+	mutable std::vector<unsigned char> uniformValueSet;
+
+	// Compares a value with the one last sent to the location and remembers it, returns true if it has to be sent
+	bool uniformChanged(int location, const void* value, size_t size) const;
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "shader_preprocessor.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+// Includes nested deeper than this are reported as a cycle, which include once already rules out
+static const int MAX_INCLUDE_DEPTH = 16;
+
+// Appends the expanded file at path to source
+static bool expandFile(const std::string& path, const std::vector<std::string>& defines, int depth, std::string& source, std::vector<std::string>& files) {
+	std::ifstream file(path);
+	if (!file) {
+		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ " << path << std::endl;
+		return false;
+	}
+	int fileIndex = (int)files.size();
+	files.push_back(path);
+
+	std::filesystem::path directory = std::filesystem::path(path).parent_path();
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line)) {
+		lineNumber++;
+
+		// Directives may be indented, sources may have Windows line endings
+		size_t start = line.find_first_not_of(" \t");
+		std::string directive = start == std::string::npos ? std::string() : line.substr(start);
+		if (!directive.empty() && directive.back() == '\r') {
+			directive.pop_back();
+		}
+
+		// The keyword has to end there, #include_next or #includes go on to the compiler like any other line
+		bool include = directive.compare(0, 8, "#include") == 0 && directive.size() > 8 && (directive[8] == ' ' || directive[8] == '\t' || directive[8] == '"');
+		if (include) {
+			size_t open = directive.find('"');
+			size_t close = open == std::string::npos ? std::string::npos : directive.find('"', open + 1);
+			if (close == std::string::npos) {
+				std::cout << "ERROR::SHADER::PREPROCESSOR " << path << ":" << lineNumber << ": expected #include \"file\"" << std::endl;
+				return false;
+			}
+			std::string included = (directory / directive.substr(open + 1, close - open - 1)).lexically_normal().generic_string();
+			if (std::find(files.begin(), files.end(), included) != files.end()) {
+				continue;
+			}
+			if (depth >= MAX_INCLUDE_DEPTH) {
+				std::cout << "ERROR::SHADER::PREPROCESSOR " << path << ":" << lineNumber << ": includes nested too deeply" << std::endl;
+				return false;
+			}
+
+			source += "#line 1 " + std::to_string(files.size()) + "\n";
+			if (!expandFile(included, defines, depth + 1, source, files)) {
+				return false;
+			}
+			source += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+			continue;
+		}
+
+		source += line;
+		source += '\n';
+
+		// Nothing but comments may come before #version, so the permutation goes right after it
+		if (depth == 0 && directive.compare(0, 8, "#version") == 0 && !defines.empty()) {
+			for (const std::string& define : defines) {
+				source += "#define " + define + "\n";
+			}
+			source += "#line " + std::to_string(lineNumber + 1) + " 0\n";
+		}
+	}
+	return true;
+}
+
+// Expands a shader source file
+bool preprocessShaderSource(const std::string& path, const std::vector<std::string>& defines, std::string& source, std::vector<std::string>& files) {
+	source.clear();
+	files.clear();
+	return expandFile(path, defines, 0, source, files);
+}
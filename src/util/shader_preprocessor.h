@@ -0,0 +1,18 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include <string>
+#include <vector>
+
+// Expands a shader source file before it's handed to the GL compiler, which knows neither files nor permutations:
+//	#include "file"		replaced by the file, resolved relative to the including file. Each file is only
+//					included once per source, so shared headers need no include guards
+//	defines				a "#define NAME" per entry is inserted right after the #version line
+// #line directives keep compile errors pointing at the right line, with the source string number being the
+// file's index in files (0 is the file itself).
+//
+// Returns false and logs the path if the file or anything it includes can't be read.
+// files receives every file read, for watching them.
+bool preprocessShaderSource(const std::string& path, const std::vector<std::string>& defines, std::string& source, std::vector<std::string>& files);
+
+#endif
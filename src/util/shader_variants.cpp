@@ -0,0 +1,44 @@
+#include "shader_variants.h"
+#include "gl_state_cache.h"
+
+// Macro names of the ShaderFeature bits, in bit order
+static const char* FEATURE_NAMES[] = { "TEXTURED", "LIT", "INSTANCED", "OCTAHEDRAL_NORMALS" };
+
+ShaderVariants::ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath, ProgramCache* cache) : vertexPath(vertexPath), fragmentPath(fragmentPath), cache(cache) {
+}
+
+ShaderVariants::~ShaderVariants() {
+	for (Variant& variant : variants) {
+		// A rebuild still in flight is finished so its program gets deleted too
+		variant.shader->pollReload(true);
+		GLStateCache::current().forgetProgram(variant.shader->ID);
+		glDeleteProgram(variant.shader->ID);
+	}
+}
+
+// Macros #defined for a feature mask
+std::vector<std::string> ShaderVariants::defines(unsigned int features) {
+	std::vector<std::string> names;
+	for (unsigned int bit = 0; bit < sizeof(FEATURE_NAMES) / sizeof(FEATURE_NAMES[0]); bit++) {
+		if (features & (1u << bit)) {
+			names.push_back(FEATURE_NAMES[bit]);
+		}
+	}
+	return names;
+}
+
+// The permutation with the given feature mask, compiled on the first call
+Shader& ShaderVariants::get(unsigned int features) {
+	for (Variant& variant : variants) {
+		if (variant.features == features) {
+			return *variant.shader;
+		}
+	}
+	variants.push_back(Variant{ features, std::unique_ptr<Shader>(new Shader(vertexPath.c_str(), fragmentPath.c_str(), defines(features), cache)) });
+	return *variants.back().shader;
+}
+
+// Number of permutations compiled so far
+size_t ShaderVariants::size() const {
+	return variants.size();
+}
@@ -0,0 +1,54 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "shader.h"
+#include "program_cache.h"
+
+// Features a shader permutation can be built with, each #defines the macro of the same name in both stages
+enum ShaderFeature {
+	SHADER_TEXTURED = 1 << 0,
+	SHADER_LIT = 1 << 1,
+	SHADER_INSTANCED = 1 << 2,
+	// LIT reads octahedral normals packed into two components, see NORMAL_OCTAHEDRAL16
+	SHADER_OCTAHEDRAL_NORMALS = 1 << 3
+};
+
+// All permutations of one vertex / fragment shader pair. A permutation is compiled the first time it's asked
+// for and kept by its feature mask, so compile work only grows with the permutations actually drawn with.
+// Owns the programs of its permutations, it has to be destroyed while their context is still current.
+class ShaderVariants {
+public:
+	ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath, ProgramCache* cache = nullptr);
+	~ShaderVariants();
+
+	ShaderVariants(const ShaderVariants&) = delete;
+	ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+	// The permutation with the given ShaderFeature mask, compiled on the first call
+	Shader& get(unsigned int features);
+
+	// Number of permutations compiled so far
+	size_t size() const;
+
+	// Macros #defined for a feature mask
+	static std::vector<std::string> defines(unsigned int features);
+
+private:
+	struct Variant {
+		unsigned int features;
+		std::unique_ptr<Shader> shader;
+	};
+
+	std::string vertexPath;
+	std::string fragmentPath;
+	ProgramCache* cache;
+
+	// Few permutations are ever used, a linear search beats hashing them
+	std::vector<Variant> variants;
+};
+
+#endif
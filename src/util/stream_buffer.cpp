@@ -0,0 +1,136 @@
+#include "stream_buffer.h"
+#include "gl_extensions.h"
+#include "gl_state_cache.h"
+
+#include <chrono>
+
+// The buffer is bound here for mapping, a binding point nothing else uses so draws aren't disturbed
+static const GLenum MAPPING_TARGET = GL_COPY_WRITE_BUFFER;
+
+StreamBuffer::StreamBuffer(size_t segmentSize, bool allowPersistent) : segmentBytes(segmentSize), segment(0), used(0), persistentPointer(nullptr), mappedSegment(nullptr), frameStats(), lastFrameStats(), totalStats() {
+	for (GLsync& fence : fences) {
+		fence = 0;
+	}
+
+	glGenBuffers(1, &ID);
+	GLStateCache::current().bindBuffer(MAPPING_TARGET, ID);
+
+	persistent = allowPersistent && GLEXT_ARB_buffer_storage;
+	if (persistent) {
+		// Mapped once for the buffer's lifetime, coherent so writes need no explicit flush
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(MAPPING_TARGET, segmentBytes * SEGMENT_COUNT, NULL, flags);
+		persistentPointer = (unsigned char*)glMapBufferRange(MAPPING_TARGET, 0, segmentBytes * SEGMENT_COUNT, flags);
+		persistent = persistentPointer != nullptr;
+	}
+	if (!persistent) {
+		glBufferData(MAPPING_TARGET, segmentBytes * SEGMENT_COUNT, NULL, GL_STREAM_DRAW);
+	}
+
+	// Start on the last segment so the first beginFrame moves to segment 0
+	segment = SEGMENT_COUNT - 1;
+}
+
+StreamBuffer::~StreamBuffer() {
+	for (GLsync fence : fences) {
+		if (fence) {
+			glDeleteSync(fence);
+		}
+	}
+	if (persistentPointer || mappedSegment) {
+		GLStateCache::current().bindBuffer(MAPPING_TARGET, ID);
+		glUnmapBuffer(MAPPING_TARGET);
+	}
+	GLStateCache::current().forgetBuffer(ID);
+	glDeleteBuffers(1, &ID);
+}
+
+// True when the buffer is persistently mapped
+bool StreamBuffer::isPersistent() const {
+	return persistent;
+}
+
+// Size of one segment
+size_t StreamBuffer::segmentSize() const {
+	return segmentBytes;
+}
+
+// Moves to the next segment, waiting for the GPU to finish the frame that last used it
+void StreamBuffer::beginFrame() {
+	segment = (segment + 1) % SEGMENT_COUNT;
+	used = 0;
+
+	GLsync fence = fences[segment];
+	if (fence) {
+		// Polling first tells a free segment apart from one we actually have to wait for
+		GLenum status = glClientWaitSync(fence, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED) {
+			std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+			do {
+				status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			} while (status == GL_TIMEOUT_EXPIRED);
+			frameStats.stalls++;
+			frameStats.stallMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+		}
+		glDeleteSync(fence);
+		fences[segment] = 0;
+	}
+
+	if (persistent) {
+		mappedSegment = persistentPointer + segment * segmentBytes;
+	}
+	else {
+		// The GPU is done with this segment, so there's nothing to synchronize with, and the rest of the buffer
+		// is still in use so only this range is invalidated. Written bytes are flushed explicitly in commit
+		GLStateCache::current().bindBuffer(MAPPING_TARGET, ID);
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
+		mappedSegment = (unsigned char*)glMapBufferRange(MAPPING_TARGET, segment * segmentBytes, segmentBytes, flags);
+	}
+}
+
+// Returns size bytes of this frame's segment starting at a multiple of alignment
+StreamAllocation StreamBuffer::allocate(size_t size, size_t alignment) {
+	size_t start = (used + alignment - 1) & ~(alignment - 1);
+	if (mappedSegment == nullptr || start + size > segmentBytes) {
+		frameStats.overflows++;
+		return StreamAllocation{ nullptr, 0, 0 };
+	}
+	used = start + size;
+	return StreamAllocation{ mappedSegment + start, segment * segmentBytes + start, size };
+}
+
+// Makes everything written so far visible to the GL
+void StreamBuffer::commit() {
+	if (!persistent && mappedSegment) {
+		GLStateCache::current().bindBuffer(MAPPING_TARGET, ID);
+		if (used > 0) {
+			glFlushMappedBufferRange(MAPPING_TARGET, 0, used);
+		}
+		glUnmapBuffer(MAPPING_TARGET);
+	}
+	mappedSegment = nullptr;
+}
+
+// Fences the frame's segment behind the draws issued so far
+void StreamBuffer::endFrame() {
+	commit();
+	fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	frameStats.bytesUsed = used;
+	totalStats.stalls += frameStats.stalls;
+	totalStats.stallMilliseconds += frameStats.stallMilliseconds;
+	totalStats.overflows += frameStats.overflows;
+	totalStats.bytesUsed += frameStats.bytesUsed;
+	lastFrameStats = frameStats;
+	frameStats = StreamBufferStats();
+}
+
+// Counters of the frame ended last
+const StreamBufferStats& StreamBuffer::lastFrame() const {
+	return lastFrameStats;
+}
+
+// Counters of all frames
+const StreamBufferStats& StreamBuffer::total() const {
+	return totalStats;
+}
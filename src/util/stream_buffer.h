@@ -0,0 +1,85 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// Space handed out by StreamBuffer::allocate, pointer is null when the frame's segment is full
+struct StreamAllocation {
+	void* pointer;
+	// Offset into the buffer, for glBindBufferRange / glVertexAttribPointer
+	size_t offset;
+	size_t size;
+};
+
+// How often the CPU had to wait for the GPU to release a segment, and how full the segments got
+struct StreamBufferStats {
+	unsigned int stalls;
+	double stallMilliseconds;
+	unsigned int overflows;
+	size_t bytesUsed;
+};
+
+// Ring of three equally sized segments in one buffer for data written every frame: instance data, uniforms
+// and dynamic vertices. Each frame writes into its own segment while the GPU may still read the previous two,
+// a fence placed after a frame's draws tells when its segment can be written again.
+//
+// With ARB_buffer_storage the whole buffer stays mapped for its lifetime (persistent and coherent), otherwise
+// each frame's segment is mapped unsynchronized with its range invalidated, the fences make that safe.
+//
+// Per frame: beginFrame, allocate and write, commit before the draws that read the data, draw, endFrame.
+class StreamBuffer {
+public:
+	static const int SEGMENT_COUNT = 3;
+
+	unsigned int ID;
+
+	// Creates a buffer with three segments of segmentSize bytes, allowPersistent false forces the map per frame path
+	StreamBuffer(size_t segmentSize, bool allowPersistent = true);
+	~StreamBuffer();
+
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	// True when the buffer is persistently mapped
+	bool isPersistent() const;
+
+	// Size of one segment, the most that can be allocated per frame
+	size_t segmentSize() const;
+
+	// Moves to the next segment, waiting for the GPU to finish the frame that last used it
+	void beginFrame();
+
+	// Returns size bytes of this frame's segment starting at a multiple of alignment, which must be a power of two
+	StreamAllocation allocate(size_t size, size_t alignment = 16);
+
+	// Makes everything written so far visible to the GL, nothing may be allocated after it until the next beginFrame
+	void commit();
+
+	// Fences the frame's segment behind the draws issued so far
+	void endFrame();
+
+	// Counters of the frame ended last and of all frames
+	const StreamBufferStats& lastFrame() const;
+	const StreamBufferStats& total() const;
+
+private:
+	size_t segmentBytes;
+	bool persistent;
+	int segment;
+	size_t used;
+
+	// Start of the whole buffer when persistently mapped
+	unsigned char* persistentPointer;
+	// Start of the current segment while it is mapped
+	unsigned char* mappedSegment;
+
+	GLsync fences[SEGMENT_COUNT];
+
+	StreamBufferStats frameStats;
+	StreamBufferStats lastFrameStats;
+	StreamBufferStats totalStats;
+};
+
+#endif
@@ -0,0 +1,464 @@
+#include "texture_compression.h"
+#include "cpu_profiler.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Rows of blocks per parallelFor range
+static const size_t COMPRESS_GRAIN_SIZE = 8;
+
+// Interpolation weights of BC7's 4 bit indices, out of 64
+static const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Share of the first endpoint in each of BC1's four palette entries
+static const float BC1_FIRST_WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+static const char* FORMAT_NAMES[] = { "bc1", "bc3", "bc7" };
+
+// Size of a block in bytes
+size_t compressedBlockBytes(CompressedFormat format) {
+	return format == COMPRESSED_BC1 ? 8 : 16;
+}
+
+// Bytes an image takes in a format
+size_t compressedImageBytes(CompressedFormat format, int width, int height) {
+	return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * compressedBlockBytes(format);
+}
+
+// Short lower case name of a format
+const char* compressedFormatName(CompressedFormat format) {
+	return FORMAT_NAMES[format];
+}
+
+// Format with the given short name
+bool parseCompressedFormat(const std::string& name, CompressedFormat& format) {
+	for (int i = 0; i < 3; i++) {
+		if (name == FORMAT_NAMES[i]) {
+			format = (CompressedFormat)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Unpacks a block's pixels to floats, one row of four channels per pixel
+static void loadBlock(const unsigned char* rgba, float pixels[16][4]) {
+	for (int i = 0; i < 16; i++) {
+		for (int channel = 0; channel < 4; channel++) {
+			pixels[i][channel] = rgba[i * 4 + channel];
+		}
+	}
+}
+
+// The two ends of the line through a block's pixels along the direction they spread out most,
+// over the first channelCount channels
+static void principalExtremes(const float pixels[16][4], int channelCount, float low[4], float high[4]) {
+	float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++) {
+		for (int channel = 0; channel < channelCount; channel++) {
+			mean[channel] += pixels[i][channel] / 16.0f;
+		}
+	}
+
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; i++) {
+		for (int a = 0; a < channelCount; a++) {
+			for (int b = 0; b < channelCount; b++) {
+				covariance[a][b] += (pixels[i][a] - mean[a]) * (pixels[i][b] - mean[b]);
+			}
+		}
+	}
+
+	// Power iteration converges on the covariance's largest eigenvector, a flat block leaves the axis as it is
+	float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 8; iteration++) {
+		float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float largest = 0.0f;
+		for (int a = 0; a < channelCount; a++) {
+			for (int b = 0; b < channelCount; b++) {
+				next[a] += covariance[a][b] * axis[b];
+			}
+			largest = fmaxf(largest, fabsf(next[a]));
+		}
+		if (largest == 0.0f) {
+			break;
+		}
+		for (int a = 0; a < channelCount; a++) {
+			axis[a] = next[a] / largest;
+		}
+	}
+
+	float axisLengthSquared = 0.0f;
+	for (int channel = 0; channel < channelCount; channel++) {
+		axisLengthSquared += axis[channel] * axis[channel];
+	}
+	float lowest = 0.0f, highest = 0.0f;
+	for (int i = 0; i < 16; i++) {
+		float projection = 0.0f;
+		for (int channel = 0; channel < channelCount; channel++) {
+			projection += (pixels[i][channel] - mean[channel]) * axis[channel];
+		}
+		projection /= axisLengthSquared;
+		lowest = fminf(lowest, projection);
+		highest = fmaxf(highest, projection);
+	}
+
+	for (int channel = 0; channel < channelCount; channel++) {
+		low[channel] = fminf(fmaxf(mean[channel] + axis[channel] * lowest, 0.0f), 255.0f);
+		high[channel] = fminf(fmaxf(mean[channel] + axis[channel] * highest, 0.0f), 255.0f);
+	}
+}
+
+// Least squares endpoints for indices already chosen, where each pixel is modelled as
+// weights[i] * first + (1 - weights[i]) * second. Returns false when the weights can't pin both down
+static bool fitEndpoints(const float pixels[16][4], const float weights[16], int channelCount, float first[4], float second[4]) {
+	float firstFirst = 0.0f, firstSecond = 0.0f, secondSecond = 0.0f;
+	float firstPixel[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float secondPixel[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++) {
+		float a = weights[i];
+		float b = 1.0f - a;
+		firstFirst += a * a;
+		firstSecond += a * b;
+		secondSecond += b * b;
+		for (int channel = 0; channel < channelCount; channel++) {
+			firstPixel[channel] += a * pixels[i][channel];
+			secondPixel[channel] += b * pixels[i][channel];
+		}
+	}
+
+	float determinant = firstFirst * secondSecond - firstSecond * firstSecond;
+	if (fabsf(determinant) < 1e-6f) {
+		return false;
+	}
+	for (int channel = 0; channel < channelCount; channel++) {
+		first[channel] = (secondSecond * firstPixel[channel] - firstSecond * secondPixel[channel]) / determinant;
+		second[channel] = (firstFirst * secondPixel[channel] - firstSecond * firstPixel[channel]) / determinant;
+		first[channel] = fminf(fmaxf(first[channel], 0.0f), 255.0f);
+		second[channel] = fminf(fmaxf(second[channel], 0.0f), 255.0f);
+	}
+	return true;
+}
+
+// Rounds an 8 bit color to 565
+static uint16_t packColor565(const float color[3]) {
+	int red = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+	int green = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+	int blue = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+	return (uint16_t)((red << 11) | (green << 5) | blue);
+}
+
+// Expands 565 back to 8 bits the way the hardware does, by repeating the high bits
+static void unpackColor565(uint16_t packed, int color[3]) {
+	int red = packed >> 11;
+	int green = (packed >> 5) & 63;
+	int blue = packed & 31;
+	color[0] = (red << 3) | (red >> 2);
+	color[1] = (green << 2) | (green >> 4);
+	color[2] = (blue << 3) | (blue >> 2);
+}
+
+// Picks the closest of the four palette colors for every pixel, returns the summed squared error
+static float chooseColorIndices(const float pixels[16][4], uint16_t first, uint16_t second, uint32_t& indices) {
+	int palette[4][3];
+	unpackColor565(first, palette[0]);
+	unpackColor565(second, palette[1]);
+	for (int channel = 0; channel < 3; channel++) {
+		palette[2][channel] = (2 * palette[0][channel] + palette[1][channel]) / 3;
+		palette[3][channel] = (palette[0][channel] + 2 * palette[1][channel]) / 3;
+	}
+
+	indices = 0;
+	float totalError = 0.0f;
+	for (int i = 0; i < 16; i++) {
+		int best = 0;
+		float bestError = 1e30f;
+		for (int entry = 0; entry < 4; entry++) {
+			float error = 0.0f;
+			for (int channel = 0; channel < 3; channel++) {
+				float difference = pixels[i][channel] - palette[entry][channel];
+				error += difference * difference;
+			}
+			if (error < bestError) {
+				bestError = error;
+				best = entry;
+			}
+		}
+		indices |= (uint32_t)best << (i * 2);
+		totalError += bestError;
+	}
+	return totalError;
+}
+
+// Encodes the 8 byte BC1 color block shared by BC1 and BC3
+static void compressColorBlock(const float pixels[16][4], unsigned char* output) {
+	float low[4], high[4];
+	principalExtremes(pixels, 3, low, high);
+	uint16_t first = packColor565(high);
+	uint16_t second = packColor565(low);
+	uint32_t indices;
+	float error = chooseColorIndices(pixels, first, second, indices);
+
+	// One refinement pass, the endpoints that best fit the pixels given the indices just chosen
+	float weights[16];
+	for (int i = 0; i < 16; i++) {
+		weights[i] = BC1_FIRST_WEIGHTS[(indices >> (i * 2)) & 3];
+	}
+	float fittedFirst[4], fittedSecond[4];
+	if (fitEndpoints(pixels, weights, 3, fittedFirst, fittedSecond)) {
+		uint16_t refinedFirst = packColor565(fittedFirst);
+		uint16_t refinedSecond = packColor565(fittedSecond);
+		uint32_t refinedIndices;
+		if (chooseColorIndices(pixels, refinedFirst, refinedSecond, refinedIndices) < error) {
+			first = refinedFirst;
+			second = refinedSecond;
+			indices = refinedIndices;
+		}
+	}
+
+	// The decoder only uses four colors when the first endpoint is the larger, swapping them swaps 0 with 1 and 2 with 3.
+	// Equal endpoints would select the three color mode, where index 3 is black, so every pixel takes index 0
+	if (first < second) {
+		uint16_t swap = first;
+		first = second;
+		second = swap;
+		indices ^= 0x55555555u;
+	}
+	else if (first == second) {
+		indices = 0;
+	}
+
+	output[0] = (unsigned char)(first & 0xFF);
+	output[1] = (unsigned char)(first >> 8);
+	output[2] = (unsigned char)(second & 0xFF);
+	output[3] = (unsigned char)(second >> 8);
+	for (int byte = 0; byte < 4; byte++) {
+		output[4 + byte] = (unsigned char)(indices >> (byte * 8));
+	}
+}
+
+// Encodes BC3's alpha block: the extremes as endpoints and six values evenly between them
+static void compressAlphaBlock(const float pixels[16][4], unsigned char* output) {
+	int highest = 0, lowest = 255;
+	for (int i = 0; i < 16; i++) {
+		int alpha = (int)pixels[i][3];
+		highest = alpha > highest ? alpha : highest;
+		lowest = alpha < lowest ? alpha : lowest;
+	}
+
+	// With the first endpoint larger, indices 2 to 7 interpolate from first to second in sevenths
+	uint64_t indices = 0;
+	if (highest > lowest) {
+		int palette[8] = { highest, lowest };
+		for (int entry = 2; entry < 8; entry++) {
+			palette[entry] = ((8 - entry) * highest + (entry - 1) * lowest) / 7;
+		}
+		for (int i = 0; i < 16; i++) {
+			int best = 0;
+			int bestError = 1 << 30;
+			for (int entry = 0; entry < 8; entry++) {
+				int error = abs((int)pixels[i][3] - palette[entry]);
+				if (error < bestError) {
+					bestError = error;
+					best = entry;
+				}
+			}
+			indices |= (uint64_t)best << (i * 3);
+		}
+	}
+
+	output[0] = (unsigned char)highest;
+	output[1] = (unsigned char)lowest;
+	for (int byte = 0; byte < 6; byte++) {
+		output[2 + byte] = (unsigned char)(indices >> (byte * 8));
+	}
+}
+
+// Encodes a 4x4 block as BC1
+void compressBlockBC1(const unsigned char* rgba, unsigned char* output) {
+	float pixels[16][4];
+	loadBlock(rgba, pixels);
+	compressColorBlock(pixels, output);
+}
+
+// Encodes a 4x4 block as BC3, alpha block first
+void compressBlockBC3(const unsigned char* rgba, unsigned char* output) {
+	float pixels[16][4];
+	loadBlock(rgba, pixels);
+	compressAlphaBlock(pixels, output);
+	compressColorBlock(pixels, output + 8);
+}
+
+// Quantizes BC7 mode 6 endpoints with the given low bits and picks the closest of the 16 palette entries for every
+// pixel, returns the summed squared error
+static float chooseMode6Indices(const float pixels[16][4], const int first[4], const int second[4], int firstBit, int secondBit, int indices[16]) {
+	int palette[16][4];
+	for (int entry = 0; entry < 16; entry++) {
+		int weight = BC7_WEIGHTS[entry];
+		for (int channel = 0; channel < 4; channel++) {
+			int a = (first[channel] << 1) | firstBit;
+			int b = (second[channel] << 1) | secondBit;
+			palette[entry][channel] = ((64 - weight) * a + weight * b + 32) >> 6;
+		}
+	}
+
+	float totalError = 0.0f;
+	for (int i = 0; i < 16; i++) {
+		int best = 0;
+		float bestError = 1e30f;
+		for (int entry = 0; entry < 16; entry++) {
+			float error = 0.0f;
+			for (int channel = 0; channel < 4; channel++) {
+				float difference = pixels[i][channel] - palette[entry][channel];
+				error += difference * difference;
+			}
+			if (error < bestError) {
+				bestError = error;
+				best = entry;
+			}
+		}
+		indices[i] = best;
+		totalError += bestError;
+	}
+	return totalError;
+}
+
+// Best 7 bit endpoints and low bits for a pair of 8 bit endpoints, tried with all four low bit combinations
+static float quantizeMode6(const float pixels[16][4], const float firstColor[4], const float secondColor[4], int first[4], int second[4], int& firstBit, int& secondBit, int indices[16]) {
+	float bestError = 1e30f;
+	for (int bits = 0; bits < 4; bits++) {
+		int candidateFirstBit = bits & 1;
+		int candidateSecondBit = bits >> 1;
+		int candidateFirst[4], candidateSecond[4], candidateIndices[16];
+		for (int channel = 0; channel < 4; channel++) {
+			int a = (int)floorf((firstColor[channel] - candidateFirstBit) * 0.5f + 0.5f);
+			int b = (int)floorf((secondColor[channel] - candidateSecondBit) * 0.5f + 0.5f);
+			candidateFirst[channel] = a < 0 ? 0 : a > 127 ? 127 : a;
+			candidateSecond[channel] = b < 0 ? 0 : b > 127 ? 127 : b;
+		}
+		float error = chooseMode6Indices(pixels, candidateFirst, candidateSecond, candidateFirstBit, candidateSecondBit, candidateIndices);
+		if (error < bestError) {
+			bestError = error;
+			firstBit = candidateFirstBit;
+			secondBit = candidateSecondBit;
+			memcpy(first, candidateFirst, sizeof(candidateFirst));
+			memcpy(second, candidateSecond, sizeof(candidateSecond));
+			memcpy(indices, candidateIndices, sizeof(candidateIndices));
+		}
+	}
+	return bestError;
+}
+
+// Appends values to a block least significant bit first, the order BC7 fields are packed in
+struct BlockBitWriter {
+	unsigned char* output;
+	int position;
+
+	void write(uint32_t value, int bitCount) {
+		for (int bit = 0; bit < bitCount; bit++) {
+			if ((value >> bit) & 1) {
+				output[position >> 3] |= (unsigned char)(1 << (position & 7));
+			}
+			position++;
+		}
+	}
+};
+
+// Encodes a 4x4 block as BC7, always in mode 6: one subset, RGBA endpoints and 16 interpolation steps
+void compressBlockBC7(const unsigned char* rgba, unsigned char* output) {
+	float pixels[16][4];
+	loadBlock(rgba, pixels);
+
+	float low[4], high[4];
+	principalExtremes(pixels, 4, low, high);
+	int first[4], second[4], indices[16];
+	int firstBit = 0, secondBit = 0;
+	float error = quantizeMode6(pixels, low, high, first, second, firstBit, secondBit, indices);
+
+	// One refinement pass, like BC1's
+	float weights[16];
+	for (int i = 0; i < 16; i++) {
+		weights[i] = (64 - BC7_WEIGHTS[indices[i]]) / 64.0f;
+	}
+	float fittedFirst[4], fittedSecond[4];
+	if (fitEndpoints(pixels, weights, 4, fittedFirst, fittedSecond)) {
+		int refinedFirst[4], refinedSecond[4], refinedIndices[16];
+		int refinedFirstBit, refinedSecondBit;
+		if (quantizeMode6(pixels, fittedFirst, fittedSecond, refinedFirst, refinedSecond, refinedFirstBit, refinedSecondBit, refinedIndices) < error) {
+			memcpy(first, refinedFirst, sizeof(first));
+			memcpy(second, refinedSecond, sizeof(second));
+			memcpy(indices, refinedIndices, sizeof(indices));
+			firstBit = refinedFirstBit;
+			secondBit = refinedSecondBit;
+		}
+	}
+
+	// The first pixel's index is stored without its top bit, which therefore has to be 0. Swapping the endpoints mirrors the indices
+	if (indices[0] >= 8) {
+		for (int channel = 0; channel < 4; channel++) {
+			int swap = first[channel];
+			first[channel] = second[channel];
+			second[channel] = swap;
+		}
+		int swapBit = firstBit;
+		firstBit = secondBit;
+		secondBit = swapBit;
+		for (int i = 0; i < 16; i++) {
+			indices[i] = 15 - indices[i];
+		}
+	}
+
+	memset(output, 0, 16);
+	BlockBitWriter writer = { output, 0 };
+	// Mode 6 is six 0 bits followed by a 1
+	writer.write(1 << 6, 7);
+	for (int channel = 0; channel < 4; channel++) {
+		writer.write(first[channel], 7);
+		writer.write(second[channel], 7);
+	}
+	writer.write(firstBit, 1);
+	writer.write(secondBit, 1);
+	writer.write(indices[0], 3);
+	for (int i = 1; i < 16; i++) {
+		writer.write(indices[i], 4);
+	}
+}
+
+// Compresses a tightly packed RGBA image
+void compressImage(CompressedFormat format, const unsigned char* rgba, int width, int height, unsigned char* output, ThreadPool* pool) {
+	int blocksWide = (width + 3) / 4;
+	int blocksHigh = (height + 3) / 4;
+	size_t blockBytes = compressedBlockBytes(format);
+
+	auto compressRows = [=](size_t beginRow, size_t endRow) {
+		PROFILE_ZONE("Compress blocks");
+		unsigned char block[64];
+		for (size_t blockY = beginRow; blockY < endRow; blockY++) {
+			for (int blockX = 0; blockX < blocksWide; blockX++) {
+				for (int y = 0; y < 4; y++) {
+					int sourceY = (int)blockY * 4 + y < height ? (int)blockY * 4 + y : height - 1;
+					for (int x = 0; x < 4; x++) {
+						int sourceX = blockX * 4 + x < width ? blockX * 4 + x : width - 1;
+						memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sourceY * width + sourceX) * 4, 4);
+					}
+				}
+
+				unsigned char* destination = output + (blockY * blocksWide + blockX) * blockBytes;
+				switch (format) {
+				case COMPRESSED_BC1: compressBlockBC1(block, destination); break;
+				case COMPRESSED_BC3: compressBlockBC3(block, destination); break;
+				case COMPRESSED_BC7: compressBlockBC7(block, destination); break;
+				}
+			}
+		}
+	};
+
+	if (pool) {
+		pool->parallelFor(blocksHigh, COMPRESS_GRAIN_SIZE, compressRows);
+	}
+	else {
+		compressRows(0, blocksHigh);
+	}
+}
@@ -0,0 +1,38 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <cstddef>
+#include <string>
+
+#include "thread_pool.h"
+
+// Block compressed formats the texture baker can write. Every format stores 4x4 pixel blocks
+enum CompressedFormat {
+	// 8 bytes per block, RGB with two 565 endpoints and 2 bit indices. Alpha is dropped
+	COMPRESSED_BC1 = 0,
+	// 16 bytes per block, the BC1 color block plus an 8 bit alpha ramp with 3 bit indices
+	COMPRESSED_BC3 = 1,
+	// 16 bytes per block, RGBA in BC7's mode 6: 7 bit endpoints with a shared low bit and 4 bit indices
+	COMPRESSED_BC7 = 2
+};
+
+// Size of a block in bytes
+size_t compressedBlockBytes(CompressedFormat format);
+
+// Bytes an image takes in a format, partial blocks at the edges count as whole ones
+size_t compressedImageBytes(CompressedFormat format, int width, int height);
+
+// Short lower case name such as "bc1", and the reverse. parseCompressedFormat returns false for unknown names
+const char* compressedFormatName(CompressedFormat format);
+bool parseCompressedFormat(const std::string& name, CompressedFormat& format);
+
+// Encodes a 4x4 block of RGBA pixels given row by row, 64 bytes in all
+void compressBlockBC1(const unsigned char* rgba, unsigned char* output);
+void compressBlockBC3(const unsigned char* rgba, unsigned char* output);
+void compressBlockBC7(const unsigned char* rgba, unsigned char* output);
+
+// Compresses a tightly packed RGBA image into compressedImageBytes bytes at output. Blocks past the right
+// and bottom edges repeat the last column and row. With a pool, rows of blocks are encoded in parallel
+void compressImage(CompressedFormat format, const unsigned char* rgba, int width, int height, unsigned char* output, ThreadPool* pool = nullptr);
+
+#endif
@@ -0,0 +1,313 @@
+#include "texture_streamer.h"
+#include "gl_state_cache.h"
+#include "cpu_profiler.h"
+#include "stb_image.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+// Pixel transfer format matching the number of channels stb_image decoded
+static GLenum formatForChannels(int channels) {
+	switch (channels) {
+	case 1: return GL_RED;
+	case 2: return GL_RG;
+	case 3: return GL_RGB;
+	default: return GL_RGBA;
+	}
+}
+
+// Creates the placeholder and pixel buffers
+TextureStreamer::TextureStreamer(ThreadPool& pool, size_t uploadBudget, const std::string& bakedDirectory) : pool(pool), uploadBudget(uploadBudget), bakedDirectory(bakedDirectory), nextPixelBuffer(0), decodedImages(256), currentImage(), currentLevel(0), currentRow(0), uploading(false), totals(), decodesInFlight(0) {
+	// Neutral grey stand in, sampled until the real image is resident
+	const unsigned char grey[4] = { 128, 128, 128, 255 };
+	glGenTextures(1, &placeholder);
+	GLStateCache::current().bindTexture(GL_TEXTURE_2D, placeholder);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenBuffers(2, pixelBuffers);
+}
+
+// Waits for outstanding decodes and frees everything
+TextureStreamer::~TextureStreamer() {
+	// Workers push into our queue, so they must all be finished before it goes away. It's drained while waiting,
+	// since a worker holding an image keeps retrying its push for as long as the queue is full
+	DecodedImage image;
+	while (decodesInFlight.load() > 0) {
+		if (decodedImages.tryPop(image)) {
+			freeImage(image);
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+	while (decodedImages.tryPop(image)) {
+		freeImage(image);
+	}
+	if (uploading) {
+		freeImage(currentImage);
+	}
+
+	for (const StreamedTexture& texture : textures) {
+		if (texture.ID != 0) {
+			GLStateCache::current().forgetTexture(texture.ID);
+			glDeleteTextures(1, &texture.ID);
+		}
+	}
+	GLStateCache::current().forgetTexture(placeholder);
+	GLStateCache::current().forgetBuffer(pixelBuffers[0]);
+	GLStateCache::current().forgetBuffer(pixelBuffers[1]);
+	glDeleteTextures(1, &placeholder);
+	glDeleteBuffers(2, pixelBuffers);
+}
+
+// Starts decoding an image and returns a handle for it
+int TextureStreamer::request(const std::string& path, GLint wrap, GLint minFilter, GLint magFilter) {
+	int handle = (int)textures.size();
+	textures.push_back(StreamedTexture{ path, 0, wrap, minFilter, magFilter, false, false });
+
+	bool mipmapped = usesMipmaps(minFilter);
+	decodesInFlight.fetch_add(1);
+	pool.submit([this, handle, path, mipmapped]() {
+		PROFILE_ZONE("Decode texture");
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		DecodedImage image = { handle, nullptr, 0, 0, 0, nullptr, nullptr, 0.0, 0.0 };
+
+		// A baked file only needs mapping, the source is decoded if there's none or the driver can't sample its format
+		if (!bakedDirectory.empty()) {
+			BakedTexture* baked = new BakedTexture();
+			if (baked->open(bakedTexturePath(bakedDirectory, path), path) && baked->isSupported()) {
+				image.baked = baked;
+				image.width = baked->level(0).width;
+				image.height = baked->level(0).height;
+			}
+			else {
+				delete baked;
+			}
+		}
+		if (!image.baked) {
+			// last argument = desired number of channels, leave at 0 to keep original
+			image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &image.channels, 0);
+		}
+		std::chrono::steady_clock::time_point decoded = std::chrono::steady_clock::now();
+		image.decodeMilliseconds = std::chrono::duration<double, std::milli>(decoded - start).count();
+
+		// Idle workers help with the levels of a large image
+		if (image.pixels && mipmapped) {
+			image.mips = new std::vector<MipLevel>();
+			generateMipChain(image.pixels, image.width, image.height, image.channels, defaultMipOptions(MIP_FILTER_BOX), *image.mips, &pool);
+			image.mipMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - decoded).count();
+		}
+
+		// The GL thread drains the queue every frame, so a full queue only lasts briefly
+		while (!decodedImages.tryPush(image)) {
+			std::this_thread::yield();
+		}
+		decodesInFlight.fetch_sub(1);
+	});
+
+	return handle;
+}
+
+// The texture to bind for a handle, the placeholder until the image is resident
+unsigned int TextureStreamer::texture(int handle) const {
+	const StreamedTexture& texture = textures[handle];
+	return texture.resident ? texture.ID : placeholder;
+}
+
+// True once the image has been fully uploaded
+bool TextureStreamer::isResident(int handle) const {
+	return textures[handle].resident;
+}
+
+// Number of requested textures that aren't resident yet and haven't failed
+int TextureStreamer::pendingCount() const {
+	int pending = 0;
+	for (const StreamedTexture& texture : textures) {
+		if (!texture.resident && !texture.failed) {
+			pending++;
+		}
+	}
+	return pending;
+}
+
+// Picks up decoded images and uploads slices until the budget for this frame is spent
+void TextureStreamer::update() {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool uploaded = false;
+
+	size_t budget = uploadBudget;
+	while (budget > 0) {
+		if (!uploading) {
+			DecodedImage image;
+			if (!decodedImages.tryPop(image)) {
+				break;
+			}
+			totals.decodeMilliseconds += image.decodeMilliseconds;
+			totals.mipMilliseconds += image.mipMilliseconds;
+			if (!image.pixels && !image.baked) {
+				std::cout << "Failed to load texture " << textures[image.handle].path << std::endl;
+				textures[image.handle].failed = true;
+				continue;
+			}
+			beginUpload(image);
+		}
+
+		size_t sliceBytes = currentImage.baked ? uploadBakedLevel() : uploadSlice(budget);
+		budget -= sliceBytes < budget ? sliceBytes : budget;
+		uploaded = true;
+	}
+
+	if (uploaded) {
+		totals.uploadMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+const TextureStreamerStats& TextureStreamer::stats() const {
+	return totals;
+}
+
+// Creates the GL texture for a decoded image and starts its upload
+void TextureStreamer::beginUpload(const DecodedImage& image) {
+	StreamedTexture& texture = textures[image.handle];
+	GLenum format = formatForChannels(image.channels);
+
+	glGenTextures(1, &texture.ID);
+	GLStateCache::current().bindTexture(GL_TEXTURE_2D, texture.ID);
+
+	// Setting texture wrapping params
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, texture.wrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, texture.wrap);
+
+	// Setting texture filtering params
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texture.minFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, texture.magFilter);
+
+	if (image.baked) {
+		// Levels arrive over the next frames, the texture is complete once the last one used is in
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, bakedLevelsUsed(texture, *image.baked) - 1);
+	}
+	else {
+		// Allocate storage only, the rows of every level arrive over the next frames
+		glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, NULL);
+		if (image.mips) {
+			for (size_t i = 0; i < image.mips->size(); i++) {
+				const MipLevel& level = (*image.mips)[i];
+				glTexImage2D(GL_TEXTURE_2D, (GLint)i + 1, format, level.width, level.height, 0, format, GL_UNSIGNED_BYTE, NULL);
+			}
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)image.mips->size());
+		}
+	}
+
+	currentImage = image;
+	currentLevel = 0;
+	currentRow = 0;
+	uploading = true;
+}
+
+// Copies up to byteBudget bytes of the current level through a pixel buffer object
+size_t TextureStreamer::uploadSlice(size_t byteBudget) {
+	StreamedTexture& texture = textures[currentImage.handle];
+	GLenum format = formatForChannels(currentImage.channels);
+
+	// Level 0 is the decoded image, the ones below come from the chain the worker built
+	int width = currentImage.width;
+	int height = currentImage.height;
+	const unsigned char* pixels = currentImage.pixels;
+	if (currentLevel > 0) {
+		const MipLevel& level = (*currentImage.mips)[currentLevel - 1];
+		width = level.width;
+		height = level.height;
+		pixels = level.pixels.data();
+	}
+
+	size_t rowBytes = (size_t)width * currentImage.channels;
+	int remainingRows = height - currentRow;
+	int rows = (int)(byteBudget / rowBytes);
+	if (rows < 1) {
+		rows = 1;
+	}
+	if (rows > remainingRows) {
+		rows = remainingRows;
+	}
+	size_t sliceBytes = rows * rowBytes;
+
+	// Orphan and refill the pixel buffer, the driver copies it to the texture asynchronously
+	unsigned int pixelBuffer = pixelBuffers[nextPixelBuffer];
+	nextPixelBuffer = 1 - nextPixelBuffer;
+	GLStateCache::current().bindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, sliceBytes, NULL, GL_STREAM_DRAW);
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, sliceBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (mapped) {
+		memcpy(mapped, pixels + currentRow * rowBytes, sliceBytes);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		// stb_image rows are tightly packed, which RGB images with odd widths break at the default alignment of 4
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		GLStateCache::current().bindTexture(GL_TEXTURE_2D, texture.ID);
+		glTexSubImage2D(GL_TEXTURE_2D, currentLevel, 0, currentRow, width, rows, format, GL_UNSIGNED_BYTE, (void*)0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		currentRow += rows;
+	}
+	GLStateCache::current().bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (currentRow == height) {
+		// Drivers pad RGB to four bytes a pixel
+		totals.residentBytes += (size_t)width * height * (currentImage.channels == 3 ? 4 : currentImage.channels);
+		currentLevel++;
+		currentRow = 0;
+		if (!currentImage.mips || currentLevel > (int)currentImage.mips->size()) {
+			finishUpload();
+		}
+	}
+	return sliceBytes;
+}
+
+// Levels of a baked image to upload
+int TextureStreamer::bakedLevelsUsed(const StreamedTexture& texture, const BakedTexture& baked) {
+	return usesMipmaps(texture.minFilter) ? baked.levelCount() : 1;
+}
+
+// Whether a minification filter samples mip levels
+bool TextureStreamer::usesMipmaps(GLint minFilter) {
+	return minFilter != GL_LINEAR && minFilter != GL_NEAREST;
+}
+
+// Uploads the next level of the current baked image straight from the mapped file
+size_t TextureStreamer::uploadBakedLevel() {
+	StreamedTexture& texture = textures[currentImage.handle];
+	BakedTexture::Level level = currentImage.baked->level(currentLevel);
+
+	GLStateCache::current().bindTexture(GL_TEXTURE_2D, texture.ID);
+	glCompressedTexImage2D(GL_TEXTURE_2D, currentLevel, currentImage.baked->glFormat(), level.width, level.height, 0, (GLsizei)level.size, level.data);
+	totals.residentBytes += level.size;
+	currentLevel++;
+
+	if (currentLevel == bakedLevelsUsed(texture, *currentImage.baked)) {
+		totals.baked++;
+		finishUpload();
+	}
+	return level.size;
+}
+
+// Frees the current image's pixels or mapping and marks its texture resident
+void TextureStreamer::finishUpload() {
+	textures[currentImage.handle].resident = true;
+	totals.loaded++;
+
+	// Cleanup, free image in memory
+	freeImage(currentImage);
+	uploading = false;
+}
+
+// Frees what a worker allocated for an image
+void TextureStreamer::freeImage(DecodedImage& image) {
+	stbi_image_free(image.pixels);
+	delete image.mips;
+	delete image.baked;
+	image.pixels = nullptr;
+	image.mips = nullptr;
+	image.baked = nullptr;
+}
\ No newline at end of file
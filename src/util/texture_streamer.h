@@ -0,0 +1,135 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "concurrent_queue.h"
+#include "thread_pool.h"
+#include "baked_texture.h"
+#include "mip_generator.h"
+
+// Totals over every texture loaded so far
+struct TextureStreamerStats {
+	int loaded;
+	// Loaded from block compressed files made by bakeTexture rather than decoded from the source image
+	int baked;
+	// Decoding or mapping and building mip chains on the workers, and uploading on the GL thread
+	double decodeMilliseconds;
+	double mipMilliseconds;
+	double uploadMilliseconds;
+	// Video memory the resident textures take, mips included. Uncompressed RGB counts as 4 bytes per pixel since drivers pad it
+	size_t residentBytes;
+};
+
+// Loads textures without blocking the render thread. Images are decoded on the thread pool,
+// handed back through a lock free queue and uploaded through pixel buffer objects a few rows
+// at a time, so no single frame pays for a whole upload. Until a texture is fully resident
+// texture() returns a placeholder. Textures sampled with mipmaps get their chain built on the
+// worker too, with sRGB correct box filtering, and each level streams in after the one above.
+//
+// When a baked version of an image exists in bakedDirectory and is still up to date, the worker only maps it
+// and its compressed levels are uploaded as they are, a level at a time, instead of decoding the source.
+class TextureStreamer {
+public:
+	// Pixel data a worker hands to the GL thread. Either pixels or baked is set, neither when loading failed.
+	// mips holds the levels below pixels when the texture is sampled with mipmaps
+	struct DecodedImage {
+		int handle;
+		unsigned char* pixels;
+		int width;
+		int height;
+		int channels;
+		std::vector<MipLevel>* mips;
+		BakedTexture* baked;
+		double decodeMilliseconds;
+		double mipMilliseconds;
+	};
+
+	// uploadBudget caps the number of bytes copied to the GPU per update call, an empty bakedDirectory always decodes the sources
+	TextureStreamer(ThreadPool& pool, size_t uploadBudget = 4 * 1024 * 1024, const std::string& bakedDirectory = "");
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	// Starts decoding an image and returns a handle for it
+	int request(const std::string& path, GLint wrap = GL_REPEAT, GLint minFilter = GL_LINEAR_MIPMAP_LINEAR, GLint magFilter = GL_LINEAR);
+
+	// The texture to bind for a handle, the placeholder until the image is resident
+	unsigned int texture(int handle) const;
+
+	// True once the image has been fully uploaded
+	bool isResident(int handle) const;
+
+	// Number of requested textures that aren't resident yet and haven't failed
+	int pendingCount() const;
+
+	// Must be called on the GL thread every frame, picks up decoded images and uploads the next slice
+	void update();
+
+	const TextureStreamerStats& stats() const;
+
+private:
+	struct StreamedTexture {
+		std::string path;
+		unsigned int ID;
+		GLint wrap;
+		GLint minFilter;
+		GLint magFilter;
+		bool resident;
+		bool failed;
+	};
+
+	ThreadPool& pool;
+	size_t uploadBudget;
+	std::string bakedDirectory;
+
+	// Only touched on the GL thread
+	std::vector<StreamedTexture> textures;
+	unsigned int placeholder;
+
+	// Double buffered so filling one slice never waits on the transfer of the previous one
+	unsigned int pixelBuffers[2];
+	int nextPixelBuffer;
+
+	// Decoded images waiting for upload, plus the one currently being uploaded and how far it's got.
+	// Baked images go a whole level at a time
+	ConcurrentQueue<DecodedImage> decodedImages;
+	DecodedImage currentImage;
+	int currentLevel;
+	int currentRow;
+	bool uploading;
+
+	TextureStreamerStats totals;
+
+	// Images still being decoded by the pool
+	std::atomic<int> decodesInFlight;
+
+	// Creates the GL texture for a decoded image and starts its upload
+	void beginUpload(const DecodedImage& image);
+
+	// Copies up to byteBudget bytes of the current image's current level, returns the number of bytes copied
+	size_t uploadSlice(size_t byteBudget);
+
+	// Uploads the next level of the current baked image, returns its size
+	size_t uploadBakedLevel();
+
+	// Levels of a baked image to upload, just the first unless the texture is sampled with mipmaps
+	static int bakedLevelsUsed(const StreamedTexture& texture, const BakedTexture& baked);
+
+	// Whether a minification filter samples mip levels
+	static bool usesMipmaps(GLint minFilter);
+
+	// Frees the current image's pixels or mapping and marks its texture resident
+	void finishUpload();
+
+	// Frees what a worker allocated for an image
+	static void freeImage(DecodedImage& image);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "thread_pool.h"
+
+#include <memory>
+
+// Starts the worker threads
+ThreadPool::ThreadPool(unsigned int threadCount) : stopping(false) {
+	if (threadCount == 0) {
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+	for (unsigned int i = 0; i < threadCount; i++) {
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+// Finishes queued tasks and joins the workers
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+// Number of threads that take part in parallelFor, including the calling thread
+unsigned int ThreadPool::concurrency() const {
+	return (unsigned int)workers.size() + 1;
+}
+
+// Queues a task to run on one of the workers
+void ThreadPool::submit(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	condition.notify_one();
+}
+
+// Splits [0, count) into ranges and runs them on the workers and the calling thread
+void ThreadPool::parallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)>& body) {
+	if (count == 0) {
+		return;
+	}
+	if (grainSize == 0) {
+		grainSize = 1;
+	}
+	size_t rangeCount = (count + grainSize - 1) / grainSize;
+
+	// Not worth waking anyone up for a single range
+	if (rangeCount == 1 || workers.empty()) {
+		body(0, count);
+		return;
+	}
+
+	// Ranges are claimed from a shared counter so faster threads simply take more of them.
+	// Helpers hold the state by shared_ptr since they may only get scheduled after we've returned
+	struct Job {
+		std::atomic<size_t> nextRange{ 0 };
+		std::atomic<size_t> finishedRanges{ 0 };
+	};
+	std::shared_ptr<Job> job = std::make_shared<Job>();
+	const std::function<void(size_t, size_t)>* bodyPtr = &body;
+
+	auto runRanges = [job, bodyPtr, count, grainSize, rangeCount]() {
+		size_t range;
+		while ((range = job->nextRange.fetch_add(1)) < rangeCount) {
+			size_t begin = range * grainSize;
+			size_t end = begin + grainSize < count ? begin + grainSize : count;
+			(*bodyPtr)(begin, end);
+			job->finishedRanges.fetch_add(1, std::memory_order_release);
+		}
+	};
+
+	size_t helpers = rangeCount - 1 < workers.size() ? rangeCount - 1 : workers.size();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < helpers; i++) {
+			tasks.push_back(runRanges);
+		}
+	}
+	condition.notify_all();
+
+	runRanges();
+
+	// Every range has been claimed, wait for the ones still running on other threads
+	while (job->finishedRanges.load(std::memory_order_acquire) < rangeCount) {
+		std::this_thread::yield();
+	}
+}
+
+// Loop run by every worker thread
+void ThreadPool::workerLoop() {
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty()) {
+				return;
+			}
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
\ No newline at end of file
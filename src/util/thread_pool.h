@@ -0,0 +1,45 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads used to spread CPU work such as transform updates across cores
+class ThreadPool {
+public:
+	// Starts threadCount workers, 0 picks one less than the number of hardware threads
+	// since the thread calling parallelFor also does work
+	ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Number of threads that take part in parallelFor, including the calling thread
+	unsigned int concurrency() const;
+
+	// Queues a task to run on one of the workers
+	void submit(std::function<void()> task);
+
+	// Splits [0, count) into ranges of grainSize elements and runs body on each range,
+	// the calling thread helps out and the call returns once every range is done
+	void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)>& body);
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping;
+
+	// Loop run by every worker thread
+	void workerLoop();
+};
+
+#endif
\ No newline at end of file
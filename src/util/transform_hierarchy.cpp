@@ -0,0 +1,211 @@
+#include "transform_hierarchy.h"
+#include "cpu_profiler.h"
+
+#include <algorithm>
+#include <atomic>
+
+// Nodes per parallelFor range, a level smaller than this is updated on the calling thread
+static const size_t HIERARCHY_GRAIN_SIZE = 4096;
+
+const uint32_t TransformHierarchy::NO_PARENT;
+
+TransformHierarchy::TransformHierarchy() : levelStarts(1, 0), ordered(true), updateNumber(0), updated(0) {
+}
+
+// Appends a node, it finds its place in breadth first order at the next update
+uint32_t TransformHierarchy::add(uint32_t parent, const glm::mat4& local) {
+	uint32_t node = (uint32_t)nodePositions.size();
+	uint32_t position = (uint32_t)locals.size();
+
+	locals.push_back(local);
+	worlds.push_back(local);
+	parents.push_back(parent == NO_PARENT ? NO_PARENT : nodePositions[parent]);
+	dirty.push_back(1);
+	updatedIn.push_back(0);
+	positionNodes.push_back(node);
+	nodePositions.push_back(position);
+
+	ordered = false;
+	return node;
+}
+
+// Removes every node
+void TransformHierarchy::clear() {
+	locals.clear();
+	worlds.clear();
+	parents.clear();
+	dirty.clear();
+	updatedIn.clear();
+	positionNodes.clear();
+	nodePositions.clear();
+	levelStarts.assign(1, 0);
+	dirtyLevels.clear();
+	ordered = true;
+	updated = 0;
+}
+
+// Replaces a node's local matrix and marks it and its level dirty
+void TransformHierarchy::setLocal(uint32_t node, const glm::mat4& local) {
+	uint32_t position = nodePositions[node];
+	locals[position] = local;
+	dirty[position] = 1;
+	// Unordered hierarchies are recomputed whole by the next update anyway
+	if (ordered) {
+		size_t level = std::upper_bound(levelStarts.begin(), levelStarts.end(), (size_t)position) - levelStarts.begin() - 1;
+		dirtyLevels[level] = 1;
+	}
+}
+
+// Marks every node dirty
+void TransformHierarchy::invalidate() {
+	std::fill(dirty.begin(), dirty.end(), 1);
+	std::fill(dirtyLevels.begin(), dirtyLevels.end(), 1);
+}
+
+const glm::mat4& TransformHierarchy::local(uint32_t node) const {
+	return locals[nodePositions[node]];
+}
+
+// World matrix as of the last update
+const glm::mat4& TransformHierarchy::world(uint32_t node) const {
+	return worlds[nodePositions[node]];
+}
+
+// Walks the levels top down. A level is only scanned when setLocal touched it or the level above recomputed something,
+// and within it only dirty nodes and children of recomputed ones are multiplied
+void TransformHierarchy::update(ThreadPool* pool) {
+	PROFILE_ZONE("Update hierarchy");
+	if (!ordered) {
+		sortBreadthFirst();
+	}
+
+	// Stamps from before a wrap around could match again, so they're reset first
+	updateNumber++;
+	if (updateNumber == 0) {
+		std::fill(updatedIn.begin(), updatedIn.end(), 0);
+		updateNumber = 1;
+	}
+
+	updated = 0;
+	bool parentLevelUpdated = false;
+	for (size_t level = 0; level + 1 < levelStarts.size(); level++) {
+		if (!dirtyLevels[level] && !parentLevelUpdated) {
+			continue;
+		}
+		dirtyLevels[level] = 0;
+
+		size_t begin = levelStarts[level];
+		size_t count = levelStarts[level + 1] - begin;
+		size_t levelUpdated;
+		if (pool == nullptr || count <= HIERARCHY_GRAIN_SIZE) {
+			levelUpdated = updateRange(begin, begin + count);
+		}
+		else {
+			std::atomic<size_t> rangeUpdated(0);
+			pool->parallelFor(count, HIERARCHY_GRAIN_SIZE, [this, begin, &rangeUpdated](size_t rangeBegin, size_t rangeEnd) {
+				rangeUpdated += updateRange(begin + rangeBegin, begin + rangeEnd);
+			});
+			levelUpdated = rangeUpdated;
+		}
+		updated += levelUpdated;
+		parentLevelUpdated = levelUpdated > 0;
+	}
+}
+
+// Number of nodes
+size_t TransformHierarchy::size() const {
+	return locals.size();
+}
+
+// Number of depth levels as of the last update
+size_t TransformHierarchy::depth() const {
+	return levelStarts.size() - 1;
+}
+
+// Nodes whose world matrix the last update recomputed
+size_t TransformHierarchy::updatedCount() const {
+	return updated;
+}
+
+// Breadth first from the roots, children listed per parent with a counting sort
+void TransformHierarchy::sortBreadthFirst() {
+	PROFILE_ZONE("Sort hierarchy");
+	size_t count = locals.size();
+
+	std::vector<uint32_t> childStarts(count + 1, 0);
+	for (size_t i = 0; i < count; i++) {
+		if (parents[i] != NO_PARENT) {
+			childStarts[parents[i] + 1]++;
+		}
+	}
+	for (size_t i = 0; i < count; i++) {
+		childStarts[i + 1] += childStarts[i];
+	}
+	std::vector<uint32_t> children(childStarts[count]);
+	std::vector<uint32_t> nextChild(childStarts.begin(), childStarts.end() - 1);
+	for (size_t i = 0; i < count; i++) {
+		if (parents[i] != NO_PARENT) {
+			children[nextChild[parents[i]]++] = (uint32_t)i;
+		}
+	}
+
+	// Each pass appends the children of the level before, which makes the next level
+	std::vector<uint32_t> order;
+	order.reserve(count);
+	for (size_t i = 0; i < count; i++) {
+		if (parents[i] == NO_PARENT) {
+			order.push_back((uint32_t)i);
+		}
+	}
+	levelStarts.assign(1, 0);
+	for (size_t levelBegin = 0; levelBegin < order.size();) {
+		size_t levelEnd = order.size();
+		levelStarts.push_back(levelEnd);
+		for (size_t i = levelBegin; i < levelEnd; i++) {
+			uint32_t parent = order[i];
+			order.insert(order.end(), children.begin() + childStarts[parent], children.begin() + childStarts[parent + 1]);
+		}
+		levelBegin = levelEnd;
+	}
+
+	std::vector<uint32_t> newPositions(count);
+	for (size_t i = 0; i < count; i++) {
+		newPositions[order[i]] = (uint32_t)i;
+	}
+	std::vector<glm::mat4> sortedLocals(count);
+	std::vector<uint32_t> sortedParents(count);
+	std::vector<uint32_t> sortedNodes(count);
+	for (size_t i = 0; i < count; i++) {
+		uint32_t old = order[i];
+		sortedLocals[i] = locals[old];
+		sortedParents[i] = parents[old] == NO_PARENT ? NO_PARENT : newPositions[parents[old]];
+		sortedNodes[i] = positionNodes[old];
+		nodePositions[sortedNodes[i]] = (uint32_t)i;
+	}
+	locals.swap(sortedLocals);
+	parents.swap(sortedParents);
+	positionNodes.swap(sortedNodes);
+
+	// Every world matrix is rebuilt, parents having moved is as good as them all changing
+	std::fill(dirty.begin(), dirty.end(), 1);
+	std::fill(updatedIn.begin(), updatedIn.end(), 0);
+	dirtyLevels.assign(levelStarts.size() - 1, 1);
+	ordered = true;
+}
+
+// Recomputes nodes that were set or whose parent was recomputed earlier in this update
+size_t TransformHierarchy::updateRange(size_t begin, size_t end) {
+	size_t count = 0;
+	for (size_t i = begin; i < end; i++) {
+		uint32_t parent = parents[i];
+		bool parentUpdated = parent != NO_PARENT && updatedIn[parent] == updateNumber;
+		if (!dirty[i] && !parentUpdated) {
+			continue;
+		}
+		worlds[i] = parent == NO_PARENT ? locals[i] : worlds[parent] * locals[i];
+		dirty[i] = 0;
+		updatedIn[i] = updateNumber;
+		count++;
+	}
+	return count;
+}
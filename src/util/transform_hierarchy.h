@@ -0,0 +1,86 @@
+#ifndef TRANSFORM_HIERARCHY_H
+#define TRANSFORM_HIERARCHY_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "thread_pool.h"
+
+// Parent / child transforms, each node's world matrix being its parent's world matrix times its own local one.
+// Nodes are stored breadth first in flat arrays, so every depth level is one contiguous range whose parents all sit in
+// the level before it. Setting a local matrix marks the node dirty and update only recomputes dirty nodes and the
+// subtrees below them, one level after another with each level split across a thread pool.
+//
+// Node handles are stable, the breadth first order is rebuilt by the first update after nodes are added
+class TransformHierarchy {
+public:
+	// Parent of root nodes
+	static const uint32_t NO_PARENT = 0xFFFFFFFFu;
+
+	TransformHierarchy();
+
+	// Adds a node under parent, which must already exist, or a root with NO_PARENT, and returns its handle. Its world
+	// matrix is valid after the next update
+	uint32_t add(uint32_t parent, const glm::mat4& local);
+
+	// Removes every node
+	void clear();
+
+	// Replaces a node's local matrix, the node and everything below it are recomputed by the next update
+	void setLocal(uint32_t node, const glm::mat4& local);
+
+	// Marks every node dirty, so the next update recomputes the whole hierarchy
+	void invalidate();
+
+	const glm::mat4& local(uint32_t node) const;
+
+	// World matrix as of the last update
+	const glm::mat4& world(uint32_t node) const;
+
+	// Recomputes the world matrices of dirty nodes and their descendants, spread over the pool when one is given
+	void update(ThreadPool* pool = nullptr);
+
+	// Number of nodes
+	size_t size() const;
+
+	// Number of depth levels as of the last update, 1 when there are only roots
+	size_t depth() const;
+
+	// Nodes whose world matrix the last update recomputed
+	size_t updatedCount() const;
+
+private:
+	// Indexed by position in breadth first order
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> worlds;
+	std::vector<uint32_t> parents;
+	// Set by setLocal, cleared once the node is recomputed
+	std::vector<uint8_t> dirty;
+	// Update number that last recomputed the node, children compare their parent's against the current one
+	std::vector<uint32_t> updatedIn;
+	std::vector<uint32_t> positionNodes;
+
+	// Indexed by handle
+	std::vector<uint32_t> nodePositions;
+
+	// Level n holds positions [levelStarts[n], levelStarts[n + 1])
+	std::vector<size_t> levelStarts;
+	// Levels holding a node setLocal marked since the last update
+	std::vector<uint8_t> dirtyLevels;
+
+	// False after adding nodes, until update puts them in breadth first order
+	bool ordered;
+	uint32_t updateNumber;
+	size_t updated;
+
+	// Reorders every array breadth first, siblings together in the order their parents are in, and finds the levels
+	void sortBreadthFirst();
+
+	// Recomputes the dirty nodes among positions [begin, end) of one level, returns how many it recomputed
+	size_t updateRange(size_t begin, size_t end);
+};
+
+#endif
@@ -0,0 +1,370 @@
+#include "transform_system.h"
+#include "cpu_profiler.h"
+#include "cpu_features.h"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_SYSTEM_SSE
+#include <emmintrin.h>
+// AVX2 code is compiled per function below, so it's available without building the whole engine for AVX2
+#if defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER)
+#define TRANSFORM_SYSTEM_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(TRANSFORM_SYSTEM_AVX2) && (defined(__GNUC__) || defined(__clang__))
+#define TRANSFORM_AVX2_FUNCTION __attribute__((target("avx2")))
+#else
+#define TRANSFORM_AVX2_FUNCTION
+#endif
+
+// Objects per parallelFor range, large enough that scheduling is noise next to the math
+static const size_t TRANSFORM_GRAIN_SIZE = 4096;
+
+static const char* KERNEL_NAMES[] = { "scalar", "sse2", "avx2" };
+
+// ------------------------------------------------ SSE2 ------------------------------------------------------
+#ifdef TRANSFORM_SYSTEM_SSE
+// Sine and cosine of four angles at once, Cephes style range reduction and minimax polynomials.
+// Accurate to a couple of ulps for angles up to a few thousand radians.
+static inline void sinCos4(__m128 x, __m128* sinOut, __m128* cosOut) {
+	const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128i two = _mm_set1_epi32(2);
+	const __m128i four = _mm_set1_epi32(4);
+
+	__m128 sinSign = _mm_and_ps(x, signMask);
+	x = _mm_andnot_ps(signMask, x);
+
+	// Find the octant, rounding to an even value so we only deal with the 0 and pi/2 polynomials
+	__m128 y = _mm_mul_ps(x, _mm_set1_ps(1.27323954473516f));
+	__m128i octant = _mm_cvttps_epi32(y);
+	octant = _mm_add_epi32(octant, one);
+	octant = _mm_and_si128(octant, _mm_set1_epi32(~1));
+	y = _mm_cvtepi32_ps(octant);
+
+	__m128 sinSwap = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(octant, four), 29));
+	__m128 polyMask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(octant, two), _mm_setzero_si128()));
+	__m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(octant, two), four), 29));
+	sinSign = _mm_xor_ps(sinSign, sinSwap);
+
+	// Extended precision x - y * pi/4
+	x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-0.78515625f)));
+	x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-2.4187564849853515625e-4f)));
+	x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(-3.77489497744594108e-8f)));
+	__m128 z = _mm_mul_ps(x, x);
+
+	// Cosine polynomial on [-pi/4, pi/4]
+	__m128 cosPoly = _mm_set1_ps(2.443315711809948e-5f);
+	cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(-1.388731625493765e-3f));
+	cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(4.166664568298827e-2f));
+	cosPoly = _mm_mul_ps(_mm_mul_ps(cosPoly, z), z);
+	cosPoly = _mm_sub_ps(cosPoly, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+	cosPoly = _mm_add_ps(cosPoly, _mm_set1_ps(1.0f));
+
+	// Sine polynomial on [-pi/4, pi/4]
+	__m128 sinPoly = _mm_set1_ps(-1.9515295891e-4f);
+	sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(8.3321608736e-3f));
+	sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(-1.6666654611e-1f));
+	sinPoly = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPoly, z), x), x);
+
+	// Pick which polynomial gives the sine and which the cosine for each lane's octant
+	__m128 sinResult = _mm_or_ps(_mm_and_ps(polyMask, sinPoly), _mm_andnot_ps(polyMask, cosPoly));
+	__m128 cosResult = _mm_or_ps(_mm_and_ps(polyMask, cosPoly), _mm_andnot_ps(polyMask, sinPoly));
+
+	*sinOut = _mm_xor_ps(sinResult, sinSign);
+	*cosOut = _mm_xor_ps(cosResult, cosSign);
+}
+
+// Loads one member of four transforms
+#define LOAD4(transforms, i, member) _mm_setr_ps(transforms[i].member, transforms[i + 1].member, transforms[i + 2].member, transforms[i + 3].member)
+
+// Builds matrices four at a time from slot i on, returns the first slot it left for a narrower kernel
+template <typename Transforms>
+static size_t computeSSE2(float time, const Transforms& transforms, glm::mat4* out, size_t i, size_t end) {
+	const __m128 timeVector = _mm_set1_ps(time);
+	const __m128 oneVector = _mm_set1_ps(1.0f);
+	const __m128 zeroVector = _mm_setzero_ps();
+
+	// Each lane is one object, the matrix elements are transposed back into columns on the way out
+	for (; i + 4 <= end; i += 4) {
+		__m128 ax = LOAD4(transforms, i, spinAxis.x);
+		__m128 ay = LOAD4(transforms, i, spinAxis.y);
+		__m128 az = LOAD4(transforms, i, spinAxis.z);
+
+		__m128 s, c;
+		sinCos4(_mm_mul_ps(timeVector, LOAD4(transforms, i, spinSpeed)), &s, &c);
+		__m128 t = _mm_sub_ps(oneVector, c);
+
+		__m128 tx = _mm_mul_ps(t, ax);
+		__m128 ty = _mm_mul_ps(t, ay);
+		__m128 tz = _mm_mul_ps(t, az);
+		__m128 sx = _mm_mul_ps(s, ax);
+		__m128 sy = _mm_mul_ps(s, ay);
+		__m128 sz = _mm_mul_ps(s, az);
+
+		__m128 scaleX = LOAD4(transforms, i, scale.x);
+		__m128 scaleY = LOAD4(transforms, i, scale.y);
+		__m128 scaleZ = LOAD4(transforms, i, scale.z);
+
+		__m128 column0x = _mm_mul_ps(_mm_add_ps(c, _mm_mul_ps(tx, ax)), scaleX);
+		__m128 column0y = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(tx, ay), sz), scaleX);
+		__m128 column0z = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(tx, az), sy), scaleX);
+		__m128 column0w = zeroVector;
+
+		__m128 column1x = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(ty, ax), sz), scaleY);
+		__m128 column1y = _mm_mul_ps(_mm_add_ps(c, _mm_mul_ps(ty, ay)), scaleY);
+		__m128 column1z = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ty, az), sx), scaleY);
+		__m128 column1w = zeroVector;
+
+		__m128 column2x = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(tz, ax), sy), scaleZ);
+		__m128 column2y = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(tz, ay), sx), scaleZ);
+		__m128 column2z = _mm_mul_ps(_mm_add_ps(c, _mm_mul_ps(tz, az)), scaleZ);
+		__m128 column2w = zeroVector;
+
+		__m128 column3x = LOAD4(transforms, i, position.x);
+		__m128 column3y = LOAD4(transforms, i, position.y);
+		__m128 column3z = LOAD4(transforms, i, position.z);
+		__m128 column3w = oneVector;
+
+		_MM_TRANSPOSE4_PS(column0x, column0y, column0z, column0w);
+		_MM_TRANSPOSE4_PS(column1x, column1y, column1z, column1w);
+		_MM_TRANSPOSE4_PS(column2x, column2y, column2z, column2w);
+		_MM_TRANSPOSE4_PS(column3x, column3y, column3z, column3w);
+
+		// After transposing, register n of column k holds column k of object i + n
+		float* m0 = &out[i][0][0];
+		float* m1 = &out[i + 1][0][0];
+		float* m2 = &out[i + 2][0][0];
+		float* m3 = &out[i + 3][0][0];
+		_mm_storeu_ps(m0, column0x);      _mm_storeu_ps(m1, column0y);      _mm_storeu_ps(m2, column0z);      _mm_storeu_ps(m3, column0w);
+		_mm_storeu_ps(m0 + 4, column1x);  _mm_storeu_ps(m1 + 4, column1y);  _mm_storeu_ps(m2 + 4, column1z);  _mm_storeu_ps(m3 + 4, column1w);
+		_mm_storeu_ps(m0 + 8, column2x);  _mm_storeu_ps(m1 + 8, column2y);  _mm_storeu_ps(m2 + 8, column2z);  _mm_storeu_ps(m3 + 8, column2w);
+		_mm_storeu_ps(m0 + 12, column3x); _mm_storeu_ps(m1 + 12, column3y); _mm_storeu_ps(m2 + 12, column3z); _mm_storeu_ps(m3 + 12, column3w);
+	}
+	return i;
+}
+#endif
+
+// ------------------------------------------------ AVX2 ------------------------------------------------------
+#ifdef TRANSFORM_SYSTEM_AVX2
+// sinCos4 on eight angles, the same operations in the same order so both kernels give bit identical matrices
+TRANSFORM_AVX2_FUNCTION static inline void sinCos8(__m256 x, __m256* sinOut, __m256* cosOut) {
+	const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32((int)0x80000000));
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i two = _mm256_set1_epi32(2);
+	const __m256i four = _mm256_set1_epi32(4);
+
+	__m256 sinSign = _mm256_and_ps(x, signMask);
+	x = _mm256_andnot_ps(signMask, x);
+
+	__m256 y = _mm256_mul_ps(x, _mm256_set1_ps(1.27323954473516f));
+	__m256i octant = _mm256_cvttps_epi32(y);
+	octant = _mm256_add_epi32(octant, one);
+	octant = _mm256_and_si256(octant, _mm256_set1_epi32(~1));
+	y = _mm256_cvtepi32_ps(octant);
+
+	__m256 sinSwap = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(octant, four), 29));
+	__m256 polyMask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(octant, two), _mm256_setzero_si256()));
+	__m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(octant, two), four), 29));
+	sinSign = _mm256_xor_ps(sinSign, sinSwap);
+
+	x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(-0.78515625f)));
+	x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(-2.4187564849853515625e-4f)));
+	x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(-3.77489497744594108e-8f)));
+	__m256 z = _mm256_mul_ps(x, x);
+
+	__m256 cosPoly = _mm256_set1_ps(2.443315711809948e-5f);
+	cosPoly = _mm256_add_ps(_mm256_mul_ps(cosPoly, z), _mm256_set1_ps(-1.388731625493765e-3f));
+	cosPoly = _mm256_add_ps(_mm256_mul_ps(cosPoly, z), _mm256_set1_ps(4.166664568298827e-2f));
+	cosPoly = _mm256_mul_ps(_mm256_mul_ps(cosPoly, z), z);
+	cosPoly = _mm256_sub_ps(cosPoly, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+	cosPoly = _mm256_add_ps(cosPoly, _mm256_set1_ps(1.0f));
+
+	__m256 sinPoly = _mm256_set1_ps(-1.9515295891e-4f);
+	sinPoly = _mm256_add_ps(_mm256_mul_ps(sinPoly, z), _mm256_set1_ps(8.3321608736e-3f));
+	sinPoly = _mm256_add_ps(_mm256_mul_ps(sinPoly, z), _mm256_set1_ps(-1.6666654611e-1f));
+	sinPoly = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(sinPoly, z), x), x);
+
+	__m256 sinResult = _mm256_blendv_ps(cosPoly, sinPoly, polyMask);
+	__m256 cosResult = _mm256_blendv_ps(sinPoly, cosPoly, polyMask);
+
+	*sinOut = _mm256_xor_ps(sinResult, sinSign);
+	*cosOut = _mm256_xor_ps(cosResult, cosSign);
+}
+
+// Loads one member of eight transforms
+#define LOAD8(transforms, i, member) _mm256_setr_ps(transforms[i].member, transforms[i + 1].member, transforms[i + 2].member, transforms[i + 3].member, \
+	transforms[i + 4].member, transforms[i + 5].member, transforms[i + 6].member, transforms[i + 7].member)
+
+// Writes column k of objects i to i + 7, given its x, y, z and w with one object per lane
+TRANSFORM_AVX2_FUNCTION static inline void storeColumn8(glm::mat4* out, size_t i, int column, __m256 x, __m256 y, __m256 z, __m256 w) {
+	__m128 x0 = _mm256_castps256_ps128(x), y0 = _mm256_castps256_ps128(y), z0 = _mm256_castps256_ps128(z), w0 = _mm256_castps256_ps128(w);
+	__m128 x1 = _mm256_extractf128_ps(x, 1), y1 = _mm256_extractf128_ps(y, 1), z1 = _mm256_extractf128_ps(z, 1), w1 = _mm256_extractf128_ps(w, 1);
+	_MM_TRANSPOSE4_PS(x0, y0, z0, w0);
+	_MM_TRANSPOSE4_PS(x1, y1, z1, w1);
+	_mm_storeu_ps(&out[i][column][0], x0);
+	_mm_storeu_ps(&out[i + 1][column][0], y0);
+	_mm_storeu_ps(&out[i + 2][column][0], z0);
+	_mm_storeu_ps(&out[i + 3][column][0], w0);
+	_mm_storeu_ps(&out[i + 4][column][0], x1);
+	_mm_storeu_ps(&out[i + 5][column][0], y1);
+	_mm_storeu_ps(&out[i + 6][column][0], z1);
+	_mm_storeu_ps(&out[i + 7][column][0], w1);
+}
+
+// Builds matrices eight at a time from slot i on, returns the first slot it left for a narrower kernel
+template <typename Transforms>
+TRANSFORM_AVX2_FUNCTION static size_t computeAVX2(float time, const Transforms& transforms, glm::mat4* out, size_t i, size_t end) {
+	const __m256 timeVector = _mm256_set1_ps(time);
+	const __m256 oneVector = _mm256_set1_ps(1.0f);
+	const __m256 zeroVector = _mm256_setzero_ps();
+
+	for (; i + 8 <= end; i += 8) {
+		__m256 ax = LOAD8(transforms, i, spinAxis.x);
+		__m256 ay = LOAD8(transforms, i, spinAxis.y);
+		__m256 az = LOAD8(transforms, i, spinAxis.z);
+
+		__m256 s, c;
+		sinCos8(_mm256_mul_ps(timeVector, LOAD8(transforms, i, spinSpeed)), &s, &c);
+		__m256 t = _mm256_sub_ps(oneVector, c);
+
+		__m256 tx = _mm256_mul_ps(t, ax);
+		__m256 ty = _mm256_mul_ps(t, ay);
+		__m256 tz = _mm256_mul_ps(t, az);
+		__m256 sx = _mm256_mul_ps(s, ax);
+		__m256 sy = _mm256_mul_ps(s, ay);
+		__m256 sz = _mm256_mul_ps(s, az);
+
+		__m256 scaleX = LOAD8(transforms, i, scale.x);
+		__m256 scaleY = LOAD8(transforms, i, scale.y);
+		__m256 scaleZ = LOAD8(transforms, i, scale.z);
+
+		storeColumn8(out, i, 0,
+			_mm256_mul_ps(_mm256_add_ps(c, _mm256_mul_ps(tx, ax)), scaleX),
+			_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(tx, ay), sz), scaleX),
+			_mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(tx, az), sy), scaleX),
+			zeroVector);
+		storeColumn8(out, i, 1,
+			_mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(ty, ax), sz), scaleY),
+			_mm256_mul_ps(_mm256_add_ps(c, _mm256_mul_ps(ty, ay)), scaleY),
+			_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(ty, az), sx), scaleY),
+			zeroVector);
+		storeColumn8(out, i, 2,
+			_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(tz, ax), sy), scaleZ),
+			_mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(tz, ay), sx), scaleZ),
+			_mm256_mul_ps(_mm256_add_ps(c, _mm256_mul_ps(tz, az)), scaleZ),
+			zeroVector);
+		storeColumn8(out, i, 3, LOAD8(transforms, i, position.x), LOAD8(transforms, i, position.y), LOAD8(transforms, i, position.z), oneVector);
+	}
+	return i;
+}
+#endif
+
+// ------------------------------------------------ Scalar ----------------------------------------------------
+// Builds the matrices of slots [i, end) one at a time, for the leftovers or everything when no SIMD kernel runs
+template <typename Transforms>
+static void computeScalar(float time, const Transforms& transforms, glm::mat4* out, size_t i, size_t end) {
+	for (; i < end; i++) {
+		const TransformComponent& transform = transforms[i];
+		float angle = time * transform.spinSpeed;
+		float s = std::sin(angle);
+		float c = std::cos(angle);
+		float t = 1.0f - c;
+		float ax = transform.spinAxis.x, ay = transform.spinAxis.y, az = transform.spinAxis.z;
+		glm::vec3 scale = transform.scale;
+
+		glm::mat4& m = out[i];
+		m[0][0] = (c + t * ax * ax) * scale.x;      m[0][1] = (t * ax * ay + s * az) * scale.x; m[0][2] = (t * ax * az - s * ay) * scale.x; m[0][3] = 0.0f;
+		m[1][0] = (t * ay * ax - s * az) * scale.y; m[1][1] = (c + t * ay * ay) * scale.y;      m[1][2] = (t * ay * az + s * ax) * scale.y; m[1][3] = 0.0f;
+		m[2][0] = (t * az * ax + s * ay) * scale.z; m[2][1] = (t * az * ay - s * ax) * scale.z; m[2][2] = (c + t * az * az) * scale.z;      m[2][3] = 0.0f;
+		m[3][0] = transform.position.x;             m[3][1] = transform.position.y;             m[3][2] = transform.position.z;             m[3][3] = 1.0f;
+	}
+}
+
+// Builds the matrices of output slots [begin, end) from transforms[i], matching glm::translate, glm::rotate and
+// glm::scale in that order. Transforms is indexed like an array of TransformComponent, either the components
+// themselves or a list of pointers to them. Each kernel hands what's left over to the next narrower one
+template <typename Transforms>
+static void computeRange(float time, const Transforms& transforms, glm::mat4* out, size_t begin, size_t end, TransformKernel kernel) {
+	PROFILE_ZONE("Compute matrices");
+	if (!isTransformKernelSupported(kernel)) {
+		kernel = TRANSFORM_KERNEL_SCALAR;
+	}
+	size_t i = begin;
+#ifdef TRANSFORM_SYSTEM_AVX2
+	if (kernel == TRANSFORM_KERNEL_AVX2) {
+		i = computeAVX2(time, transforms, out, i, end);
+	}
+#endif
+#ifdef TRANSFORM_SYSTEM_SSE
+	if (kernel != TRANSFORM_KERNEL_SCALAR) {
+		i = computeSSE2(time, transforms, out, i, end);
+	}
+#endif
+	computeScalar(time, transforms, out, i, end);
+}
+
+// True when the kernel was compiled in and the CPU can run it
+bool isTransformKernelSupported(TransformKernel kernel) {
+	switch (kernel) {
+	case TRANSFORM_KERNEL_SCALAR:
+		return true;
+	case TRANSFORM_KERNEL_SSE2:
+#ifdef TRANSFORM_SYSTEM_SSE
+		return true;
+#else
+		return false;
+#endif
+	case TRANSFORM_KERNEL_AVX2: {
+#ifdef TRANSFORM_SYSTEM_AVX2
+		static const bool supported = cpuSupportsAVX2();
+		return supported;
+#else
+		return false;
+#endif
+	}
+	}
+	return false;
+}
+
+// Fastest kernel both this build and the CPU support
+TransformKernel bestTransformKernel() {
+	if (isTransformKernelSupported(TRANSFORM_KERNEL_AVX2)) {
+		return TRANSFORM_KERNEL_AVX2;
+	}
+	return isTransformKernelSupported(TRANSFORM_KERNEL_SSE2) ? TRANSFORM_KERNEL_SSE2 : TRANSFORM_KERNEL_SCALAR;
+}
+
+// Short name such as "avx2"
+const char* transformKernelName(TransformKernel kernel) {
+	return KERNEL_NAMES[kernel];
+}
+
+// Indexes a list of pointers like an array of components
+struct TransformList {
+	const TransformComponent* const* pointers;
+
+	const TransformComponent& operator[](size_t i) const {
+		return *pointers[i];
+	}
+};
+
+// Builds the matrices of consecutive transforms
+void computeModelMatrices(float time, const TransformComponent* transforms, size_t count, glm::mat4* out, TransformKernel kernel) {
+	computeRange(time, transforms, out, 0, count, kernel);
+}
+
+// Builds the matrices of the listed transforms, spread over the pool when one is given
+void computeModelMatrices(float time, const TransformComponent* const* transforms, size_t count, glm::mat4* out, ThreadPool* pool, TransformKernel kernel) {
+	TransformList list = { transforms };
+	if (pool == nullptr) {
+		computeRange(time, list, out, 0, count, kernel);
+		return;
+	}
+	pool->parallelFor(count, TRANSFORM_GRAIN_SIZE, [list, time, out, kernel](size_t begin, size_t end) {
+		computeRange(time, list, out, begin, end, kernel);
+	});
+}
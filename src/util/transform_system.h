@@ -0,0 +1,38 @@
+#ifndef TRANSFORM_SYSTEM_H
+#define TRANSFORM_SYSTEM_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+#include "thread_pool.h"
+#include "world.h"
+
+// Instruction sets the matrix kernels are written for, eight objects at a time with AVX2 and four with SSE2. All give
+// bit identical results, only the speed differs
+enum TransformKernel {
+	TRANSFORM_KERNEL_SCALAR = 0,
+	TRANSFORM_KERNEL_SSE2 = 1,
+	TRANSFORM_KERNEL_AVX2 = 2
+};
+
+// Fastest kernel both this build and the CPU running it support
+TransformKernel bestTransformKernel();
+
+// True when the kernel was compiled in and the CPU can run it
+bool isTransformKernelSupported(TransformKernel kernel);
+
+// Short name such as "avx2"
+const char* transformKernelName(TransformKernel kernel);
+
+// Builds the model matrices of transform components with the fastest kernel unless told otherwise. out may point
+// straight into a mapped instance buffer
+
+// Matrices of count consecutive transforms, such as one chunk of a World
+void computeModelMatrices(float time, const TransformComponent* transforms, size_t count, glm::mat4* out, TransformKernel kernel = bestTransformKernel());
+
+// Matrices of the count transforms listed, packed into out[0, count), for drawing a culled subset. Split across the
+// pool when one is given
+void computeModelMatrices(float time, const TransformComponent* const* transforms, size_t count, glm::mat4* out, ThreadPool* pool = nullptr, TransformKernel kernel = bestTransformKernel());
+
+#endif
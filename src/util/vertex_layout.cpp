@@ -0,0 +1,469 @@
+#include "vertex_layout.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Vertices packed per parallelFor range
+static const size_t PACK_GRAIN_SIZE = 16 * 1024;
+
+// Bytes one component of a GL type takes
+size_t vertexComponentBytes(GLenum type) {
+	switch (type) {
+	case GL_BYTE:
+	case GL_UNSIGNED_BYTE:
+		return 1;
+	case GL_SHORT:
+	case GL_UNSIGNED_SHORT:
+	case GL_HALF_FLOAT:
+		return 2;
+	default:
+		return 4;
+	}
+}
+
+// Bytes a whole attribute takes
+size_t vertexAttributeBytes(uint32_t components, GLenum type) {
+	if (type == GL_INT_2_10_10_10_REV || type == GL_UNSIGNED_INT_2_10_10_10_REV) {
+		return 4;
+	}
+	return components * vertexComponentBytes(type);
+}
+
+// Appends an attribute after the last one
+void addVertexAttribute(VertexLayout& layout, uint32_t location, uint32_t components, GLenum type, bool normalized) {
+	VertexAttribute& attribute = layout.attributes[layout.attributeCount++];
+	attribute.location = location;
+	attribute.components = components;
+	attribute.type = type;
+	attribute.normalized = normalized ? 1 : 0;
+	attribute.offset = layout.stride;
+
+	// Attributes that don't start on a 4 byte boundary are slow to fetch or not supported at all on some GPUs
+	size_t bytes = vertexAttributeBytes(components, type);
+	layout.stride += (uint32_t)((bytes + 3) & ~(size_t)3);
+}
+
+// Points and enables every attribute of the layout
+void applyVertexLayout(const VertexLayout& layout) {
+	for (uint32_t i = 0; i < layout.attributeCount; i++) {
+		const VertexAttribute& attribute = layout.attributes[i];
+		glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized ? GL_TRUE : GL_FALSE, layout.stride, (void*)(size_t)attribute.offset);
+		glEnableVertexAttribArray(attribute.location);
+	}
+}
+
+// Nearest half precision float, rounding to even. Values too large become infinity, NaN stays NaN
+uint16_t floatToHalf(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t magnitude = bits & 0x7FFFFFFF;
+
+	if (magnitude >= 0x7F800000) {
+		return (uint16_t)(sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0));
+	}
+	// At or past 65520 the value rounds up to infinity
+	if (magnitude >= 0x477FF000) {
+		return (uint16_t)(sign | 0x7C00);
+	}
+	// Below the smallest normal half the mantissa is shifted into a denormal, rounding on the bits shifted out
+	if (magnitude < 0x38800000) {
+		if (magnitude < 0x33000000) {
+			return (uint16_t)sign;
+		}
+		uint32_t exponent = magnitude >> 23;
+		uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+		uint32_t shift = 126 - exponent;
+		uint32_t half = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1))) {
+			half++;
+		}
+		return (uint16_t)(sign | half);
+	}
+
+	// Rebias the exponent from 127 to 15 and round the 13 dropped mantissa bits, a carry correctly bumps the exponent
+	uint32_t half = (magnitude - 0x38000000) >> 13;
+	uint32_t remainder = magnitude & 0x1FFF;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+		half++;
+	}
+	return (uint16_t)(sign | half);
+}
+
+// The float a half precision one stands for
+float halfToFloat(uint16_t value) {
+	uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1F;
+	uint32_t mantissa = value & 0x3FF;
+	uint32_t bits;
+	if (exponent == 0x1F) {
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else if (exponent != 0) {
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+	else if (mantissa == 0) {
+		bits = sign;
+	}
+	else {
+		// A denormal half is a normal float, shifted until its leading bit becomes the implicit one
+		exponent = 113;
+		while (!(mantissa & 0x400)) {
+			mantissa <<= 1;
+			exponent--;
+		}
+		bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+	}
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+// Octahedral map of a unit vector onto [-1, 1]^2. The upper half of the octahedron maps to the inner diamond,
+// the lower half is folded out over the corners
+glm::vec2 octahedralEncode(const glm::vec3& normal) {
+	float sum = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+	if (sum <= 0.0f) {
+		return glm::vec2(0.0f, 0.0f);
+	}
+	glm::vec2 encoded(normal.x / sum, normal.y / sum);
+	if (normal.z < 0.0f) {
+		encoded = glm::vec2((1.0f - std::fabs(encoded.y)) * (encoded.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::fabs(encoded.x)) * (encoded.y >= 0.0f ? 1.0f : -1.0f));
+	}
+	return encoded;
+}
+
+// Unfolds an octahedral map back to a unit vector, the same steps the OCTAHEDRAL_NORMALS shaders take
+glm::vec3 octahedralDecode(const glm::vec2& encoded) {
+	glm::vec3 normal(encoded.x, encoded.y, 1.0f - std::fabs(encoded.x) - std::fabs(encoded.y));
+	float fold = std::max(-normal.z, 0.0f);
+	normal.x += normal.x >= 0.0f ? -fold : fold;
+	normal.y += normal.y >= 0.0f ? -fold : fold;
+	return glm::normalize(normal);
+}
+
+// Quantizes a value in [0, 1] to 16 bits
+static inline uint16_t quantizeUnorm16(float value) {
+	return (uint16_t)(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f + 0.5f);
+}
+
+// Quantizes a value in [-1, 1] to a signed integer of the given largest magnitude. GL 4.2 and later read it back as
+// value / largest, GL 3.3 drivers that still use (2 * value + 1) / (2 * largest + 1) are off by at most half a step
+static inline int quantizeSnorm(float value, int largest) {
+	return (int)lroundf(std::min(std::max(value, -1.0f), 1.0f) * largest);
+}
+
+// Reads a signed normalized integer the way GL 4.2 and later do
+static inline float dequantizeSnorm(int value, int largest) {
+	return std::max((float)value / largest, -1.0f);
+}
+
+// Octahedral encoding in two 16 bit components. Of the four codes around the exact encoding the one decoding
+// closest to the normal is kept, rounding each component alone can be more than twice as far off. The candidates
+// are a fraction of a thousandth of a degree apart, so they're unfolded and compared in double precision
+static void quantizeOctahedral(const glm::vec3& normal, int16_t code[2]) {
+	glm::vec2 encoded = octahedralEncode(normal);
+	double x = std::floor(std::min(std::max(encoded.x, -1.0f), 1.0f) * 32767.0f);
+	double y = std::floor(std::min(std::max(encoded.y, -1.0f), 1.0f) * 32767.0f);
+	double best = -2.0;
+	for (int corner = 0; corner < 4; corner++) {
+		double candidateX = std::min(x + (corner & 1), 32767.0);
+		double candidateY = std::min(y + (corner >> 1), 32767.0);
+		double unfoldedX = candidateX / 32767.0, unfoldedY = candidateY / 32767.0;
+		double unfoldedZ = 1.0 - std::fabs(unfoldedX) - std::fabs(unfoldedY);
+		double fold = std::max(-unfoldedZ, 0.0);
+		unfoldedX += unfoldedX >= 0.0 ? -fold : fold;
+		unfoldedY += unfoldedY >= 0.0 ? -fold : fold;
+		double cosine = (unfoldedX * normal.x + unfoldedY * normal.y + unfoldedZ * normal.z) / std::sqrt(unfoldedX * unfoldedX + unfoldedY * unfoldedY + unfoldedZ * unfoldedZ);
+		if (cosine > best) {
+			best = cosine;
+			code[0] = (int16_t)candidateX;
+			code[1] = (int16_t)candidateY;
+		}
+	}
+}
+
+// Where positions are stored across for POSITION_UNORM16, a flat axis gets a unit extent so it doesn't divide by zero
+static glm::vec3 quantizationExtent(const PackedVertices& packed) {
+	glm::vec3 extent = packed.boundsMax - packed.boundsMin;
+	for (int axis = 0; axis < 3; axis++) {
+		if (!(extent[axis] > 0.0f)) {
+			extent[axis] = 1.0f;
+		}
+	}
+	return extent;
+}
+
+// Packs one float attribute into the type its layout entry says
+static void packAttribute(const float* source, int size, VertexSemantic semantic, const VertexAttribute& attribute, const glm::vec3& origin, const glm::vec3& inverseExtent, unsigned char* destination) {
+	switch (attribute.type) {
+	case GL_HALF_FLOAT: {
+		uint16_t halves[4] = { 0, 0, 0, 0 };
+		for (int i = 0; i < size; i++) {
+			halves[i] = floatToHalf(source[i]);
+		}
+		memcpy(destination, halves, size * sizeof(uint16_t));
+		break;
+	}
+	case GL_UNSIGNED_SHORT: {
+		uint16_t values[4];
+		for (int i = 0; i < size; i++) {
+			values[i] = quantizeUnorm16(semantic == VERTEX_POSITION ? (source[i] - origin[i]) * inverseExtent[i] : source[i]);
+		}
+		memcpy(destination, values, size * sizeof(uint16_t));
+		break;
+	}
+	case GL_BYTE: {
+		int8_t values[3];
+		for (int i = 0; i < 3; i++) {
+			values[i] = (int8_t)quantizeSnorm(source[i], 127);
+		}
+		memcpy(destination, values, sizeof(values));
+		break;
+	}
+	case GL_INT_2_10_10_10_REV: {
+		// x in the low bits, w's two bits left at zero
+		uint32_t packedValue = 0;
+		for (int i = 0; i < 3; i++) {
+			packedValue |= ((uint32_t)quantizeSnorm(source[i], 511) & 0x3FF) << (10 * i);
+		}
+		memcpy(destination, &packedValue, sizeof(packedValue));
+		break;
+	}
+	case GL_SHORT: {
+		glm::vec3 normal(source[0], source[1], source[2]);
+		float length = glm::length(normal);
+		int16_t code[2] = { 0, 0 };
+		quantizeOctahedral(length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f), code);
+		memcpy(destination, code, sizeof(code));
+		break;
+	}
+	default:
+		memcpy(destination, source, size * sizeof(float));
+		break;
+	}
+}
+
+// Reads one packed attribute back into floats
+static void unpackAttribute(const unsigned char* source, int size, VertexSemantic semantic, const VertexAttribute& attribute, const glm::vec3& origin, const glm::vec3& extent, float* destination) {
+	switch (attribute.type) {
+	case GL_HALF_FLOAT: {
+		uint16_t halves[4];
+		memcpy(halves, source, size * sizeof(uint16_t));
+		for (int i = 0; i < size; i++) {
+			destination[i] = halfToFloat(halves[i]);
+		}
+		break;
+	}
+	case GL_UNSIGNED_SHORT: {
+		uint16_t values[4];
+		memcpy(values, source, size * sizeof(uint16_t));
+		for (int i = 0; i < size; i++) {
+			float value = values[i] / 65535.0f;
+			destination[i] = semantic == VERTEX_POSITION ? origin[i] + value * extent[i] : value;
+		}
+		break;
+	}
+	case GL_BYTE:
+		for (int i = 0; i < 3; i++) {
+			destination[i] = dequantizeSnorm((int8_t)source[i], 127);
+		}
+		break;
+	case GL_INT_2_10_10_10_REV: {
+		uint32_t packedValue;
+		memcpy(&packedValue, source, sizeof(packedValue));
+		for (int i = 0; i < 3; i++) {
+			// Sign extended from 10 bits
+			int value = (int)((packedValue >> (10 * i)) & 0x3FF);
+			destination[i] = dequantizeSnorm(value >= 512 ? value - 1024 : value, 511);
+		}
+		break;
+	}
+	case GL_SHORT: {
+		int16_t code[2];
+		memcpy(code, source, sizeof(code));
+		glm::vec3 normal = octahedralDecode(glm::vec2(dequantizeSnorm(code[0], 32767), dequantizeSnorm(code[1], 32767)));
+		destination[0] = normal.x;
+		destination[1] = normal.y;
+		destination[2] = normal.z;
+		break;
+	}
+	default:
+		memcpy(destination, source, size * sizeof(float));
+		break;
+	}
+}
+
+// Packs interleaved float vertices into a compact layout
+void packVertices(const float* vertices, size_t vertexCount, const std::vector<int>& attributeSizes, const std::vector<VertexSemantic>& semantics, const VertexFormat& format, PackedVertices& packed, ThreadPool* pool) {
+	int floatsPerVertex = 0;
+	std::vector<int> floatOffsets;
+	for (int size : attributeSizes) {
+		floatOffsets.push_back(floatsPerVertex);
+		floatsPerVertex += size;
+	}
+
+	// Bounds of the positions, and whether every texture coordinate fits unorm16
+	packed.boundsMin = glm::vec3(0.0f);
+	packed.boundsMax = glm::vec3(0.0f);
+	bool texCoordsInUnitRange = true;
+	for (size_t attribute = 0; attribute < attributeSizes.size(); attribute++) {
+		if (semantics[attribute] == VERTEX_POSITION && vertexCount > 0) {
+			glm::vec3 low(INFINITY), high(-INFINITY);
+			for (size_t i = 0; i < vertexCount; i++) {
+				const float* position = vertices + i * floatsPerVertex + floatOffsets[attribute];
+				for (int axis = 0; axis < attributeSizes[attribute] && axis < 3; axis++) {
+					low[axis] = std::min(low[axis], position[axis]);
+					high[axis] = std::max(high[axis], position[axis]);
+				}
+			}
+			packed.boundsMin = low;
+			packed.boundsMax = high;
+		}
+		else if (semantics[attribute] == VERTEX_TEXCOORD && format.texCoord == TEXCOORD_UNORM16) {
+			for (size_t i = 0; i < vertexCount * floatsPerVertex && texCoordsInUnitRange; i += floatsPerVertex) {
+				for (int axis = 0; axis < attributeSizes[attribute]; axis++) {
+					float value = vertices[i + floatOffsets[attribute] + axis];
+					texCoordsInUnitRange = texCoordsInUnitRange && value >= 0.0f && value <= 1.0f;
+				}
+			}
+		}
+	}
+
+	// Attribute i at location i, normals only pack as the three floats of a direction
+	packed.layout = VertexLayout();
+	for (size_t attribute = 0; attribute < attributeSizes.size(); attribute++) {
+		uint32_t location = (uint32_t)attribute;
+		uint32_t size = (uint32_t)attributeSizes[attribute];
+		switch (semantics[attribute]) {
+		case VERTEX_POSITION:
+			if (format.position == POSITION_HALF) {
+				addVertexAttribute(packed.layout, location, size, GL_HALF_FLOAT, false);
+			}
+			else if (format.position == POSITION_UNORM16) {
+				addVertexAttribute(packed.layout, location, size, GL_UNSIGNED_SHORT, true);
+			}
+			else {
+				addVertexAttribute(packed.layout, location, size, GL_FLOAT, false);
+			}
+			break;
+		case VERTEX_NORMAL:
+			if (size == 3 && format.normal == NORMAL_SNORM8) {
+				addVertexAttribute(packed.layout, location, 3, GL_BYTE, true);
+			}
+			else if (size == 3 && format.normal == NORMAL_SNORM10) {
+				addVertexAttribute(packed.layout, location, 4, GL_INT_2_10_10_10_REV, true);
+			}
+			else if (size == 3 && format.normal == NORMAL_OCTAHEDRAL16) {
+				addVertexAttribute(packed.layout, location, 2, GL_SHORT, true);
+			}
+			else {
+				addVertexAttribute(packed.layout, location, size, GL_FLOAT, false);
+			}
+			break;
+		case VERTEX_TEXCOORD:
+			if (format.texCoord == TEXCOORD_UNORM16 && texCoordsInUnitRange) {
+				addVertexAttribute(packed.layout, location, size, GL_UNSIGNED_SHORT, true);
+			}
+			else if (format.texCoord != TEXCOORD_FLOAT) {
+				addVertexAttribute(packed.layout, location, size, GL_HALF_FLOAT, false);
+			}
+			else {
+				addVertexAttribute(packed.layout, location, size, GL_FLOAT, false);
+			}
+			break;
+		}
+	}
+
+	glm::vec3 extent = quantizationExtent(packed);
+	packed.dequantization = glm::mat4(1.0f);
+	if (format.position == POSITION_UNORM16) {
+		packed.dequantization = glm::scale(glm::translate(glm::mat4(1.0f), packed.boundsMin), extent);
+	}
+
+	// Padding between attributes is left zeroed
+	packed.vertexCount = vertexCount;
+	packed.data.assign(vertexCount * packed.layout.stride, 0);
+	glm::vec3 inverseExtent = 1.0f / extent;
+	auto packRange = [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			const float* source = vertices + i * floatsPerVertex;
+			unsigned char* destination = packed.data.data() + i * packed.layout.stride;
+			for (size_t attribute = 0; attribute < attributeSizes.size(); attribute++) {
+				const VertexAttribute& entry = packed.layout.attributes[attribute];
+				packAttribute(source + floatOffsets[attribute], attributeSizes[attribute], semantics[attribute], entry, packed.boundsMin, inverseExtent, destination + entry.offset);
+			}
+		}
+	};
+	if (pool) {
+		pool->parallelFor(vertexCount, PACK_GRAIN_SIZE, packRange);
+	}
+	else {
+		packRange(0, vertexCount);
+	}
+}
+
+// Reads packed vertices back into floats
+void unpackVertices(const PackedVertices& packed, const std::vector<int>& attributeSizes, const std::vector<VertexSemantic>& semantics, std::vector<float>& vertices) {
+	int floatsPerVertex = 0;
+	for (int size : attributeSizes) {
+		floatsPerVertex += size;
+	}
+	glm::vec3 extent = quantizationExtent(packed);
+	vertices.resize(packed.vertexCount * floatsPerVertex);
+	for (size_t i = 0; i < packed.vertexCount; i++) {
+		const unsigned char* source = packed.data.data() + i * packed.layout.stride;
+		float* destination = vertices.data() + i * floatsPerVertex;
+		for (size_t attribute = 0; attribute < attributeSizes.size(); attribute++) {
+			const VertexAttribute& entry = packed.layout.attributes[attribute];
+			unpackAttribute(source + entry.offset, attributeSizes[attribute], semantics[attribute], entry, packed.boundsMin, extent, destination);
+			destination += attributeSizes[attribute];
+		}
+	}
+}
+
+// Angle between two directions in radians. Taken from the cross and dot products in double precision, an acos of a
+// float dot product can't resolve anything under a few hundredths of a degree
+static double angleBetween(const glm::vec3& a, const glm::vec3& b) {
+	double crossX = (double)a.y * b.z - (double)a.z * b.y;
+	double crossY = (double)a.z * b.x - (double)a.x * b.z;
+	double crossZ = (double)a.x * b.y - (double)a.y * b.x;
+	double dot = (double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z;
+	return std::atan2(std::sqrt(crossX * crossX + crossY * crossY + crossZ * crossZ), dot);
+}
+
+// Compares float vertices with what the GPU reads from their packed version
+VertexPackingError measurePackingError(const float* vertices, size_t vertexCount, const std::vector<int>& attributeSizes, const std::vector<VertexSemantic>& semantics, const PackedVertices& packed) {
+	std::vector<float> unpacked;
+	unpackVertices(packed, attributeSizes, semantics, unpacked);
+
+	VertexPackingError error = VertexPackingError();
+	size_t offset = 0;
+	for (size_t i = 0; i < vertexCount; i++) {
+		for (size_t attribute = 0; attribute < attributeSizes.size(); attribute++) {
+			const float* original = vertices + offset;
+			const float* read = unpacked.data() + offset;
+			int size = attributeSizes[attribute];
+			offset += size;
+			if (semantics[attribute] == VERTEX_NORMAL && size == 3) {
+				// Shaders normalize whatever they read, so only the direction counts. Zero normals have none
+				glm::vec3 expected(original[0], original[1], original[2]);
+				glm::vec3 actual(read[0], read[1], read[2]);
+				if (glm::length(expected) > 0.0f && glm::length(actual) > 0.0f) {
+					error.normalDegrees = std::max(error.normalDegrees, glm::degrees((float)angleBetween(expected, actual)));
+				}
+				continue;
+			}
+			float& largest = semantics[attribute] == VERTEX_POSITION ? error.position : error.texCoord;
+			for (int component = 0; component < size; component++) {
+				largest = std::max(largest, std::fabs(original[component] - read[component]));
+			}
+		}
+	}
+	return error;
+}
@@ -0,0 +1,131 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "thread_pool.h"
+
+// Most attributes a layout describes
+static const int MAX_VERTEX_ATTRIBUTES = 8;
+
+// Where one attribute sits in an interleaved vertex and how the GPU reads it. Plain data with fixed sized fields
+// so a layout can be written to and mapped from a file as it is
+struct VertexAttribute {
+	uint32_t location;
+	uint32_t components;
+	// GL component type such as GL_FLOAT or GL_UNSIGNED_SHORT
+	uint32_t type;
+	// Integer types are scaled to [0, 1] or [-1, 1] rather than read as whole numbers
+	uint32_t normalized;
+	uint32_t offset;
+};
+
+// Interleaved vertex layout, attributes in the order they appear in a vertex
+struct VertexLayout {
+	uint32_t stride;
+	uint32_t attributeCount;
+	VertexAttribute attributes[MAX_VERTEX_ATTRIBUTES];
+};
+
+// What an attribute of a float vertex holds, which decides how it can be packed
+enum VertexSemantic {
+	VERTEX_POSITION,
+	VERTEX_NORMAL,
+	VERTEX_TEXCOORD
+};
+
+// How positions are stored once packed
+enum PositionFormat {
+	POSITION_FLOAT,
+	// 3 half floats padded to 8 bytes, exact for small integers and halves such as a unit cube's corners
+	POSITION_HALF,
+	// 16 bits per axis across the mesh's bounds, taken back into them by the dequantization transform
+	POSITION_UNORM16
+};
+
+// How normals are stored once packed
+enum NormalFormat {
+	NORMAL_FLOAT,
+	// 8 bits per axis, padded to 4 bytes
+	NORMAL_SNORM8,
+	// 10 bits per axis in a GL_INT_2_10_10_10_REV, read as a vec3 like the float layout
+	NORMAL_SNORM10,
+	// Octahedral map of the unit sphere onto two 16 bit components, the shader unfolds it (OCTAHEDRAL_NORMALS)
+	NORMAL_OCTAHEDRAL16
+};
+
+// How texture coordinates are stored once packed
+enum TexCoordFormat {
+	TEXCOORD_FLOAT,
+	TEXCOORD_HALF,
+	// 16 bits per axis over [0, 1], meshes with coordinates outside it get half floats instead
+	TEXCOORD_UNORM16
+};
+
+// Storage picked for each kind of attribute
+struct VertexFormat {
+	PositionFormat position;
+	NormalFormat normal;
+	TexCoordFormat texCoord;
+};
+
+// Float vertices packed into a compact interleaved layout
+struct PackedVertices {
+	std::vector<unsigned char> data;
+	VertexLayout layout;
+	size_t vertexCount;
+	// Bounds of the positions the unorm16 ones are stored across
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	// Takes positions as the GPU reads them back into the mesh's space. Goes in front of the model matrix, it's
+	// the identity unless positions are POSITION_UNORM16
+	glm::mat4 dequantization;
+};
+
+// Largest differences between float vertices and their packed version as the GPU reads it
+struct VertexPackingError {
+	// In the mesh's units, after dequantization
+	float position;
+	float normalDegrees;
+	float texCoord;
+};
+
+// Bytes one component of a GL type takes
+size_t vertexComponentBytes(GLenum type);
+
+// Bytes a whole attribute takes, packed types such as GL_INT_2_10_10_10_REV hold all their components in 4 bytes
+size_t vertexAttributeBytes(uint32_t components, GLenum type);
+
+// Appends an attribute after the last one, padded to 4 bytes, and grows the stride to match
+void addVertexAttribute(VertexLayout& layout, uint32_t location, uint32_t components, GLenum type, bool normalized);
+
+// Points and enables every attribute of the layout at the buffer bound to GL_ARRAY_BUFFER, for the bound VAO
+void applyVertexLayout(const VertexLayout& layout);
+
+// Nearest half precision float, for GL_HALF_FLOAT attributes
+uint16_t floatToHalf(float value);
+
+// The float a half precision one stands for
+float halfToFloat(uint16_t value);
+
+// Packs interleaved float vertices, attribute i with attributeSizes[i] floats holding semantics[i] and going to
+// location i, the way Mesh lays them out. With a pool the vertices are packed in parallel ranges
+void packVertices(const float* vertices, size_t vertexCount, const std::vector<int>& attributeSizes, const std::vector<VertexSemantic>& semantics, const VertexFormat& format, PackedVertices& packed, ThreadPool* pool = nullptr);
+
+// Reads packed vertices back into the float layout they were packed from, the way the GPU converts them, with the
+// dequantization applied and octahedral normals unfolded
+void unpackVertices(const PackedVertices& packed, const std::vector<int>& attributeSizes, const std::vector<VertexSemantic>& semantics, std::vector<float>& vertices);
+
+// Compares float vertices with what the GPU reads from their packed version
+VertexPackingError measurePackingError(const float* vertices, size_t vertexCount, const std::vector<int>& attributeSizes, const std::vector<VertexSemantic>& semantics, const PackedVertices& packed);
+
+// Octahedral map of a unit vector onto [-1, 1]^2 and back
+glm::vec2 octahedralEncode(const glm::vec3& normal);
+glm::vec3 octahedralDecode(const glm::vec2& encoded);
+
+#endif
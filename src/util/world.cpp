@@ -0,0 +1,299 @@
+#include "world.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+// Size of each component, indexed by ComponentType
+static const size_t COMPONENT_SIZES[COMPONENT_TYPE_COUNT] = {
+	sizeof(TransformComponent),
+	sizeof(MeshComponent),
+	sizeof(MaterialComponent),
+	sizeof(BoundsComponent),
+	sizeof(LightComponent),
+	sizeof(NodeComponent)
+};
+
+// Component arrays start on this boundary so SIMD loads of them never straddle it
+static const size_t COLUMN_ALIGNMENT = 16;
+// Chunks start on a cache line
+static const size_t CHUNK_ALIGNMENT = 64;
+// Archetype of a free slot
+static const uint32_t NO_ARCHETYPE = 0xFFFFFFFFu;
+
+// Rounds up to a multiple of COLUMN_ALIGNMENT
+static size_t alignColumn(size_t offset) {
+	return (offset + COLUMN_ALIGNMENT - 1) & ~(COLUMN_ALIGNMENT - 1);
+}
+
+World::World() : liveCount(0) {
+}
+
+// Frees every chunk, in use or kept for reuse
+World::~World() {
+	for (Archetype& archetype : archetypes) {
+		for (unsigned char* chunk : archetype.chunks) {
+			::operator delete(chunk, std::align_val_t(CHUNK_ALIGNMENT));
+		}
+	}
+	for (unsigned char* chunk : freeChunks) {
+		::operator delete(chunk, std::align_val_t(CHUNK_ALIGNMENT));
+	}
+}
+
+// Creates an entity in the archetype of its components, reusing the most recently freed slot
+Entity World::create(ComponentMask components) {
+	uint32_t archetype = findArchetype(components);
+
+	uint32_t index;
+	if (!freeSlots.empty()) {
+		index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else {
+		index = (uint32_t)slots.size();
+		slots.push_back(Slot{ 0, NO_ARCHETYPE, 0 });
+	}
+
+	Entity entity = { index, slots[index].generation };
+	slots[index].archetype = archetype;
+	slots[index].row = appendRow(archetype, entity);
+	liveCount++;
+	return entity;
+}
+
+// Destroys an entity, bumping its slot's generation so existing handles to it go stale
+bool World::destroy(Entity entity) {
+	if (!isAlive(entity)) {
+		return false;
+	}
+	Slot& slot = slots[entity.index];
+	removeRow(slot.archetype, slot.row);
+	slot.generation++;
+	slot.archetype = NO_ARCHETYPE;
+	freeSlots.push_back(entity.index);
+	liveCount--;
+	return true;
+}
+
+// True while the entity the handle was made for hasn't been destroyed
+bool World::isAlive(Entity entity) const {
+	return entity.index < slots.size() && slots[entity.index].generation == entity.generation && slots[entity.index].archetype != NO_ARCHETYPE;
+}
+
+// Moves an entity to the archetype of its new components, copying the ones it keeps
+bool World::setComponents(Entity entity, ComponentMask components) {
+	if (!isAlive(entity)) {
+		return false;
+	}
+	uint32_t from = slots[entity.index].archetype;
+	uint32_t to = findArchetype(components);
+	if (from == to) {
+		return true;
+	}
+
+	uint32_t oldRow = slots[entity.index].row;
+	uint32_t newRow = appendRow(to, entity);
+	ComponentMask kept = archetypes[from].mask & archetypes[to].mask;
+	for (int type = 0; type < COMPONENT_TYPE_COUNT; type++) {
+		if (kept & componentBit((ComponentType)type)) {
+			memcpy(rowData(archetypes[to], newRow, type), rowData(archetypes[from], oldRow, type), COMPONENT_SIZES[type]);
+		}
+	}
+	removeRow(from, oldRow);
+
+	slots[entity.index].archetype = to;
+	slots[entity.index].row = newRow;
+	return true;
+}
+
+// Components of an entity, 0 if the handle is stale
+ComponentMask World::components(Entity entity) const {
+	if (!isAlive(entity)) {
+		return 0;
+	}
+	return archetypes[slots[entity.index].archetype].mask;
+}
+
+// One component of an entity, null if it's stale or doesn't have it
+void* World::component(Entity entity, ComponentType type) {
+	return const_cast<void*>(static_cast<const World*>(this)->component(entity, type));
+}
+
+// One component of an entity, null if it's stale or doesn't have it
+const void* World::component(Entity entity, ComponentType type) const {
+	if (!isAlive(entity)) {
+		return nullptr;
+	}
+	const Slot& slot = slots[entity.index];
+	const Archetype& archetype = archetypes[slot.archetype];
+	if (!(archetype.mask & componentBit(type))) {
+		return nullptr;
+	}
+	return rowData(archetype, slot.row, type);
+}
+
+// Number of entities
+size_t World::size() const {
+	return liveCount;
+}
+
+// Number of entities with at least the required components
+size_t World::count(ComponentMask required) const {
+	size_t total = 0;
+	for (const Archetype& archetype : archetypes) {
+		if ((archetype.mask & required) == required) {
+			total += archetype.count;
+		}
+	}
+	return total;
+}
+
+// Collects the matching chunks, then runs body on each, one chunk per parallelFor range
+void World::forEachChunk(ComponentMask required, const std::function<void(const ChunkView&)>& body, ThreadPool* pool) {
+	std::vector<ChunkView> views;
+	size_t firstIndex = 0;
+	for (const Archetype& archetype : archetypes) {
+		if ((archetype.mask & required) != required) {
+			continue;
+		}
+		for (size_t chunk = 0; chunk * archetype.capacity < archetype.count; chunk++) {
+			ChunkView view;
+			view.count = std::min((size_t)archetype.capacity, archetype.count - chunk * archetype.capacity);
+			view.firstIndex = firstIndex;
+			view.entities = (const Entity*)archetype.chunks[chunk];
+			for (int type = 0; type < COMPONENT_TYPE_COUNT; type++) {
+				view.columns[type] = (archetype.mask & componentBit((ComponentType)type)) ? archetype.chunks[chunk] + archetype.offsets[type] : nullptr;
+			}
+			views.push_back(view);
+			firstIndex += view.count;
+		}
+	}
+
+	if (pool == nullptr) {
+		for (const ChunkView& view : views) {
+			body(view);
+		}
+		return;
+	}
+	pool->parallelFor(views.size(), 1, [&views, &body](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			body(views[i]);
+		}
+	});
+}
+
+// Chunks holding entities
+size_t World::chunkCount() const {
+	size_t total = 0;
+	for (const Archetype& archetype : archetypes) {
+		total += archetype.chunks.size();
+	}
+	return total;
+}
+
+// Chunks kept for reuse
+size_t World::freeChunkCount() const {
+	return freeChunks.size();
+}
+
+// Archetypes seen so far
+size_t World::archetypeCount() const {
+	return archetypes.size();
+}
+
+// Finds the archetype of a set of components, laying out a new one the first time
+uint32_t World::findArchetype(ComponentMask mask) {
+	for (size_t i = 0; i < archetypes.size(); i++) {
+		if (archetypes[i].mask == mask) {
+			return (uint32_t)i;
+		}
+	}
+
+	size_t rowBytes = sizeof(Entity);
+	for (int type = 0; type < COMPONENT_TYPE_COUNT; type++) {
+		if (mask & componentBit((ComponentType)type)) {
+			rowBytes += COMPONENT_SIZES[type];
+		}
+	}
+
+	// As many rows as fit once every array is padded to its alignment
+	Archetype archetype;
+	archetype.mask = mask;
+	archetype.count = 0;
+	archetype.capacity = (uint32_t)(CHUNK_BYTES / rowBytes) + 1;
+	size_t end;
+	do {
+		archetype.capacity--;
+		end = archetype.capacity * sizeof(Entity);
+		for (int type = 0; type < COMPONENT_TYPE_COUNT; type++) {
+			archetype.offsets[type] = 0;
+			if (mask & componentBit((ComponentType)type)) {
+				end = alignColumn(end);
+				archetype.offsets[type] = (uint32_t)end;
+				end += archetype.capacity * COMPONENT_SIZES[type];
+			}
+		}
+	} while (end > CHUNK_BYTES);
+
+	archetypes.push_back(archetype);
+	return (uint32_t)(archetypes.size() - 1);
+}
+
+// Appends a zeroed row, taking a chunk from the free list when the last one is full
+uint32_t World::appendRow(uint32_t archetypeIndex, Entity entity) {
+	Archetype& archetype = archetypes[archetypeIndex];
+	if (archetype.count == archetype.chunks.size() * archetype.capacity) {
+		unsigned char* chunk;
+		if (!freeChunks.empty()) {
+			chunk = freeChunks.back();
+			freeChunks.pop_back();
+		}
+		else {
+			chunk = (unsigned char*)::operator new(CHUNK_BYTES, std::align_val_t(CHUNK_ALIGNMENT));
+		}
+		archetype.chunks.push_back(chunk);
+	}
+
+	uint32_t row = (uint32_t)archetype.count++;
+	memcpy(rowData(archetype, row, COMPONENT_TYPE_COUNT), &entity, sizeof(Entity));
+	for (int type = 0; type < COMPONENT_TYPE_COUNT; type++) {
+		if (archetype.mask & componentBit((ComponentType)type)) {
+			memset(rowData(archetype, row, type), 0, COMPONENT_SIZES[type]);
+		}
+	}
+	return row;
+}
+
+// Fills the hole with the last row so the archetype stays dense, and hands back its last chunk once that's empty
+void World::removeRow(uint32_t archetypeIndex, uint32_t row) {
+	Archetype& archetype = archetypes[archetypeIndex];
+	uint32_t last = (uint32_t)(archetype.count - 1);
+	if (row != last) {
+		Entity moved;
+		memcpy(&moved, rowData(archetype, last, COMPONENT_TYPE_COUNT), sizeof(Entity));
+		memcpy(rowData(archetype, row, COMPONENT_TYPE_COUNT), &moved, sizeof(Entity));
+		for (int type = 0; type < COMPONENT_TYPE_COUNT; type++) {
+			if (archetype.mask & componentBit((ComponentType)type)) {
+				memcpy(rowData(archetype, row, type), rowData(archetype, last, type), COMPONENT_SIZES[type]);
+			}
+		}
+		slots[moved.index].row = row;
+	}
+
+	archetype.count--;
+	if (archetype.count <= (archetype.chunks.size() - 1) * archetype.capacity) {
+		freeChunks.push_back(archetype.chunks.back());
+		archetype.chunks.pop_back();
+	}
+}
+
+// Address of a row's component, or its entity handle with COMPONENT_TYPE_COUNT
+unsigned char* World::rowData(const Archetype& archetype, uint32_t row, int type) const {
+	unsigned char* chunk = archetype.chunks[row / archetype.capacity];
+	size_t index = row % archetype.capacity;
+	if (type == COMPONENT_TYPE_COUNT) {
+		return chunk + index * sizeof(Entity);
+	}
+	return chunk + archetype.offsets[type] + index * COMPONENT_SIZES[type];
+}
@@ -0,0 +1,212 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "frustum.h"
+#include "thread_pool.h"
+
+// Kinds of component an entity can have
+enum ComponentType {
+	COMPONENT_TRANSFORM,
+	COMPONENT_MESH,
+	COMPONENT_MATERIAL,
+	COMPONENT_BOUNDS,
+	COMPONENT_LIGHT,
+	COMPONENT_NODE,
+	COMPONENT_TYPE_COUNT
+};
+
+// Set of component types, bit n standing for ComponentType n
+typedef uint32_t ComponentMask;
+
+// Mask holding one component type
+inline ComponentMask componentBit(ComponentType type) {
+	return 1u << type;
+}
+
+// Where an entity is, its model matrix is translate(position) * rotate(time * spinSpeed, spinAxis) * scale(scale)
+struct TransformComponent {
+	static const ComponentType TYPE = COMPONENT_TRANSFORM;
+	glm::vec3 position;
+	glm::vec3 scale;
+	// Normalized, turned about at spinSpeed radians per second. A speed of zero keeps the entity still
+	glm::vec3 spinAxis;
+	float spinSpeed;
+};
+
+// Render queue geometry an entity is drawn with
+struct MeshComponent {
+	static const ComponentType TYPE = COMPONENT_MESH;
+	int geometry;
+};
+
+// Render queue material an entity is drawn with
+struct MaterialComponent {
+	static const ComponentType TYPE = COMPONENT_MATERIAL;
+	int material;
+};
+
+// World space box holding everything the entity covers while it moves, for culling
+struct BoundsComponent {
+	static const ComponentType TYPE = COMPONENT_BOUNDS;
+	AABB box;
+};
+
+// Point light shining from the entity's position
+struct LightComponent {
+	static const ComponentType TYPE = COMPONENT_LIGHT;
+	glm::vec3 color;
+};
+
+// Node of a TransformHierarchy whose world matrix places the entity, for entities that only move when told to
+struct NodeComponent {
+	static const ComponentType TYPE = COMPONENT_NODE;
+	uint32_t node;
+};
+
+// Handle to an entity. Slots of destroyed entities are reused, the generation tells a handle to the current entity
+// apart from handles to the ones that had the slot before
+struct Entity {
+	uint32_t index;
+	uint32_t generation;
+};
+
+inline bool operator==(const Entity& a, const Entity& b) {
+	return a.index == b.index && a.generation == b.generation;
+}
+
+inline bool operator!=(const Entity& a, const Entity& b) {
+	return !(a == b);
+}
+
+// Handle that never refers to an entity
+static const Entity NULL_ENTITY = { 0xFFFFFFFFu, 0 };
+
+// One chunk of entities as a system sees it: count entities, each component of their archetype in its own array
+struct ChunkView {
+	size_t count;
+	// Position of the chunk's first entity among all the entities the iteration visits, for writing results to flat arrays
+	size_t firstIndex;
+	const Entity* entities;
+	// Null for components the archetype doesn't have
+	void* columns[COMPONENT_TYPE_COUNT];
+
+	// The array of one component, such as chunk.get<TransformComponent>()
+	template <typename T>
+	T* get() const {
+		return (T*)columns[T::TYPE];
+	}
+};
+
+// Entities and their components, stored by archetype: every entity with the same set of components lives in the
+// same archetype, whose entities are packed into fixed size chunks with each component in its own array. Systems
+// walk the chunks of the archetypes they need, touching only the components they use, and can spread the chunks
+// over a thread pool.
+//
+// Archetypes are kept dense: destroying an entity moves its archetype's last entity into the hole, and chunks that
+// empty out go to a free list every archetype allocates from, so creating and destroying entities in any order never
+// fragments memory. Handles stay valid when entities move, component pointers don't.
+class World {
+public:
+	// Size of a chunk of entities
+	static const size_t CHUNK_BYTES = 16 * 1024;
+
+	World();
+	~World();
+
+	World(const World&) = delete;
+	World& operator=(const World&) = delete;
+
+	// Creates an entity with the components in the mask, all zeroed
+	Entity create(ComponentMask components);
+
+	// Destroys an entity. Returns false if the handle is stale
+	bool destroy(Entity entity);
+
+	// True while the entity the handle was made for hasn't been destroyed
+	bool isAlive(Entity entity) const;
+
+	// Gives an entity a new set of components, moving it to that archetype. Components it keeps keep their values,
+	// new ones are zeroed. Returns false if the handle is stale
+	bool setComponents(Entity entity, ComponentMask components);
+
+	// Components of an entity, 0 if the handle is stale
+	ComponentMask components(Entity entity) const;
+
+	// One component of an entity, null if the handle is stale or the entity doesn't have it. Valid until the next
+	// create, destroy or setComponents
+	void* component(Entity entity, ComponentType type);
+	const void* component(Entity entity, ComponentType type) const;
+
+	// Typed versions, such as world.get<TransformComponent>(entity)
+	template <typename T>
+	T* get(Entity entity) {
+		return (T*)component(entity, T::TYPE);
+	}
+	template <typename T>
+	const T* get(Entity entity) const {
+		return (const T*)component(entity, T::TYPE);
+	}
+
+	// Number of entities
+	size_t size() const;
+
+	// Number of entities with at least the components in required
+	size_t count(ComponentMask required) const;
+
+	// Calls body once for each chunk of the archetypes having at least the components in required. With a pool the
+	// chunks are spread over its threads, so body must only write to the entities of its own chunk. Entities can't be
+	// created or destroyed during the iteration
+	void forEachChunk(ComponentMask required, const std::function<void(const ChunkView&)>& body, ThreadPool* pool = nullptr);
+
+	// Chunks holding entities, chunks kept for reuse, and archetypes seen so far
+	size_t chunkCount() const;
+	size_t freeChunkCount() const;
+	size_t archetypeCount() const;
+
+private:
+	// Entities sharing one set of components
+	struct Archetype {
+		ComponentMask mask;
+		// Entities per chunk
+		uint32_t capacity;
+		// Byte offset of each component's array within a chunk, the entity handles come first
+		uint32_t offsets[COMPONENT_TYPE_COUNT];
+		std::vector<unsigned char*> chunks;
+		// Entities, all chunks but the last are full
+		size_t count;
+	};
+
+	// Where an entity lives, or the generation the next entity in the slot gets when it's free
+	struct Slot {
+		uint32_t generation;
+		uint32_t archetype;
+		uint32_t row;
+	};
+
+	std::vector<Archetype> archetypes;
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+	std::vector<unsigned char*> freeChunks;
+	size_t liveCount;
+
+	// Index of the archetype with exactly the components in mask, made the first time it's asked for
+	uint32_t findArchetype(ComponentMask mask);
+
+	// Appends a zeroed row for entity to an archetype and returns it
+	uint32_t appendRow(uint32_t archetype, Entity entity);
+
+	// Removes a row, moving the archetype's last row into it
+	void removeRow(uint32_t archetype, uint32_t row);
+
+	// Address of a row's component, or its entity handle with COMPONENT_TYPE_COUNT
+	unsigned char* rowData(const Archetype& archetype, uint32_t row, int type) const;
+};
+
+#endif